@@ -0,0 +1,85 @@
+// ----------------------------------------------------------------------------
+// Task: Sample distance of a subtree into a sparse brick volume (see
+// distance_field_baking_pass.h).
+//
+// Baking is done in two stages:
+//   1. [Coarse] Distance is sampled at the center of each cell of the grid,
+//      CPU decides which cells are close enough to the surface to get a brick.
+//   2. [Bricks] Each brick is filled with BAKED_BRICK_SIZE^3 samples, border
+//      samples lie on the faces of the cell, so that neighbouring bricks are
+//      continuous.
+//
+// Samples are taken in the space of the baked geometry, distances are divided
+// by its scale (the same way, as SDF is scaled by the draw program).
+//
+// Please, note! This is not a full shader, it's included into a generated by
+// geometry code. This code lacks bakedSubtreeDistance() function.
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = DISTANCE_FIELD_BAKING_LOCAL_SIZE) in;
+
+// Coarse stage: output (distance, geometry ID) per cell,
+// bricks stage: input index of the cell per brick (in x)
+layout(std430, binding = DISTANCE_FIELD_BAKING_SSBO_BINDING) buffer DistanceFieldBakingSSBO
+{
+  float2 cells[];
+};
+
+layout(rg32f, binding = 0) uniform writeonly image3D bricksAtlas;
+
+uniform uint32 bakingStage;
+uniform uint32 bakedGeometryID;
+uniform uint32 itemsCount;
+uniform float3 boundsMin;
+uniform float32 cellSize;
+uniform int3 gridSize;
+uniform int32 atlasBricksPerAxis;
+
+int3 cellIndexToCoord(uint32 cellIndex)
+{
+  int32 index = int32(cellIndex);
+  return int3(index % gridSize.x, (index / gridSize.x) % gridSize.y, index / (gridSize.x * gridSize.y));
+}
+
+float2 sampleSubtree(float3 tp)
+{
+  float3 p = geo[bakedGeometryID].scale.xyz * (geo[bakedGeometryID].geoWorldMat * float4(tp, 1.0)).xyz;
+  float2 result = bakedSubtreeDistance(p);
+
+  return float2(result.x / geo[bakedGeometryID].scale.x, result.y);
+}
+
+void main()
+{
+  uint32 index = gl_GlobalInvocationID.x;
+  if(index >= itemsCount)
+  {
+    return;
+  }
+
+  if(bakingStage == DISTANCE_FIELD_BAKING_STAGE_COARSE)
+  {
+    float3 tp = boundsMin + (float3(cellIndexToCoord(index)) + 0.5) * cellSize;
+    cells[index] = sampleSubtree(tp);
+  }
+  else
+  {
+    const uint32 samplesPerBrick = BAKED_BRICK_SIZE * BAKED_BRICK_SIZE * BAKED_BRICK_SIZE;
+
+    int32 brick = int32(index / samplesPerBrick);
+    int32 sampleIndex = int32(index % samplesPerBrick);
+
+    int3 sampleCoord = int3(sampleIndex % BAKED_BRICK_SIZE,
+                            (sampleIndex / BAKED_BRICK_SIZE) % BAKED_BRICK_SIZE,
+                            sampleIndex / (BAKED_BRICK_SIZE * BAKED_BRICK_SIZE));
+
+    int3 cell = cellIndexToCoord(floatBitsToUint(cells[brick].x));
+    float3 tp = boundsMin + (float3(cell) + float3(sampleCoord) / float32(BAKED_BRICK_SIZE - 1)) * cellSize;
+
+    int3 brickCoord = int3(brick % atlasBricksPerAxis,
+                           (brick / atlasBricksPerAxis) % atlasBricksPerAxis,
+                           brick / (atlasBricksPerAxis * atlasBricksPerAxis));
+
+    imageStore(bricksAtlas, brickCoord * BAKED_BRICK_SIZE + sampleCoord, float4(sampleSubtree(tp), 0.0, 0.0));
+  }
+}
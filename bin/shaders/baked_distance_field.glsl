@@ -0,0 +1,67 @@
+// ----------------------------------------------------------------------------
+// Sampling of a baked distance field (see distance_field_baking_pass.h).
+//
+// Bounds of the field are split into a coarse grid of cells. A cell near the
+// surface points to a brick of BAKED_BRICK_SIZE^3 samples in the atlas, which
+// is sampled trilinearly. Other cells store a single conservative distance.
+//
+// Please, note! This is not a full shader, it's included into a generated by
+// geometry code.
+// ----------------------------------------------------------------------------
+
+#ifndef BAKED_DISTANCE_FIELD_GLSL_INCLUDED
+#define BAKED_DISTANCE_FIELD_GLSL_INCLUDED
+
+// x - distance, y - index of the brick or -1 if the cell is empty, z - geometry ID
+layout(binding = BAKED_INDIRECTION_TEXTURE_UNIT) uniform sampler3D bakedIndirectionMap;
+// x - distance, y - geometry ID
+layout(binding = BAKED_BRICKS_TEXTURE_UNIT) uniform sampler3D bakedBricksAtlas;
+
+uniform float3 bakedBoundsMin;
+uniform float32 bakedCellSize;
+uniform int3 bakedGridSize;
+uniform int32 bakedAtlasBricksPerAxis;
+
+/**
+ * @param p point in the space of the baked geometry
+ * @return (distance, geometry ID)
+ */
+float2 sampleBakedDistanceField(float3 p)
+{
+  float3 q = (p - bakedBoundsMin) / bakedCellSize;
+  float3 clampedQ = clamp(q, float3(0.0), float3(bakedGridSize));
+
+  // NOTE: Bounds have a margin of one cell around the surface, so it's safe to step a half of
+  // the cell further than the bounds
+  if(any(notEqual(q, clampedQ)))
+  {
+    float32 outsideDistance = length(q - clampedQ) * bakedCellSize;
+    int3 cell = min(int3(clampedQ), bakedGridSize - 1);
+
+    return float2(outsideDistance + bakedCellSize * 0.5, texelFetch(bakedIndirectionMap, cell, 0).z);
+  }
+
+  int3 cell = min(int3(q), bakedGridSize - 1);
+  float4 indirection = texelFetch(bakedIndirectionMap, cell, 0);
+  if(indirection.y < 0.0)
+  {
+    return indirection.xz;
+  }
+
+  // NOTE: Draw programs are formatted by sprintf() after generation, so modulo operator can't be used
+  int32 brick = int32(indirection.y);
+  int32 bricksPerLayer = bakedAtlasBricksPerAxis * bakedAtlasBricksPerAxis;
+  int32 brickInLayer = brick - (brick / bricksPerLayer) * bricksPerLayer;
+  int3 brickCoord = int3(brickInLayer - (brickInLayer / bakedAtlasBricksPerAxis) * bakedAtlasBricksPerAxis,
+                         brickInLayer / bakedAtlasBricksPerAxis,
+                         brick / bricksPerLayer);
+
+  float3 texel = float3(brickCoord * BAKED_BRICK_SIZE) + (q - float3(cell)) * float32(BAKED_BRICK_SIZE - 1);
+
+  float32 distance = textureLod(bakedBricksAtlas, (texel + 0.5) / float3(textureSize(bakedBricksAtlas, 0)), 0).x;
+  float32 id = texelFetch(bakedBricksAtlas, int3(round(texel)), 0).y;
+
+  return float2(distance, id);
+}
+
+#endif
@@ -0,0 +1,40 @@
+// ----------------------------------------------------------------------------
+// Task: Find the distance at which a ray of a batch hits the surface of a leaf
+// geometry by sphere tracing its distance (see scenePick()). Code of transform()
+// is generated before the file is included, the ray is traced only inside of
+// the interval, where it's in bounds of the geometry.
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = 1, local_size_y = 1) in;
+
+// NOTE: Hits of all rays of the batch, they're read back at once (see rayHitPassReadHits())
+layout(std430, binding = RAY_HIT_SSBO_BINDING) buffer RayHitBuffer
+{
+  float32 hitDistances[];
+};
+
+layout(location = 1) uniform float3 rayOrigin;
+// NOTE: Direction is normalized, so distances of the geometry are distances along the ray
+layout(location = 2) uniform float3 rayDirection;
+layout(location = 3) uniform float2 rayInterval;
+layout(location = 4) uniform uint32 rayIndex;
+
+#define RAY_HIT_MAX_STEPS 512
+
+void main()
+{
+  float32 t = rayInterval.x;
+  for(uint32 i = 0; i < RAY_HIT_MAX_STEPS && t <= rayInterval.y; i++)
+  {
+    float32 d = transform(rayOrigin + rayDirection * t);
+
+    // NOTE: Ray, which starts inside of the geometry, hits it right away
+    if(d < params.intersectionThreshold)
+    {
+      hitDistances[rayIndex] = t;
+      return;
+    }
+
+    t += d;
+  }
+}
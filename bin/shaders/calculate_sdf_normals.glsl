@@ -0,0 +1,42 @@
+// ----------------------------------------------------------------------------
+// Task: Calculate the exact normal of the surface of a leaf geometry by
+// tetrahedral central differences of its distance. Code of transform() is
+// generated before the file is included, pixels of other geometries are kept.
+// ----------------------------------------------------------------------------
+
+layout(location = 0) out float3 outNormal;
+
+layout(location = 0) uniform sampler2D depthMap;
+layout(location = 1) uniform usampler2D idsMap;
+
+// NOTE: Surface which is farther from the leaf (in pixel footprints) is produced by operations of
+// its parents (e.g subtraction or ODFs of a branch), so the normal reconstructed from depth is kept
+#define LEAF_SURFACE_TOLERANCE 2.0
+
+void main()
+{
+  int2 ifragCoord = int2(gl_FragCoord.xy);
+  if(texelFetch(idsMap, ifragCoord, 0).r != geometryID)
+  {
+    discard;
+  }
+
+  float3 p = getWorldPos(fragCoordToUV(gl_FragCoord.xy), ifragCoord, depthMap);
+
+  // NOTE: Step of differences is a fraction of the pixel footprint, so that details smaller than a
+  // pixel don't alias
+  float3 neighbourPos = getWorldPos(fragCoordToUV(gl_FragCoord.xy + float2(1.0, 0.0)), ifragCoord, depthMap);
+  float32 footprint = max(distance(p, neighbourPos), INT_DISTANCE);
+  float32 h = 0.5 * footprint;
+
+  if(abs(transform(p)) > LEAF_SURFACE_TOLERANCE * max(footprint, params.intersectionThreshold))
+  {
+    discard;
+  }
+
+  const float2 k = float2(1.0, -1.0);
+  outNormal = normalize(k.xyy * transform(p + k.xyy * h) +
+                        k.yyx * transform(p + k.yyx * h) +
+                        k.yxy * transform(p + k.yxy * h) +
+                        k.xxx * transform(p + k.xxx * h));
+}
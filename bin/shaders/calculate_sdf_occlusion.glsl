@@ -0,0 +1,64 @@
+// ----------------------------------------------------------------------------
+// Task: Sample the distance of a leaf (or of a baked subtree, or of a branch
+// which isn't a union) at a few fixed points along the normal of each pixel
+// and toward the key light. Code of transform() is generated before the file
+// is included, samples of all geometries are combined by GL_MIN blending.
+// ----------------------------------------------------------------------------
+
+#include sdf_occlusion_common.glsl
+
+// NOTE: Samples 0-3 and 4-7 along the normal, then samples 0-3 and 4-7 toward the light
+layout(location = 0) out float4 outAODistances0;
+layout(location = 1) out float4 outAODistances1;
+layout(location = 2) out float4 outShadowDistances0;
+layout(location = 3) out float4 outShadowDistances1;
+
+layout(location = 0) uniform sampler2D depthMap;
+layout(location = 1) uniform sampler2D normalsMap;
+layout(location = 3) uniform uint32 samplesCount;
+layout(location = 4) uniform float32 aoDistance;
+layout(location = 5) uniform float32 shadowDistance;
+layout(location = 6) uniform int32 shadowLightIndex;
+
+void main()
+{
+  int2 ifragCoord = int2(gl_FragCoord.xy);
+
+  float3 n = texelFetch(normalsMap, ifragCoord, 0).xyz;
+  if(dot(n, n) < 0.1)
+  {
+    discard;
+  }
+
+  float3 p = getWorldPos(fragCoordToUV(gl_FragCoord.xy), ifragCoord, depthMap);
+
+  float3 ro;
+  float3 rd;
+  float32 rayDistance;
+  bool traceShadow = getOcclusionShadowRay(shadowLightIndex, shadowDistance, p, n, ro, rd, rayDistance);
+
+  // NOTE: Unused samples keep the distance, which doesn't occlude anything
+  float32 aoDistances[SDF_OCCLUSION_MAX_SAMPLES_COUNT];
+  float32 shadowDistances[SDF_OCCLUSION_MAX_SAMPLES_COUNT];
+
+  for(uint32 i = 0; i < SDF_OCCLUSION_MAX_SAMPLES_COUNT; i++)
+  {
+    aoDistances[i] = INF_DISTANCE;
+    shadowDistances[i] = INF_DISTANCE;
+
+    if(i < samplesCount)
+    {
+      aoDistances[i] = transform(p + n * getOcclusionSampleDistance(i, samplesCount, aoDistance));
+
+      if(traceShadow)
+      {
+        shadowDistances[i] = transform(ro + rd * getOcclusionSampleDistance(i, samplesCount, rayDistance));
+      }
+    }
+  }
+
+  outAODistances0 = float4(aoDistances[0], aoDistances[1], aoDistances[2], aoDistances[3]);
+  outAODistances1 = float4(aoDistances[4], aoDistances[5], aoDistances[6], aoDistances[7]);
+  outShadowDistances0 = float4(shadowDistances[0], shadowDistances[1], shadowDistances[2], shadowDistances[3]);
+  outShadowDistances1 = float4(shadowDistances[4], shadowDistances[5], shadowDistances[6], shadowDistances[7]);
+}
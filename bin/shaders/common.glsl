@@ -6,15 +6,94 @@
   layout(std140, binding = GLOBAL_PARAMS_UBO_BINDING) uniform GlobalParametersUBO
   {
     GlobalParameters params;
-    LightSourceParameters lightParams[MAX_LIGHT_SOURCES_COUNT];
-    MaterialParameters materials[MAX_MATERIALS];    
   };
 
-  layout(std140, binding = GEOMETRY_TRANSFORMS_UBO_BINDING) uniform GeometryParametersUBO
+  layout(std430, binding = LIGHT_PARAMS_SSBO_BINDING) readonly buffer LightSourceParametersSSBO
   {
-    GeometryParameters geo[MAX_GEOMETRIES];
+    LightSourceParameters lightParams[];
   };
 
+  // NOTE: Light grid starts with (offset, count) pair per screen tile, offsets point to the indices of
+  // light sources which reach the tile, they're stored in the same array after the pairs
+  layout(std430, binding = LIGHT_GRID_SSBO_BINDING) readonly buffer LightGridSSBO
+  {
+    uint32 lightGrid[];
+  };
+
+  // NOTE: Sizes of geometry and material arrays aren't limited, they grow with the scene
+  layout(std430, binding = GEOMETRY_PARAMS_SSBO_BINDING) readonly buffer GeometryParametersSSBO
+  {
+    GeometryParameters geo[];
+  };
+
+  layout(std430, binding = MATERIAL_PARAMS_SSBO_BINDING) readonly buffer MaterialParametersSSBO
+  {
+    MaterialParameters materials[];
+  };
+
+  layout(std430, binding = INSTANCE_PARAMS_SSBO_BINDING) readonly buffer InstanceParametersSSBO
+  {
+    GeometryInstanceParameters instances[];
+  };
+
+  struct GeometrySurface
+  {
+    uint32 materialID;
+    // Position of the point in the space of the geometry (or of its instance)
+    float3 objectPos;
+  };
+
+  // NOTE: Instance isn't stored in the IDs map, so the instance with the closest origin is taken,
+  // which is exact as long as instances don't overlap
+  GeometrySurface getGeometrySurface(uint32 id, float3 worldPos)
+  {
+    GeometrySurface surface;
+    surface.materialID = geo[id].materialID;
+    surface.objectPos = (geo[id].worldGeoMat * float4(worldPos, 1.0)).xyz;
+
+    if(geo[id].instancesCount == 0)
+    {
+      return surface;
+    }
+
+    uint32 instanceIndex = geo[id].instancesOffset;
+    float3 instancePos = surface.objectPos;
+    
+    if(geo[id].instancesLattice != 0)
+    {
+      // NOTE: Instances of a lattice share material, orientation and scale
+      float3 q = surface.objectPos - geo[id].latticeOrigin.xyz;
+      float3 spacing = geo[id].latticeSpacing.xyz;
+      int3 cell = clamp(int3(round(q / spacing)), int3(0), int3(geo[id].latticeCount.xyz) - 1);
+      instancePos = float3x3(instances[instanceIndex].geoInstanceMat) * (q - float3(cell) * spacing);
+    }
+    else
+    {
+      float32 minDistance = INF_DISTANCE;
+      for(uint32 i = 0; i < geo[id].instancesCount; i++)
+      {
+        uint32 index = geo[id].instancesOffset + i;
+        float3 p = (instances[index].geoInstanceMat * float4(surface.objectPos, 1.0)).xyz;
+        float32 d = dot(p, p);
+        
+        if(d < minDistance)
+        {
+          minDistance = d;
+          instanceIndex = index;
+          instancePos = p;
+        }
+      }
+    }
+
+    surface.objectPos = instancePos / instances[instanceIndex].scale;
+    if(instances[instanceIndex].materialID != UNKNOWN_MATERIAL_ID)
+    {
+      surface.materialID = instances[instanceIndex].materialID;
+    }
+    
+    return surface;
+  }
+
   float32 normalizeAndGetLength(inout float3 vector)
   {
     float32 len = length(vector);
@@ -36,6 +115,16 @@
     return float2(fragCoord.x * params.invGapResolution.x, fragCoord.y * params.invGapResolution.y);
   }
 
+  /** @return (offset, count) of indices of light sources, which reach the tile of the pixel */
+  uint2 getLightGridTile(int2 ifragCoord)
+  {
+    uint32 tilesCountX = (params.gapResolution.x + LIGHT_GRID_TILE_SIZE - 1) / LIGHT_GRID_TILE_SIZE;
+    uint2 tile = uint2(ifragCoord) / LIGHT_GRID_TILE_SIZE;
+    uint32 index = 2 * (tile.y * tilesCountX + tile.x);
+
+    return uint2(lightGrid[index], lightGrid[index + 1]);
+  }
+
   float32 distance2(float3 from, float3 to)
   {
     float3 vector = to - from;
@@ -112,6 +201,24 @@
     return worldPos.xyz / worldPos.w;
   }
 
+  // NOTE: Shadow rays of all light sources are traced at once, shadow rays map and stacks consist of
+  // slices of gapResolution stacked vertically, one slice per light source
+  uint32 getShadowSlice(int2 ifragCoord)
+  {
+    return uint32(ifragCoord.y) / params.gapResolution.y;
+  }
+
+  int2 shadowSliceToFilmCoord(int2 ifragCoord)
+  {
+    return int2(ifragCoord.x, ifragCoord.y - int32(getShadowSlice(ifragCoord) * params.gapResolution.y));
+  }
+
+  float3 getShadowRayOrigin(int2 ifragCoord, sampler2D depthMap)
+  {
+    int2 filmCoord = shadowSliceToFilmCoord(ifragCoord);
+    return getWorldPos(fragCoordToUV(float2(filmCoord) + 0.5), filmCoord, depthMap);
+  }
+
   float32 goldNoise(float2 xy, float32 seed){
     return fract(tan(distance(xy*1.61803398874989484820459, xy)*seed)*xy.x);
   }
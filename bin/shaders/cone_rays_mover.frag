@@ -0,0 +1,49 @@
+#version 450 core
+#extension GL_ARB_shader_stencil_export : require
+
+#include stack.glsl
+
+out float4 outCameraRay;
+
+uniform uint32 coneBlockSize;
+
+void main()
+{
+    int2 ifragCoord = int2(gl_FragCoord.x, gl_FragCoord.y);
+
+    float32 distance = stackFront(ifragCoord).distance / params.rayMarching.x;
+    float32 totalDistance = stackGetTotalDistance(ifragCoord);
+
+    // NOTE: Radius of the cone grows with distance, it's a half of the block's diagonal
+    // (size of a pixel at unit distance is 2 * tan(FovY / 2) / height)
+    float32 coneSlope = float32(coneBlockSize) * sqrt(2.0) * tan(params.camMisc.w * 0.5) / float32(params.gapResolution.y);
+    float32 coneRadius = coneSlope * totalDistance;
+
+    // NOTE: Radius grows along the step too, so the step s must keep the whole cone out of the
+    // surface at its end: s + coneSlope * (t + s) <= distance
+    float32 step = (distance - coneRadius) / (1.0 + coneSlope);
+
+    if(totalDistance >= INF_DISTANCE)
+    {
+      gl_FragStencilRefARB = 0;
+      outCameraRay = float4(0.0f);
+    }
+    // Once the cone is about to touch a surface, rays of the block have to be
+    // traced separately
+    else if(totalDistance > params.rayMarching.z || step < max(coneRadius, params.rayMarching.w))
+    {
+      gl_FragStencilRefARB = 0;
+      outCameraRay = float4(0.0f);
+      stackAddTotalDistance(ifragCoord, INF_DISTANCE);
+    }
+    else
+    {
+      gl_FragStencilRefARB = 1;
+
+      stackClearSize(ifragCoord);
+      stackAddTotalDistance(ifragCoord, step);
+
+      // NOTE: Traversed distance is the start distance of rays of the block (see extract_cone_results.frag)
+      outCameraRay = float4(0.0f, 0.0f, 0.0f, step);
+    }
+}
@@ -8,14 +8,32 @@
   #endif
 
   #define GLOBAL_PARAMS_UBO_BINDING       0
-  #define GEOMETRY_TRANSFORMS_UBO_BINDING 1
   #define STACKS_SSBO_BINDING             2
   #define AABB_CALCULATION_SSBO_BINDING   3
+  #define GEOMETRY_PARAMS_SSBO_BINDING    4
+  #define MATERIAL_PARAMS_SSBO_BINDING    5
+  #define INSTANCE_PARAMS_SSBO_BINDING    6
+  #define DISTANCE_FIELD_BAKING_SSBO_BINDING 7
+  #define SHADOW_RECEIVERS_SSBO_BINDING   8
+  #define LIGHT_PARAMS_SSBO_BINDING       9
+  #define LIGHT_GRID_SSBO_BINDING         10
+  #define SHADING_TILES_SSBO_BINDING      11
+  #define RAY_HIT_SSBO_BINDING            12
 
-  #define MAX_GEOMETRIES                  64
-  #define MAX_MATERIALS                   32
+  #define BAKED_INDIRECTION_TEXTURE_UNIT  2
+  #define BAKED_BRICKS_TEXTURE_UNIT       3
+  // Samples per side of a brick, neighbouring bricks share their border samples
+  #define BAKED_BRICK_SIZE                8
 
-  #define MAX_LIGHT_SOURCES_COUNT         4
+  #define DISTANCE_FIELD_BAKING_STAGE_COARSE 0
+  #define DISTANCE_FIELD_BAKING_STAGE_BRICKS 1
+  #define DISTANCE_FIELD_BAKING_LOCAL_SIZE   64
+
+  // NOTE: Count of light sources isn't limited, but only the first ones cast shadows (one channel
+  // of the shadows map per light source)
+  #define MAX_SHADOW_LIGHT_SOURCES_COUNT  4
+  // Side of a screen tile of the light grid in pixels (see getLightGridTile() in common.glsl)
+  #define LIGHT_GRID_TILE_SIZE            16
   #define MAX_STACK_SIZE                  8
   #define INF_DISTANCE                    77777.0
   #define INT_DISTANCE                    0.0001
@@ -35,8 +53,11 @@
   // One geometry stack consists of
   //   1. one member for size
   //   2. one member for total traversed distance
-  //   3. array of geometry (see GeometriesStack declaration)
-  #define GEOMETRY_STACK_MEMBERS_COUNT (2 + GEOMETRY_MEMBERS_COUNT * MAX_STACK_SIZE)
+  //   3. three members of the over-relaxed sphere tracing state (previous distance,
+  //      length of the previous step, current relaxation factor)
+  //   4. array of geometry (see GeometriesStack declaration)
+  #define GEOMETRY_STACK_HEADER_MEMBERS_COUNT 5
+  #define GEOMETRY_STACK_MEMBERS_COUNT (GEOMETRY_STACK_HEADER_MEMBERS_COUNT + GEOMETRY_MEMBERS_COUNT * MAX_STACK_SIZE)
 
   struct GeometriesStack
   {
@@ -85,7 +106,8 @@
     
     float4   camUpAxis;
     float4   camMisc; // x=Near, y=Far, z=FovX, w=FovY
-    float4   _gap3;
+    // x=Lipschitz bound of the scene, y=Relaxation factor, z=Max distance, w=Convergence threshold
+    float4   rayMarching;
     float4   _gap4;
     
     float4x4 camNDCCameraMat;
@@ -109,9 +131,10 @@
   struct GeometryParameters
   {
     uint32 materialID;
-    uint32 _gap1;
-    uint32 _gap2;
-    uint32 _gap3;    
+    uint32 instancesOffset;
+    uint32 instancesCount;
+    // 1 if instances form a regular lattice (see lattice* members), 0 otherwise
+    uint32 instancesLattice;
     
     float4   position;
     float4   scale;
@@ -119,6 +142,21 @@
     float4x4 worldGeoMat;
     float4x4 geoParentMat;
     float4x4 parentGeoMat;
+
+    float4   latticeOrigin;
+    float4   latticeSpacing;
+    uint4    latticeCount;
+  };
+
+  struct GeometryInstanceParameters
+  {
+    uint32   materialID;
+    float32  scale;
+    uint32   _gap1;
+    uint32   _gap2;
+
+    // Transform from the space of the geometry into the space of the instance (scale excluded)
+    float4x4 geoInstanceMat;
   };
 
   #define MATERIAL_TEXTURE_PROJECTION_MODE_TRIPLANAR   0
@@ -131,6 +169,21 @@
   #define MATERIAL_TEXTURE_TYPE_MRIAO    3
   #define MATERIAL_TEXTURE_TYPE_COUNT    4
 
+  // NOTE: Features which shading of a material needs, a material with textures needs the projection
+  // of its mode (see getMaterialFeatures() in pbr_common.glsl). Shading is specialised per set of
+  // features in a screen tile of SHADING_TILE_SIZE x SHADING_TILE_SIZE pixels
+  #define MATERIAL_FEATURE_TRIPLANAR   (1 << MATERIAL_TEXTURE_PROJECTION_MODE_TRIPLANAR)
+  #define MATERIAL_FEATURE_SPHERICAL   (1 << MATERIAL_TEXTURE_PROJECTION_MODE_SPHERICAL)
+  #define MATERIAL_FEATURE_CYLINDRICAL (1 << MATERIAL_TEXTURE_PROJECTION_MODE_CYLINDRICAL)
+  #define MATERIAL_FEATURES_PERMUTATIONS_COUNT 8
+
+  #define SHADING_TILE_SIZE 16
+
+  // NOTE: Distances sampled by SDF occlusion along the normal (AO) and toward the key light (soft
+  // shadow) per pixel, 4 samples are stored per layer of the samples map
+  #define SDF_OCCLUSION_MAX_SAMPLES_COUNT 8
+  #define SDF_OCCLUSION_SAMPLES_LAYERS_COUNT (2 * SDF_OCCLUSION_MAX_SAMPLES_COUNT / 4)
+
   #if defined(__cplusplus)
     using MaterialTextureProjectionMode = uint32;
     using MaterialTextureType = uint32;
@@ -168,6 +221,18 @@
     uint4 max;
   };
 
+  // NOTE: Receivers are gathered per tile of SHADOW_RECEIVERS_TILE_SIZE x SHADOW_RECEIVERS_TILE_SIZE pixels
+  #define SHADOW_RECEIVERS_TILE_SIZE 16
+
+  struct ShadowReceiversBufferParameters
+  {
+    // Fixed point bounds of visible surface in world space (see fp_math.h)
+    uint4 min;
+    uint4 max;
+    // xy - minimal tile, zw - maximal tile, which contain surface
+    uint4 tiles;
+  };
+
   #define LIGHT_SOURCE_TYPE_DIRECTIONAL 0
   #define LIGHT_SOURCE_TYPE_SPOT        1
   #define LIGHT_SOURCE_TYPE_POINT       2
@@ -0,0 +1,13 @@
+#version 450 core
+
+#include geometry_common.glsl
+
+layout(location = 0) out float32 outConeDistance;
+
+void main()
+{
+  int2 ifragCoord = int2(gl_FragCoord.x, gl_FragCoord.y);
+
+  // NOTE: Rays map accumulates distance traversed by the axis of the cone
+  outConeDistance = texelFetch(raysMap, ifragCoord, 0).w;
+}
@@ -49,27 +49,49 @@ float4 sampleCylindrical(sampler2D text, float3 p, float2 uvMin, float2 uvSize)
   return texture(text, uvSize * uv + uvMin);
 }
 
+uint32 getMaterialFeatures(MaterialParameters material)
+{
+  if(material.textures[MATERIAL_TEXTURE_TYPE_DIFFUSE].enabled == FALSE &&
+     material.textures[MATERIAL_TEXTURE_TYPE_MRIAO].enabled == FALSE)
+  {
+    return 0u;
+  }
+
+  return 1u << material.projectionMode;
+}
+
+// NOTE: Shading programs are specialised by MATERIAL_FEATURES (see simple_shading_pass.cpp), only
+// projections of the features are compiled then
+#if !defined(MATERIAL_FEATURES)
+  #define MATERIAL_FEATURES (MATERIAL_FEATURE_TRIPLANAR | MATERIAL_FEATURE_SPHERICAL | MATERIAL_FEATURE_CYLINDRICAL)
+#endif
+
 float4 psample(sampler2D text, float3 p, float3 n, MaterialTextureParameters params, uint32 mode)
 {
+#if MATERIAL_FEATURES != 0
   if(params.enabled == TRUE)
   {
-  
     float2 uvSize = params.uvRect.zw - params.uvRect.xy;
     float2 uvMin = params.uvRect.xy;
 
     switch(mode)
     {
+  #if (MATERIAL_FEATURES & MATERIAL_FEATURE_TRIPLANAR) != 0
       case MATERIAL_TEXTURE_PROJECTION_MODE_TRIPLANAR: return sampleTriplanar(text, p, n, uvMin, uvSize, params.blendingFactor);
+  #endif
+  #if (MATERIAL_FEATURES & MATERIAL_FEATURE_SPHERICAL) != 0
       case MATERIAL_TEXTURE_PROJECTION_MODE_SPHERICAL: return sampleSpherical(text, p, uvMin, uvSize);
+  #endif
+  #if (MATERIAL_FEATURES & MATERIAL_FEATURE_CYLINDRICAL) != 0
       case MATERIAL_TEXTURE_PROJECTION_MODE_CYLINDRICAL: return sampleCylindrical(text, p, uvMin, uvSize);
+  #endif
     }
 
     return 0.0f.xxxx;
   }
-  else
-  {
-    return params.defaultValue;
-  }
+#endif
+
+  return params.defaultValue;
 }
 
 // ----------------------------------------------------------------------------
@@ -188,14 +210,16 @@ float3 simplifiedRenderingEquation(float3 pWorld,
                                    float32 roughness,
                                    float32 ao,
                                    float4 shadows,
-                                   uint32 lightsCount)
+                                   uint2 lightGridTile)
                      
 {
   float3 radiance = ambientColor;
   float32 shininess = roughnessToShininess(roughness);
   
-  for(uint32 i = 0; i < lightsCount; i++)
+  for(uint32 j = 0; j < lightGridTile.y; j++)
   {
+    uint32 i = lightGrid[lightGridTile.x + j];
+    
     float32 lLen = 1.0f;
     float3 l = getLightDirection(i, pWorld, lLen);
     float32 NoL = max(dot(n, l), 0.0f);
@@ -204,7 +228,7 @@ float3 simplifiedRenderingEquation(float3 pWorld,
     float32 NoH = max(dot(n, h), 0.0f);
     
     float32 attenuation = getAttenuation(i, lLen, l);
-    float32 shadow = shadows[i % 4];
+    float32 shadow = i < MAX_SHADOW_LIGHT_SOURCES_COUNT ? shadows[i] : 1.0f;
     
     float3 irradiance = lightParams[i].intensity.rgb * attenuation * shadow;
     
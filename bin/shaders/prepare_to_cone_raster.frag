@@ -0,0 +1,21 @@
+#version 450 core
+
+#include geometry_common.glsl
+
+out float4 outCameraRay;
+
+// NOTE: Count of pixels along a side of a block, which is covered by one cone
+uniform uint32 coneBlockSize;
+
+void main()
+{
+    int2 ifragCoord = int2(gl_FragCoord.x, gl_FragCoord.y);
+
+    stackClear(ifragCoord);
+
+    // NOTE: Axis of the cone goes through the center of the block
+    float2 blockCenter = float2(ifragCoord * int32(coneBlockSize)) + float32(coneBlockSize - 1) * 0.5;
+    float2 uv = fragCoordToUV(blockCenter);
+
+    outCameraRay = float4(generateRayDir(uv), 0.0);
+}
@@ -4,6 +4,10 @@
 
 out float4 outCameraRay;
 
+// NOTE: 0 if cone marching pre-pass is disabled
+uniform uint32 coneBlockSize;
+layout(location = 2) uniform sampler2D coneDistancesMap;
+
 void main()
 {
     int2 ifragCoord = int2(gl_FragCoord.x, gl_FragCoord.y);
@@ -14,5 +18,13 @@ void main()
     // we may want to use some sort of src/samplers/sampler.h
     float2 uv = fragCoordToUV(float2(ifragCoord.x, ifragCoord.y));
 
-    outCameraRay = float4(generateRayDir(uv), 0.0);
+    // NOTE: Rays of the block start from the distance, which has been safely traversed by the cone
+    float32 startDistance = 0.0;
+    if(coneBlockSize > 0)
+    {
+      startDistance = texelFetch(coneDistancesMap, ifragCoord / int32(coneBlockSize), 0).x;
+      stackAddTotalDistance(ifragCoord, startDistance);
+    }
+
+    outCameraRay = float4(generateRayDir(uv), startDistance);
 }
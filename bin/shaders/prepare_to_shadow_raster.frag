@@ -7,8 +7,13 @@ out float4 outCameraRay;
 
 layout(location = 0) uniform sampler2D depthMap;
 layout(location = 1) uniform sampler2D normalsMap;
+// NOTE: Pixels with shadows reused from the previous frame (see reproject_shadows.frag)
+layout(location = 2) uniform sampler2D reuseMask;
 
-layout(location = 2) uniform uint32 lightIndex;
+// NOTE: Index of the light source traced in each slice and its screen rectangle (xy - min, zw - max),
+// fragments outside of the rectangle aren't lit by it
+uniform uint32 shadowSlicesLights[MAX_SHADOW_LIGHT_SOURCES_COUNT];
+uniform int4 shadowSlicesRects[MAX_SHADOW_LIGHT_SOURCES_COUNT];
 
 void markFragmentAsCulled(int2 ifragCoord)
 {
@@ -25,9 +30,19 @@ void main()
   stackClear(ifragCoord);
   stackAddTotalDistance(ifragCoord, tOffset);
 
-  float2 uv = fragCoordToUV(gl_FragCoord.xy);
-  float3 worldPos = getWorldPos(uv, ifragCoord, depthMap);
-  float3 normal = texelFetch(normalsMap, ifragCoord, 0).xyz;
+  uint32 slice = getShadowSlice(ifragCoord);
+  int2 filmCoord = shadowSliceToFilmCoord(ifragCoord);
+  int4 rect = shadowSlicesRects[slice];
+
+  if(any(lessThan(filmCoord, rect.xy)) || any(greaterThanEqual(filmCoord, rect.zw)) ||
+     texelFetch(reuseMask, filmCoord, 0).x > 0.5)
+  {
+    markFragmentAsCulled(ifragCoord);
+    return;
+  }
+
+  float3 worldPos = getShadowRayOrigin(ifragCoord, depthMap);
+  float3 normal = texelFetch(normalsMap, filmCoord, 0).xyz;
 
   // If length of a normal is smaller than some value, then this fragment doesn't have normal -->
   // this fragment doesn't represent a surface --> it can be safely culled.
@@ -37,7 +52,7 @@ void main()
     return;
   }
   
-  const LightSourceParameters light = lightParams[lightIndex];
+  const LightSourceParameters light = lightParams[shadowSlicesLights[slice]];
   
   // Based on light type, precalculate light direction. Additionally perform early-quit tests:
   //   1) Check if light source is too far (based on its attenuation) to be kicked
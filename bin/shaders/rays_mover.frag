@@ -11,9 +11,19 @@ void main()
 {
     int2 ifragCoord = int2(gl_FragCoord.x, gl_FragCoord.y);
 
-    float32 distance = stackFront(ifragCoord).distance;
+    // NOTE: Script functions may stretch space, distance divided by the Lipschitz bound of the scene
+    // is a safe step
+    float32 distance = stackFront(ifragCoord).distance / params.rayMarching.x;
     float32 totalDistance = stackGetTotalDistance(ifragCoord);
 
+    // Over-relaxed sphere tracing: step is enlarged by the relaxation factor, which is valid only
+    // while unbounding spheres of the previous and the current points overlap. Otherwise the surface
+    // might have been skipped, so the ray steps back and continues with plain sphere tracing.
+    TracingState state = stackGetTracingState(ifragCoord);
+    bool relaxationFailed = state.relaxation > 1.0 && abs(distance) + state.prevDistance < state.prevStep;
+
+    float32 step = relaxationFailed ? (1.0 - state.relaxation) * state.prevStep : distance * state.relaxation;
+
     // If totalDistance is larger than INF_DISTANCE, then we know that this
     // pixel was already processed previously --> do not add distance from
     // the stack, simply quit
@@ -22,9 +32,10 @@ void main()
       gl_FragStencilRefARB = 0;
       outCameraRay = float4(0.0f);
     }
-    // Distances larger than 0.001 cause "ringing" effect
+    // Distances larger than the convergence threshold cause "ringing" effect
     // during normals visualization
-    else if(totalDistance > 100.0 || distance < 0.001)
+    else if(relaxationFailed == false &&
+            (totalDistance > params.rayMarching.z || distance < params.rayMarching.w))
     {
       gl_FragStencilRefARB = 0;
       outCameraRay = float4(0.0f, 0.0f, 0.0f, distance);
@@ -40,10 +51,14 @@ void main()
         stackClearSize(ifragCoord);
       }
 
-      stackAddTotalDistance(ifragCoord, distance);
+      state.prevDistance = relaxationFailed ? 0.0 : abs(distance);
+      state.prevStep = step;
+      state.relaxation = relaxationFailed ? 1.0 : state.relaxation;
+      stackSetTracingState(ifragCoord, state);
 
-      outCameraRay = float4(0, 0, 0, distance);                
+      stackAddTotalDistance(ifragCoord, step);
+
+      outCameraRay = float4(0, 0, 0, step);                
     }
 
 }
-
@@ -0,0 +1,65 @@
+#version 450 core
+
+// ----------------------------------------------------------------------------
+// Task: Reuse shadows of the previous frame, when only the camera has moved.
+//
+// Shadow of a point doesn't depend on the camera, so a pixel takes shadows of
+// the previous frame at the position, where its point was visible. If the
+// previous pixel shows another point (e.g the point was occluded), nothing is
+// reused and the pixel is traced as usual.
+// ----------------------------------------------------------------------------
+
+#include common.glsl
+
+layout(location = 0) out float4 outShadows;
+layout(location = 1) out float32 outReused;
+
+layout(location = 0) uniform sampler2D depthMap;
+layout(location = 1) uniform sampler2D depthHistoryMap;
+layout(location = 2) uniform sampler2D shadowsHistoryMap;
+
+uniform float4x4 prevWorldNDCMat;
+uniform float4x4 prevNDCWorldMat;
+// NOTE: Maximal distance between points relative to the distance to the camera
+uniform float32 reprojectionThreshold;
+
+void main()
+{
+  int2 ifragCoord = int2(gl_FragCoord.x, gl_FragCoord.y);
+
+  outShadows = 1.0f.xxxx;
+  outReused = 0.0;
+
+  float3 worldPos = getWorldPos(fragCoordToUV(gl_FragCoord.xy), ifragCoord, depthMap);
+
+  float4 prevNDCPos = prevWorldNDCMat * float4(worldPos, 1.0);
+  if(prevNDCPos.w <= 0.0)
+  {
+    return;
+  }
+
+  prevNDCPos.xyz /= prevNDCPos.w;
+  if(any(greaterThan(abs(prevNDCPos.xy), float2(1.0))))
+  {
+    return;
+  }
+
+  // NOTE: Inverse of the mapping in getWorldPos()
+  float2 prevUV = float2(1.0 - prevNDCPos.x, prevNDCPos.y + 1.0) * 0.5;
+  int2 prevCoord = min(int2(prevUV * float2(params.gapResolution)), int2(params.gapResolution) - 1);
+
+  float2 prevCenterUV = fragCoordToUV(float2(prevCoord) + 0.5);
+  float32 prevDepth = texelFetch(depthHistoryMap, prevCoord, 0).x;
+  float4 prevWorldPos = prevNDCWorldMat * float4(prevCenterUV * float2(-2.0, 2.0) + float2(1.0, -1.0),
+                                                 prevDepth * 2.0 - 1.0,
+                                                 1.0);
+
+  float32 threshold = reprojectionThreshold * distance(worldPos, params.camPosition.xyz);
+  if(distance(prevWorldPos.xyz / prevWorldPos.w, worldPos) > threshold)
+  {
+    return;
+  }
+
+  outShadows = texelFetch(shadowsHistoryMap, prevCoord, 0);
+  outReused = 1.0;
+}
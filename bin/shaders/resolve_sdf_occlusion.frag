@@ -0,0 +1,80 @@
+#version 450 core
+
+#include common.glsl
+#include sdf_occlusion_common.glsl
+
+// NOTE: x - ambient occlusion, y - soft shadow of the key light source, it's combined with the
+// shadows map by shading (see simple_shading.frag)
+layout(location = 0) out float2 outOcclusion;
+
+layout(location = 0) uniform sampler2D depthMap;
+layout(location = 1) uniform sampler2D normalsMap;
+layout(location = 2) uniform sampler2DArray samplesMap;
+layout(location = 3) uniform uint32 samplesCount;
+layout(location = 4) uniform float32 aoDistance;
+layout(location = 5) uniform float32 shadowDistance;
+layout(location = 6) uniform int32 shadowLightIndex;
+
+// NOTE: Farther samples are weighted less, occluders near the surface darken it the most
+#define AO_FALLOFF   0.75
+#define AO_INTENSITY 2.0
+
+float32 fetchSample(int2 ifragCoord, uint32 firstLayer, uint32 i)
+{
+  return texelFetch(samplesMap, int3(ifragCoord, firstLayer + i / 4), 0)[i % 4];
+}
+
+void main()
+{
+  int2 ifragCoord = int2(gl_FragCoord.xy);
+
+  outOcclusion = 1.0f.xx;
+
+  float3 n = texelFetch(normalsMap, ifragCoord, 0).xyz;
+  if(dot(n, n) < 0.1)
+  {
+    return;
+  }
+
+  float3 p = getWorldPos(fragCoordToUV(gl_FragCoord.xy), ifragCoord, depthMap);
+
+  // 1. Ambient occlusion: sample is occluded by the part of its distance, which is shorter than its
+  // distance from the surface
+  float32 occlusion = 0.0;
+  float32 weight = 1.0;
+  float32 totalWeight = 0.0;
+
+  for(uint32 i = 0; i < samplesCount; i++)
+  {
+    float32 t = getOcclusionSampleDistance(i, samplesCount, aoDistance);
+    float32 d = fetchSample(ifragCoord, 0, i);
+
+    occlusion += weight * (t - clamp(d, 0.0, t)) / t;
+    totalWeight += weight;
+    weight *= AO_FALLOFF;
+  }
+
+  outOcclusion.x = clamp(1.0 - AO_INTENSITY * occlusion / max(totalWeight, INT_DISTANCE), 0.0, 1.0);
+
+  // 2. Soft shadow: improved estimator (see https://iquilezles.org/articles/rmshadows), distance may
+  // become negative inside occluders, so penumbra continues inside of them and shadow is smooth.
+  // Factor is clamped, so that occluders farther than the sample distance from samples never darken
+  // them, it's what the reach of geometries is based on (see sdfOcclusionPassCalculateRect())
+  float3 ro;
+  float3 rd;
+  float32 rayDistance;
+  if(getOcclusionShadowRay(shadowLightIndex, shadowDistance, p, n, ro, rd, rayDistance))
+  {
+    float32 k = max(lightParams[shadowLightIndex].shadowFactor, 1.0);
+    float32 res = 1.0;
+
+    for(uint32 i = 0; i < samplesCount; i++)
+    {
+      float32 t = getOcclusionSampleDistance(i, samplesCount, rayDistance);
+      res = min(res, k * fetchSample(ifragCoord, SDF_OCCLUSION_MAX_SAMPLES_COUNT / 4, i) / t);
+    }
+
+    res = max(res, -1.0);
+    outOcclusion.y = 0.25 * (1.0 + res) * (1.0 + res) * (2.0 - res);
+  }
+}
@@ -0,0 +1,52 @@
+// ----------------------------------------------------------------------------
+// Samples of SDF occlusion (see sdf_occlusion_pass.h). Distances of geometries
+// are sampled at the same points by calculate_sdf_occlusion.glsl and resolved
+// by resolve_sdf_occlusion.frag, so both of them place samples by these
+// functions.
+// ----------------------------------------------------------------------------
+
+#ifndef SDF_OCCLUSION_COMMON_GLSL_INCLUDED
+#define SDF_OCCLUSION_COMMON_GLSL_INCLUDED
+
+// NOTE: Samples are evenly spaced, the last one is at maxDistance
+float32 getOcclusionSampleDistance(uint32 i, uint32 samplesCount, float32 maxDistance)
+{
+  return maxDistance * float32(i + 1) / float32(samplesCount);
+}
+
+/**
+ * @param lightIndex key light source, -1 if there is no one
+ * @param maxDistance distance of the last sample, it's shortened to the distance to the light source
+ * @return false if the ray isn't traced, i.e there is no light source or the surface faces away from it
+ */
+bool getOcclusionShadowRay(int32 lightIndex, float32 maxDistance, float3 p, float3 n,
+                           out float3 ro, out float3 rd, out float32 rayDistance)
+{
+  // NOTE: Ray starts above the surface, so that the pixel isn't shadowed by the surface itself
+  ro = p + n * params.intersectionThreshold;
+  rd = float3(0.0, 0.0, 0.0);
+  rayDistance = 0.0;
+
+  if(lightIndex < 0)
+  {
+    return false;
+  }
+
+  if(lightParams[lightIndex].type == LIGHT_SOURCE_TYPE_DIRECTIONAL)
+  {
+    rd = -lightParams[lightIndex].forward.xyz;
+    rayDistance = maxDistance;
+  }
+  else
+  {
+    float3 toLight = lightParams[lightIndex].position.xyz - ro;
+    float32 lightDistance = length(toLight);
+
+    rd = toLight / max(lightDistance, INT_DISTANCE);
+    rayDistance = min(maxDistance, lightDistance);
+  }
+
+  return rayDistance > INT_DISTANCE && dot(rd, n) > 0.0;
+}
+
+#endif
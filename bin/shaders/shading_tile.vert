@@ -0,0 +1,25 @@
+#version 450 core
+
+#include common.glsl
+
+// NOTE: See classify_materials.comp
+layout(std430, binding = SHADING_TILES_SSBO_BINDING) readonly buffer ShadingTilesSSBO
+{
+  uint4 shadingBins[MATERIAL_FEATURES_PERMUTATIONS_COUNT];
+  uint32 shadingTiles[];
+};
+
+// NOTE: Offset of tiles of the drawn bin, each instance is a tile
+layout(location = 0) uniform uint32 tilesOffset;
+
+const uint2 TILE_CORNERS[6] = uint2[6](uint2(0, 0), uint2(1, 0), uint2(0, 1),
+                                       uint2(0, 1), uint2(1, 0), uint2(1, 1));
+
+void main()
+{
+  uint32 tile = shadingTiles[tilesOffset + gl_InstanceID];
+  uint2 corner = (uint2(tile & 0xFFFF, tile >> 16) + TILE_CORNERS[gl_VertexID]) * SHADING_TILE_SIZE;
+
+  float2 pos = float2(min(corner, params.gapResolution)) * params.invGapResolution;
+  gl_Position = float4(pos * 2.0 - 1.0, 0.5, 1.0);
+}
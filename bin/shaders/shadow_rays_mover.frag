@@ -7,13 +7,14 @@ out float4 outCameraRay;
 
 uniform sampler2D depthMap;
 uniform uint32 curIterIdx;
-uniform uint32 lightIndex;
+uniform uint32 shadowSlicesLights[MAX_SHADOW_LIGHT_SOURCES_COUNT];
 
 void main()
 {
     int2 ifragCoord = int2(gl_FragCoord.x, gl_FragCoord.y);
     
-    float32 distance = stackFront(ifragCoord).distance;
+    // NOTE: See rays_mover.frag
+    float32 distance = stackFront(ifragCoord).distance / params.rayMarching.x;
     float32 totalDistance = stackGetTotalDistance(ifragCoord);
     
     // If totalDistance is larger than INF_DISTANCE, then we know that this
@@ -37,11 +38,11 @@ void main()
     {
       float32 movedDistance = totalDistance + distance;
       float32 distanceToLight = INF_DISTANCE;
+      uint32 lightIndex = shadowSlicesLights[getShadowSlice(ifragCoord)];
       
       if(lightParams[lightIndex].type != LIGHT_SOURCE_TYPE_DIRECTIONAL)
       {
-        float2 uv = fragCoordToUV(gl_FragCoord.xy);
-        float3 worldPos = getWorldPos(uv, ifragCoord, depthMap);
+        float3 worldPos = getShadowRayOrigin(ifragCoord, depthMap);
       
         distanceToLight = distance2(worldPos, lightParams[lightIndex].position.xyz);
       }
@@ -1,29 +1,38 @@
 #version 450 core
-#extension GL_ARB_shader_stencil_export : require
 
 #include stack.glsl
 
 out float4 outShadows;
 
-layout(location = 0) uniform uint32 lightIndex;
+// NOTE: Fragments are film pixels, shadow of each light source is estimated from its slice
+// (see getShadowSlice())
+uniform uint32 shadowSlicesCount;
+uniform uint32 shadowSlicesLights[MAX_SHADOW_LIGHT_SOURCES_COUNT];
 
 void main()
 {
     int2 ifragCoord = int2(gl_FragCoord.x, gl_FragCoord.y);
-    float32 t = stackGetTotalDistance(ifragCoord);
-    float32 h = stackEmpty(ifragCoord) ? INF_DISTANCE : stackFront(ifragCoord).distance;
-    float32 k = lightParams[lightIndex].shadowFactor;
-
-    // NOTE: If distance to the nearest surface is smaller than intersection
-    // distance, then texel is in full shadow
-    float32 shadow = t < INF_DISTANCE ? mix(k * h / t, 0.0, h < INT_DISTANCE) : 1.0f;
 
     // NOTE: Init values to 1, so that during blending, min(...) operation won't
     // affect unused channels
     float4 result = 1.0f.xxxx;
 
-    // NOTE: Change only channel corresponding to the current light index
-    result[lightIndex % 4] = shadow;
+    for(uint32 slice = 0; slice < shadowSlicesCount; slice++)
+    {
+      int2 sliceCoord = int2(ifragCoord.x, ifragCoord.y + int32(slice * params.gapResolution.y));
+      uint32 lightIndex = shadowSlicesLights[slice];
+      
+      float32 t = stackGetTotalDistance(sliceCoord);
+      float32 h = stackEmpty(sliceCoord) ? INF_DISTANCE : stackFront(sliceCoord).distance;
+      float32 k = lightParams[lightIndex].shadowFactor;
+
+      // NOTE: If distance to the nearest surface is smaller than intersection
+      // distance, then texel is in full shadow
+      float32 shadow = t < INF_DISTANCE ? mix(k * h / t, 0.0, h < INT_DISTANCE) : 1.0f;
+
+      // NOTE: Change only channel corresponding to the light index
+      result[lightIndex % 4] = min(result[lightIndex % 4], shadow);
+    }
 
     outShadows = result;
 }
@@ -1,15 +1,34 @@
-#version 450 core
+// NOTE: Version and MATERIAL_FEATURES are prepended by simple shading pass, one program per set of
+// features (see classify_materials.comp)
 
 #include pbr_common.glsl
 
 layout(location = 0) out float4 outColor;
 
-layout(location = 0) uniform uint32 lightsCount;
 layout(location = 1) uniform sampler2D atlasTexture;
 layout(location = 2) uniform usampler2D idTexture;
 layout(location = 3) uniform sampler2D depthTexture;
 layout(location = 4) uniform sampler2D normalsTexture;
 layout(location = 5) uniform sampler2D shadowsTexture;
+// NOTE: Visibility and contact shadow of the key light source calculated by SDF occlusion pass,
+// 1.0 if it's off
+layout(location = 6) uniform sampler2D occlusionTexture;
+
+// NOTE: Key light source is the first one, which casts shadows (see sdf_occlusion_pass.cpp)
+float4 applyContactShadow(float4 shadows, float32 contactShadow)
+{
+  uint32 lightsCount = min(uint32(lightParams.length()), uint32(MAX_SHADOW_LIGHT_SOURCES_COUNT));
+  for(uint32 i = 0; i < lightsCount; i++)
+  {
+    if(lightParams[i].shadowEnabled != 0)
+    {
+      shadows[i] = min(shadows[i], contactShadow);
+      break;
+    }
+  }
+
+  return shadows;
+}
 
 void main()
 {
@@ -18,7 +37,9 @@ void main()
   
   float3 worldPos = getWorldPos(uv, ifragCoord, depthTexture);
   float3 normal = texelFetch(normalsTexture, ifragCoord, 0).xyz;
-  float4 shadows = texelFetch(shadowsTexture, ifragCoord, 0);
+  float2 occlusion = texelFetch(occlusionTexture, ifragCoord, 0).rg;
+  float4 shadows = applyContactShadow(texelFetch(shadowsTexture, ifragCoord, 0), occlusion.y);
+  float32 visibility = occlusion.x;
 
   bool isSurface = dot(normal, normal) > 0.1;
   
@@ -26,9 +47,10 @@ void main()
   if(isSurface)
   {
     uint32 id = texelFetch(idTexture, ifragCoord, 0).r;
-    MaterialParameters material = materials[geo[id].materialID];
+    GeometrySurface surface = getGeometrySurface(id, worldPos);
+    MaterialParameters material = materials[surface.materialID];
 
-    float3 objectPos = (geo[id].worldGeoMat * float4(worldPos, 1.0)).xyz;
+    float3 objectPos = surface.objectPos;
     float3 view = normalize(params.camPosition.xyz - worldPos);    
 
     float3 diffuseColor = psample(atlasTexture,
@@ -49,9 +71,9 @@ void main()
                                            material.ambientColor.rgb,
                                            diffuseColor,
                                            mriao.y,
-                                           mriao.w,
+                                           1.0 - (1.0 - mriao.w) * visibility,
                                            shadows,
-                                           lightsCount);
+                                           getLightGridTile(ifragCoord));
   }
   
   outColor = float4(radiance, isSurface);
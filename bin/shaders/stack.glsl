@@ -24,8 +24,8 @@ GeometryData stackFront(uint2 pixelCoord)
 
   GeometryData data;
   
-  data.distance = _stacks[byteOffset + 2];
-  data.id = uint32(_stacks[byteOffset + 3]);
+  data.distance = _stacks[byteOffset + GEOMETRY_STACK_HEADER_MEMBERS_COUNT];
+  data.id = uint32(_stacks[byteOffset + GEOMETRY_STACK_HEADER_MEMBERS_COUNT + 1]);
 
   return data;
 }
@@ -37,8 +37,8 @@ GeometryData stackBack(uint2 pixelCoord)
   
   GeometryData data;
   
-  data.distance = _stacks[byteOffset + (stackSize - 1) * GEOMETRY_MEMBERS_COUNT + 2];
-  data.id = uint32(_stacks[byteOffset + (stackSize - 1) * GEOMETRY_MEMBERS_COUNT + 3]);
+  data.distance = _stacks[byteOffset + (stackSize - 1) * GEOMETRY_MEMBERS_COUNT + GEOMETRY_STACK_HEADER_MEMBERS_COUNT];
+  data.id = uint32(_stacks[byteOffset + (stackSize - 1) * GEOMETRY_MEMBERS_COUNT + GEOMETRY_STACK_HEADER_MEMBERS_COUNT + 1]);
 
   return data;
 }
@@ -60,8 +60,8 @@ void stackPushGeometry(uint2 pixelCoord, GeometryData geometry)
   uint32 byteOffset = getStackIndex(pixelCoord);
   uint32 stackSize = uint32(_stacks[byteOffset]);
 
-  _stacks[byteOffset + stackSize * GEOMETRY_MEMBERS_COUNT + 2]  = geometry.distance;
-  _stacks[byteOffset + stackSize * GEOMETRY_MEMBERS_COUNT + 3]  = geometry.id;
+  _stacks[byteOffset + stackSize * GEOMETRY_MEMBERS_COUNT + GEOMETRY_STACK_HEADER_MEMBERS_COUNT]     = geometry.distance;
+  _stacks[byteOffset + stackSize * GEOMETRY_MEMBERS_COUNT + GEOMETRY_STACK_HEADER_MEMBERS_COUNT + 1] = geometry.id;
 
   _stacks[byteOffset] = stackSize + 1;
 }
@@ -93,11 +93,41 @@ void stackClearSize(uint2 pixelCoord)
   _stacks[byteOffset] = 0;
 }
 
+struct TracingState
+{
+  float32 prevDistance;
+  float32 prevStep;
+  float32 relaxation;
+};
+
+TracingState stackGetTracingState(uint2 pixelCoord)
+{
+  uint32 byteOffset = getStackIndex(pixelCoord);
+
+  TracingState state;
+  state.prevDistance = _stacks[byteOffset + 2];
+  state.prevStep = _stacks[byteOffset + 3];
+  state.relaxation = _stacks[byteOffset + 4];
+
+  return state;
+}
+
+void stackSetTracingState(uint2 pixelCoord, TracingState state)
+{
+  uint32 byteOffset = getStackIndex(pixelCoord);
+  _stacks[byteOffset + 2] = state.prevDistance;
+  _stacks[byteOffset + 3] = state.prevStep;
+  _stacks[byteOffset + 4] = state.relaxation;
+}
+
 void stackClear(uint2 pixelCoord)
 {
   uint32 byteOffset = getStackIndex(pixelCoord);
   _stacks[byteOffset] = 0;
   _stacks[byteOffset + 1] = 0;  
+  _stacks[byteOffset + 2] = 0;
+  _stacks[byteOffset + 3] = 0;
+  _stacks[byteOffset + 4] = params.rayMarching.y;
 }
 
 #endif
@@ -13,6 +13,7 @@
 #include <camera.h>
 #include <logging.h>
 #include <application.h>
+#include <binary_document.h>
 #include <memory_manager.h>
 #include <game_framework.h>
 #include <assets/assets_manager.h>
@@ -293,15 +294,13 @@ void drawMenu(float2& outMenuSize)
       
       if(strlen(enteredName) > 0)
       {
-        std::ifstream file(enteredName);
-        if(file.is_open())
+        Document* document = nullptr;
+        if(openDocument(enteredName, &document) == TRUE)
         {
-          json jsonData;
-          file >> jsonData;
-
           Scene* loadedScene;
           createScene(&loadedScene);
-          assert(deserializeScene(loadedScene, jsonData));
+          assert(deserializeScene(loadedScene, documentGetRoot(document)));
+          closeDocument(document);
 
           editorSetScene(loadedScene);
         }
@@ -176,7 +176,7 @@ void drawMaterialItem(AssetPtr geometry, AssetPtr material)
   
   if(ImGui::SmallButton(ICON_KI_LIST))
   {
-    std::vector<AssetPtr> assetsToDisplay = assetsManagerGetAssetsByType(ASSET_TYPE_MATERIAL);
+    const std::vector<AssetPtr>& assetsToDisplay = assetsManagerGetAssetsByType(ASSET_TYPE_MATERIAL);
 
     std::vector<ListItem> items = {};
     for(AssetPtr asset: assetsToDisplay)
@@ -415,7 +415,7 @@ bool8 drawLightSourceItemActionButtons(AssetPtr lightSource)
 
 void drawGeometriesList(AssetPtr geometry)
 {
-  std::vector<AssetPtr> assetsToDisplay = assetsManagerGetAssetsByType(ASSET_TYPE_GEOMETRY);
+  const std::vector<AssetPtr>& assetsToDisplay = assetsManagerGetAssetsByType(ASSET_TYPE_GEOMETRY);
 
   std::vector<ListItem> items = {};
   for(AssetPtr asset: assetsToDisplay)
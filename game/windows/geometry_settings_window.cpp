@@ -17,6 +17,9 @@ struct GeometrySettingsWindowData
   bool8 positionRelativeToParent = TRUE;
   bool8 orientationRelativeToParent = TRUE;
   bool8 uniformScaling = TRUE;
+
+  uint3 latticeCount = uint3(2, 2, 2);
+  float3 latticeSpacing = float3(2.0f, 2.0f, 2.0f);
 };
 
 static bool8 geometrySettingsWindowInitialize(Window*);
@@ -341,6 +344,96 @@ void geometrySettingsWindowDraw(Window* window, float64 delta)
     
     ImGui::TreePop();
   }
+
+  // Baking
+  if(geometryIsBranch(data->geometry) && geometryIsRoot(data->geometry) == FALSE)
+  {
+    bool baked = geometryIsBaked(data->geometry);
+    if(ImGui::Checkbox("Baked", &baked))
+    {
+      geometrySetBaked(data->geometry, baked);
+    }
+  }
+  
+  // Instances
+  if(geometryIsLeaf(data->geometry) && ImGui::TreeNode("Instances"))
+  {
+    ImGui::InputScalarN("Count##Lattice", ImGuiDataType_U32, &data->latticeCount.x, 3);
+    ImGui::SliderFloat3("Spacing##Lattice", &data->latticeSpacing.x, 0.1f, 10.0f);
+
+    pushIconSmallButtonStyle();
+    ImGui::PushStyleColor(ImGuiCol_Text, (float4)NewClr);
+      if(ImGui::SmallButton("[Fill lattice]"))
+      {
+        geometryFillInstancesLattice(data->geometry, data->latticeCount, data->latticeSpacing);
+      }
+      ImGui::SameLine();
+
+      if(ImGui::SmallButton("[New instance]"))
+      {
+        geometryAddInstance(data->geometry, GeometryInstance());
+      }
+      ImGui::SameLine();
+    ImGui::PopStyleColor();
+
+    ImGui::PushStyleColor(ImGuiCol_Text, (float4)BrightDeleteClr);
+      if(ImGui::SmallButton("[" ICON_KI_TRASH " Clear]"))
+      {
+        geometryClearInstances(data->geometry);
+      }
+    ImGui::PopStyleColor();
+    popIconSmallButtonStyle();
+
+    GeometryInstancesLattice lattice;
+    const std::vector<GeometryInstance>& instances = geometryGetInstances(data->geometry);
+    
+    ImGui::Text("%u instances%s", (uint32)instances.size(),
+                geometryGetInstancesLattice(data->geometry, lattice) == TRUE ? " (lattice)" : "");
+
+    ImGuiListClipper clipper;
+    clipper.Begin(instances.size());
+    
+    bool8 removed = FALSE;
+    while(removed == FALSE && clipper.Step())
+    {
+      for(int32 i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+      {
+        GeometryInstance instance = instances[i];
+        bool8 changed = FALSE;
+
+        ImGui::PushID(i);
+          changed |= ImGui::SliderFloat3("Position##Instance", &instance.position.x, -10.0f, 10.0f);
+          changed |= ImGui::SliderFloat("Scale##Instance", &instance.scale, 0.01f, 10.0f);
+          ImGui::SameLine();
+
+          pushIconSmallButtonStyle();
+          ImGui::PushStyleColor(ImGuiCol_Text, (float4)BrightDeleteClr);
+            removed = ImGui::SmallButton(ICON_KI_TRASH"##RemoveInstance");
+          ImGui::PopStyleColor();
+          popIconSmallButtonStyle();
+        ImGui::PopID();
+
+        if(removed == TRUE)
+        {
+          geometryRemoveInstance(data->geometry, i);
+          break;
+        }
+        
+        if(changed == TRUE)
+        {
+          geometrySetInstance(data->geometry, i, instance);
+        }
+      }
+    }
+
+    // NOTE: Clipper asserts if it's destroyed in the middle of stepping
+    if(removed == TRUE)
+    {
+      clipper.End();
+    }
+    
+    ImGui::TreePop();
+  }
   
   // Script functions list
   if(ImGui::TreeNode("Attached script functions"))
@@ -193,15 +193,19 @@ void materialSettingsWindowDraw(Window* window, float64 delta)
 
           if(ImGui::Button("Load"))
           {
-            ImagePtr loadedImage = imageManagerLoadImage(data->texturePaths[type]);
-            if(loadedImage != ImagePtr(nullptr))
+            // NOTE: Region covers the whole image, so it's set once the size of the image is known
+            AssetPtr material = data->material;
+            imageManagerLoadImageAsync(data->texturePaths[type], [material, type](ImagePtr loadedImage)
             {
-              uint2 loadedTextureSize = imageGetSize(loadedImage);
-              uint4 loadedTextureRegion = uint4(0, 0, loadedTextureSize.x, loadedTextureSize.y);
-              
-              materialSetTexture(data->material, type, loadedImage);
-              materialSetTextureRegion(data->material, type, loadedTextureRegion);
-            }
+              if(loadedImage != ImagePtr(nullptr))
+              {
+                uint2 loadedTextureSize = imageGetSize(loadedImage);
+                uint4 loadedTextureRegion = uint4(0, 0, loadedTextureSize.x, loadedTextureSize.y);
+
+                materialSetTexture(material, type, loadedImage);
+                materialSetTextureRegion(material, type, loadedTextureRegion);
+              }
+            });
           }
 
         if(textureEnabled == TRUE)
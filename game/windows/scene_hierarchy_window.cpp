@@ -422,10 +422,7 @@ static void sceneHierarchyDraw(Window* window, float64 delta)
 
   if(newLsourcePressed)
   {
-    if(sceneAddLightSource(currentScene, createNewLight()) == FALSE)
-    {
-      LOG_WARNING("Attempt to create more light sources than possible (%d)!", MAX_LIGHT_SOURCES_COUNT);
-    }
+    sceneAddLightSource(currentScene, createNewLight());
   }
 
   if(showLsourcePressed)
@@ -323,6 +323,28 @@ void scriptFunctionSettingsWindowDraw(Window* window, float64 delta)
     ImGui::PopItemWidth();
     
   }
+
+  // --------------------------------------------------------------------------
+  // Lipschitz bound slider
+  // --------------------------------------------------------------------------
+
+  float32 lipschitzBound = scriptFunctionGetLipschitzBound(data->function);
+
+  ImGui::SameLine();
+  ImGui::PushItemWidth(50.0);
+  if(ImGui::DragFloat("Lipschitz bound", &lipschitzBound, 0.05, 1.0, 16.0, "%.2f"))
+  {
+    scriptFunctionSetLipschitzBound(data->function, lipschitzBound);
+  }
+
+  // NOTE: Geometries are notified once editing is finished, otherwise they'd be rebuilt each frame
+  if(ImGui::IsItemDeactivatedAfterEdit())
+  {
+    geometryTraversePostorder(sceneGetGeometryRoot(editorGetCurrentScene()),
+                              notifyGeometryScriptFunctionHasChanged,
+                              data->function);
+  }
+  ImGui::PopItemWidth();
   
 
   popIconSmallButtonStyle();
@@ -461,7 +483,10 @@ void scriptFunctionSettingsWindowDraw(Window* window, float64 delta)
 
               // Value column
               ImGui::TableSetColumnIndex(3);
-              ImGui::InputFloat("##ArgValueInput", &argIt->second, 0.0f, 0.0f, "%.1f");
+              if(ImGui::InputFloat("##ArgValueInput", &argIt->second, 0.0f, 0.0f, "%.1f"))
+              {
+                assetMarkModified(data->function);
+              }
 
             ImGui::PopID();
 
@@ -478,6 +503,7 @@ void scriptFunctionSettingsWindowDraw(Window* window, float64 delta)
                      argIt->first.c_str());
               
               argIt = args.erase(argIt);
+              assetMarkModified(data->function);
             }
           }
         }
@@ -501,6 +527,7 @@ void scriptFunctionSettingsWindowDraw(Window* window, float64 delta)
           if(argNameAlreadyExists == FALSE)
           {
             args[data->newArgName] = 0.0f;
+            assetMarkModified(data->function);
 
             logMsg(data->logger,
                    LOG_MESSAGE_TYPE_SUCCESS,
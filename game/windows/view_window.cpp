@@ -81,8 +81,8 @@ static void updateViewWindow(Window* window, float64 delta)
   
   if(data->controlMode != VIEW_CONTROL_MODE_NONE)
   {
-    const static float32& cameraSpeed = CVarSystemReadFloat("editor_ViewWindow_CameraSpeed");
-    float32 finalCameraSpeed = cameraSpeed;
+    const static CVarFloatHandle cameraSpeedHandle = StaticCVar_editor_ViewWindow_CameraSpeed.getHandle();
+    float32 finalCameraSpeed = CVarSystemRead(cameraSpeedHandle);
     if(glfwGetKey(glfwWindow, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
     {
       finalCameraSpeed *= 2.0f;
@@ -134,9 +134,32 @@ static void updateViewWindowSize(Window* window, uint2 size)
   imageIntegratorSetSize(data->integrator, size);
 }
 
+/** @param cursorPos position of the cursor relatively to the top-left corner of the image */
+static void viewWindowPickGeometry(Window* window, Scene* scene, float2 cursorPos, float2 imageSize)
+{
+  ViewWindowData* data = (ViewWindowData*)windowGetInternalData(window);
+  Camera* camera = imageIntegratorGetCamera(data->integrator);
+
+  // NOTE: Image is drawn flipped vertically, so the top of it is the top of NDC
+  float2 ndc = float2(cursorPos.x / imageSize.x * 2.0f - 1.0f,
+                      1.0f - cursorPos.y / imageSize.y * 2.0f);
+
+  bool ctrlPressed = ImGui::GetIO().KeyCtrl;
+  if(!ctrlPressed)
+  {
+    editorClearSelectedGeometry();
+  }
+
+  ScenePickResult pickResult = {};
+  if(scenePick(scene, cameraGenerateWorldRay(camera, ndc), pickResult, cameraGetFar(camera)) == TRUE)
+  {
+    geometrySetSelected(pickResult.geometry, geometryIsSelected(pickResult.geometry) == TRUE ? FALSE : TRUE);
+  }
+}
+
 static void drawViewWindow(Window* window, float64 delta)
 {
-  const static uint32& culledObjectsCounter = CVarSystemReadUint("engine_RasterizationStatistics_LastFrameCulledObjects");  
+  const static CVarUintHandle culledObjectsCounterHandle = CVarSystemGetUintHandle("engine_RasterizationStatistics_LastFrameCulledObjects");
   
   ViewWindowData* data = (ViewWindowData*)windowGetInternalData(window);
   ImGuiStyle& style = ImGui::GetStyle();
@@ -199,6 +222,12 @@ static void drawViewWindow(Window* window, float64 delta)
     ImGui::Image((void*)filmGetGLHandle(film),
                  float2(filmSize.x, filmSize.y), float2(0.0, 1.0), float2(1.0, 0.0));
 
+    if(ImGui::IsItemClicked(ImGuiMouseButton_Left) && data->controlMode == VIEW_CONTROL_MODE_NONE)
+    {
+      viewWindowPickGeometry(window, currentScene, float2(ImGui::GetMousePos()) - float2(ImGui::GetItemRectMin()),
+                             float2(ImGui::GetItemRectSize()));
+    }
+
     ImGui::SetCursorPos(initialCursorPos);
 
     if(ImGui::Button(ICON_KI_RELOAD_INVERSE"##view"))
@@ -268,7 +297,7 @@ static void drawViewWindow(Window* window, float64 delta)
     ImGui::Text("%s", shortInfoBuf);
 
     ImGui::SetCursorPos(initialCursorPos + float2(0.0f, avalReg.y - 1.5 * ImGui::GetFontSize()));
-    ImGui::Text("Culled objects: %d", culledObjectsCounter);
+    ImGui::Text("Culled objects: %d", CVarSystemRead(culledObjectsCounterHandle));
 
     static float32 imageButtonWidth = 10.0f;
     static float32 imageButtonHeight = 10.0f;
@@ -370,7 +399,8 @@ static void processInputViewWindow(Window* window,
   {
     if(data->controlMode != VIEW_CONTROL_MODE_NONE && ignoreFirstFrame == FALSE)
     {
-      const static float32& sensitivity = CVarSystemReadFloat("editor_ViewWindow_MouseSensitivity");
+      const static CVarFloatHandle sensitivityHandle = StaticCVar_editor_ViewWindow_MouseSensitivity.getHandle();
+      const float32 sensitivity = CVarSystemRead(sensitivityHandle);
 
       float32 dx = eventData.f32[0] * sensitivity;
       float32 dy = eventData.f32[1] * sensitivity;
@@ -526,15 +556,23 @@ static void drawViewSettingsWindow(Window* window, float64 delta)
     ImGui::SameLine();
     ImGui::Checkbox("Enable normals", (bool*)&params.enableNormals);
     ImGui::SameLine();
+    ImGui::Checkbox("Analytic normals", (bool*)&params.enableAnalyticNormals);
+    ImGui::SameLine();
     ImGui::Checkbox("Show UI widgets", (bool*)&params.showUIWidgets);
     ImGui::SameLine();
     ImGui::Checkbox("Show Lights", (bool*)&params.showLights);
+    ImGui::SameLine();
+    ImGui::Checkbox("Cache shadows", (bool*)&params.enableShadowCache);
     
     ImGui::Combo("Shading mode", (int32*)&params.shadingMode, shadingModeLabels, ARRAY_SIZE(shadingModeLabels));
     ImGui::SliderFloat("Gamma", &params.gamma, 1.0f, 3.0f);
     ImGui::SliderInt("Rasterizations iterations count", (int*)&params.rasterItersMaxCount, 1, 512);
     ImGui::SliderInt("Shadow rasterizations iterations count", (int*)&params.shadowRasterItersMaxCount, 1, 512);    
+    ImGui::SliderInt("Cone block size", (int*)&params.coneBlockSize, 1, 32);
+    ImGui::SliderInt("Cone iterations count", (int*)&params.coneItersMaxCount, 0, 128);
     ImGui::SliderFloat("Intersection threshold", &params.intersectionThreshold, 0.0001f, 100.0f);
+    ImGui::SliderFloat("Relaxation factor", &params.relaxationFactor, 1.0f, 1.99f);
+    ImGui::SliderFloat("Max trace distance", &params.maxTraceDistance, 1.0f, 1000.0f);
 
     uint2 minValue = uint2(0, 0), maxValue = uint2(128, 128);
     ImGui::SliderScalarN("Pixel gap", ImGuiDataType_U32, &params.pixelGap, 2, &minValue, &maxValue);    
@@ -444,6 +444,7 @@ static void processInputApplication()
 static void updateApplication(float64 delta)
 {
   schedulerUpdate(delta);
+  imageManagerUpdate();
   masUpdate();
   game.update(&application, delta);
 }
@@ -1,6 +1,7 @@
 #include <memory_manager.h>
 
 #include "asset.h"
+#include "assets_manager.h"
 
 using std::string;
 
@@ -8,6 +9,7 @@ struct Asset
 {
   AssetInterface interface;
   string name;
+  uint32 revision;
 
   void* internalData;
 };
@@ -19,6 +21,7 @@ bool8 allocateAsset(AssetInterface interface, const string& name, Asset** outAss
   Asset* asset = *outAsset;
   asset->interface = interface;
   asset->name = name;
+  asset->revision = 0;
 
   return TRUE;
 }
@@ -46,13 +49,13 @@ bool8 assetSerialize(AssetPtr asset, nlohmann::json& jsonData)
   return FALSE;
 }
 
-bool8 assetDeserialize(AssetPtr asset, nlohmann::json& jsonData)
+bool8 assetDeserialize(AssetPtr asset, DocumentValue value)
 {
   if(asset->interface.deserialize != nullptr)
   {
-    asset->name = jsonData["name"];
+    asset->name = documentValueGetString(documentValueFind(value, "name"));
     
-    return asset->interface.deserialize(asset, jsonData);
+    return asset->interface.deserialize(asset, value);
   }
 
   return FALSE;  
@@ -63,6 +66,10 @@ void assetSetName(Asset* asset, const std::string& newName)
   std::string prevName = asset->name;
   
   asset->name = newName;
+  assetMarkModified(asset);
+
+  assetsManagerOnAssetRenamed(asset, prevName);
+
   if(asset->interface.onNameChanged != nullptr)
   {
     asset->interface.onNameChanged(asset, prevName, newName);
@@ -79,6 +86,21 @@ AssetType assetGetType(Asset* asset)
   return asset->interface.type;
 }
 
+void assetMarkModified(Asset* asset)
+{
+  asset->revision++;
+}
+
+uint32 assetGetRevision(Asset* asset)
+{
+  if(asset->interface.refreshRevision != nullptr)
+  {
+    asset->interface.refreshRevision(asset);
+  }
+
+  return asset->revision;
+}
+
 void assetSetInternalData(Asset* asset, void* data)
 {
   asset->internalData = data;
@@ -4,6 +4,8 @@
 
 #include <nlohmann/json.hpp>
 
+#include "binary_document.h"
+
 #include "ptr.h"
 #include "defines.h"
 
@@ -23,8 +25,11 @@ struct AssetInterface
   // NOTE: Serialize/Deserialize requires AssetPtr, because some assets
   // may need to know what smart pointer belongs to the asset (e.g geometry)
   bool8(*serialize)(AssetPtr, nlohmann::json&);
-  bool8(*deserialize)(AssetPtr, nlohmann::json&);
+  bool8(*deserialize)(AssetPtr, DocumentValue);
   uint32(*getSize)(Asset*);
+  // NOTE: Optional, called before the revision is read, so that the asset can mark itself as
+  // modified when assets it serializes (but doesn't get notified about) have changed
+  void (*refreshRevision)(Asset*);
   
   void (*onNameChanged)(Asset*, const std::string&, const std::string&);
   
@@ -35,17 +40,34 @@ ENGINE_API bool8 allocateAsset(AssetInterface interface, const std::string& name
 
 
 ENGINE_API bool8 assetSerialize(AssetPtr asset, nlohmann::json& jsonData);
-ENGINE_API bool8 assetDeserialize(AssetPtr asset, nlohmann::json& jsonData);
+ENGINE_API bool8 assetDeserialize(AssetPtr asset, DocumentValue value);
 
-// WARNING: Be careful with name changing. When an asset from asset manager is changing a name,
-// asset manger should be informed immediately!
-// CONSIDER: We can add a previousName variable, so that asset manager can check name changing
-// by itsel
-// CONSIDER: We can also trigger an event
+// NOTE: Asset manager is informed about the name changing, but it doesn't check that the new name
+// is free, so check it beforehand (see assetsManagerHasAsset())
 ENGINE_API void assetSetName(Asset* asset, const std::string& newName);
 ENGINE_API const std::string& assetGetName(Asset* asset);
 ENGINE_API AssetType assetGetType(Asset* asset);
 
+/**
+ * Revision is increased each time the asset is changed in a way which affects its serialized
+ * state, so that e.g autosave can skip assets which weren't changed since the last save.
+ */
+ENGINE_API void assetMarkModified(Asset* asset);
+ENGINE_API uint32 assetGetRevision(Asset* asset);
+
+/** Assigns a serialized property, asset is marked as modified only if the value has changed */
+template <typename T>
+void assetSetProperty(Asset* asset, T& property, const T& value)
+{
+  if(property == value)
+  {
+    return;
+  }
+
+  property = value;
+  assetMarkModified(asset);
+}
+
 void assetSetInternalData(Asset* asset, void* data);
 void* assetGetInternalData(Asset* asset);
 
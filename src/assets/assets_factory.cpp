@@ -5,11 +5,11 @@
 #include "light_source.h"
 #include "script_function.h"
 
-AssetPtr createAssetFromJson(nlohmann::json& jsonData)
+AssetPtr createAssetFromDocument(DocumentValue value)
 {
-  if(jsonData.contains("type_id"))
+  if(documentValueContains(value, "type_id"))
   {
-    AssetType typeId = AssetType(jsonData["type_id"]);
+    AssetType typeId = documentValueGet(value, "type_id", AssetType(0));
     Asset* asset = nullptr;
     
     switch(typeId)
@@ -18,7 +18,7 @@ AssetPtr createAssetFromJson(nlohmann::json& jsonData)
       case ASSET_TYPE_LIGHT_SOURCE: createLightSource("", 0, &asset); break;      
       case ASSET_TYPE_SCRIPT_FUNCTION:
       {
-        if(ScriptFunctionType(jsonData["sf_type"]) == SCRIPT_FUNCTION_TYPE_PCF)
+        if(documentValueGet(value, "sf_type", SCRIPT_FUNCTION_TYPE_SDF) == SCRIPT_FUNCTION_TYPE_PCF)
         {
           createPCF("", PCF_NATIVE_TYPE_INTERSECTION, &asset);
         }
@@ -30,16 +30,16 @@ AssetPtr createAssetFromJson(nlohmann::json& jsonData)
       case ASSET_TYPE_MATERIAL: createMaterial("", &asset); break;
       default:
       {
-        LOG_ERROR("Attempt to create asset from a json with unknown ID!");
+        LOG_ERROR("Attempt to create asset from a document with unknown ID!");
         return AssetPtr(nullptr);
       }
     }
 
     AssetPtr assetPtr = AssetPtr(asset);
 
-    if(assetDeserialize(assetPtr, jsonData) == FALSE)
+    if(assetDeserialize(assetPtr, value) == FALSE)
     {
-      LOG_ERROR("Cannot create asset from a json because given json has wrong data!");
+      LOG_ERROR("Cannot create asset from a document because given document has wrong data!");
       return AssetPtr(nullptr);
     }
 
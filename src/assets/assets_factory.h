@@ -1,6 +1,6 @@
 #pragma once
 
-#include <nlohmann/json.hpp>
 #include "asset.h"
+#include "binary_document.h"
 
-ENGINE_API AssetPtr createAssetFromJson(nlohmann::json& jsonData);
+ENGINE_API AssetPtr createAssetFromDocument(DocumentValue value);
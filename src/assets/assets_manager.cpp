@@ -1,5 +1,7 @@
 #include <string>
 #include <vector>
+#include <cstdio>
+#include <memory>
 #include <fstream>
 #include <algorithm>
 #include <unordered_map>
@@ -13,151 +15,392 @@ using namespace nlohmann;
 
 #include <logging.h>
 #include <scheduler.h>
+#include <binary_document.h>
 #include <assets/geometry.h>
 #include <assets/assets_factory.h>
 
 #include "assets_manager.h"
 
+struct AutosaveCacheEntry
+{
+  uint32 revision;
+  string name;
+
+  // NOTE: Dumped json of the asset from the last save, nullptr if it wasn't dumped yet
+  std::shared_ptr<string> dump;
+};
+
+struct AutosaveDumpRequest
+{
+  json jsonData;
+  std::shared_ptr<string> dump;
+};
+
 struct AssetsManager
 {
+  // NOTE: Owns assets and keeps the order in which they were registered
   vector<AssetPtr> assets;
+
+  // NOTE: Assets can be renamed without checking that the name is free, so a name refers to all
+  // registered assets with it, the first one is reachable by the name
+  unordered_map<string, vector<AssetPtr>> assetsByName;
+  unordered_map<AssetType, vector<AssetPtr>> assetsByType;
+
+  SchedulerTaskHandle autosaveTask;
+  bool8 savingInProgress;
+
+  unordered_map<Asset*, AutosaveCacheEntry> autosaveCache;
+  bool8 assetsListChanged;
 };
 
 static AssetsManager manager;
 
+static void assetsManagerInvalidateGeometriesDumps()
+{
+  for(auto& cachePair: manager.autosaveCache)
+  {
+    if(assetGetType(cachePair.first) == ASSET_TYPE_GEOMETRY)
+    {
+      cachePair.second.dump = nullptr;
+    }
+  }
+}
 
-static void assetsManagerSaveToFile(float32 time, const std::string& fileName, void* owner, void* data)
+static void assetsManagerForgetAsset(Asset* asset)
 {
-  json jsonData;
-  vector<AssetPtr> geometries;
+  manager.autosaveCache.erase(asset);
+  manager.assetsListChanged = TRUE;
 
-  uint32 counter = 0;
-  for(AssetPtr asset : manager.assets)
+  // NOTE: Geometries refer to other assets by name (and store prototypes differently from forked
+  // functions), so their dumps may become outdated
+  if(assetGetType(asset) != ASSET_TYPE_GEOMETRY)
   {
-    if(assetGetType(asset) == ASSET_TYPE_GEOMETRY)
+    assetsManagerInvalidateGeometriesDumps();
+  }
+}
+
+/**
+ * Runs on a worker thread: dumps json of changed assets and writes the whole database into
+ * a temporary file, which then replaces the destination one, so that the database on disk is never
+ * left half-written.
+ */
+static bool8 assetsManagerWriteDatabase(const string& fileName,
+                                        vector<AutosaveDumpRequest>& dumpRequests,
+                                        const vector<std::shared_ptr<string>>& dumps)
+{
+  for(AutosaveDumpRequest& request: dumpRequests)
+  {
+    *request.dump = request.jsonData.dump();
+  }
+
+  string tempFileName = fileName + ".tmp";
+
+  {
+    std::ofstream file(tempFileName, std::ios::out | std::ios::trunc);
+    file << "{\"assets\":[";
+
+    for(uint32 dumpIdx = 0; dumpIdx < dumps.size(); dumpIdx++)
     {
-      geometries.push_back(asset);
+      if(dumpIdx > 0)
+      {
+        file << ',';
+      }
+
+      file << *dumps[dumpIdx];
     }
-    else
+
+    file << "]}";
+    file.flush();
+
+    if(file.good() == FALSE)
+    {
+      return FALSE;
+    }
+  }
+
+  return std::rename(tempFileName.c_str(), fileName.c_str()) == 0 ? TRUE : FALSE;
+}
+
+static void assetsManagerSaveToFile(float32 time, const std::string& fileName, void* owner, void* data)
+{
+  // NOTE: Previous save is still being written, skip this one instead of queueing up writes
+  if(manager.savingInProgress == TRUE)
+  {
+    return;
+  }
+
+  bool8 needSave = manager.assetsListChanged;
+  for(AssetPtr asset: manager.assets)
+  {
+    auto cacheIt = manager.autosaveCache.find(asset);
+    if(cacheIt == manager.autosaveCache.end() || cacheIt->second.revision != assetGetRevision(asset))
     {
-      assetSerialize(asset, jsonData["assets"][counter++]);
+      needSave = TRUE;
+
+      if(cacheIt != manager.autosaveCache.end() && cacheIt->second.name != assetGetName(asset) &&
+         assetGetType(asset) != ASSET_TYPE_GEOMETRY)
+      {
+        assetsManagerInvalidateGeometriesDumps();
+      }
     }
   }
 
+  if(needSave == FALSE)
+  {
+    return;
+  }
+
   // Geometries should be serialized in the end, because they depend on the other assets, so that
   // during deserialization of geometry, everything else will be already deserialized.
-  for(AssetPtr geometry: geometries)
+  vector<AssetPtr> orderedAssets;
+  orderedAssets.reserve(manager.assets.size());
+
+  for(AssetPtr asset: manager.assets)
   {
-    assetSerialize(geometry, jsonData["assets"][counter++]);
+    if(assetGetType(asset) != ASSET_TYPE_GEOMETRY)
+    {
+      orderedAssets.push_back(asset);
+    }
   }
-  
-  jsonData.dump(4);
-  
-  std::ofstream file(fileName);
-  file << jsonData;
-  
-  LOG_INFO("Assets have been successfully saved!");
+
+  for(AssetPtr asset: manager.assets)
+  {
+    if(assetGetType(asset) == ASSET_TYPE_GEOMETRY)
+    {
+      orderedAssets.push_back(asset);
+    }
+  }
+
+  // NOTE: Serialization touches assets, so only changed assets are serialized here (on the main
+  // thread), dumping and writing are done by a worker. Shared, because std::function requires
+  // a copyable callable.
+  auto dumpRequests = std::make_shared<vector<AutosaveDumpRequest>>();
+  auto dumps = std::make_shared<vector<std::shared_ptr<string>>>();
+  dumps->reserve(orderedAssets.size());
+
+  for(AssetPtr asset: orderedAssets)
+  {
+    AutosaveCacheEntry& cacheEntry = manager.autosaveCache[asset];
+
+    if(cacheEntry.dump == nullptr || cacheEntry.revision != assetGetRevision(asset))
+    {
+      // NOTE: Dump is filled by the worker, nobody reads it until the save is completed
+      cacheEntry.revision = assetGetRevision(asset);
+      cacheEntry.name = assetGetName(asset);
+      cacheEntry.dump = std::make_shared<string>();
+
+      dumpRequests->push_back(AutosaveDumpRequest{json(), cacheEntry.dump});
+      assetSerialize(asset, dumpRequests->back().jsonData);
+    }
+
+    dumps->push_back(cacheEntry.dump);
+  }
+
+  manager.assetsListChanged = FALSE;
+  manager.savingInProgress = TRUE;
+
+  uint32 serializedCount = dumpRequests->size();
+  auto saved = std::make_shared<bool8>(FALSE);
+
+  schedulerSubmitJob([fileName, dumpRequests, dumps, saved]()
+  {
+    *saved = assetsManagerWriteDatabase(fileName, *dumpRequests, *dumps);
+  },
+  [fileName, saved, serializedCount]()
+  {
+    manager.savingInProgress = FALSE;
+
+    if(*saved == TRUE)
+    {
+      LOG_INFO("Assets have been successfully saved (%u changed)!", serializedCount);
+    }
+    else
+    {
+      // NOTE: Dumps are valid, so the next autosave only needs to rewrite the file
+      manager.assetsListChanged = TRUE;
+
+      LOG_ERROR("Cannot save assets to '%s'!", fileName.c_str());
+    }
+  });
 }
 
 bool8 initAssetsManager()
 {
+  manager.savingInProgress = FALSE;
+
   if(assetsManagerLoadFromFile("saved_assets.json") == FALSE)
   {
     LOG_WARNING("No saved assets were discovered, either they were deleted or moved.");
   }
+  else
+  {
+    // NOTE: Loaded assets are the same as on the disk, so nothing has to be saved until they change
+    for(AssetPtr asset: manager.assets)
+    {
+      manager.autosaveCache[asset] = AutosaveCacheEntry{assetGetRevision(asset), assetGetName(asset), nullptr};
+    }
+
+    manager.assetsListChanged = FALSE;
+  }
 
-  schedulerRegisterFunctionT1(assetsManagerSaveToFile, 30.0f, "saved_assets.json");
+  manager.autosaveTask = schedulerRegisterFunctionT1(assetsManagerSaveToFile, 30.0f, std::string("saved_assets.json"));
   
   return TRUE;
 }
 
 void shutdownAssetsManager()
 {
+  schedulerCancelFunction(manager.autosaveTask);
+  manager.autosaveCache.clear();
+  manager.assetsByName.clear();
+  manager.assetsByType.clear();
   manager.assets.clear();
 }
 
 bool8 assetsManagerLoadFromFile(const std::string& fileName)
 {
-  std::ifstream file(fileName);
-  if(file.is_open())
+  Document* document = nullptr;
+  if(openDocument(fileName, &document) == TRUE)
   {
-    json jsonData;
-    file >> jsonData;
-
-    for(json assetJson: jsonData["assets"])
+    DocumentValue assets = documentValueFind(documentGetRoot(document), "assets");
+    for(uint32 assetIdx = 0; assetIdx < documentValueGetSize(assets); assetIdx++)
     {
-      AssetPtr asset = createAssetFromJson(assetJson);
+      DocumentValue assetValue = documentValueGetElement(assets, assetIdx);
+      string assetName = string(documentValueGetString(documentValueFind(assetValue, "name")));
+
+      AssetPtr asset = createAssetFromDocument(assetValue);
       if(asset == AssetPtr(nullptr))
       {
-        LOG_ERROR("Asset manager cannot load an asset %s from '%s'!", jsonData.value("name", "").c_str(), fileName.c_str());
+        LOG_ERROR("Asset manager cannot load an asset %s from '%s'!", assetName.c_str(), fileName.c_str());
       }
       else
       {
         if(assetsManagerAddAsset(asset) == FALSE)
         {
           LOG_WARNING("File '%s' contains asset '%s', which is already registered!",
-                      fileName.c_str(), assetJson.at("name").get<std::string>().c_str());
+                      fileName.c_str(), assetName.c_str());
         }
       }
     }
 
+    closeDocument(document);
     return TRUE;
   }
 
   return FALSE;
 }
 
+static void assetsManagerIndexName(AssetPtr asset)
+{
+  const string& name = assetGetName(asset);
+
+  vector<AssetPtr>& sameNameAssets = manager.assetsByName[name];
+  if(sameNameAssets.empty() == FALSE)
+  {
+    LOG_WARNING("Asset '%s' has the same name as another registered asset!", name.c_str());
+  }
+
+  sameNameAssets.push_back(asset);
+}
+
+/** @return the registered asset or nullptr if the asset isn't registered with the name */
+static AssetPtr assetsManagerUnindexName(Asset* asset, const string& name)
+{
+  auto nameIt = manager.assetsByName.find(name);
+  if(nameIt == manager.assetsByName.end())
+  {
+    return AssetPtr(nullptr);
+  }
+
+  vector<AssetPtr>& sameNameAssets = nameIt->second;
+
+  auto assetIt = std::find(sameNameAssets.begin(), sameNameAssets.end(), asset);
+  if(assetIt == sameNameAssets.end())
+  {
+    return AssetPtr(nullptr);
+  }
+
+  // NOTE: If the asset was reachable by the name, the next one with the same name becomes reachable
+  AssetPtr unindexedAsset = *assetIt;
+  sameNameAssets.erase(assetIt);
+
+  if(sameNameAssets.empty())
+  {
+    manager.assetsByName.erase(nameIt);
+  }
+
+  return unindexedAsset;
+}
+
+static bool8 assetsManagerRemoveRegisteredAsset(Asset* asset)
+{
+  auto assetIt = std::find(manager.assets.begin(), manager.assets.end(), asset);
+  if(assetIt == manager.assets.end())
+  {
+    return FALSE;
+  }
+
+  // NOTE: Asset must stay alive until it's removed from all the containers
+  AssetPtr removedAsset = *assetIt;
+  manager.assets.erase(assetIt);
+
+  vector<AssetPtr>& typeBucket = manager.assetsByType[assetGetType(asset)];
+  typeBucket.erase(std::find(typeBucket.begin(), typeBucket.end(), asset));
+
+  assetsManagerUnindexName(asset, assetGetName(asset));
+  assetsManagerForgetAsset(asset);
+
+  return TRUE;
+}
+
 bool8 assetsManagerAddAsset(AssetPtr asset)
 {
-  auto assetIt = std::find_if(manager.assets.begin(),
-                              manager.assets.end(),
-                              [asset](AssetPtr arrAsset){ return assetGetName(asset) == assetGetName(arrAsset); });
-  
-  if(assetIt != manager.assets.end())
+  if(manager.assetsByName.find(assetGetName(asset)) != manager.assetsByName.end())
   {
     return FALSE;
   }
 
   manager.assets.push_back(asset);
+  manager.assetsByName[assetGetName(asset)].push_back(asset);
+  manager.assetsByType[assetGetType(asset)].push_back(asset);
+  manager.assetsListChanged = TRUE;
+
   return TRUE;
 }
 
 bool8 assetsManagerRemoveAsset(Asset* asset)
 {
-  auto assetIt = std::find(manager.assets.begin(), manager.assets.end(), asset);
-  if(assetIt != manager.assets.end())
+  return assetsManagerRemoveRegisteredAsset(asset);
+}
+
+bool8 assetsManagerRemoveAsset(const std::string& name)
+{
+  auto nameIt = manager.assetsByName.find(name);
+  if(nameIt != manager.assetsByName.end())
   {
-    manager.assets.erase(assetIt);
-    return TRUE;
+    return assetsManagerRemoveRegisteredAsset(nameIt->second.front());
   }
 
   return FALSE;
 }
 
-bool8 assetsManagerRemoveAsset(const std::string& name)
+void assetsManagerOnAssetRenamed(Asset* asset, const std::string& prevName)
 {
-  auto assetIt = std::find_if(manager.assets.begin(),
-                              manager.assets.end(),
-                              [&name](Asset* asset) { return assetGetName(asset) == name; });
-
-  if(assetIt != manager.assets.end())
+  // NOTE: Registered assets are always indexed by their names, so an asset, which isn't found by
+  // the previous name, isn't registered
+  AssetPtr renamedAsset = assetsManagerUnindexName(asset, prevName);
+  if(renamedAsset != AssetPtr(nullptr))
   {
-    manager.assets.erase(assetIt);
-    return TRUE;
+    assetsManagerIndexName(renamedAsset);
   }
-
-  return FALSE;
 }
 
 AssetPtr assetsManagerFindAsset(const std::string& name)
 {
-  auto assetIt = std::find_if(manager.assets.begin(),
-                              manager.assets.end(),
-                              [&name](AssetPtr asset){ return assetGetName(asset) == name; });
-
-  if(assetIt != manager.assets.end())
+  auto nameIt = manager.assetsByName.find(name);
+  if(nameIt != manager.assetsByName.end())
   {
-    return *assetIt;
+    return nameIt->second.front();
   }
   
   return AssetPtr(nullptr);
@@ -165,16 +408,24 @@ AssetPtr assetsManagerFindAsset(const std::string& name)
 
 bool8 assetsManagerHasAsset(AssetPtr asset)
 {
-  auto assetIt = std::find_if(manager.assets.begin(),
-                              manager.assets.end(),
-                              [&asset](AssetPtr lasset) { return lasset == asset; });
-  
-  return assetIt != manager.assets.end() ? TRUE : FALSE;
+  if(asset == AssetPtr(nullptr))
+  {
+    return FALSE;
+  }
+
+  auto nameIt = manager.assetsByName.find(assetGetName(asset));
+  if(nameIt == manager.assetsByName.end())
+  {
+    return FALSE;
+  }
+
+  const vector<AssetPtr>& sameNameAssets = nameIt->second;
+  return std::find(sameNameAssets.begin(), sameNameAssets.end(), asset) != sameNameAssets.end() ? TRUE : FALSE;
 }
 
 bool8 assetsManagerHasAsset(const std::string& name)
 {
-  return assetsManagerFindAsset(name) != nullptr;
+  return manager.assetsByName.find(name) != manager.assetsByName.end() ? TRUE : FALSE;
 }
 
 const std::vector<AssetPtr>& assetsManagerGetAssets()
@@ -182,16 +433,10 @@ const std::vector<AssetPtr>& assetsManagerGetAssets()
   return manager.assets;
 }
 
-std::vector<AssetPtr> assetsManagerGetAssetsByType(AssetType type)
+const std::vector<AssetPtr>& assetsManagerGetAssetsByType(AssetType type)
 {
-  std::vector<AssetPtr> result;
-  for(auto it = manager.assets.begin(); it != manager.assets.end(); it++)
-  {
-    if(assetGetType(*it) == type)
-    {
-      result.push_back(*it);
-    }
-  }
+  static const std::vector<AssetPtr> emptyBucket;
 
-  return result;
+  auto typeIt = manager.assetsByType.find(type);
+  return typeIt != manager.assetsByType.end() ? typeIt->second : emptyBucket;
 }
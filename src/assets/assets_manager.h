@@ -18,5 +18,13 @@ ENGINE_API bool8 assetsManagerHasAsset(AssetPtr asset);
 ENGINE_API bool8 assetsManagerHasAsset(const std::string& name);
 
 ENGINE_API const std::vector<AssetPtr>& assetsManagerGetAssets();
-ENGINE_API std::vector<AssetPtr> assetsManagerGetAssetsByType(AssetType type);
+
+/**
+ * @return assets of the type in the order of registration.
+ * @warning Reference is invalidated when assets of the type are added or removed.
+ */
+ENGINE_API const std::vector<AssetPtr>& assetsManagerGetAssetsByType(AssetType type);
+
+/** Called by assetSetName() to keep the index of names up to date */
+void assetsManagerOnAssetRenamed(Asset* asset, const std::string& prevName);
 
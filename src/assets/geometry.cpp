@@ -1,6 +1,7 @@
 #include <cstring>
 
 #include <string>
+#include <algorithm>
 #include <vector>
 
 #include "logging.h"
@@ -11,6 +12,8 @@
 #include "assets_factory.h"
 #include "maths/json_serializers.h"
 #include "renderer/passes/geometry_native_aabb_calculation_pass.h"
+#include "renderer/passes/geometry_ray_hit_pass.h"
+#include "renderer/passes/distance_field_baking_pass.h"
 
 #include "geometry.h"
 
@@ -23,6 +26,24 @@ DECLARE_CVAR(engine_AABBCalculation_IterationsCount, 12u);
 DECLARE_CVAR(engine_AABBCalculation_RaysPerIteration, 1024u);
 DECLARE_CVAR(engine_AABBCalculation_LocalWorkGroupSize, 32u);
 
+// NOTE: Bumped each time AABB calculation cvars are changed, geometries compare it with their own
+// generation to find out whether native AABB (or AABB calculation program) is outdated.
+static uint32 aabbCalculationGeneration = 0;
+static uint32 aabbProgramGeneration = 0;
+// NOTE: Bumped each time distance field baking cvars are changed, trees compare it with their own
+// generation to find out whether baked fields are outdated.
+static uint32 bakingGeneration = 0;
+
+struct GeometryEditTransaction
+{
+  uint32 depth;
+
+  // NOTE: Geometries which have structureChanged flag set, they're processed on commit
+  vector<Asset*> editedGeometries;
+};
+
+static GeometryEditTransaction editTransaction;
+
 struct Geometry
 {
   // Common data
@@ -55,92 +76,284 @@ struct Geometry
   ShaderProgramPtr drawProgram;
   ShaderProgramPtr shadowProgram;
   ShaderProgramPtr aabbProgram;
+  // NOTE: Only leaves have them, see geometryRebuildQueryPrograms(), except occlusion programs of
+  // branches which aren't unions, see geometryLinkOcclusionProxyProgram()
+  ShaderProgramPtr normalsProgram;
+  ShaderProgramPtr occlusionProgram;
+  // NOTE: Linked on demand by the first picking of the leaf, see geometryTraceRay()
+  ShaderProgramPtr rayHitProgram;
 
   bool8 bounded;
   bool8 aabbAutomaticallyCalculated;
   bool8 needAABBRecalculation;
   bool8 needRebuild;
   bool8 dirty;
+
+  // NOTE: Children were added or removed during the current edit transaction
+  bool8 structureChanged;
+
+  // NOTE: Geometry has to be processed by the next geometryUpdate() of its tree
+  bool8 changed;
+
+  // NOTE: Code of some of its functions reads global parameters, it's updated before the rebuild
+  bool8 readsGlobalParameters;
+
+  uint32 aabbCalculationGeneration;
+  uint32 aabbProgramGeneration;
   bool8 selected;
   bool8 enabled;
 
   // Root geometry data
   set<AssetPtr> allChildren;
+
+  // NOTE: Sum of revisions of functions of the tree, functions are serialized within the tree,
+  // but they're edited directly (e.g by the script function settings window)
+  uint32 functionsRevision;
+
+  // NOTE: Allocated on demand, only for roots
+  GeometryFlatTree* flatTree;
+  bool8 flatTreeOutdated;
+
+  // NOTE: At least one geometry of the tree has changed since the last update
+  bool8 treeChanged;
   
   // Branch geometry data
   std::vector<AssetPtr> children;  
 
+  // NOTE: Subtree is drawn as a single node, which samples its distance field baked on GPU
+  bool8 baked;
+  bool8 bakeOutdated;
+  BakedDistanceField* bakedField;
+  ShaderProgramPtr bakedDrawProgram;
+  ShaderProgramPtr bakedShadowProgram;
+  ShaderProgramPtr bakedOcclusionProgram;
+
   // Leaf geometry data
   AssetPtr sdf;
   AssetPtr material;
+
+  std::vector<GeometryInstance> instances;
+  bool8 instancesFormLattice = FALSE;
+  GeometryInstancesLattice instancesLattice;
 };
 
 static void geometryDestroy(Asset* geometry);
 static bool8 geometrySerialize(AssetPtr geometry, json& jsonData);
-static bool8 geometryDeserialize(AssetPtr geometry, json& jsonData);
+static bool8 geometryDeserialize(AssetPtr geometry, DocumentValue value);
 static uint32 geometryGetSize(Asset* geometry) { /** TODO */ }
 
 // ----------------------------------------------------------------------------
 // Helper functions
 // ----------------------------------------------------------------------------
 
-static void geometryRecalculateFullTransforms(Asset* geometry, bool8 parentWasDirty = FALSE)
+// NOTE: Unlike AABB::genTransformed(), transformation isn't applied relatively to the center
+static AABB geometryTransformAABB(const AABB& aabb, const float4x4& transformation)
 {
-  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  float3 cMin = mul(transformation, float4(aabb.getVertex(0), 1.0f)).xyz();
+  float3 cMax = cMin;
+
+  for(uint32 i = 1; i < 8; i++)
+  {
+    float3 vertex = mul(transformation, float4(aabb.getVertex(i), 1.0f)).xyz();
+    cMin = min(cMin, vertex);
+    cMax = max(cMax, vertex);
+  }
+
+  return AABB(cMin, cMax);
+}
+
+static float4x4 geometryInstanceGetTransform(const GeometryInstance& instance)
+{
+  return mul(translation_matrix(instance.position),
+             mul(rotation_matrix(instance.orientation),
+                 scaling_matrix(float3(instance.scale, instance.scale, instance.scale))));
+}
+
+// NOTE: AABB which contains all instances, in the space of the geometry
+static AABB geometryCalculateInstancesAABB(Geometry* geometryData)
+{
+  AABB instancesAABB = geometryTransformAABB(geometryData->nativeAABB,
+                                             geometryInstanceGetTransform(geometryData->instances[0]));
+
+  for(uint32 i = 1; i < geometryData->instances.size(); i++)
+  {
+    instancesAABB |= geometryTransformAABB(geometryData->nativeAABB,
+                                           geometryInstanceGetTransform(geometryData->instances[i]));
+  }
+
+  return instancesAABB;
+}
+
+static bool8 geometryDetectInstancesLattice(const vector<GeometryInstance>& instances,
+                                            GeometryInstancesLattice& outLattice)
+{
+  // NOTE: Deviation of a position from its cell, relatively to the spacing
+  const static float32 cellEpsilon = 0.001f;
   
-  // NOTE: If parent was dirty, then its matrices have been recalculated in some way, hence, even
-  // if child is not dirty, its transforms still should be recalculated
-  if(geometryData->dirty == TRUE || parentWasDirty == TRUE)
+  if(instances.size() < 2)
   {
-    float4x4 transformFromLocal = mul(translation_matrix(geometryData->position),
-                                      rotation_matrix(geometryData->orientation));
+    return FALSE;
+  }
 
-    float4x4 transformToLocal = inverse(transformFromLocal);
+  const GeometryInstance& first = instances[0];
+  float3 minPosition = first.position;
   
-    if(geometryIsRoot(geometry))
+  for(const GeometryInstance& instance: instances)
+  {
+    if(instance.orientation != first.orientation ||
+       instance.scale != first.scale ||
+       instance.material.raw() != first.material.raw())
     {
-      // NOTE: Root geometry doesn't have a parent => use identity matrix for parent-related
-      // transforms
-      geometryData->transformToLocalFromParent = scaling_matrix(float3(1.0f, 1.0f, 1.0f));
-      geometryData->transformToParentFromLocal = scaling_matrix(float3(1.0f, 1.0f, 1.0f));
+      return FALSE;
+    }
 
-      geometryData->transformToLocal = transformToLocal;
-      geometryData->transformToWorld = transformFromLocal;
+    minPosition = min(minPosition, instance.position);
+  }
 
-      geometryData->fullScale = geometryData->scale;
+  // NOTE: Lattice has as many cells along an axis as there are distinct coordinates along it
+  uint3 count;
+  float3 spacing;
+  
+  for(uint32 axis = 0; axis < 3; axis++)
+  {
+    vector<float32> coordinates;
+    coordinates.reserve(instances.size());
+    
+    for(const GeometryInstance& instance: instances)
+    {
+      coordinates.push_back(instance.position[axis]);
     }
-    else
+
+    std::sort(coordinates.begin(), coordinates.end());
+
+    float32 extent = coordinates.back() - coordinates.front();
+    float32 epsilon = cellEpsilon * std::max(extent, 1.0f) / instances.size();
+    
+    count[axis] = 1;
+    for(uint32 i = 1; i < coordinates.size(); i++)
+    {
+      if(coordinates[i] - coordinates[i - 1] > epsilon)
+      {
+        count[axis]++;
+      }
+    }
+
+    spacing[axis] = count[axis] > 1 ? extent / (count[axis] - 1) : 1.0f;
+  }
+
+  if(count.x * count.y * count.z != instances.size())
+  {
+    return FALSE;
+  }
+
+  // NOTE: Each cell has to be occupied by exactly one instance
+  vector<bool> occupiedCells(instances.size(), false);
+  
+  for(const GeometryInstance& instance: instances)
+  {
+    float3 cell = (instance.position - minPosition) / spacing;
+    float3 roundedCell = round(cell);
+
+    if(maxelem(abs(cell - roundedCell)) > cellEpsilon)
     {
-      geometryData->transformToLocalFromParent = transformToLocal;
-      geometryData->transformToParentFromLocal = transformFromLocal;
-      
-      // NOTE: To convert from world to local, first use parent transform to parent's space
-      // and only then apply transform from parent's space to the space of the current geometry
-      Geometry* parentData = (Geometry*)assetGetInternalData(geometryData->parent);
-      geometryData->transformToLocal = mul(transformToLocal, parentData->transformToLocal);
+      return FALSE;
+    }
 
-      // NOTE: To convert from local to world, first convert to the parent space, for which transformation
-      // from local space to world is known and use that.
-      geometryData->transformToWorld = mul(parentData->transformToWorld, transformFromLocal);
+    uint32 cellIndex = (uint32)roundedCell.x +
+                       (uint32)roundedCell.y * count.x +
+                       (uint32)roundedCell.z * count.x * count.y;
 
-      geometryData->fullScale = float3(geometryData->scale.x * parentData->fullScale.x,
-                                       geometryData->scale.y * parentData->fullScale.y,
-                                       geometryData->scale.z * parentData->fullScale.z);
+    if(occupiedCells[cellIndex] == true)
+    {
+      return FALSE;
     }
 
-    // NOTE: Recalculate dynamic AABB, if it's a leaf, based on the new transformations
-    if(geometryIsLeaf(geometry) == TRUE)
+    occupiedCells[cellIndex] = true;
+  }
+
+  outLattice.origin = minPosition;
+  outLattice.spacing = spacing;
+  outLattice.count = count;
+
+  return TRUE;
+}
+
+static void geometryRecalculateNodeTransforms(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  float4x4 transformFromLocal = mul(translation_matrix(geometryData->position),
+                                    rotation_matrix(geometryData->orientation));
+
+  float4x4 transformToLocal = inverse(transformFromLocal);
+
+  if(geometryIsRoot(geometry))
+  {
+    // NOTE: Root geometry doesn't have a parent => use identity matrix for parent-related
+    // transforms
+    geometryData->transformToLocalFromParent = scaling_matrix(float3(1.0f, 1.0f, 1.0f));
+    geometryData->transformToParentFromLocal = scaling_matrix(float3(1.0f, 1.0f, 1.0f));
+
+    geometryData->transformToLocal = transformToLocal;
+    geometryData->transformToWorld = transformFromLocal;
+
+    geometryData->fullScale = geometryData->scale;
+  }
+  else
+  {
+    geometryData->transformToLocalFromParent = transformToLocal;
+    geometryData->transformToParentFromLocal = transformFromLocal;
+    
+    // NOTE: To convert from world to local, first use parent transform to parent's space
+    // and only then apply transform from parent's space to the space of the current geometry
+    Geometry* parentData = (Geometry*)assetGetInternalData(geometryData->parent);
+    geometryData->transformToLocal = mul(transformToLocal, parentData->transformToLocal);
+
+    // NOTE: To convert from local to world, first convert to the parent space, for which transformation
+    // from local space to world is known and use that.
+    geometryData->transformToWorld = mul(parentData->transformToWorld, transformFromLocal);
+
+    geometryData->fullScale = float3(geometryData->scale.x * parentData->fullScale.x,
+                                     geometryData->scale.y * parentData->fullScale.y,
+                                     geometryData->scale.z * parentData->fullScale.z);
+  }
+
+  // NOTE: Recalculate dynamic AABB, if it's a leaf, based on the new transformations
+  if(geometryIsLeaf(geometry) == TRUE)
+  {
+    float32 maxScale = std::max(geometryData->fullScale.x,
+                                std::max(geometryData->fullScale.y,
+                                         geometryData->fullScale.z));
+
+    float4x4 transformToWorld = mul(geometryData->transformToWorld,
+                                    scaling_matrix(float3(maxScale, maxScale, maxScale)));
+
+    if(geometryData->instances.empty())
+    {
+      geometryData->dynamicAABB = geometryData->nativeAABB.genTransformed(transformToWorld);
+    }
+    else
     {
-      float32 maxScale = std::max(geometryData->fullScale.x,
-                                  std::max(geometryData->fullScale.y,
-                                           geometryData->fullScale.z));
-      
-      geometryData->dynamicAABB = geometryData->nativeAABB.genTransformed(mul(geometryData->transformToWorld,
-                                                                              scaling_matrix(float3(maxScale,
-                                                                                                    maxScale,
-                                                                                                    maxScale))));
+      geometryData->dynamicAABB = geometryTransformAABB(geometryCalculateInstancesAABB(geometryData),
+                                                        transformToWorld);
     }
   }
+}
+
+static void geometryRecalculateFullTransforms(Asset* geometry, bool8 parentWasDirty = FALSE)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  
+  // NOTE: If parent was dirty, then its matrices have been recalculated in some way, hence, even
+  // if child is not dirty, its transforms still should be recalculated
+  if(geometryData->dirty == TRUE || parentWasDirty == TRUE)
+  {
+    geometryRecalculateNodeTransforms(geometry);
+
+    // NOTE: Transforms were requested before the update of the tree, it still has to refresh
+    // the flat tree and AABBs
+    geometryData->changed = TRUE;
+  }
 
   for(Asset* child: geometryData->children)
   {
@@ -170,33 +383,6 @@ static void geometryCollectParents(Asset* geometry, vector<Asset*>& collection)
   collection.push_back(geometry);
 }
 
-static uint32 geometryGetIndexInBranch(Asset* geometry)
-{
-  AssetPtr parent = geometryGetParent(geometry);
-  if(parent == nullptr)
-  {
-    return (uint32)-1;
-  }
-  
-  const std::vector<AssetPtr>& children = geometryGetChildren(parent);
-
-  uint32 disabledSiblingsCount = 0;
-  for(uint32 i = 0; i < children.size(); i++)
-  {
-    if(children[i] == geometry)
-    {
-      return i - disabledSiblingsCount;
-    }
-    else if(geometryIsEnabled(children[i]) == FALSE)
-    {
-      disabledSiblingsCount++;
-    }
-  }
-
-  assert(FALSE);
-  return 0;
-}
-
 static void geometryGenerateDistancesCombinationCode(Asset* geometry, ShaderBuild* build)
 {
   // NOTE: We can eliminate if(indexInBrach == 0) condition, i.e precalculate here and
@@ -232,7 +418,94 @@ static void geometryGenerateDistancesCombinationCode(Asset* geometry, ShaderBuil
 
 }
 
-static void geometryGenerateTransformCode(Asset* geometry, ShaderBuild* build, bool8 applyGeometryTransform)
+static void geometryRegisterPCF(AssetPtr pcf, ShaderBuild* build, const char* functionName)
+{
+  if(pcf != AssetPtr(nullptr))
+  {
+    shaderBuildAddFunction(build,
+                           "float2",
+                           functionName,
+                           "float32 d1, float32 d2",
+                           scriptFunctionGetGLSLCode(pcf).c_str());
+  }
+  else
+  {
+    shaderBuildAddFunction(build,
+                           "float2",
+                           functionName,
+                           "float32 d1, float32 d2",
+                           "return (d1 < d2 ? float2(d1, 0.0) : float2(d2, 1.0));");
+  }
+}
+
+static void geometryGenerateInstancesTransformCode(Asset* geometry, ShaderBuild* build, uint32 registeredIDFCount,
+                                                   const char* suffix)
+{
+  const std::vector<AssetPtr>& odfs = geometryGetODFs(geometry);
+
+  // generate a transform function of a single instance:
+  // ---------------------------------------------------
+  shaderBuildAddCodefln(build, "float32 instanceTransform%s(float3 ip, float32 scale) {", suffix);
+  shaderBuildAddCodefln(build, "\tfloat32 d = SDF%s(ip) * scale;", suffix);
+  for(uint32 i = 0; i < odfs.size(); i++)
+  {
+    shaderBuildAddCodefln(build, "\td = ODF%d%s(d, ip);", i, suffix);
+  }
+  shaderBuildAddCode(build, "\treturn d;");
+  shaderBuildAddCode(build, "}");
+
+  // generate a transform function:
+  // ------------------------------
+  shaderBuildAddCodefln(build, "float32 transform%s(float3 p) {", suffix);
+  for(uint32 i = 0; i < registeredIDFCount; i++)
+  {
+    shaderBuildAddCodefln(build, "\tp = IDF%d%s(p);", i, suffix);
+  }
+
+  shaderBuildAddCode(build, "\tfloat3 tp = (geo[geometryID].worldGeoMat * float4(p / geo[geometryID].scale.xyz, 1.0)).xyz;");
+  shaderBuildAddCode(build, "\tfloat32 d = INF_DISTANCE;");
+  shaderBuildAddCode(build, "\tuint32 offset = geo[geometryID].instancesOffset;");
+
+  // Lattice: domain repetition, the closest cell and its neighbours are evaluated, so that
+  // instances which are a bit bigger than the spacing are still correct
+  shaderBuildAddCode(build, "\tif(geo[geometryID].instancesLattice != 0)");
+  shaderBuildAddCode(build, "\t{");
+    shaderBuildAddCode(build, "\t\tfloat3 q = tp - geo[geometryID].latticeOrigin.xyz;");
+    shaderBuildAddCode(build, "\t\tfloat3 spacing = geo[geometryID].latticeSpacing.xyz;");
+    shaderBuildAddCode(build, "\t\tint3 maxCell = int3(geo[geometryID].latticeCount.xyz) - 1;");
+    shaderBuildAddCode(build, "\t\tint3 cell = clamp(int3(floor(q / spacing)), int3(0), maxCell);");
+    shaderBuildAddCode(build, "\t\tfloat3x3 rotation = float3x3(instances[offset].geoInstanceMat);");
+    shaderBuildAddCode(build, "\t\tfloat32 scale = instances[offset].scale;");
+    shaderBuildAddCode(build, "\t\tfor(int32 i = 0; i < 8; i++)");
+    shaderBuildAddCode(build, "\t\t{");
+      shaderBuildAddCode(build, "\t\t\tint3 c = min(cell + int3(i & 1, (i >> 1) & 1, (i >> 2) & 1), maxCell);");
+      shaderBuildAddCode(build, "\t\t\tfloat3 ip = rotation * (q - float3(c) * spacing) / scale;");
+      shaderBuildAddCodefln(build, "\t\t\td = min(d, instanceTransform%s(ip, scale * geo[geometryID].scale.x));", suffix);
+    shaderBuildAddCode(build, "\t\t}");
+  shaderBuildAddCode(build, "\t}");
+
+  // Arbitrary instances: loop over all of them
+  shaderBuildAddCode(build, "\telse");
+  shaderBuildAddCode(build, "\t{");
+    shaderBuildAddCode(build, "\t\tfor(uint32 i = offset; i < offset + geo[geometryID].instancesCount; i++)");
+    shaderBuildAddCode(build, "\t\t{");
+      shaderBuildAddCode(build, "\t\t\tfloat32 scale = instances[i].scale;");
+      shaderBuildAddCode(build, "\t\t\tfloat3 ip = (instances[i].geoInstanceMat * float4(tp, 1.0)).xyz / scale;");
+      shaderBuildAddCodefln(build, "\t\t\td = min(d, instanceTransform%s(ip, scale * geo[geometryID].scale.x));", suffix);
+    shaderBuildAddCode(build, "\t\t}");
+  shaderBuildAddCode(build, "\t}");
+
+  shaderBuildAddCode(build, "\treturn d;");
+  shaderBuildAddCode(build, "}");
+}
+
+/**
+ * Generates transform() function of the geometry, which calculates its distance from a world point.
+ * @param suffix is appended to names of all generated functions, so that code of several geometries
+ * can be put into one shader
+ */
+static void geometryGenerateTransformCode(Asset* geometry, ShaderBuild* build, bool8 applyGeometryTransform,
+                                          const char* suffix = "")
 {
   // collect all parents (in order from the root to the leaf)
   vector<Asset*> parents;
@@ -245,7 +518,7 @@ static void geometryGenerateTransformCode(Asset* geometry, ShaderBuild* build, b
     const std::vector<AssetPtr>& idfs = geometryGetIDFs(parent);
     for(AssetPtr idf: idfs)
     {
-      string functionName = "IDF" + std::to_string(registeredIDFCount);
+      string functionName = "IDF" + std::to_string(registeredIDFCount) + suffix;
       string functionBody = scriptFunctionGetGLSLCode(idf);
       shaderBuildAddFunction(build, "float3", functionName.c_str(), "float3 p", functionBody.c_str());
       registeredIDFCount = registeredIDFCount + 1;
@@ -253,12 +526,13 @@ static void geometryGenerateTransformCode(Asset* geometry, ShaderBuild* build, b
   }
 
   // register SDF
+  string sdfName = string("SDF") + suffix;
   AssetPtr sdf = geometryGetSDF(geometry);
   if(sdf != nullptr)
   {
     shaderBuildAddFunction(build,
                            "float32",
-                           "SDF",
+                           sdfName.c_str(),
                            "float3 p",
                            scriptFunctionGetGLSLCode(sdf).c_str());
   }
@@ -266,7 +540,7 @@ static void geometryGenerateTransformCode(Asset* geometry, ShaderBuild* build, b
   {
     shaderBuildAddFunction(build,
                            "float32",
-                           "SDF",
+                           sdfName.c_str(),
                            "float3 p",
                            "return 1.0;");
   }
@@ -275,38 +549,30 @@ static void geometryGenerateTransformCode(Asset* geometry, ShaderBuild* build, b
   const std::vector<AssetPtr>& odfs = geometryGetODFs(geometry);
   for(uint32 i = 0; i < odfs.size(); i++)
   {
-    string functionName = "ODF" + std::to_string(i);
+    string functionName = "ODF" + std::to_string(i) + suffix;
     string functionBody = scriptFunctionGetGLSLCode(odfs[i]);
     shaderBuildAddFunction(build, "float32", functionName.c_str(), "float32 d, float3 p", functionBody.c_str());
   }
 
   // register PCF
-  AssetPtr pcf = geometryGetPCF(geometryGetParent(geometry));
-  if(pcf != AssetPtr(nullptr))
-  {
-    shaderBuildAddFunction(build,
-                           "float2",
-                           "PCF",
-                           "float32 d1, float32 d2",
-                           scriptFunctionGetGLSLCode(pcf).c_str());
-  }
-  else
+  geometryRegisterPCF(geometryGetPCF(geometryGetParent(geometry)), build, (string("PCF") + suffix).c_str());
+  
+  // NOTE: Instanced geometry evaluates SDF and ODFs once per instance (or per lattice cell), so they
+  // are moved into a separate function
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  if(applyGeometryTransform == TRUE && geometryData->instances.empty() == FALSE)
   {
-    shaderBuildAddFunction(build,
-                           "float2",
-                           "PCF",
-                           "float32 d1, float32 d2",
-                           "return (d1 < d2 ? float2(d1, 0.0) : float2(d2, 1.0));");
-
+    geometryGenerateInstancesTransformCode(geometry, build, registeredIDFCount, suffix);
+    return;
   }
   
   // generate a transform function:
   // ------------------------------
-  shaderBuildAddCode(build, "float32 transform(float3 p) {");
+  shaderBuildAddCodefln(build, "float32 transform%s(float3 p) {", suffix);
   // 1. Transform point p with all IDFs
   for(uint32 i = 0; i < registeredIDFCount; i++)
   {
-    shaderBuildAddCodefln(build, "\tp = IDF%d(p);", i);
+    shaderBuildAddCodefln(build, "\tp = IDF%d%s(p);", i, suffix);
   }
 
   // 2. SDF is defined in local coordinates, but the geometry which uses SDF has a transformation:
@@ -318,18 +584,18 @@ static void geometryGenerateTransformCode(Asset* geometry, ShaderBuild* build, b
   if(applyGeometryTransform == TRUE)
   {
     shaderBuildAddCode(build, "\tfloat4 tp = geo[geometryID].worldGeoMat * float4(p / geo[geometryID].scale.xyz, 1.0);");
-    shaderBuildAddCode(build, "\tfloat32 d = SDF(tp.xyz) * geo[geometryID].scale.x;");    
+    shaderBuildAddCodefln(build, "\tfloat32 d = SDF%s(tp.xyz) * geo[geometryID].scale.x;", suffix);    
   }
   else
   {
     shaderBuildAddCode(build, "\tfloat4 tp = float4(p, 1.0);");
-    shaderBuildAddCode(build, "\tfloat32 d = SDF(tp.xyz);");
+    shaderBuildAddCodefln(build, "\tfloat32 d = SDF%s(tp.xyz);", suffix);
   }
   
   // 3. Transform distance via ODFs
   for(uint32 i = 0; i < odfs.size(); i++)
   {
-    shaderBuildAddCodefln(build, "\td = ODF%d(d, tp.xyz);", i);
+    shaderBuildAddCodefln(build, "\td = ODF%d%s(d, tp.xyz);", i, suffix);
   }
   
   // 4. return distance
@@ -353,8 +619,7 @@ static void geometryGenerateLeafCode(Asset* geometry, ShaderBuild* build)
   shaderBuildAddCode(build, "\t#if NORMAL_PATH");
   shaderBuildAddCode(build, "\t\tfloat3 p = ray.xyz * ray.w + params.camPosition.xyz;");
   shaderBuildAddCode(build, "\t#elif SHADOW_PATH");
-  shaderBuildAddCode(build, "\t\tfloat2 uv = fragCoordToUV(gl_FragCoord.xy);");
-  shaderBuildAddCode(build, "\t\tfloat3 ro = getWorldPos(uv, ifragCoord, depthMap);");
+  shaderBuildAddCode(build, "\t\tfloat3 ro = getShadowRayOrigin(ifragCoord, depthMap);");
   shaderBuildAddCode(build, "\t\tfloat3 p = ro + ray.xyz * ray.w;");
   shaderBuildAddCode(build, "\t#endif");
 
@@ -403,39 +668,57 @@ static void geometryGenerateBranchCode(Asset* geometry, ShaderBuild* build)
   shaderBuildAddCode(build, "}");
 }
 
-static bool8 geometryRebuildDrawProgram(Asset* geometry)
+/**
+ * Generates bakedTransform() function, which samples the baked distance field of the geometry.
+ * @param suffix has to match the suffix passed to geometryGenerateTransformCode(), which registers ODFs
+ */
+static void geometryGenerateBakedTransformCode(Asset* geometry, ShaderBuild* build, const char* suffix = "")
 {
-  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  assert(shaderBuildIncludeFile(build, "shaders/baked_distance_field.glsl") == TRUE);
 
-  ShaderBuild* build = nullptr;
-  assert(createShaderBuild(&build));
+  // NOTE: ODFs of the baked geometry aren't baked, they're applied the same way as by the branch code
+  const std::vector<AssetPtr>& odfs = geometryGetODFs(geometry);
 
-  shaderBuildAddVersion(build, 430, "core");
-  shaderBuildAddCode(build, "layout(early_fragment_tests) in;");
-  shaderBuildAddCode(build, "%s");
+  shaderBuildAddCodefln(build, "GeometryData bakedTransform%s(float3 p) {", suffix);
+  shaderBuildAddCode(build, "\tfloat3 tp = (geo[geometryID].worldGeoMat * float4(p / geo[geometryID].scale.xyz, 1.0)).xyz;");
+  shaderBuildAddCode(build, "\tfloat2 baked = sampleBakedDistanceField(tp);");
+  shaderBuildAddCode(build, "\tGeometryData geometry = createGeometryData(baked.x * geo[geometryID].scale.x, uint32(baked.y));");
+  for(uint32 i = 0; i < odfs.size(); i++)
+  {
+    shaderBuildAddCodefln(build, "\tgeometry.distance = ODF%d%s(geometry.distance, 0.0f.xxx);", i, suffix);
+  }
+  shaderBuildAddCode(build, "\treturn geometry;");
+  shaderBuildAddCode(build, "}");
+}
 
-  shaderBuildAddMacro(build, "PROGRAM_DRAW", "1");  
-  assert(shaderBuildIncludeFile(build, "shaders/common.glsl") == TRUE);
-  assert(shaderBuildIncludeFile(build, "shaders/geometry_common.glsl") == TRUE);
-  assert(shaderBuildIncludeFile(build, "shaders/complex.glsl") == TRUE);    
+static void geometryGenerateBakedCode(Asset* geometry, ShaderBuild* build)
+{
+  geometryGenerateBakedTransformCode(geometry, build);
 
-  shaderBuildAddCode(build, "uniform uint32 geometryID;");
-  shaderBuildAddCode(build, "uniform uint32 indexInBranch;");
-  shaderBuildAddCode(build, "uniform uint32 prevCulledSiblingsCount;");  
+  shaderBuildAddCode(build, "void main() {");
+  shaderBuildAddCode(build, "\tint2 ifragCoord = int2(gl_FragCoord.x, gl_FragCoord.y);");
 
-  shaderBuildAddCode(build, "layout(location = 0) out float4 outColor;");
+  shaderBuildAddCode(build, "\tfloat4 ray = texelFetch(raysMap, ifragCoord, 0);");
+  shaderBuildAddCode(build, "\t#if NORMAL_PATH");
+  shaderBuildAddCode(build, "\t\tfloat3 p = ray.xyz * ray.w + params.camPosition.xyz;");
+  shaderBuildAddCode(build, "\t#elif SHADOW_PATH");
+  shaderBuildAddCode(build, "\t\tfloat3 ro = getShadowRayOrigin(ifragCoord, depthMap);");
+  shaderBuildAddCode(build, "\t\tfloat3 p = ro + ray.xyz * ray.w;");
+  shaderBuildAddCode(build, "\t#endif");
 
-  geometryGenerateTransformCode(geometry, build, /** Use transformation of geometry */ TRUE);      
+  shaderBuildAddCode(build, "\tGeometryData geometry = bakedTransform(p);");
 
-  if(geometryIsLeaf(geometry))
-  {
-    geometryGenerateLeafCode(geometry, build);
-  }
-  else
-  {
-    geometryGenerateBranchCode(geometry, build);
-  }
+  geometryGenerateDistancesCombinationCode(geometry, build);
+
+  shaderBuildAddCode(build, "\toutColor = 0.0f.xxxx;");
+  shaderBuildAddCode(build, "}");
+}
 
+/** @param unformattedCode code of the fragment shader with %s in place of the path define */
+static bool8 geometryLinkDrawPrograms(const string& unformattedCode,
+                                      ShaderProgramPtr& outDrawProgram,
+                                      ShaderProgramPtr& outShadowProgram)
+{
   ShaderPtr vertexShader = shaderManagerGetShader("triangle.vert");
   if(vertexShader == nullptr)
   {
@@ -443,9 +726,6 @@ static bool8 geometryRebuildDrawProgram(Asset* geometry)
     return FALSE;
   }
   
-  string unformattedCode = shaderBuildGetCode(build);
-  destroyShaderBuild(build);
-  
   // Normal path program generation
   char normalPathCode[32 * KIBIBYTE];
   sprintf(normalPathCode, unformattedCode.c_str(), "#define NORMAL_PATH 1");
@@ -469,7 +749,7 @@ static bool8 geometryRebuildDrawProgram(Asset* geometry)
     return FALSE;
   }
 
-  geometryData->drawProgram = ShaderProgramPtr(normalPathShaderProgram);
+  outDrawProgram = ShaderProgramPtr(normalPathShaderProgram);
 
   // Shadow path program generation
   char shadowPathCode[32 * KIBIBYTE];
@@ -494,37 +774,192 @@ static bool8 geometryRebuildDrawProgram(Asset* geometry)
     return FALSE;
   }
 
-  geometryData->shadowProgram = ShaderProgramPtr(shadowPathShaderProgram);
+  outShadowProgram = ShaderProgramPtr(shadowPathShaderProgram);
   
   return TRUE;
 }
 
-static bool8 geometryRebuildAABBCalculationProgram(Asset* geometry)
+/** @param baked generate code, which samples the baked distance field instead of the branch code */
+static string geometryGenerateDrawCode(Asset* geometry, bool8 baked)
 {
-  const static uint32& localWorkgroupSize = CVarSystemReadUint("engine_AABBCalculation_LocalWorkGroupSize");
-
-  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
-
   ShaderBuild* build = nullptr;
   assert(createShaderBuild(&build));
 
   shaderBuildAddVersion(build, 430, "core");
-  shaderBuildAddCodefln(build, "layout(local_size_x = %u, local_size_y = %u) in;",
-                        localWorkgroupSize,
-                        localWorkgroupSize);
+  shaderBuildAddCode(build, "layout(early_fragment_tests) in;");
+  shaderBuildAddCode(build, "%s");
 
-  shaderBuildAddMacro(build, "PROGRAM_AABB", "1");
+  shaderBuildAddMacro(build, "PROGRAM_DRAW", "1");  
   assert(shaderBuildIncludeFile(build, "shaders/common.glsl") == TRUE);
+  assert(shaderBuildIncludeFile(build, "shaders/geometry_common.glsl") == TRUE);
   assert(shaderBuildIncludeFile(build, "shaders/complex.glsl") == TRUE);    
 
-  shaderBuildAddCodefln(build, "layout(location = 0) uniform uint32 geometryID;");
-  
-  geometryGenerateTransformCode(geometry, build, /** Use transformation of geometry */ FALSE);  
+  shaderBuildAddCode(build, "uniform uint32 geometryID;");
+  shaderBuildAddCode(build, "uniform uint32 indexInBranch;");
+  shaderBuildAddCode(build, "uniform uint32 prevCulledSiblingsCount;");  
 
-  assert(shaderBuildIncludeFile(build, "shaders/calculate_aabb.glsl") == TRUE);    
-  
-  ShaderPtr computeShader = shaderBuildGenerateShader(build, GL_COMPUTE_SHADER);
-  if(computeShader == nullptr)
+  shaderBuildAddCode(build, "layout(location = 0) out float4 outColor;");
+
+  geometryGenerateTransformCode(geometry, build, /** Use transformation of geometry */ TRUE);      
+
+  if(baked == TRUE)
+  {
+    geometryGenerateBakedCode(geometry, build);
+  }
+  else if(geometryIsLeaf(geometry))
+  {
+    geometryGenerateLeafCode(geometry, build);
+  }
+  else
+  {
+    geometryGenerateBranchCode(geometry, build);
+  }
+
+  string unformattedCode = shaderBuildGetCode(build);
+  destroyShaderBuild(build);
+
+  return unformattedCode;
+}
+
+/**
+ * Query programs evaluate the distance of the geometry alone at points derived from pixels of the
+ * film, e.g normals program calculates exact normals of pixels of the leaf by differences of its
+ * distance. They're optional, the renderer falls back to its screen space estimations without them.
+ * @param queryFile fragment code, which is included after transform() of the geometry is generated
+ * @param baked transform() samples the baked distance field of the subtree instead of the leaf code
+ * @return nullptr if the program can't be linked
+ */
+static ShaderProgram* geometryLinkQueryProgram(Asset* geometry, const char* programMacro,
+                                               const char* queryFile, bool8 baked)
+{
+  ShaderBuild* build = nullptr;
+  assert(createShaderBuild(&build));
+
+  shaderBuildAddVersion(build, 430, "core");
+
+  shaderBuildAddMacro(build, programMacro, "1");
+  assert(shaderBuildIncludeFile(build, "shaders/common.glsl") == TRUE);
+  assert(shaderBuildIncludeFile(build, "shaders/complex.glsl") == TRUE);
+
+  shaderBuildAddCode(build, "layout(location = 2) uniform uint32 geometryID;");
+
+  if(baked == TRUE)
+  {
+    // NOTE: Functions of the branch get a suffix, so that only the query transform() samples the field
+    geometryGenerateTransformCode(geometry, build, /** Use transformation of geometry */ TRUE, "Branch");
+    geometryGenerateBakedTransformCode(geometry, build, "Branch");
+    shaderBuildAddCode(build, "float32 transform(float3 p) {");
+    shaderBuildAddCode(build, "\treturn bakedTransformBranch(p).distance;");
+    shaderBuildAddCode(build, "}");
+  }
+  else
+  {
+    geometryGenerateTransformCode(geometry, build, /** Use transformation of geometry */ TRUE);
+  }
+
+  assert(shaderBuildIncludeFile(build, queryFile) == TRUE);
+
+  ShaderPtr fragmentShader = shaderBuildGenerateShader(build, GL_FRAGMENT_SHADER);
+  destroyShaderBuild(build);
+
+  if(fragmentShader == nullptr)
+  {
+    return nullptr;
+  }
+
+  ShaderProgram* shaderProgram = nullptr;
+  assert(createShaderProgram(&shaderProgram));
+  shaderProgramAttachShader(shaderProgram, shaderManagerGetShader("triangle.vert"));
+  shaderProgramAttachShader(shaderProgram, fragmentShader);
+
+  if(linkShaderProgram(shaderProgram) == FALSE)
+  {
+    destroyShaderProgram(shaderProgram);
+    return nullptr;
+  }
+
+  return shaderProgram;
+}
+
+/** Rebuilds normals and occlusion programs of the leaf, @return FALSE if any of them has failed */
+static bool8 geometryRebuildQueryPrograms(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  geometryData->normalsProgram = ShaderProgramPtr(
+    geometryLinkQueryProgram(geometry, "PROGRAM_NORMALS", "shaders/calculate_sdf_normals.glsl", FALSE));
+  geometryData->occlusionProgram = ShaderProgramPtr(
+    geometryLinkQueryProgram(geometry, "PROGRAM_OCCLUSION", "shaders/calculate_sdf_occlusion.glsl", FALSE));
+
+  return geometryData->normalsProgram != nullptr && geometryData->occlusionProgram != nullptr ? TRUE : FALSE;
+}
+
+static bool8 geometryRebuildDrawProgram(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  if(geometryLinkDrawPrograms(geometryGenerateDrawCode(geometry, FALSE),
+                              geometryData->drawProgram,
+                              geometryData->shadowProgram) == FALSE)
+  {
+    return FALSE;
+  }
+
+  geometryData->bakedDrawProgram = ShaderProgramPtr(nullptr);
+  geometryData->bakedShadowProgram = ShaderProgramPtr(nullptr);
+  geometryData->bakedOcclusionProgram = ShaderProgramPtr(nullptr);
+
+  // NOTE: PCF of the geometry is baked into the field too
+  geometryData->bakeOutdated = geometryData->baked;
+
+  if(geometryData->baked == TRUE &&
+     geometryLinkDrawPrograms(geometryGenerateDrawCode(geometry, TRUE),
+                              geometryData->bakedDrawProgram,
+                              geometryData->bakedShadowProgram) == FALSE)
+  {
+    LOG_ERROR("Cannot generate programs of the baked geometry, it'll be drawn as a branch!");
+  }
+  else if(geometryData->baked == TRUE)
+  {
+    geometryData->bakedOcclusionProgram = ShaderProgramPtr(
+      geometryLinkQueryProgram(geometry, "PROGRAM_OCCLUSION", "shaders/calculate_sdf_occlusion.glsl", TRUE));
+
+    if(geometryData->bakedOcclusionProgram == nullptr)
+    {
+      LOG_WARNING("Cannot generate occlusion program of the baked geometry, its subtree doesn't occlude!");
+    }
+  }
+
+  return TRUE;
+}
+
+static bool8 geometryRebuildAABBCalculationProgram(Asset* geometry)
+{
+  const static CVarUintHandle localWorkgroupSizeHandle = StaticCVar_engine_AABBCalculation_LocalWorkGroupSize.getHandle();
+  const uint32 localWorkgroupSize = CVarSystemRead(localWorkgroupSizeHandle);
+
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  ShaderBuild* build = nullptr;
+  assert(createShaderBuild(&build));
+
+  shaderBuildAddVersion(build, 430, "core");
+  shaderBuildAddCodefln(build, "layout(local_size_x = %u, local_size_y = %u) in;",
+                        localWorkgroupSize,
+                        localWorkgroupSize);
+
+  shaderBuildAddMacro(build, "PROGRAM_AABB", "1");
+  assert(shaderBuildIncludeFile(build, "shaders/common.glsl") == TRUE);
+  assert(shaderBuildIncludeFile(build, "shaders/complex.glsl") == TRUE);    
+
+  shaderBuildAddCodefln(build, "layout(location = 0) uniform uint32 geometryID;");
+  
+  geometryGenerateTransformCode(geometry, build, /** Use transformation of geometry */ FALSE);  
+
+  assert(shaderBuildIncludeFile(build, "shaders/calculate_aabb.glsl") == TRUE);    
+  
+  ShaderPtr computeShader = shaderBuildGenerateShader(build, GL_COMPUTE_SHADER);
+  if(computeShader == nullptr)
   {
     LOG_ERROR("Cannot generate a shader for aabb calculation!");
     return FALSE;
@@ -538,84 +973,592 @@ static bool8 geometryRebuildAABBCalculationProgram(Asset* geometry)
 
   if(linkShaderProgram(shaderProgram) == FALSE)
   {
-    return FALSE;
+    return FALSE;
+  }
+  
+  geometryData->aabbProgram = ShaderProgramPtr(shaderProgram);
+
+  return TRUE;
+}
+
+/** @return nullptr if the program can't be linked */
+static ShaderProgram* geometryLinkRayHitProgram(Asset* geometry)
+{
+  ShaderBuild* build = nullptr;
+  assert(createShaderBuild(&build));
+
+  shaderBuildAddVersion(build, 430, "core");
+
+  shaderBuildAddMacro(build, "PROGRAM_RAY_HIT", "1");
+  assert(shaderBuildIncludeFile(build, "shaders/common.glsl") == TRUE);
+  assert(shaderBuildIncludeFile(build, "shaders/complex.glsl") == TRUE);
+
+  shaderBuildAddCode(build, "layout(location = 0) uniform uint32 geometryID;");
+
+  geometryGenerateTransformCode(geometry, build, /** Use transformation of geometry */ TRUE);
+
+  assert(shaderBuildIncludeFile(build, "shaders/calculate_ray_hit.glsl") == TRUE);
+
+  ShaderPtr computeShader = shaderBuildGenerateShader(build, GL_COMPUTE_SHADER);
+  destroyShaderBuild(build);
+
+  if(computeShader == nullptr)
+  {
+    return nullptr;
+  }
+
+  ShaderProgram* shaderProgram = nullptr;
+  assert(createShaderProgram(&shaderProgram));
+  shaderProgramAttachShader(shaderProgram, computeShader);
+
+  if(linkShaderProgram(shaderProgram) == FALSE)
+  {
+    destroyShaderProgram(shaderProgram);
+    return nullptr;
+  }
+
+  return shaderProgram;
+}
+
+/**
+ * Generates node<N>() function, which returns (distance, ID) of the subtree, the same way as it's
+ * combined by draw programs of its nodes.
+ * @return N, index of the generated function
+ */
+static uint32 geometryGenerateSubtreeCode(Asset* geometry, ShaderBuild* build, bool8 applyODFs, uint32& functionsCount)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  if(geometryIsLeaf(geometry) == TRUE)
+  {
+    uint32 index = functionsCount++;
+    string suffix = "_" + std::to_string(index);
+
+    // NOTE: Generated transform code refers to the current geometry through geometryID
+    shaderBuildAddCodefln(build, "#define geometryID %uu", geometryData->ID);
+    geometryGenerateTransformCode(geometry, build, /** Use transformation of geometry */ TRUE, suffix.c_str());
+    shaderBuildAddCodefln(build, "float2 node%s(float3 p) { return float2(transform%s(p), float32(geometryID)); }",
+                          suffix.c_str(), suffix.c_str());
+    shaderBuildAddCode(build, "#undef geometryID");
+
+    return index;
+  }
+
+  vector<uint32> children;
+  for(Asset* child: geometryData->children)
+  {
+    if(geometryIsEnabled(child) == TRUE)
+    {
+      children.push_back(geometryGenerateSubtreeCode(child, build, TRUE, functionsCount));
+    }
+  }
+
+  uint32 index = functionsCount++;
+  string suffix = "_" + std::to_string(index);
+
+  geometryRegisterPCF(geometryData->pcf, build, ("PCF" + suffix).c_str());
+
+  const std::vector<AssetPtr>& odfs = geometryData->odfs;
+  if(applyODFs == TRUE)
+  {
+    for(uint32 i = 0; i < odfs.size(); i++)
+    {
+      string functionName = "ODF" + std::to_string(i) + suffix;
+      string functionBody = scriptFunctionGetGLSLCode(odfs[i]);
+      shaderBuildAddFunction(build, "float32", functionName.c_str(), "float32 d, float3 p", functionBody.c_str());
+    }
+  }
+
+  shaderBuildAddCodefln(build, "float2 node%s(float3 p) {", suffix.c_str());
+  shaderBuildAddCode(build, "\tfloat2 result = float2(INF_DISTANCE, float32(UNKNOWN_GEOMETRY_ID));");
+  for(uint32 i = 0; i < children.size(); i++)
+  {
+    if(i == 0)
+    {
+      shaderBuildAddCodefln(build, "\tresult = node_%u(p);", children[i]);
+      continue;
+    }
+
+    shaderBuildAddCode(build, "\t{");
+    shaderBuildAddCodefln(build, "\t\tfloat2 child = node_%u(p);", children[i]);
+    shaderBuildAddCodefln(build, "\t\tfloat2 pcfResult = PCF%s(result.x, child.x);", suffix.c_str());
+    shaderBuildAddCode(build, "\t\tresult = float2(pcfResult.x, mix(result.y, child.y, pcfResult.y));");
+    shaderBuildAddCode(build, "\t}");
+  }
+
+  if(applyODFs == TRUE)
+  {
+    for(uint32 i = 0; i < odfs.size(); i++)
+    {
+      shaderBuildAddCodefln(build, "\tresult.x = ODF%d%s(result.x, 0.0f.xxx);", i, suffix.c_str());
+    }
+  }
+
+  shaderBuildAddCode(build, "\treturn result;");
+  shaderBuildAddCode(build, "}");
+
+  return index;
+}
+
+static ShaderProgramPtr geometryGenerateBakeProgram(Asset* geometry)
+{
+  ShaderBuild* build = nullptr;
+  assert(createShaderBuild(&build));
+
+  shaderBuildAddVersion(build, 430, "core");
+
+  shaderBuildAddMacro(build, "PROGRAM_BAKE", "1");
+  assert(shaderBuildIncludeFile(build, "shaders/common.glsl") == TRUE);
+  assert(shaderBuildIncludeFile(build, "shaders/complex.glsl") == TRUE);
+
+  // NOTE: ODFs of the baked geometry are applied by its draw program
+  uint32 functionsCount = 0;
+  uint32 rootFunction = geometryGenerateSubtreeCode(geometry, build, FALSE, functionsCount);
+  shaderBuildAddCodefln(build, "float2 bakedSubtreeDistance(float3 p) { return node_%u(p); }", rootFunction);
+
+  assert(shaderBuildIncludeFile(build, "shaders/bake_distance_field.glsl") == TRUE);
+
+  ShaderPtr computeShader = shaderBuildGenerateShader(build, GL_COMPUTE_SHADER);
+  destroyShaderBuild(build);
+
+  if(computeShader == nullptr)
+  {
+    LOG_ERROR("Cannot generate a shader for distance field baking!");
+    return ShaderProgramPtr(nullptr);
+  }
+
+  ShaderProgram* shaderProgram = nullptr;
+  assert(createShaderProgram(&shaderProgram));
+  shaderProgramAttachShader(shaderProgram, computeShader);
+
+  if(linkShaderProgram(shaderProgram) == FALSE)
+  {
+    destroyShaderProgram(shaderProgram);
+    return ShaderProgramPtr(nullptr);
+  }
+
+  return ShaderProgramPtr(shaderProgram);
+}
+
+/**
+ * Links occlusion program of the branch, which samples the distance of its whole subtree, since samples
+ * of its leaves can't be combined by min (e.g a subtracted leaf carves its siblings instead of occluding)
+ * @return nullptr if the program can't be linked
+ */
+static ShaderProgram* geometryLinkOcclusionProxyProgram(Asset* geometry)
+{
+  ShaderBuild* build = nullptr;
+  assert(createShaderBuild(&build));
+
+  shaderBuildAddVersion(build, 430, "core");
+
+  shaderBuildAddMacro(build, "PROGRAM_OCCLUSION", "1");
+  assert(shaderBuildIncludeFile(build, "shaders/common.glsl") == TRUE);
+  assert(shaderBuildIncludeFile(build, "shaders/complex.glsl") == TRUE);
+
+  uint32 functionsCount = 0;
+  uint32 rootFunction = geometryGenerateSubtreeCode(geometry, build, TRUE, functionsCount);
+  shaderBuildAddCodefln(build, "float32 transform(float3 p) { return node_%u(p).x; }", rootFunction);
+
+  assert(shaderBuildIncludeFile(build, "shaders/calculate_sdf_occlusion.glsl") == TRUE);
+
+  ShaderPtr fragmentShader = shaderBuildGenerateShader(build, GL_FRAGMENT_SHADER);
+  destroyShaderBuild(build);
+
+  if(fragmentShader == nullptr)
+  {
+    return nullptr;
+  }
+
+  ShaderProgram* shaderProgram = nullptr;
+  assert(createShaderProgram(&shaderProgram));
+  shaderProgramAttachShader(shaderProgram, shaderManagerGetShader("triangle.vert"));
+  shaderProgramAttachShader(shaderProgram, fragmentShader);
+
+  if(linkShaderProgram(shaderProgram) == FALSE)
+  {
+    destroyShaderProgram(shaderProgram);
+    return nullptr;
+  }
+
+  return shaderProgram;
+}
+
+static void geometryDestroyBakedDistanceField(Geometry* geometryData)
+{
+  if(geometryData->bakedField != nullptr)
+  {
+    destroyBakedDistanceField(geometryData->bakedField);
+    geometryData->bakedField = nullptr;
+  }
+}
+
+// NOTE: Only root geometries are stored (and saved) by the assets manager, so changes of a child
+// are tracked through the revision of its root.
+static void geometryMarkModified(Asset* geometry)
+{
+  assetMarkModified(geometryGetRoot(geometry));
+}
+
+static void geometryMarkChanged(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  geometryData->changed = TRUE;
+
+  Geometry* rootData = (Geometry*)assetGetInternalData(geometryGetRoot(geometry));
+  rootData->treeChanged = TRUE;
+}
+
+static void geometryMarkDirty(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  geometryData->dirty = TRUE;
+
+  geometryMarkChanged(geometry);
+}
+
+static void geometryOnNameChanged(Asset* geometry, const string& prevName, const string& newName)
+{
+  geometryMarkModified(geometry);
+}
+
+static uint32 geometryGetFunctionsRevision(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  uint32 revision = 0;
+  for(AssetPtr function: {geometryData->pcf, geometryData->sdf})
+  {
+    if(function != AssetPtr(nullptr))
+    {
+      revision += assetGetRevision(function);
+    }
+  }
+
+  for(AssetPtr idf: geometryData->idfs)
+  {
+    revision += assetGetRevision(idf);
+  }
+
+  for(AssetPtr odf: geometryData->odfs)
+  {
+    revision += assetGetRevision(odf);
+  }
+
+  for(AssetPtr child: geometryData->children)
+  {
+    revision += geometryGetFunctionsRevision(child);
+  }
+
+  return revision;
+}
+
+// NOTE: Revisions of functions only grow and adding or removing a function marks the geometry as
+// modified itself, so any change of the sum means that some function has been edited
+static void geometryRefreshRevision(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  uint32 functionsRevision = geometryGetFunctionsRevision(geometry);
+  if(geometryData->functionsRevision != functionsRevision)
+  {
+    geometryData->functionsRevision = functionsRevision;
+    geometryMarkModified(geometry);
+  }
+}
+
+static void geometryMarkNeedRebuild(Asset* geometry, bool8 forwardToChildren)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  geometryData->needRebuild = TRUE;
+
+  geometryMarkModified(geometry);
+  geometryMarkChanged(geometry);
+
+  if(forwardToChildren == TRUE)
+  {
+    for(AssetPtr child: geometryData->children)
+    {
+      geometryMarkNeedRebuild(child, forwardToChildren);
+    }
+  }
+}
+
+static uint32 geometryFlatTreeAddSubtree(GeometryFlatTree* tree, Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  uint32 firstChild = GEOMETRY_INVALID_INDEX;
+  uint32 prevChild = GEOMETRY_INVALID_INDEX;
+  for(Asset* child: geometryData->children)
+  {
+    uint32 childIndex = geometryFlatTreeAddSubtree(tree, child);
+
+    if(prevChild == GEOMETRY_INVALID_INDEX)
+    {
+      firstChild = childIndex;
+    }
+    else
+    {
+      tree->nextSiblings[prevChild] = childIndex;
+    }
+
+    prevChild = childIndex;
+  }
+
+  uint32 index = tree->geometries.size();
+  tree->geometries.push_back(geometry);
+  tree->parents.push_back(GEOMETRY_INVALID_INDEX);
+  tree->firstChildren.push_back(firstChild);
+  tree->nextSiblings.push_back(GEOMETRY_INVALID_INDEX);
+  tree->totalChildrenCounts.push_back(geometryData->totalChildrenCount);
+
+  for(uint32 child = firstChild; child != GEOMETRY_INVALID_INDEX; child = tree->nextSiblings[child])
+  {
+    tree->parents[child] = index;
+  }
+
+  return index;
+}
+
+static void geometryFlatTreeRefreshNode(GeometryFlatTree* tree, uint32 index)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(tree->geometries[index]);
+
+  tree->ids[index] = geometryData->ID;
+  tree->positions[index] = geometryData->position;
+  tree->fullScales[index] = geometryData->fullScale;
+  tree->transformsToLocal[index] = geometryData->transformToLocal;
+  tree->transformsToWorld[index] = geometryData->transformToWorld;
+  tree->transformsToLocalFromParent[index] = geometryData->transformToLocalFromParent;
+  tree->transformsToParentFromLocal[index] = geometryData->transformToParentFromLocal;
+  tree->materials[index] = geometryData->material.raw();
+  tree->drawPrograms[index] = geometryData->drawProgram.raw();
+  tree->shadowPrograms[index] = geometryData->shadowProgram.raw();
+  tree->normalsPrograms[index] = geometryData->normalsProgram.raw();
+  tree->occlusionPrograms[index] = geometryData->occlusionProgram.raw();
+  tree->enabled[index] = geometryData->enabled;
+  tree->bounded[index] = geometryData->bounded;
+  tree->nodesReadGlobalParameters[index] = geometryData->readsGlobalParameters;
+}
+
+/** Rebuilds arrays which depend on the structure of the tree, it happens only after the tree is edited */
+static void geometryRebuildFlatTree(Asset* root, GeometryFlatTree* tree)
+{
+  tree->geometries.clear();
+  tree->parents.clear();
+  tree->firstChildren.clear();
+  tree->nextSiblings.clear();
+  tree->totalChildrenCounts.clear();
+
+  geometryFlatTreeAddSubtree(tree, root);
+
+  uint32 nodesCount = tree->geometries.size();
+  tree->ids.resize(nodesCount);
+  tree->positions.resize(nodesCount);
+  tree->fullScales.resize(nodesCount);
+  tree->transformsToLocal.resize(nodesCount);
+  tree->transformsToWorld.resize(nodesCount);
+  tree->transformsToLocalFromParent.resize(nodesCount);
+  tree->transformsToParentFromLocal.resize(nodesCount);
+  tree->finalAABBs.resize(nodesCount);
+  tree->materials.resize(nodesCount);
+  tree->drawPrograms.resize(nodesCount);
+  tree->shadowPrograms.resize(nodesCount);
+  tree->normalsPrograms.resize(nodesCount);
+  tree->occlusionPrograms.resize(nodesCount);
+  tree->enabled.resize(nodesCount);
+  tree->bounded.resize(nodesCount);
+  tree->nodesReadGlobalParameters.resize(nodesCount);
+  tree->lipschitzBounds.resize(nodesCount);
+
+  tree->nodesChanged.resize(nodesCount);
+  tree->codesChanged.resize(nodesCount);
+  tree->transformsChanged.resize(nodesCount);
+  tree->aabbsChanged.resize(nodesCount);
+  tree->smallestParentsAABBsChanged.resize(nodesCount);
+  tree->firstEnabledChildren.resize(nodesCount);
+  tree->combinedAABBs.resize(nodesCount);
+  tree->smallestParentsAABBs.resize(nodesCount);
+  tree->lipschitzBoundsChanged.resize(nodesCount);
+  tree->idfsLipschitzBounds.resize(nodesCount);
+
+  tree->leaves.clear();
+  for(uint32 i = 0; i < tree->getRootIndex(); i++)
+  {
+    if(tree->firstChildren[i] == GEOMETRY_INVALID_INDEX)
+    {
+      tree->leaves.push_back(i);
+    }
+  }
+
+  // NOTE: Indices have changed, so everything is recalculated by the next update
+  for(uint32 i = 0; i < nodesCount; i++)
+  {
+    Geometry* geometryData = (Geometry*)assetGetInternalData(tree->geometries[i]);
+    geometryData->changed = TRUE;
+
+    geometryFlatTreeRefreshNode(tree, i);
+    tree->combinedAABBs[i] = geometryData->finalAABB;
+    tree->finalAABBs[i] = geometryData->finalAABB;
+  }
+
+  // NOTE: BVH is built right away, so that it always matches indices of the tree
+  bvhBuild(tree->leavesBVH, tree->finalAABBs, tree->leaves);
+  tree->leavesBVHOutdated = FALSE;
+}
+
+static GeometryFlatTree* geometryRootGetFlatTree(Asset* root)
+{
+  assert(geometryIsRoot(root) == TRUE);
+
+  Geometry* rootData = (Geometry*)assetGetInternalData(root);
+  if(rootData->flatTree == nullptr)
+  {
+    rootData->flatTree = engineAllocObject<GeometryFlatTree>(MEMORY_TYPE_GENERAL);
+    rootData->flatTreeOutdated = TRUE;
+    rootData->treeChanged = TRUE;
+  }
+
+  if(rootData->flatTreeOutdated == TRUE)
+  {
+    geometryRebuildFlatTree(root, rootData->flatTree);
+    rootData->flatTreeOutdated = FALSE;
+  }
+
+  return rootData->flatTree;
+}
+
+static void geometryFreeFlatTree(Geometry* geometryData)
+{
+  if(geometryData->flatTree != nullptr)
+  {
+    engineFreeObject(geometryData->flatTree, MEMORY_TYPE_GENERAL);
+    geometryData->flatTree = nullptr;
+  }
+}
+
+static void geometryMarkStructureChanged(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  if(geometryData->structureChanged == FALSE)
+  {
+    geometryData->structureChanged = TRUE;
+    editTransaction.editedGeometries.push_back(geometry);
+  }
+}
+
+/**
+ * Single pass over the tree, which replaces work that was previously done on each added or removed
+ * child: assigns IDs, marks subtrees of edited geometries for rebuild and collects all children of
+ * the root.
+ */
+static void geometryCommitStructure(Asset* geometry, Geometry* rootData, bool8 parentChanged, uint32& idCounter)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  geometryData->ID = idCounter++;
+
+  if(geometryData->structureChanged == TRUE)
+  {
+    // NOTE: Leaf could have become a branch (or vice versa) and transforms of new children are
+    // relative to a new parent
+    geometryData->needAABBRecalculation = TRUE;
+    geometryData->dirty = TRUE;
+    geometryData->structureChanged = FALSE;
+
+    parentChanged = TRUE;
+  }
+
+  // NOTE: Generated code depends on parents (IDFs and PCF), so the whole subtree is rebuilt
+  if(parentChanged == TRUE)
+  {
+    geometryData->needRebuild = TRUE;
+    geometryData->changed = TRUE;
+  }
+
+  // NOTE: Geometry could have been a root before it was added to the tree
+  if(geometryData != rootData)
+  {
+    geometryData->allChildren.clear();
+    geometryFreeFlatTree(geometryData);
+  }
+
+  for(AssetPtr child: geometryData->children)
+  {
+    rootData->allChildren.insert(child);
+    geometryCommitStructure(child, rootData, parentChanged, idCounter);
   }
-  
-  geometryData->aabbProgram = ShaderProgramPtr(shaderProgram);
 
-  return TRUE;
+  geometryData->totalChildrenCount = idCounter - geometryData->ID - 1;
 }
 
-static void geometryMarkNeedRebuild(Asset* geometry, bool8 forwardToChildren)
+static void geometryChildWasRemoved(Asset* parent, AssetPtr child)
 {
-  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
-  geometryData->needRebuild = TRUE;
+  Geometry* childData = (Geometry*)assetGetInternalData(child);
+  geometryClearChildren(child);
+  childData->parent = AssetPtr(nullptr);
+}
 
-  if(forwardToChildren == TRUE)
+// ----------------------------------------------------------------------------
+// Geometry common interface
+// ----------------------------------------------------------------------------
+static void geometryAABBCalculationCVarChanged(const string& name, void* listener)
+{
+  if(name == CVarSystemGetName(StaticCVar_engine_AABBCalculation_LocalWorkGroupSize.getHandle()))
   {
-    for(AssetPtr child: geometryData->children)
-    {
-      geometryMarkNeedRebuild(child, forwardToChildren);
-    }
+    aabbProgramGeneration++;
   }
+
+  aabbCalculationGeneration++;
 }
 
-static void geometryRecalculateIDs(Asset* geometry, uint32& idCounter)
+static void geometrySubscribeToAABBCalculationCVars()
 {
-  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
-  geometryData->ID = idCounter++;
-  
-  for(AssetPtr child: geometryData->children)
+  static bool8 subscribed = FALSE;
+  if(subscribed == TRUE)
   {
-    geometryRecalculateIDs(child, idCounter);
+    return;
   }
 
-  geometryData->totalChildrenCount = idCounter - geometryData->ID - 1;
+  CVarSystemSubscribe("engine_AABBCalculation_IterationsCount", &aabbCalculationGeneration, geometryAABBCalculationCVarChanged);
+  CVarSystemSubscribe("engine_AABBCalculation_RaysPerIteration", &aabbCalculationGeneration, geometryAABBCalculationCVarChanged);
+  CVarSystemSubscribe("engine_AABBCalculation_LocalWorkGroupSize", &aabbCalculationGeneration, geometryAABBCalculationCVarChanged);
+
+  subscribed = TRUE;
 }
 
-static void geometryRecalculateIDs(Asset* geometry)
+static void geometryBakingCVarChanged(const string& name, void* listener)
 {
-  uint32 idCounter = 0;
-  geometryRecalculateIDs(geometryGetRoot(geometry), idCounter);
-
-  assert(idCounter < 65535);
+  bakingGeneration++;
 }
 
-static void geometryChildWasAdded(Asset* parent, AssetPtr child)
+static void geometrySubscribeToBakingCVars()
 {
-  Geometry* childData = (Geometry*)assetGetInternalData(child);
-  for(AssetPtr childOfChild: childData->children)
+  static bool8 subscribed = FALSE;
+  if(subscribed == TRUE)
   {
-    geometryChildWasAdded(child, childOfChild);
+    return;
   }
-  
-  Asset* root = geometryGetRoot(parent);
-  Geometry* rootData = (Geometry*)assetGetInternalData(root);
-  auto insertInfo = rootData->allChildren.insert(child);
-  assert(insertInfo.second);
-}
 
-static void geometryChildWasRemoved(Asset* parent, AssetPtr child)
-{
-  Geometry* childData = (Geometry*)assetGetInternalData(child);
-  geometryClearChildren(child);
-  childData->parent = AssetPtr(nullptr);
-  
-  Asset* root = geometryGetRoot(parent);
-  Geometry* rootData = (Geometry*)assetGetInternalData(root);
-  assert(rootData->allChildren.erase(child) == 1);
+  CVarSystemSubscribe("engine_DistanceFieldBaking_Resolution", &bakingGeneration, geometryBakingCVarChanged);
+  CVarSystemSubscribe("engine_DistanceFieldBaking_BandWidth", &bakingGeneration, geometryBakingCVarChanged);
+
+  subscribed = TRUE;
 }
 
-// ----------------------------------------------------------------------------
-// Geometry common interface
-// ----------------------------------------------------------------------------
 bool8 createGeometry(const string& name, Asset** outGeometry)
 {
+  geometrySubscribeToAABBCalculationCVars();
+  geometrySubscribeToBakingCVars();
+
   AssetInterface interface = {};
   interface.destroy = geometryDestroy;
   interface.serialize = geometrySerialize;
   interface.deserialize = geometryDeserialize;
   interface.getSize = geometryGetSize;
+  interface.onNameChanged = geometryOnNameChanged;
+  interface.refreshRevision = geometryRefreshRevision;
   interface.type = ASSET_TYPE_GEOMETRY;
 
   assert(allocateAsset(interface, name, outGeometry));
@@ -634,13 +1577,31 @@ bool8 createGeometry(const string& name, Asset** outGeometry)
   geometryData->needAABBRecalculation = TRUE;    
   geometryData->needRebuild = TRUE;
   geometryData->dirty = TRUE;
+  geometryData->structureChanged = FALSE;
+  geometryData->changed = TRUE;
+  geometryData->readsGlobalParameters = FALSE;
+  geometryData->flatTree = nullptr;
+  geometryData->flatTreeOutdated = TRUE;
+  geometryData->treeChanged = TRUE;
+  geometryData->functionsRevision = 0;
   geometryData->enabled = TRUE;
+  geometryData->baked = FALSE;
+  geometryData->bakeOutdated = FALSE;
+  geometryData->bakedField = nullptr;
+  geometryData->aabbCalculationGeneration = aabbCalculationGeneration;
+  geometryData->aabbProgramGeneration = aabbProgramGeneration;
   geometryData->nativeAABB = AABB(-1024.0f, -1024.0f, -1024.0f, 1024.0f, 1024.0f, 1024.0f);
   geometryData->dynamicAABB = AABB(-1024.0f, -1024.0f, -1024.0f, 1024.0f, 1024.0f, 1024.0f);
   geometryData->finalAABB = AABB(-1024.0f, -1024.0f, -1024.0f, 1024.0f, 1024.0f, 1024.0f);
   geometryData->drawProgram = ShaderProgramPtr(nullptr);
   geometryData->shadowProgram = ShaderProgramPtr(nullptr);
   geometryData->aabbProgram = ShaderProgramPtr(nullptr);
+  geometryData->normalsProgram = ShaderProgramPtr(nullptr);
+  geometryData->occlusionProgram = ShaderProgramPtr(nullptr);
+  geometryData->rayHitProgram = ShaderProgramPtr(nullptr);
+  geometryData->bakedDrawProgram = ShaderProgramPtr(nullptr);
+  geometryData->bakedShadowProgram = ShaderProgramPtr(nullptr);
+  geometryData->bakedOcclusionProgram = ShaderProgramPtr(nullptr);
   
   assetSetInternalData(*outGeometry, geometryData);
   
@@ -651,15 +1612,36 @@ void geometryDestroy(Asset* geometry)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
 
+  if(geometryData->structureChanged == TRUE)
+  {
+    vector<Asset*>& editedGeometries = editTransaction.editedGeometries;
+
+    auto editedIt = std::find(editedGeometries.begin(), editedGeometries.end(), geometry);
+    if(editedIt != editedGeometries.end())
+    {
+      editedGeometries.erase(editedIt);
+    }
+  }
+
+  geometryFreeFlatTree(geometryData);
+
   geometryData->parent = AssetPtr(nullptr);
   geometryData->children.clear();
   geometryData->idfs.clear();
   geometryData->odfs.clear();
   geometryData->sdf = AssetPtr(nullptr);
+  geometryData->instances.clear();
 
   geometryData->drawProgram = ShaderProgramPtr(nullptr);
   geometryData->shadowProgram = ShaderProgramPtr(nullptr);
   geometryData->aabbProgram = ShaderProgramPtr(nullptr);
+  geometryData->normalsProgram = ShaderProgramPtr(nullptr);
+  geometryData->occlusionProgram = ShaderProgramPtr(nullptr);
+  geometryData->rayHitProgram = ShaderProgramPtr(nullptr);
+  geometryData->bakedDrawProgram = ShaderProgramPtr(nullptr);
+  geometryData->bakedShadowProgram = ShaderProgramPtr(nullptr);
+  geometryData->bakedOcclusionProgram = ShaderProgramPtr(nullptr);
+  geometryDestroyBakedDistanceField(geometryData);
   
   engineFreeObject(geometryData, MEMORY_TYPE_GENERAL);
 }
@@ -679,18 +1661,18 @@ static json serializeScriptFunction(AssetPtr scriptFunction)
   return result;
 }
 
-static AssetPtr deserializeScriptFunction(json& jsonData)
+static AssetPtr deserializeScriptFunction(DocumentValue value)
 {
-  bool8 isPrototype = jsonData.value("is_prototype", FALSE);
+  bool8 isPrototype = documentValueGet(value, "is_prototype", FALSE);
   AssetPtr result = AssetPtr(nullptr);
   
   if(isPrototype == TRUE)
   {
-    result = assetsManagerFindAsset(jsonData["name"]);
+    result = assetsManagerFindAsset(string(documentValueGetString(documentValueFind(value, "name"))));
   }
   else
   {
-    result = createAssetFromJson(jsonData);
+    result = createAssetFromDocument(value);
   }
 
   assert(result != nullptr && "Geometry contains invalid forked script function!");
@@ -734,12 +1716,28 @@ bool8 geometrySerialize(AssetPtr geometry, json& jsonData)
   jsonData["dynamic_aabb"]["max"] = vecToJson(geometryData->dynamicAABB.max);
 
   jsonData["bounded"] = geometryData->bounded;
+  jsonData["baked"] = geometryData->baked;
   jsonData["aabb_automatically_calculated"] = geometryData->aabbAutomaticallyCalculated;
 
   if(geometryData->material != nullptr)
   {
     jsonData["material"] = assetGetName(geometryData->material);
   }
+
+  for(uint32 i = 0; i < geometryData->instances.size(); i++)
+  {
+    const GeometryInstance& instance = geometryData->instances[i];
+    json& instanceJson = jsonData["instances"][i];
+    
+    instanceJson["position"] = vecToJson(instance.position);
+    instanceJson["orientation"] = vecToJson(instance.orientation);
+    instanceJson["scale"] = instance.scale;
+
+    if(instance.material != nullptr)
+    {
+      instanceJson["material"] = assetGetName(instance.material);
+    }
+  }
   
   for(uint32 i = 0; i < geometryData->children.size(); i++)
   {
@@ -752,77 +1750,106 @@ bool8 geometrySerialize(AssetPtr geometry, json& jsonData)
   return TRUE;
 }
 
-bool8 geometryDeserialize(AssetPtr geometry, json& jsonData)
+bool8 geometryDeserialize(AssetPtr geometry, DocumentValue value)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
 
-  if(jsonData.contains("idfs"))
+  DocumentValue idfs = documentValueFind(value, "idfs");
+  for(uint32 i = 0; i < documentValueGetSize(idfs); i++)
   {
-    for(auto& idf: jsonData["idfs"])
-    {
-      geometryData->idfs.push_back(deserializeScriptFunction(idf));
-    }
+    geometryData->idfs.push_back(deserializeScriptFunction(documentValueGetElement(idfs, i)));
   }
 
-  if(jsonData.contains("odfs"))
+  DocumentValue odfs = documentValueFind(value, "odfs");
+  for(uint32 i = 0; i < documentValueGetSize(odfs); i++)
   {
-    for(auto& odf: jsonData["odfs"])
-    {
-      geometryData->odfs.push_back(deserializeScriptFunction(odf));
-    }
+    geometryData->odfs.push_back(deserializeScriptFunction(documentValueGetElement(odfs, i)));
   }
 
-  if(jsonData.contains("pcf"))
+  if(documentValueContains(value, "pcf"))
   {
-    geometryData->pcf = deserializeScriptFunction(jsonData.at("pcf"));
+    geometryData->pcf = deserializeScriptFunction(documentValueFind(value, "pcf"));
   }
   else
   {
     geometryData->pcf = assetsManagerFindAsset("unionPCF");
   }
   
-  if(jsonData.contains("sdf"))
+  if(documentValueContains(value, "sdf"))
   {
-    geometryData->sdf = deserializeScriptFunction(jsonData.at("sdf"));
+    geometryData->sdf = deserializeScriptFunction(documentValueFind(value, "sdf"));
   }
 
-  if(jsonData["scale"].is_number())
+  DocumentValue scale = documentValueFind(value, "scale");
+  if(documentValueIsNumber(scale))
   {
-    float32 scale = jsonData["scale"];
-    geometryData->scale = float3(scale, scale, scale);
+    float32 uniformScale = documentValueGet(scale, 1.0f);
+    geometryData->scale = float3(uniformScale, uniformScale, uniformScale);
   }
   else
   {
-    geometryData->scale = jsonToVec<float32, 3>(jsonData["scale"]);
+    geometryData->scale = documentValueToVec<float32, 3>(scale);
   }
   
-  geometryData->origin = jsonToVec<float32, 3>(jsonData["origin"]);
-  geometryData->position = jsonToVec<float32, 3>(jsonData["position"]);
-  geometryData->orientation = jsonToVec<float32, 4>(jsonData["orientation"]);
-  
-  geometryData->nativeAABB.min = jsonToVec<float32, 3>(jsonData["native_aabb"]["min"]);
-  geometryData->nativeAABB.max = jsonToVec<float32, 3>(jsonData["native_aabb"]["max"]);
-  geometryData->dynamicAABB.min = jsonToVec<float32, 3>(jsonData["dynamic_aabb"]["min"]);
-  geometryData->dynamicAABB.max = jsonToVec<float32, 3>(jsonData["dynamic_aabb"]["max"]);  
+  geometryData->origin = documentValueToVec<float32, 3>(documentValueFind(value, "origin"));
+  geometryData->position = documentValueToVec<float32, 3>(documentValueFind(value, "position"));
+  geometryData->orientation = documentValueToVec<float32, 4>(documentValueFind(value, "orientation"));
 
-  geometryData->bounded = jsonData.value("bounded", FALSE);
-  geometryData->aabbAutomaticallyCalculated = jsonData.value("aabb_automatically_calculated", FALSE);
+  DocumentValue nativeAABB = documentValueFind(value, "native_aabb");
+  DocumentValue dynamicAABB = documentValueFind(value, "dynamic_aabb");
+  geometryData->nativeAABB.min = documentValueToVec<float32, 3>(documentValueFind(nativeAABB, "min"));
+  geometryData->nativeAABB.max = documentValueToVec<float32, 3>(documentValueFind(nativeAABB, "max"));
+  geometryData->dynamicAABB.min = documentValueToVec<float32, 3>(documentValueFind(dynamicAABB, "min"));
+  geometryData->dynamicAABB.max = documentValueToVec<float32, 3>(documentValueFind(dynamicAABB, "max"));  
 
-  geometryData->material = assetsManagerFindAsset(jsonData.value("material", "default_material"));
-  
-  // Remove previous children
-  geometryClearChildren(geometry);
+  geometryData->bounded = documentValueGet(value, "bounded", FALSE);
+  geometryData->baked = documentValueGet(value, "baked", FALSE);
+  geometryData->bakeOutdated = geometryData->baked;
+  geometryData->aabbAutomaticallyCalculated = documentValueGet(value, "aabb_automatically_calculated", FALSE);
+
+  DocumentValue material = documentValueFind(value, "material");
+  geometryData->material = assetsManagerFindAsset(string(documentValueGetString(material, "default_material")));
 
-  // Generate new children
-  if(jsonData.contains("children"))
+  geometryData->instances.clear();
+  DocumentValue instances = documentValueFind(value, "instances");
+  for(uint32 i = 0; i < documentValueGetSize(instances); i++)
   {
-    for(auto& childJson: jsonData["children"])
+    DocumentValue instanceValue = documentValueGetElement(instances, i);
+
+    GeometryInstance instance;
+    instance.position = documentValueToVec<float32, 3>(documentValueFind(instanceValue, "position"));
+    instance.orientation = documentValueToVec<float32, 4>(documentValueFind(instanceValue, "orientation"));
+    instance.scale = documentValueGet(instanceValue, "scale", 1.0f);
+
+    DocumentValue material = documentValueFind(instanceValue, "material");
+    if(documentValueIsValid(material))
     {
-      AssetPtr child = createAssetFromJson(childJson);
-      geometryAddChild(geometry, child);
+      instance.material = assetsManagerFindAsset(string(documentValueGetString(material)));
     }
+
+    geometryData->instances.push_back(instance);
   }
 
+  geometryData->instancesFormLattice = geometryDetectInstancesLattice(geometryData->instances,
+                                                                      geometryData->instancesLattice);
+
+  // NOTE: Children are deserialized recursively, so the whole tree is committed only once, by the
+  // outermost transaction
+  geometryBeginEdit();
+
+    // Remove previous children
+    geometryClearChildren(geometry);
+
+    // Generate new children
+    DocumentValue children = documentValueFind(value, "children");
+    for(uint32 i = 0; i < documentValueGetSize(children); i++)
+    {
+      AssetPtr child = createAssetFromDocument(documentValueGetElement(children, i));
+      geometryAddChild(geometry, child);
+    }
+
+  geometryCommitEdit();
+
   return TRUE;
 }
 
@@ -830,18 +1857,53 @@ static void geometryUpdateChild(Asset* geometry, float64 delta)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
 
+  if(geometryData->aabbCalculationGeneration != aabbCalculationGeneration)
+  {
+    geometryData->aabbCalculationGeneration = aabbCalculationGeneration;
+    geometryData->needAABBRecalculation = TRUE;
+  }
+
+  if(geometryData->aabbProgramGeneration != aabbProgramGeneration && geometryData->needRebuild == FALSE &&
+     geometryIsLeaf(geometry))
+  {
+    geometryData->aabbProgramGeneration = aabbProgramGeneration;
+
+    if(geometryRebuildAABBCalculationProgram(geometry) == FALSE)
+    {
+      LOG_ERROR("Geometry rebuild of AABB calculation program has failed!");
+
+      geometryData->aabbProgram = ShaderProgramPtr(nullptr);
+    }
+  }
+
   if(geometryData->needRebuild == TRUE)
   {
+    // NOTE: Code of the leaf has changed, ray hit program is linked again when it's needed
+    geometryData->rayHitProgram = ShaderProgramPtr(nullptr);
+
     if(geometryRebuildDrawProgram(geometry) == TRUE)
     {
       if(geometryIsLeaf(geometry))
       {
+        geometryData->aabbProgramGeneration = aabbProgramGeneration;
+
         if(geometryRebuildAABBCalculationProgram(geometry) == FALSE)
         {
           LOG_ERROR("Geometry rebuild of AABB calculation program has failed!");
 
           geometryData->aabbProgram = ShaderProgramPtr(nullptr);
         }
+
+        if(geometryRebuildQueryPrograms(geometry) == FALSE)
+        {
+          LOG_WARNING("Geometry rebuild of query programs has failed, its normals are reconstructed from depth "
+                      "or it doesn't occlude!");
+        }
+      }
+      else
+      {
+        geometryData->normalsProgram = ShaderProgramPtr(nullptr);
+        geometryData->occlusionProgram = ShaderProgramPtr(nullptr);
       }
 
       geometryData->needRebuild = FALSE;
@@ -852,6 +1914,8 @@ static void geometryUpdateChild(Asset* geometry, float64 delta)
 
       geometryData->drawProgram = ShaderProgramPtr(nullptr);
       geometryData->shadowProgram = ShaderProgramPtr(nullptr);
+      geometryData->normalsProgram = ShaderProgramPtr(nullptr);
+      geometryData->occlusionProgram = ShaderProgramPtr(nullptr);
     }
   }
 
@@ -870,125 +1934,444 @@ static void geometryUpdateChild(Asset* geometry, float64 delta)
     geometryData->dirty = TRUE;
     geometryData->needAABBRecalculation = FALSE;
   }
+}
+
+static void geometryFlatTreeRecalculateTransforms(GeometryFlatTree* tree)
+{
+  // NOTE: In reversed postorder parents go before their children
+  for(int32 i = tree->getRootIndex(); i >= 0; i--)
+  {
+    Geometry* geometryData = (Geometry*)assetGetInternalData(tree->geometries[i]);
+
+    uint32 parent = tree->parents[i];
+    bool8 parentWasDirty = parent != GEOMETRY_INVALID_INDEX && tree->transformsChanged[parent];
+
+    bool8 changed = geometryData->dirty == TRUE || parentWasDirty == TRUE;
+    if(changed == TRUE)
+    {
+      geometryRecalculateNodeTransforms(tree->geometries[i]);
+    }
+
+    tree->transformsChanged[i] = changed;
+    geometryData->dirty = FALSE;
+  }
+}
+
+static void geometryFlatTreeCalculateBranchesFinalAABB(GeometryFlatTree* tree)
+{
+  // NOTE: In postorder children go before their parent, so AABBs of children are already calculated
+  for(uint32 i = 0; i < tree->getRootIndex(); i++)
+  {
+    Asset* geometry = tree->geometries[i];
+    Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+    bool8 changed = tree->nodesChanged[i] || tree->transformsChanged[i];
+
+    uint32 child = tree->firstChildren[i];
+    if(child == GEOMETRY_INVALID_INDEX)
+    {
+      if(changed == TRUE)
+      {
+        tree->combinedAABBs[i] = geometryData->dynamicAABB;
+      }
+
+      tree->aabbsChanged[i] = changed;
+      continue;
+    }
+
+    // NOTE: Enabling/disabling of a child changes the first enabled child
+    for(uint32 changedChild = child; changedChild != GEOMETRY_INVALID_INDEX; changedChild = tree->nextSiblings[changedChild])
+    {
+      changed = changed || tree->aabbsChanged[changedChild] || tree->nodesChanged[changedChild];
+    }
+
+    tree->aabbsChanged[i] = changed;
+    if(changed == FALSE)
+    {
+      continue;
+    }
+
+    // NOTE: Needed by leafs subtracted from the first enabled sibling
+    tree->firstEnabledChildren[i] = GEOMETRY_INVALID_INDEX;
+    for(uint32 enabledChild = child; enabledChild != GEOMETRY_INVALID_INDEX; enabledChild = tree->nextSiblings[enabledChild])
+    {
+      if(tree->enabled[enabledChild] == TRUE)
+      {
+        tree->firstEnabledChildren[i] = enabledChild;
+        break;
+      }
+    }
+
+    AABB combinedAABB = tree->combinedAABBs[child];
+
+    PCFNativeType combinationType = geometryGetPCFNativeType(geometry);
+    // NOTE: For subtraction AABB of the first child is used
+    if(combinationType != PCF_NATIVE_TYPE_SUBTRACTION)
+    {
+      for(child = tree->nextSiblings[child]; child != GEOMETRY_INVALID_INDEX; child = tree->nextSiblings[child])
+      {
+        const AABB& childAABB = tree->combinedAABBs[child];
+
+        if(combinationType == PCF_NATIVE_TYPE_UNION)
+        {
+          combinedAABB = AABBUnion(combinedAABB, childAABB);
+        }
+        else if(combinationType == PCF_NATIVE_TYPE_INTERSECTION)
+        {
+          combinedAABB = AABBIntersection(combinedAABB, childAABB);
+        }
+        else
+        {
+          assert(false);
+        }
+      }
+    }
+
+    tree->combinedAABBs[i] = combinedAABB;
+    tree->finalAABBs[i] = combinedAABB;
+    geometryData->finalAABB = combinedAABB;
+  }
+}
+
+static void geometryFlatTreeCalculateLeafsFinalAABB(GeometryFlatTree* tree)
+{
+  uint32 rootIndex = tree->getRootIndex();
+
+  // NOTE: AABB of the root isn't calculated
+  tree->aabbsChanged[rootIndex] = tree->nodesChanged[rootIndex];
+  tree->smallestParentsAABBsChanged[rootIndex] = tree->nodesChanged[rootIndex];
+  tree->smallestParentsAABBs[rootIndex] = tree->finalAABBs[rootIndex];
+
+  // NOTE: In reversed postorder parents go before their children, so the smallest AABB among parents
+  // of each branch is propagated down instead of walking from each leaf to the root
+  for(int32 i = rootIndex - 1; i >= 0; i--)
+  {
+    uint32 parent = tree->parents[i];
+    const AABB& smallestParentsAABB = tree->smallestParentsAABBs[parent];
+
+    bool8 parentChanged = tree->aabbsChanged[parent] || tree->smallestParentsAABBsChanged[parent];
+
+    if(tree->firstChildren[i] != GEOMETRY_INVALID_INDEX)
+    {
+      bool8 changed = tree->aabbsChanged[i] || tree->smallestParentsAABBsChanged[parent];
+      if(changed == TRUE)
+      {
+        // NOTE: On equal volumes the closest one is picked
+        tree->smallestParentsAABBs[i] = tree->finalAABBs[i].getVolume() <= smallestParentsAABB.getVolume() ?
+          tree->finalAABBs[i] : smallestParentsAABB;
+      }
+
+      tree->smallestParentsAABBsChanged[i] = changed;
+      continue;
+    }
+
+    if(tree->aabbsChanged[i] == FALSE && parentChanged == FALSE)
+    {
+      continue;
+    }
+
+    AABB finalAABB = tree->combinedAABBs[i];
+
+    // NOTE: If this geometry is subtracted from other geometry in the branch -
+    // calculate the intersection of AABB of those two first (because only that region of
+    // AABB matters)
+    if(geometryGetPCFNativeType(tree->geometries[parent]) == PCF_NATIVE_TYPE_SUBTRACTION &&
+       tree->firstEnabledChildren[parent] != (uint32)i)
+    {
+      // NOTE: We know that in case of subtraction, parent has an AABB of the first child, the one
+      // from which we subract the rest of children
+      finalAABB = AABBIntersection(tree->finalAABBs[parent], finalAABB);
+    }
+
+    // NOTE: Compare AABB of the parents to the leaf's AABB, pick the smallest (it's possible, for
+    // example, in case where two subsequent geometry levels have intersection combination function
+    // --> parent's AABB will be always smaller)
+    if(finalAABB.getVolume() > smallestParentsAABB.getVolume())
+    {
+      finalAABB = smallestParentsAABB;
+    }
+
+    tree->finalAABBs[i] = finalAABB;
+
+    Geometry* geometryData = (Geometry*)assetGetInternalData(tree->geometries[i]);
+    geometryData->finalAABB = finalAABB;
+
+    if(tree->leavesBVHOutdated == FALSE && bvhRefit(tree->leavesBVH, i, finalAABB) == FALSE)
+    {
+      tree->leavesBVHOutdated = TRUE;
+    }
+  }
+}
 
-  for(auto child: geometryData->children)
+static float32 geometryFunctionsLipschitzBound(const std::vector<AssetPtr>& functions)
+{
+  float32 bound = 1.0f;
+  for(AssetPtr function: functions)
   {
-    geometryUpdateChild(child, delta);
+    bound *= scriptFunctionGetLipschitzBound(function);
   }
+
+  return bound;
+}
+
+// NOTE: Global parameters (e.g time) may change every frame, so such functions are never static
+static bool8 geometryFunctionReadsGlobalParameters(Asset* function)
+{
+  return function != nullptr && scriptFunctionGetRawCode(function).find("params.") != string::npos ? TRUE : FALSE;
 }
 
-static void geometryCalculateBranchesFinalAABB(Asset* geometry)
+/** Searches code of functions of the geometry, it's done only before the geometry is rebuilt */
+static bool8 geometryFunctionsReadGlobalParameters(Asset* geometry)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
-  
-  if(geometryIsLeaf(geometry) == TRUE)
+
+  bool8 reads = geometryFunctionReadsGlobalParameters(geometryData->sdf) == TRUE ||
+                geometryFunctionReadsGlobalParameters(geometryData->pcf) == TRUE;
+
+  for(AssetPtr function: geometryData->idfs)
   {
-    geometryData->finalAABB = geometryData->dynamicAABB;
-    return;
+    reads = reads == TRUE || geometryFunctionReadsGlobalParameters(function) == TRUE;
   }
 
-  for(auto child: geometryData->children)
+  for(AssetPtr function: geometryData->odfs)
   {
-    geometryCalculateBranchesFinalAABB(child);
+    reads = reads == TRUE || geometryFunctionReadsGlobalParameters(function) == TRUE;
   }
 
-  AABB finalAABB = geometryGetFinalAABB(geometryData->children[0]);
+  return reads;
+}
+
+/** Recalculates bounds only of changed nodes, nodes of their subtrees and of their parents */
+static void geometryFlatTreeCalculateLipschitzBounds(GeometryFlatTree* tree)
+{
+  int32 rootIndex = tree->getRootIndex();
+
+  // NOTE: IDFs of all parents are applied to points of leaves, so their bounds are accumulated from
+  // the root down to leaves (parents are stored after their children, subtree of a node is
+  // [node - total children count, node])
+  int32 dirtySubtreeBegin = rootIndex + 1;
+  for(int32 i = rootIndex; i >= 0; i--)
+  {
+    if(i < dirtySubtreeBegin && tree->nodesChanged[i] == true)
+    {
+      dirtySubtreeBegin = i - tree->totalChildrenCounts[i];
+    }
+
+    tree->lipschitzBoundsChanged[i] = i >= dirtySubtreeBegin;
+    if(tree->lipschitzBoundsChanged[i] == false)
+    {
+      continue;
+    }
+
+    Geometry* geometryData = (Geometry*)assetGetInternalData(tree->geometries[i]);
+
+    uint32 parent = tree->parents[i];
+    if(parent == GEOMETRY_INVALID_INDEX)
+    {
+      tree->idfsLipschitzBounds[i] = geometryFunctionsLipschitzBound(geometryData->idfs);
+    }
+    else
+    {
+      tree->idfsLipschitzBounds[i] = tree->idfsLipschitzBounds[parent] * geometryFunctionsLipschitzBound(geometryData->idfs);
+    }
+  }
 
-  PCFNativeType combinationType = geometryGetPCFNativeType(geometry);
-  // NOTE: For subtraction AABB of the first child is used
-  if(combinationType != PCF_NATIVE_TYPE_SUBTRACTION)
+  // NOTE: Bound of a branch depends on bounds of its children, so changes are propagated to parents
+  for(int32 i = 0; i <= rootIndex; i++)
   {
-    for(uint32 i = 1; i < geometryData->children.size(); i++)
+    if(tree->lipschitzBoundsChanged[i] == false)
+    {
+      continue;
+    }
+
+    Geometry* geometryData = (Geometry*)assetGetInternalData(tree->geometries[i]);
+
+    float32 bound = 1.0f;
+    if(tree->firstChildren[i] == GEOMETRY_INVALID_INDEX)
     {
-      AABB childAABB = geometryGetFinalAABB(geometryData->children[i]);
-      
-      if(combinationType == PCF_NATIVE_TYPE_UNION)
+      bound = tree->idfsLipschitzBounds[i];
+      if(geometryData->sdf != nullptr)
       {
-        finalAABB = AABBUnion(finalAABB, childAABB);
+        bound *= scriptFunctionGetLipschitzBound(geometryData->sdf);
       }
-      else if(combinationType == PCF_NATIVE_TYPE_INTERSECTION)
+    }
+    else
+    {
+      // NOTE: PCF combines distances of children, so it scales the largest of their bounds
+      for(uint32 child = tree->firstChildren[i]; child != GEOMETRY_INVALID_INDEX; child = tree->nextSiblings[child])
       {
-        finalAABB = AABBIntersection(finalAABB, childAABB);
+        if(tree->enabled[child] == true)
+        {
+          bound = std::max(bound, tree->lipschitzBounds[child]);
+        }
       }
-      else
+
+      if(geometryData->pcf != nullptr)
       {
-        assert(false);
+        bound *= scriptFunctionGetLipschitzBound(geometryData->pcf);
       }
     }
-  }
 
-  geometryData->finalAABB = finalAABB;
+    tree->lipschitzBounds[i] = bound * geometryFunctionsLipschitzBound(geometryData->odfs);
+
+    if(tree->parents[i] != GEOMETRY_INVALID_INDEX)
+    {
+      tree->lipschitzBoundsChanged[tree->parents[i]] = true;
+    }
+  }
 }
 
-static void geometryCalculateLeafsFinalAABB(Asset* geometry)
+void geometryUpdate(Asset* geometry, float64 delta)
 {
-  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
-  
-  if(geometryIsLeaf(geometry) == TRUE)
+  Geometry* rootData = (Geometry*)assetGetInternalData(geometry);
+  GeometryFlatTree* tree = geometryRootGetFlatTree(geometry);
+
+  bool8 generationsChanged = tree->aabbCalculationGeneration != aabbCalculationGeneration ||
+    tree->aabbProgramGeneration != aabbProgramGeneration;
+  bool8 bakingChanged = tree->bakingGeneration != bakingGeneration;
+
+  // NOTE: Nothing has changed since the last update, so everything is up to date
+  if(rootData->treeChanged == FALSE && generationsChanged == FALSE && bakingChanged == FALSE)
   {
-    // NOTE: If this geometry is subtracted from other geometry in the branch -
-    // calculate the intersection of AABB of those two first (because only that region of
-    // AABB matters)
-    if(geometryGetPCFNativeType(geometryData->parent) == PCF_NATIVE_TYPE_SUBTRACTION &&
-       geometryGetIndexInBranch(geometry) > 0)
+    return;
+  }
+
+  rootData->treeChanged = FALSE;
+  tree->aabbCalculationGeneration = aabbCalculationGeneration;
+  tree->aabbProgramGeneration = aabbProgramGeneration;
+  tree->bakingGeneration = bakingGeneration;
+  tree->epoch++;
+
+  uint32 rootIndex = tree->getRootIndex();
+  for(uint32 i = 0; i <= rootIndex; i++)
+  {
+    Geometry* geometryData = (Geometry*)assetGetInternalData(tree->geometries[i]);
+
+    tree->nodesChanged[i] = geometryData->changed == TRUE || generationsChanged == TRUE;
+    tree->codesChanged[i] = tree->nodesChanged[i] == TRUE &&
+      (geometryData->needRebuild == TRUE || tree->enabled[i] != bool(geometryData->enabled));
+    geometryData->changed = FALSE;
+
+    // NOTE: Functions of the geometry (or their code) have changed since they were searched
+    if(tree->nodesChanged[i] == TRUE && geometryData->needRebuild == TRUE)
+    {
+      geometryData->readsGlobalParameters = geometryFunctionsReadGlobalParameters(tree->geometries[i]);
+    }
+  }
+
+  for(uint32 i = 0; i < rootIndex; i++)
+  {
+    if(tree->nodesChanged[i] == TRUE)
+    {
+      geometryUpdateChild(tree->geometries[i], delta);
+
+      // NOTE: Rebuild has failed, try again during the next update
+      Geometry* geometryData = (Geometry*)assetGetInternalData(tree->geometries[i]);
+      if(geometryData->needRebuild == TRUE)
+      {
+        geometryData->changed = TRUE;
+        rootData->treeChanged = TRUE;
+      }
+    }
+  }
+
+  // NOTE: Occlusion proxy of a branch contains code of its whole subtree, so it's linked again when
+  // code of any node of the subtree changes
+  for(uint32 i = 0; i < rootIndex; i++)
+  {
+    if(tree->firstChildren[i] == GEOMETRY_INVALID_INDEX)
+    {
+      continue;
+    }
+
+    bool8 subtreeCodeChanged = FALSE;
+    for(uint32 j = i - tree->totalChildrenCounts[i]; j <= i && subtreeCodeChanged == FALSE; j++)
     {
-      // NOTE: We know that in case of subtraction, parent has an AABB of the first child, the one
-      // from which we subract the rest of children
-      geometryData->finalAABB = AABBIntersection(geometryGetFinalAABB(geometryData->parent),
-                                                 geometryData->finalAABB);
+      subtreeCodeChanged = tree->codesChanged[j];
     }
 
-    // NOTE: Traverse from the leaf to the parents, compare AABB of the parent to the leaf's AABB, pick
-    // the smallest (it's possible, for example, in case where two subsequent geometry levels have
-    // intersection combination function --> parent's AABB will be always smaller)
-    AssetPtr parent = geometryData->parent;
-    while(parent != nullptr)
+    if(subtreeCodeChanged == FALSE)
     {
-      Geometry* parentsGeometryData = (Geometry*)assetGetInternalData(parent);
+      continue;
+    }
 
-      if(geometryData->finalAABB.getVolume() > parentsGeometryData->finalAABB.getVolume())
+    Geometry* geometryData = (Geometry*)assetGetInternalData(tree->geometries[i]);
+    geometryData->occlusionProgram = ShaderProgramPtr(nullptr);
+
+    // NOTE: Children of a branch without PCF are combined by min
+    if(geometryData->pcf != nullptr && geometryGetPCFNativeType(tree->geometries[i]) != PCF_NATIVE_TYPE_UNION)
+    {
+      geometryData->occlusionProgram = ShaderProgramPtr(geometryLinkOcclusionProxyProgram(tree->geometries[i]));
+      if(geometryData->occlusionProgram == nullptr)
       {
-        geometryData->finalAABB = parentsGeometryData->finalAABB;
+        LOG_WARNING("Cannot generate occlusion program of the branch, its leaves occlude as a union!");
       }
-      
-      parent = parentsGeometryData->parent;
     }
+
+    tree->occlusionPrograms[i] = geometryData->occlusionProgram.raw();
   }
-  else
+
+  geometryFlatTreeRecalculateTransforms(tree);
+
+  for(uint32 i = 0; i <= rootIndex; i++)
   {
-    for(auto child: geometryData->children)
+    if(tree->nodesChanged[i] == TRUE || tree->transformsChanged[i] == TRUE)
     {
-      geometryCalculateLeafsFinalAABB(child);
+      geometryFlatTreeRefreshNode(tree, i);
     }
   }
-}
 
-void geometryUpdate(Asset* geometry, float64 delta)
-{
-  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
-  
-  for(auto child: geometryData->children)
-  {
-    geometryUpdateChild(child, delta);
-  }
+  geometryFlatTreeCalculateBranchesFinalAABB(tree);
+  geometryFlatTreeCalculateLeafsFinalAABB(tree);
+  geometryFlatTreeCalculateLipschitzBounds(tree);
+  tree->readsGlobalParameters = std::find(tree->nodesReadGlobalParameters.begin(),
+                                          tree->nodesReadGlobalParameters.end(), true) != tree->nodesReadGlobalParameters.end();
 
-  for(auto child: geometryData->children)
+  // NOTE: Refit keeps the hierarchy valid, but it's rebuilt when a leaf becomes (un)bounded
+  if(tree->leavesBVHOutdated == TRUE)
   {
-    geometryCalculateBranchesFinalAABB(child);
+    bvhBuild(tree->leavesBVH, tree->finalAABBs, tree->leaves);
+    tree->leavesBVHOutdated = FALSE;
   }
 
-  for(auto child: geometryData->children)
+  // NOTE: Baked field is defined in the space of the geometry, so only changes of its children (or of
+  // baking cvars) make it outdated (changes of the geometry itself are handled by its rebuild)
+  for(uint32 i = 0; i < rootIndex; i++)
   {
-    geometryCalculateLeafsFinalAABB(child);
+    Geometry* geometryData = (Geometry*)assetGetInternalData(tree->geometries[i]);
+    if(geometryData->baked == FALSE || geometryData->bakeOutdated == TRUE)
+    {
+      continue;
+    }
+
+    if(bakingChanged == TRUE)
+    {
+      geometryData->bakeOutdated = TRUE;
+      continue;
+    }
+
+    for(uint32 j = i - tree->totalChildrenCounts[i]; j < i; j++)
+    {
+      if(tree->nodesChanged[j] == TRUE)
+      {
+        geometryData->bakeOutdated = TRUE;
+        break;
+      }
+    }
   }
 }
 
 void geometrySetScale(Asset* geometry, float3 scale)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
-  
-  geometryData->dirty = TRUE;
-  geometryData->scale = scale;
+
+  if(geometryData->scale != scale)
+  {
+    geometryData->scale = scale;
+
+    geometryMarkDirty(geometry);
+    geometryMarkModified(geometry);
+  }
 }
 
 float3 geometryGetScale(Asset* geometry)
@@ -1009,8 +2392,13 @@ void geometrySetPosition(Asset* geometry, float3 position)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
   
-  geometryData->dirty = TRUE;
-  geometryData->position = position;
+  if(geometryData->position != position)
+  {
+    geometryData->position = position;
+
+    geometryMarkDirty(geometry);
+    geometryMarkModified(geometry);
+  }
 }
 
 float3 geometryGetPosition(Asset* geometry)
@@ -1024,8 +2412,13 @@ void geometrySetOrientation(Asset* geometry, quat orientation)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
   
-  geometryData->dirty = TRUE;
-  geometryData->orientation = orientation;
+  if(geometryData->orientation != orientation)
+  {
+    geometryData->orientation = orientation;
+
+    geometryMarkDirty(geometry);
+    geometryMarkModified(geometry);
+  }
 }
 
 quat geometryGetOrientation(Asset* geometry)
@@ -1147,6 +2540,7 @@ void geometryAddODF(Asset* geometry, AssetPtr odf)
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
   
   geometryData->odfs.push_back(odf);
+  geometryMarkModified(geometry);
 }
 
 std::vector<AssetPtr>& geometryGetODFs(Asset* geometry)
@@ -1391,7 +2785,12 @@ void geometrySetBounded(Asset* geometry, bool8 bounded)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
 
-  geometryData->bounded = bounded;
+  if(geometryData->bounded != bounded)
+  {
+    geometryData->bounded = bounded;
+    geometryMarkModified(geometry);
+    geometryMarkChanged(geometry);
+  }
 }
 
 bool8 geometryIsBounded(Asset* geometry)
@@ -1400,10 +2799,114 @@ bool8 geometryIsBounded(Asset* geometry)
   return geometryData->bounded;
 }
 
+void geometrySetBaked(Asset* geometry, bool8 baked)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  if(geometryIsBranch(geometry) == FALSE || geometryIsRoot(geometry) == TRUE)
+  {
+    LOG_WARNING("Only branches, which aren't roots, can be baked!");
+    return;
+  }
+
+  if(geometryData->baked != baked)
+  {
+    geometryData->baked = baked;
+    geometryData->bakeOutdated = baked;
+    geometryData->needRebuild = TRUE;
+
+    if(baked == FALSE)
+    {
+      geometryDestroyBakedDistanceField(geometryData);
+    }
+
+    geometryMarkModified(geometry);
+    geometryMarkChanged(geometry);
+  }
+}
+
+bool8 geometryIsBaked(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  return geometryData->baked;
+}
+
+void geometryBakeDistanceField(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  if(geometryData->baked == FALSE || geometryData->bakeOutdated == FALSE)
+  {
+    return;
+  }
+
+  geometryData->bakeOutdated = FALSE;
+
+  if(geometryData->finalAABB.isUnbounded() == TRUE)
+  {
+    LOG_WARNING("Unbounded geometry '%s' can't be baked, it's drawn as a usual branch",
+                assetGetName(geometry).c_str());
+    geometryDestroyBakedDistanceField(geometryData);
+    return;
+  }
+
+  // NOTE: Field is sampled in the space of the geometry (before its scale is applied)
+  AABB localAABB = AABB(geometryData->finalAABB.min / geometryData->fullScale,
+                        geometryData->finalAABB.max / geometryData->fullScale);
+  AABB bounds = geometryTransformAABB(localAABB, geometryData->transformToLocal);
+
+  ShaderProgramPtr bakeProgram = geometryGenerateBakeProgram(geometry);
+  if(bakeProgram == nullptr)
+  {
+    geometryDestroyBakedDistanceField(geometryData);
+    return;
+  }
+
+  BakedDistanceField* field = nullptr;
+  bool8 baked = distanceFieldBakingPassBake(bakeProgram.raw(), geometryData->ID, bounds, &field);
+
+  // NOTE: If baking has failed, the subtree is drawn as usual
+  geometryDestroyBakedDistanceField(geometryData);
+  if(baked == TRUE)
+  {
+    geometryData->bakedField = field;
+  }
+}
+
+const BakedDistanceField* geometryGetBakedDistanceField(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+
+  if(geometryData->baked == FALSE || geometryData->bakedDrawProgram == nullptr ||
+     geometryData->bakedShadowProgram == nullptr)
+  {
+    return nullptr;
+  }
+
+  return geometryData->bakedField;
+}
+
+ShaderProgramPtr geometryGetBakedProgram(Asset* geometry, bool8 shadowPath)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  return shadowPath == TRUE ? geometryData->bakedShadowProgram : geometryData->bakedDrawProgram;
+}
+
+ShaderProgramPtr geometryGetBakedOcclusionProgram(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  return geometryData->bakedOcclusionProgram;
+}
+
 void geometrySetEnabled(Asset* geometry, bool8 enabled)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
-  geometryData->enabled = enabled;
+
+  if(geometryData->enabled != enabled)
+  {
+    geometryData->enabled = enabled;
+    geometryMarkChanged(geometry);
+  }
 }
 
 bool8 geometryIsEnabled(Asset* geometry)
@@ -1415,7 +2918,12 @@ bool8 geometryIsEnabled(Asset* geometry)
 void geometrySetAABBAutomaticallyCalculated(Asset* geometry, bool8 automatically)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
-  geometryData->aabbAutomaticallyCalculated = automatically;
+  if(geometryData->aabbAutomaticallyCalculated != automatically)
+  {
+    geometryData->aabbAutomaticallyCalculated = automatically;
+    geometryMarkModified(geometry);
+  }
+
   if(automatically == TRUE)
   {
     geometryMarkNeedAABBRecalculation(geometry);
@@ -1432,7 +2940,9 @@ void geometrySetNativeAABB(Asset* geometry, const AABB& nativeAABB)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
   geometryData->nativeAABB = nativeAABB;
-  geometryData->dirty = TRUE;
+
+  geometryMarkDirty(geometry);
+  geometryMarkModified(geometry);
 }
 
 const AABB& geometryGetNativeAABB(Asset* geometry)
@@ -1458,11 +2968,92 @@ const AABB& geometryGetFinalAABB(Asset* geometry)
   return geometryData->finalAABB;
 }
 
+// NOTE: Ray is transformed by the inverse matrix without renormalization of the direction, so the
+// distance along the local ray is the same as along the world one
+static bool8 geometryClipRayLocal(const Ray& ray, const AABB& aabb, const float4x4& transformToWorld,
+                                  float32 maxDistance, float32& outMinDistance, float32& outMaxDistance)
+{
+  float4x4 transformToLocal = inverse(transformToWorld);
+  Ray localRay(mul(transformToLocal, float4(ray.origin, 1.0f)).xyz(),
+               mul(transformToLocal, float4(ray.direction, 0.0f)).xyz());
+
+  return rayClipAABB(localRay, aabb, maxDistance, outMinDistance, outMaxDistance);
+}
+
+bool8 geometryTraceRay(Asset* geometry, const Ray& ray, float32 maxDistance, uint32 rayIndex)
+{
+  assert(geometryIsLeaf(geometry) == TRUE);
+
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  if(geometryData->dirty == TRUE)
+  {
+    geometryRecalculateTransforms(geometry);
+  }
+
+  // 1. Interval of the ray inside of bounds of the leaf (or of any of its instances), unbounded
+  // leaves are traced along the whole ray
+  float32 minDistance = 0.0f;
+  float32 maxTracedDistance = maxDistance;
+
+  if(geometryData->bounded == TRUE)
+  {
+    // NOTE: The same space in which the dynamic AABB is calculated
+    float32 maxScale = maxelem(geometryData->fullScale);
+    float4x4 transformToWorld = mul(geometryData->transformToWorld,
+                                    scaling_matrix(float3(maxScale, maxScale, maxScale)));
+
+    bool8 hit = FALSE;
+    minDistance = maxDistance;
+    maxTracedDistance = 0.0f;
+
+    uint32 instancesCount = std::max<uint32>(geometryData->instances.size(), 1);
+    for(uint32 i = 0; i < instancesCount; i++)
+    {
+      float4x4 instanceTransformToWorld = geometryData->instances.empty() ?
+        transformToWorld : mul(transformToWorld, geometryInstanceGetTransform(geometryData->instances[i]));
+
+      float32 instanceMinDistance = 0.0f;
+      float32 instanceMaxDistance = 0.0f;
+      if(geometryClipRayLocal(ray, geometryData->nativeAABB, instanceTransformToWorld, maxDistance,
+                              instanceMinDistance, instanceMaxDistance) == TRUE)
+      {
+        hit = TRUE;
+        minDistance = std::min(minDistance, instanceMinDistance);
+        maxTracedDistance = std::max(maxTracedDistance, instanceMaxDistance);
+      }
+    }
+
+    if(hit == FALSE)
+    {
+      return FALSE;
+    }
+  }
+
+  // 2. Surface is found by sphere tracing of the leaf on GPU, SDF code exists only in GLSL
+  if(geometryData->rayHitProgram == nullptr)
+  {
+    geometryData->rayHitProgram = ShaderProgramPtr(geometryLinkRayHitProgram(geometry));
+    if(geometryData->rayHitProgram == nullptr)
+    {
+      LOG_ERROR("Cannot generate ray hit program of geometry '%s', it can't be picked!",
+                assetGetName(geometry).c_str());
+      return FALSE;
+    }
+  }
+
+  rayHitPassTraceRay(geometryData->rayHitProgram.raw(), geometryData->ID, rayIndex, ray, minDistance,
+                     maxTracedDistance);
+
+  return TRUE;
+}
+
 void geometryMarkNeedAABBRecalculation(Asset* geometry, bool8 markChildren)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
   geometryData->needAABBRecalculation = TRUE;
 
+  geometryMarkChanged(geometry);
+
   if(markChildren == TRUE)
   {
     if(geometryData->children.size() > 0)
@@ -1551,15 +3142,32 @@ void geometryCopy(AssetPtr geometryDst, Asset* geometrySrc)
   Geometry* dstData = (Geometry*)assetGetInternalData(geometryDst);
   Geometry* srcData = (Geometry*)assetGetInternalData(geometrySrc);
   
+  geometryBeginEdit();
+
   AssetPtr dstParent = dstData->parent;
   geometryClearChildren(geometryDst);
-  
+
+  GeometryFlatTree* dstFlatTree = dstData->flatTree;
+  geometryDestroyBakedDistanceField(dstData);
+
+  // NOTE: Destination is already registered in the transaction by geometryClearChildren()
   *dstData = *srcData;
+  dstData->structureChanged = TRUE;
+  dstData->flatTree = dstFlatTree;
+  dstData->flatTreeOutdated = TRUE;
+  dstData->treeChanged = TRUE;
   dstData->parent = dstParent;
   dstData->ID = 0;
   dstData->drawProgram = ShaderProgramPtr(nullptr);
   dstData->shadowProgram = ShaderProgramPtr(nullptr);
   dstData->aabbProgram = ShaderProgramPtr(nullptr);
+  dstData->normalsProgram = ShaderProgramPtr(nullptr);
+  dstData->occlusionProgram = ShaderProgramPtr(nullptr);
+  dstData->bakedDrawProgram = ShaderProgramPtr(nullptr);
+  dstData->bakedShadowProgram = ShaderProgramPtr(nullptr);
+  dstData->bakedOcclusionProgram = ShaderProgramPtr(nullptr);
+  dstData->bakedField = nullptr;
+  dstData->bakeOutdated = dstData->baked;
 
   assetSetName(geometryDst, assetGetName(geometrySrc));
   
@@ -1596,6 +3204,8 @@ void geometryCopy(AssetPtr geometryDst, Asset* geometrySrc)
   dstData->needRebuild = TRUE;  
   dstData->needAABBRecalculation = TRUE;
   dstData->dirty = TRUE;
+
+  geometryCommitEdit();
 }
 
 bool8 geometryTraversePostorder(Asset* geometry, fpTraverseFunction traverseFunction, void* userData)
@@ -1614,6 +3224,11 @@ bool8 geometryTraversePostorder(Asset* geometry, fpTraverseFunction traverseFunc
   return traverseFunction(geometry, userData);
 }
 
+const GeometryFlatTree& geometryGetFlatTree(Asset* root)
+{
+  return *geometryRootGetFlatTree(root);
+}
+
 const std::set<AssetPtr>& geometryRootGetAllChildren(Asset* root)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(root);
@@ -1624,18 +3239,64 @@ const std::set<AssetPtr>& geometryRootGetAllChildren(Asset* root)
 // Branch geometry-related interface
 // ----------------------------------------------------------------------------
 
+void geometryBeginEdit()
+{
+  editTransaction.depth++;
+}
+
+void geometryCommitEdit()
+{
+  assert(editTransaction.depth > 0);
+
+  editTransaction.depth--;
+  if(editTransaction.depth > 0)
+  {
+    return;
+  }
+
+  // NOTE: Edited geometries may belong to the same tree, or even stop being a part of a tree
+  vector<Asset*> roots;
+  for(Asset* geometry: editTransaction.editedGeometries)
+  {
+    Asset* root = geometryGetRoot(geometry);
+    if(std::find(roots.begin(), roots.end(), root) == roots.end())
+    {
+      roots.push_back(root);
+    }
+  }
+
+  editTransaction.editedGeometries.clear();
+
+  for(Asset* root: roots)
+  {
+    Geometry* rootData = (Geometry*)assetGetInternalData(root);
+    rootData->allChildren.clear();
+
+    uint32 idCounter = 0;
+    geometryCommitStructure(root, rootData, FALSE, idCounter);
+    assert(idCounter < 65535);
+
+    rootData->flatTreeOutdated = TRUE;
+
+    // NOTE: Otherwise the next update of an already updated tree would skip the new nodes
+    geometryMarkChanged(root);
+    geometryMarkModified(root);
+  }
+}
+
 void geometryAddChild(AssetPtr geometry, AssetPtr child)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);  
-  
-  geometryData->children.push_back(child);
-  geometrySetParent(child, geometry);
+  Geometry* childData = (Geometry*)assetGetInternalData(child);
 
-  geometryMarkNeedRebuild(geometry, /** Mark children */ TRUE);
+  geometryBeginEdit();
 
-  geometryRecalculateIDs(geometry);
+    geometryData->children.push_back(child);
+    childData->parent = geometry;
 
-  geometryChildWasAdded(geometry, child);
+    geometryMarkStructureChanged(geometry);
+
+  geometryCommitEdit();
 }
 
 bool8 geometryRemoveChild(Asset* geometry, Asset* child)
@@ -1648,13 +3309,14 @@ bool8 geometryRemoveChild(Asset* geometry, Asset* child)
     return FALSE;
   }
 
-  geometryChildWasRemoved(geometry, *childIt);
-  
-  geometryData->children.erase(childIt);
+  geometryBeginEdit();
 
-  geometryMarkNeedRebuild(geometry, /** Mark children */ TRUE);
-  geometryMarkNeedAABBRecalculation(geometry);  
-  geometryRecalculateIDs(geometry);
+    geometryChildWasRemoved(geometry, *childIt);
+    geometryData->children.erase(childIt);
+
+    geometryMarkStructureChanged(geometry);
+
+  geometryCommitEdit();
   
   return TRUE;
 }
@@ -1663,16 +3325,18 @@ void geometryClearChildren(Asset* geometry)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
 
-  for(AssetPtr child: geometryData->children)
-  {
-    geometryChildWasRemoved(geometry, child);
-  }
+  geometryBeginEdit();
 
-  geometryData->children.clear();
+    for(AssetPtr child: geometryData->children)
+    {
+      geometryChildWasRemoved(geometry, child);
+    }
+
+    geometryData->children.clear();
 
-  geometryMarkNeedRebuild(geometry, /** Mark children */ TRUE);
-  geometryMarkNeedAABBRecalculation(geometry);  
-  geometryRecalculateIDs(geometry);  
+    geometryMarkStructureChanged(geometry);
+
+  geometryCommitEdit();
 }
  
 std::vector<AssetPtr>& geometryGetChildren(Asset* geometry)
@@ -1701,6 +3365,7 @@ void geometrySetSDF(Asset* geometry, AssetPtr sdf)
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);  
   
   geometryData->sdf = sdf;
+  geometryMarkModified(geometry);
 }
 
 AssetPtr geometryGetSDF(Asset* geometry)
@@ -1721,6 +3386,9 @@ void geometrySetMaterial(Asset* geometry, AssetPtr material)
 {
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
   geometryData->material = material;
+
+  geometryMarkModified(geometry);
+  geometryMarkChanged(geometry);
 }
 
 AssetPtr geometryGetMaterial(Asset* geometry)
@@ -1728,3 +3396,114 @@ AssetPtr geometryGetMaterial(Asset* geometry)
   Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
   return geometryData->material;
 }
+
+static void geometryInstancesChanged(Asset* geometry, bool8 hadInstances)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  bool8 hasInstances = geometryData->instances.empty() == FALSE;
+
+  geometryData->instancesFormLattice = geometryDetectInstancesLattice(geometryData->instances,
+                                                                      geometryData->instancesLattice);
+
+  // NOTE: Instanced geometry has its own transform code, but otherwise instances are only data,
+  // so programs are rebuilt only when geometry becomes (or stops being) instanced
+  if(hasInstances != hadInstances)
+  {
+    geometryMarkNeedRebuild(geometry, /** Mark children */ FALSE);
+  }
+
+  // NOTE: Dynamic AABB covers all instances
+  geometryMarkDirty(geometry);
+  geometryMarkModified(geometry);
+}
+
+void geometryAddInstance(Asset* geometry, const GeometryInstance& instance)
+{
+  assert(geometryIsLeaf(geometry) && "Only leaf geometries can have instances");
+  
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  bool8 hadInstances = geometryData->instances.empty() == FALSE;
+  
+  geometryData->instances.push_back(instance);
+  geometryInstancesChanged(geometry, hadInstances);
+}
+
+void geometrySetInstance(Asset* geometry, uint32 index, const GeometryInstance& instance)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  assert(index < geometryData->instances.size());
+
+  geometryData->instances[index] = instance;
+  geometryInstancesChanged(geometry, TRUE);
+}
+
+bool8 geometryRemoveInstance(Asset* geometry, uint32 index)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  if(index >= geometryData->instances.size())
+  {
+    return FALSE;
+  }
+
+  geometryData->instances.erase(geometryData->instances.begin() + index);
+  geometryInstancesChanged(geometry, TRUE);
+
+  return TRUE;
+}
+
+void geometryClearInstances(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  bool8 hadInstances = geometryData->instances.empty() == FALSE;
+
+  geometryData->instances.clear();
+  geometryInstancesChanged(geometry, hadInstances);
+}
+
+const std::vector<GeometryInstance>& geometryGetInstances(Asset* geometry)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  return geometryData->instances;
+}
+
+void geometryFillInstancesLattice(Asset* geometry, uint3 count, float3 spacing)
+{
+  assert(geometryIsLeaf(geometry) && "Only leaf geometries can have instances");
+  
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  bool8 hadInstances = geometryData->instances.empty() == FALSE;
+
+  geometryData->instances.clear();
+  geometryData->instances.reserve(count.x * count.y * count.z);
+
+  // NOTE: Lattice is centered at the origin of the geometry
+  float3 origin = -spacing * (float3(count) - float3(1.0f, 1.0f, 1.0f)) * 0.5f;
+  
+  for(uint32 z = 0; z < count.z; z++)
+  {
+    for(uint32 y = 0; y < count.y; y++)
+    {
+      for(uint32 x = 0; x < count.x; x++)
+      {
+        GeometryInstance instance;
+        instance.position = origin + spacing * float3(x, y, z);
+        
+        geometryData->instances.push_back(instance);
+      }
+    }
+  }
+
+  geometryInstancesChanged(geometry, hadInstances);
+}
+
+bool8 geometryGetInstancesLattice(Asset* geometry, GeometryInstancesLattice& outLattice)
+{
+  Geometry* geometryData = (Geometry*)assetGetInternalData(geometry);
+  if(geometryData->instancesFormLattice == FALSE)
+  {
+    return FALSE;
+  }
+
+  outLattice = geometryData->instancesLattice;
+  return TRUE;
+}
@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "cvar_system.h"
+#include "maths/bvh.h"
 #include "maths/common.h"
 #include "shader_program.h"
 #include "maths/primitives.h"
@@ -14,8 +15,116 @@
 #include "assets/pcf_script_function.h"
 
 struct Material;
+struct BakedDistanceField;
 
 static const AssetType ASSET_TYPE_GEOMETRY = 0xe6593c2d;
+static const uint32 GEOMETRY_INVALID_INDEX = (uint32)-1;
+
+/**
+ * Instance repeats a leaf geometry (its IDFs, SDF and ODFs) with its own transform and material,
+ * all instances of the geometry are drawn by a single program in a single pass. Transform of an
+ * instance is relative to the space of the geometry, scale is uniform so that distances stay valid.
+ */
+struct GeometryInstance
+{
+  float3 position = float3(0.0f, 0.0f, 0.0f);
+  quat orientation = quat(0.0f, 0.0f, 0.0f, 1.0f);
+  float32 scale = 1.0f;
+
+  // NOTE: Material of the geometry is used if it's not set
+  AssetPtr material = AssetPtr(nullptr);
+};
+
+/**
+ * Instances form a lattice if they share orientation, scale and material and their positions are
+ * origin + spacing * cell for each cell in [0, count). Such instances are drawn via domain
+ * repetition, i.e cost of drawing doesn't depend on the count of instances.
+ */
+struct GeometryInstancesLattice
+{
+  float3 origin;
+  float3 spacing;
+  uint3 count;
+};
+
+/**
+ * Flat snapshot of a tree, which is used by per-frame traversals instead of chasing pointers of
+ * geometries. Nodes are stored in postorder (children go before their parent, root is the last one),
+ * all the arrays are indexed by the position of the node.
+ *
+ * Structure (parents, children, geometries) is rebuilt only after the tree is edited, the rest is
+ * refreshed by geometryUpdate() for geometries which have changed.
+ */
+struct GeometryFlatTree
+{
+  std::vector<Asset*> geometries;
+  std::vector<uint32> parents;
+  std::vector<uint32> firstChildren;
+  std::vector<uint32> nextSiblings;
+  std::vector<uint32> totalChildrenCounts;
+
+  std::vector<uint32> ids;
+  std::vector<float3> positions;
+  std::vector<float3> fullScales;
+  std::vector<float4x4> transformsToLocal;
+  std::vector<float4x4> transformsToWorld;
+  std::vector<float4x4> transformsToLocalFromParent;
+  std::vector<float4x4> transformsToParentFromLocal;
+  std::vector<AABB> finalAABBs;
+  std::vector<Asset*> materials;
+  std::vector<ShaderProgram*> drawPrograms;
+  std::vector<ShaderProgram*> shadowPrograms;
+  // NOTE: Calculate exact normals of leaves, nullptr for branches
+  std::vector<ShaderProgram*> normalsPrograms;
+  // NOTE: Sample distances of leaves around pixels for SDF occlusion, branches which aren't unions
+  // sample their whole subtrees (their leaves aren't sampled then), nullptr for other branches
+  std::vector<ShaderProgram*> occlusionPrograms;
+
+  std::vector<bool> enabled;
+  std::vector<bool> bounded;
+  // NOTE: Code of functions of the node reads global parameters, see readsGlobalParameters
+  std::vector<bool> nodesReadGlobalParameters;
+
+  // NOTE: Upper bound of the Lipschitz constant of distance of each node (declared bounds of its
+  // script functions combined through the tree), bound of the root is used by the renderer, since
+  // distance of the root is bounded by the largest bound of its subtree
+  std::vector<float32> lipschitzBounds;
+
+  // NOTE: Indices of leaves, BVH is built over their final AABBs (primitive is an index in the
+  // tree), it contains disabled leaves too, so that toggling doesn't require a rebuild
+  std::vector<uint32> leaves;
+  BVH leavesBVH;
+  bool8 leavesBVHOutdated = FALSE;
+
+  // NOTE: Incremented by geometryUpdate() each time anything in the tree changes, so that results
+  // derived from the tree (e.g cached shadows) can be validated
+  uint32 epoch = 0;
+  // NOTE: Code of some functions reads global parameters (e.g time), so distances may change
+  // every frame without any change of the tree
+  bool8 readsGlobalParameters = FALSE;
+
+  // NOTE: Intermediate data of geometryUpdate(), which allows to process only changed subtrees
+  std::vector<bool> nodesChanged;
+  // NOTE: Node has been rebuilt or (un)hidden, i.e code of its subtree has changed
+  std::vector<bool> codesChanged;
+  std::vector<bool> transformsChanged;
+  std::vector<bool> aabbsChanged;
+  std::vector<bool> smallestParentsAABBsChanged;
+  std::vector<uint32> firstEnabledChildren;
+  std::vector<AABB> combinedAABBs;
+  std::vector<AABB> smallestParentsAABBs;
+  std::vector<bool> lipschitzBoundsChanged;
+  // NOTE: Products of bounds of IDFs of all parents of each node
+  std::vector<float32> idfsLipschitzBounds;
+  uint32 aabbCalculationGeneration = 0;
+  uint32 aabbProgramGeneration = 0;
+  uint32 bakingGeneration = 0;
+
+  uint32 getRootIndex() const
+  {
+    return geometries.size() - 1;
+  }
+};
 
 // ----------------------------------------------------------------------------
 // Geometry common interface
@@ -73,6 +182,21 @@ ENGINE_API const float4x4& geometryGetGeoParentMat(Asset* geometry);
 ENGINE_API void geometrySetBounded(Asset* geometry, bool8 bounded);
 ENGINE_API bool8 geometryIsBounded(Asset* geometry);
 
+/**
+ * Baked branch is drawn as a single node, which samples a distance field of its subtree instead of
+ * evaluating each of its children. Field is re-baked when anything inside of the subtree changes.
+ */
+ENGINE_API void geometrySetBaked(Asset* geometry, bool8 baked);
+ENGINE_API bool8 geometryIsBaked(Asset* geometry);
+
+// NOTE: Requires geometries parameters to be uploaded, so it's called by the renderer
+ENGINE_API void geometryBakeDistanceField(Asset* geometry);
+// NOTE: Returns nullptr if the geometry isn't baked (yet), it's drawn as a usual branch then
+ENGINE_API const BakedDistanceField* geometryGetBakedDistanceField(Asset* geometry);
+ENGINE_API ShaderProgramPtr geometryGetBakedProgram(Asset* geometry, bool8 shadowPath);
+// NOTE: Samples distances of the whole subtree for SDF occlusion, may be nullptr
+ENGINE_API ShaderProgramPtr geometryGetBakedOcclusionProgram(Asset* geometry);
+
 ENGINE_API void geometrySetEnabled(Asset* geometry, bool8 enabled);
 ENGINE_API bool8 geometryIsEnabled(Asset* geometry);
 
@@ -84,6 +208,14 @@ ENGINE_API const AABB& geometryGetNativeAABB(Asset* geometry);
 ENGINE_API const AABB& geometryGetDynamicAABB(Asset* geometry);
 ENGINE_API const AABB& geometryGetFinalAABB(Asset* geometry);
 
+/**
+ * Sphere traces the leaf along the ray on GPU as a ray of the current batch (see rayHitPassTraceRay()).
+ * The ray is clipped by the native AABB of the leaf (or of each of its instances) in the local space,
+ * unbounded leaves are traced along the whole ray.
+ * @return FALSE if the ray misses bounds of the leaf (or it can't be traced), so its hit isn't written
+ */
+ENGINE_API bool8 geometryTraceRay(Asset* geometry, const Ray& ray, float32 maxDistance, uint32 rayIndex);
+
 ENGINE_API void geometryMarkNeedAABBRecalculation(Asset* geometry, bool8 markChildren = FALSE);
 ENGINE_API bool8 geometryNeedAABBRecalculation(Asset* geometry);
 ENGINE_API bool8 geometryNeedRebuild(Asset* geometry);
@@ -104,10 +236,24 @@ ENGINE_API bool8 geometryTraversePostorder(Asset* geometry,
 
 const std::set<AssetPtr>& geometryRootGetAllChildren(Asset* root);
 
+// WARNING: Assumes that given geometry is a root
+ENGINE_API const GeometryFlatTree& geometryGetFlatTree(Asset* root);
+
 // ----------------------------------------------------------------------------
 // Branch geometry-related interface
 // ----------------------------------------------------------------------------
 
+/**
+ * Edit transaction defers work which depends on the structure of the tree (assignment of IDs,
+ * marking for rebuild, collecting children of the root) until the outermost transaction is
+ * committed, so that building a tree of N geometries takes a single pass instead of N.
+ *
+ * Transactions can be nested, each geometryBeginEdit() must be paired with geometryCommitEdit().
+ * @warning IDs, total children count and geometryRootGetAllChildren() are outdated until commit.
+ */
+ENGINE_API void geometryBeginEdit();
+ENGINE_API void geometryCommitEdit();
+
 // NOTE: We need an AssetPtr because we need to set a parent for a child, hence,
 // we cannot use a raw pointer as a parent ptr.
 ENGINE_API void geometryAddChild(AssetPtr geometry, AssetPtr child);
@@ -126,4 +272,16 @@ ENGINE_API bool8 geometryHasSDF(Asset* geometry);
 ENGINE_API void geometrySetMaterial(Asset* geometry, AssetPtr material);
 ENGINE_API AssetPtr geometryGetMaterial(Asset* geometry);
 
+// NOTE: Geometry without instances is drawn once, as if it had a single default instance
+ENGINE_API void geometryAddInstance(Asset* geometry, const GeometryInstance& instance);
+ENGINE_API void geometrySetInstance(Asset* geometry, uint32 index, const GeometryInstance& instance);
+ENGINE_API bool8 geometryRemoveInstance(Asset* geometry, uint32 index);
+ENGINE_API void geometryClearInstances(Asset* geometry);
+ENGINE_API const std::vector<GeometryInstance>& geometryGetInstances(Asset* geometry);
+
+/** Replaces instances with count.x * count.y * count.z instances placed with the given spacing */
+ENGINE_API void geometryFillInstancesLattice(Asset* geometry, uint3 count, float3 spacing);
+/** @return TRUE if instances form a lattice (see GeometryInstancesLattice) */
+ENGINE_API bool8 geometryGetInstancesLattice(Asset* geometry, GeometryInstancesLattice& outLattice);
+
 
@@ -1,3 +1,6 @@
+#include <cmath>
+#include <limits>
+
 #include "maths/json_serializers.h"
 #include "light_source.h"
 
@@ -5,7 +8,7 @@ using nlohmann::json;
 
 static void lightSourceDestroy(Asset* asset);
 static bool8 lightSourceSerialize(AssetPtr asset, json& jsonData);
-static bool8 lightSourceDeserialize(AssetPtr asset, json& jsonData);
+static bool8 lightSourceDeserialize(AssetPtr asset, DocumentValue value);
 static uint32 lightSourceGetSize(Asset* asset) { /** TODO */ }
 
 struct LightSource
@@ -66,20 +69,20 @@ bool8 lightSourceSerialize(AssetPtr lsource, json& jsonData)
   return TRUE;
 }
 
-bool8 lightSourceDeserialize(AssetPtr lsource, json& jsonData)
+bool8 lightSourceDeserialize(AssetPtr lsource, DocumentValue value)
 {
   LightSource* data = (LightSource*)assetGetInternalData(lsource);  
   LightSourceParameters& parameters = data->parameters;
 
-  parameters.type = jsonData.value("light_type", LIGHT_SOURCE_TYPE_DIRECTIONAL);
-  parameters.enabled = jsonData.value("enabled", 0);
-  parameters.shadowEnabled = jsonData.value("shadow_enabled", 0);
-  parameters.shadowFactor = jsonData.value("shadow_factor", 0.0f);
-  parameters.attenuationDistanceFactors = jsonToVec<float32, 2>(jsonData["att_distance"]);
-  parameters.attenuationAngleFactors = jsonToVec<float32, 2>(jsonData["att_angle"]);
-  parameters.position = jsonToVec<float32, 4>(jsonData["position"]);
-  parameters.forward = jsonToVec<float32, 4>(jsonData["forward"]);
-  parameters.intensity = jsonToVec<float32, 4>(jsonData["intensity"]);
+  parameters.type = documentValueGet(value, "light_type", LIGHT_SOURCE_TYPE_DIRECTIONAL);
+  parameters.enabled = documentValueGet(value, "enabled", 0);
+  parameters.shadowEnabled = documentValueGet(value, "shadow_enabled", 0);
+  parameters.shadowFactor = documentValueGet(value, "shadow_factor", 0.0f);
+  parameters.attenuationDistanceFactors = documentValueToVec<float32, 2>(documentValueFind(value, "att_distance"));
+  parameters.attenuationAngleFactors = documentValueToVec<float32, 2>(documentValueFind(value, "att_angle"));
+  parameters.position = documentValueToVec<float32, 4>(documentValueFind(value, "position"));
+  parameters.forward = documentValueToVec<float32, 4>(documentValueFind(value, "forward"));
+  parameters.intensity = documentValueToVec<float32, 4>(documentValueFind(value, "intensity"));
   
   return TRUE;
 }
@@ -139,6 +142,24 @@ float2 lightSourceGetAttenuationDistanceFactors(Asset* lsource)
   return lsourceData->parameters.attenuationDistanceFactors;
 }
 
+float32 lightSourceGetAttenuationRadius(Asset* lsource)
+{
+  LightSource* lsourceData = (LightSource*)assetGetInternalData(lsource);
+
+  // NOTE: The same as calculateAttenuationRadius() in common.glsl
+  float2 k = lsourceData->parameters.attenuationDistanceFactors;
+  float32 m = LIGHT_MIN_ATTENUATION;
+
+  if(k.y <= 0.0f)
+  {
+    return k.x > 0.0f ? (1.0f - m) / (m * k.x) : std::numeric_limits<float32>::infinity();
+  }
+
+  float32 D = k.x * k.x * m * m - 4.0f * m * k.y * (m - 1.0f);
+
+  return (-m * k.x + std::sqrt(D)) / (2.0f * m * k.y);
+}
+
 void lightSourceSetIntensity(Asset* lsource, float4 intensity)
 {
   LightSource* lsourceData = (LightSource*)assetGetInternalData(lsource);
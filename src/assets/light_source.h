@@ -20,6 +20,9 @@ ENGINE_API float4 lightSourceGetFwdDirection(Asset* lsrouce, float4 direction);
 ENGINE_API void lightSourceSetAttenuationDistanceFactors(Asset* lsource, float2 attDistance);
 ENGINE_API float2 lightSourceGetAttenuationDistanceFactors(Asset* lsource);
 
+/** @return distance at which attenuation of the light drops below LIGHT_MIN_ATTENUATION */
+ENGINE_API float32 lightSourceGetAttenuationRadius(Asset* lsource);
+
 ENGINE_API void lightSourceSetIntensity(Asset* lsource, float4 intensity);
 ENGINE_API float4 lightSourceGetIntensity(Asset* lsource);
 
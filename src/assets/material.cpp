@@ -38,7 +38,7 @@ using nlohmann::json;
 
 static void materialDestroy(Asset* material);
 static bool8 materialSerialize(AssetPtr material, json& jsonData);
-static bool8 materialDeserialize(AssetPtr material, json& jsonData);
+static bool8 materialDeserialize(AssetPtr material, DocumentValue value);
 static uint32 materialGetSize(Asset* asset) { /** TODO */ }
 static void materialOnNameChanged(Asset* asset, const std::string& prevName, const std::string& newName) { }
 
@@ -148,34 +148,36 @@ bool8 materialSerialize(AssetPtr material, json& jsonData)
   return TRUE;
 }
 
-bool8 materialDeserialize(AssetPtr material, json& jsonData)
+bool8 materialDeserialize(AssetPtr material, DocumentValue value)
 {
   Material* materialData = (Material*)assetGetInternalData(material);    
   *materialData = Material{};
 
-  materialData->projectionMode = (MaterialTextureProjectionMode)jsonData.value("projection_mode", (uint32)MATERIAL_TEXTURE_PROJECTION_MODE_TRIPLANAR);
+  materialData->projectionMode = (MaterialTextureProjectionMode)documentValueGet(value, "projection_mode", (uint32)MATERIAL_TEXTURE_PROJECTION_MODE_TRIPLANAR);
                                                     
-  materialData->ior = jsonData.value("ior", 1.0f);
-  materialData->ao = jsonData.value("ao", 0.0f);
-  materialData->metallic = jsonData.value("metallic", 0.0f);
-  materialData->roughness = jsonData.value("roughness", 1.0f);
+  materialData->ior = documentValueGet(value, "ior", 1.0f);
+  materialData->ao = documentValueGet(value, "ao", 0.0f);
+  materialData->metallic = documentValueGet(value, "metallic", 0.0f);
+  materialData->roughness = documentValueGet(value, "roughness", 1.0f);
   
-  materialData->ambientColor = jsonToVec<float32, 4>(jsonData["ambient_color"]);
-  materialData->diffuseColor = jsonToVec<float32, 4>(jsonData["diffuse_color"]);
-  materialData->specularColor = jsonToVec<float32, 4>(jsonData["specular_color"]);
-  materialData->emissionColor = jsonToVec<float32, 4>(jsonData["emission_color"]);
+  materialData->ambientColor = documentValueToVec<float32, 4>(documentValueFind(value, "ambient_color"));
+  materialData->diffuseColor = documentValueToVec<float32, 4>(documentValueFind(value, "diffuse_color"));
+  materialData->specularColor = documentValueToVec<float32, 4>(documentValueFind(value, "specular_color"));
+  materialData->emissionColor = documentValueToVec<float32, 4>(documentValueFind(value, "emission_color"));
 
   for(uint32 itype = 0; itype < MATERIAL_TEXTURE_TYPE_COUNT; itype++)
   {
     MaterialTextureType type = (MaterialTextureType)itype;
     const std::string typeStr = std::string(materialTextureTypeLabel(type));
 
-    if(jsonData.contains(typeStr) && jsonData[typeStr].is_object())
+    DocumentValue textureValue = documentValueFind(value, typeStr);
+    if(documentValueIsObject(textureValue) == TRUE)
     {
       
-      std::string textureName = jsonData[typeStr][std::string("name")];
+      std::string textureName = std::string(documentValueGetString(documentValueFind(textureValue, "name")));
 
-      ImagePtr texture = imageManagerLoadImage(textureName.c_str());
+      // NOTE: Material gets a placeholder, the atlas picks up the real texture once it's loaded
+      ImagePtr texture = imageManagerLoadImageAsync(textureName.c_str());
 
       if(texture == ImagePtr(nullptr))
       {
@@ -184,9 +186,9 @@ bool8 materialDeserialize(AssetPtr material, json& jsonData)
       }
 
       materialData->textures[itype].texture = texture;
-      materialData->textures[itype].textureRegion = jsonToVec<uint32, 4>(jsonData[typeStr]["texture_region"]);
-      materialData->textures[itype].blendingFactor = jsonData[typeStr]["blending_factor"];
-      materialData->textures[itype].enabled = jsonData[typeStr]["enabled"];
+      materialData->textures[itype].textureRegion = documentValueToVec<uint32, 4>(documentValueFind(textureValue, "texture_region"));
+      materialData->textures[itype].blendingFactor = documentValueGet(textureValue, "blending_factor", 0.0f);
+      materialData->textures[itype].enabled = documentValueGet(textureValue, "enabled", FALSE);
     }
 
 
@@ -198,7 +200,7 @@ bool8 materialDeserialize(AssetPtr material, json& jsonData)
 void materialSetProjectionMode(Asset* material, MaterialTextureProjectionMode mode)
 {
   Material* materialData = (Material*)assetGetInternalData(material);
-  materialData->projectionMode = mode;
+  assetSetProperty(material, materialData->projectionMode, mode);
 }
 
 MaterialTextureProjectionMode materialGetProjectionMode(Asset* material)
@@ -211,6 +213,7 @@ void materialSetTexture(Asset* material, MaterialTextureType type, ImagePtr imag
 {
   Material* materialData = (Material*)assetGetInternalData(material);
   materialData->textures[type].texture = image;
+  assetMarkModified(material);
   materialData->integratedIntoAtlas = FALSE;
 }
 
@@ -224,6 +227,8 @@ void materialRemoveTexture(Asset* material, MaterialTextureType type)
 {
   Material* materialData = (Material*)assetGetInternalData(material);  
   materialData->textures[type].texture = ImagePtr(nullptr);
+  assetMarkModified(material);
+  materialData->integratedIntoAtlas = FALSE;
 }
 
 bool8 materialHasTexture(Asset* material, MaterialTextureType type)
@@ -235,7 +240,7 @@ bool8 materialHasTexture(Asset* material, MaterialTextureType type)
 void materialSetTextureRegion(Asset* material, MaterialTextureType type, uint4 region)
 {
   Material* materialData = (Material*)assetGetInternalData(material);
-  materialData->textures[type].textureRegion = region;
+  assetSetProperty(material, materialData->textures[type].textureRegion, region);
   materialData->integratedIntoAtlas = FALSE;  
 }
 
@@ -248,7 +253,7 @@ uint4 materialGetTextureRegion(Asset* material, MaterialTextureType type)
 void materialSetTextureBlendingFactor(Asset* material, MaterialTextureType type, float32 factor)
 {
   Material* materialData = (Material*)assetGetInternalData(material);
-  materialData->textures[type].blendingFactor = factor;
+  assetSetProperty(material, materialData->textures[type].blendingFactor, factor);
 }
 
 float32 materialGetTextureBlendingFactor(Asset* material, MaterialTextureType type)
@@ -260,7 +265,7 @@ float32 materialGetTextureBlendingFactor(Asset* material, MaterialTextureType ty
 void materialSetEnabledTexture(Asset* material, MaterialTextureType type, bool8 enabled)
 {
   Material* materialData = (Material*)assetGetInternalData(material);    
-  materialData->textures[type].enabled = enabled;
+  assetSetProperty(material, materialData->textures[type].enabled, enabled);
 }
 
 bool8 materialIsTextureEnabled(Asset* material, MaterialTextureType type)
@@ -272,7 +277,7 @@ bool8 materialIsTextureEnabled(Asset* material, MaterialTextureType type)
 void materialSetAmbientColor(Asset* material, float4 ambientColor)
 {
   Material* materialData = (Material*)assetGetInternalData(material);
-  materialData->ambientColor = ambientColor;
+  assetSetProperty(material, materialData->ambientColor, ambientColor);
 }
 
 float4 materialGetAmbientColor(Asset* material)
@@ -284,7 +289,7 @@ float4 materialGetAmbientColor(Asset* material)
 void materialSetDiffuseColor(Asset* material, float4 diffuseColor)
 {
   Material* materialData = (Material*)assetGetInternalData(material);
-  materialData->diffuseColor = diffuseColor;
+  assetSetProperty(material, materialData->diffuseColor, diffuseColor);
 }
 
 float4 materialGetDiffuseColor(Asset* material)
@@ -296,7 +301,7 @@ float4 materialGetDiffuseColor(Asset* material)
 void materialSetSpecularColor(Asset* material, float4 specularColor)
 {
   Material* materialData = (Material*)assetGetInternalData(material);
-  materialData->specularColor = specularColor;  
+  assetSetProperty(material, materialData->specularColor, specularColor);
 }
 
 float4 materialGetSpecularColor(Asset* material)
@@ -308,7 +313,7 @@ float4 materialGetSpecularColor(Asset* material)
 void materialSetEmissionColor(Asset* material, float4 emissionColor)
 {
   Material* materialData = (Material*)assetGetInternalData(material);
-  materialData->emissionColor = emissionColor;
+  assetSetProperty(material, materialData->emissionColor, emissionColor);
 }
 
 float4 materialGetEmissionColor(Asset* material)
@@ -320,7 +325,7 @@ float4 materialGetEmissionColor(Asset* material)
 void materialSetIOR(Asset* material, float32 ior)
 {
   Material* materialData = (Material*)assetGetInternalData(material);
-  materialData->ior = ior;
+  assetSetProperty(material, materialData->ior, ior);
 }
 
 float32 materialGetIOR(Asset* material)
@@ -332,7 +337,7 @@ float32 materialGetIOR(Asset* material)
 void materialSetAO(Asset* material, float32 ao)
 {
   Material* materialData = (Material*)assetGetInternalData(material);
-  materialData->ao = ao;
+  assetSetProperty(material, materialData->ao, ao);
 }
 
 float32 materialGetAO(Asset* material)
@@ -344,7 +349,7 @@ float32 materialGetAO(Asset* material)
 void materialSetMetallic(Asset* material, float32 metallic)
 {
   Material* materialData = (Material*)assetGetInternalData(material);
-  materialData->metallic = metallic;
+  assetSetProperty(material, materialData->metallic, metallic);
 }
 
 float32 materialGetMetallic(Asset* material)
@@ -356,7 +361,7 @@ float32 materialGetMetallic(Asset* material)
 void materialSetRoughness(Asset* material, float32 roughness)
 {
   Material* materialData = (Material*)assetGetInternalData(material);
-  materialData->roughness = roughness;
+  assetSetProperty(material, materialData->roughness, roughness);
 }
 
 float32 materialGetRoughness(Asset* material)
@@ -1,56 +1,113 @@
 #include <map>
+#include <array>
 #include <vector>
+#include <algorithm>
 
 using std::map;
+using std::array;
 using std::vector;
 
 #include "utils.h"
+#include "logging.h"
+#include "image_manager.h"
+#include "texture_cooker.h"
+#include "maths/rect_packer.h"
 #include "assets/material.h"
 #include "assets/assets_manager.h"
 
 #include "materials_atlas_system.h"
 
+// NOTE: Border around each texture in the atlas, it's filled by repeated edge texels of the texture,
+// so that filtering doesn't bleed neighbouring textures. Compressed textures bring it with themselves
+// (it's added when they are cooked), since a copied block of edge texels isn't their repetition.
+// Sizes of regions are rounded up to a multiple of the padding, so regions stay aligned at coarser
+// mip levels and to blocks of compressed textures
+#define MAS_TEXTURE_PADDING TEXTURE_COOKER_BORDER
+
+#define MAS_INITIAL_ATLAS_WIDTH 1024
+#define MAS_INITIAL_ATLAS_HEIGHT 512
+
+struct MASRegion
+{
+  // NOTE: Position of the texture itself, padding is around it
+  uint2 position;
+  uint2 size;
+  // NOTE: Version of the image when it was copied (see imageGetVersion())
+  uint32 version;
+
+  // NOTE: Count of materials' texture slots which use the texture, the region is evicted at the
+  // end of update when it drops to zero
+  uint32 referencesCount;
+};
+
+using MASMaterialTextures = array<ImagePtr, MATERIAL_TEXTURE_TYPE_COUNT>;
+
 struct MASData
 {
-  ImagePtr atlas;  
+  ImagePtr atlas;
   GLuint copyingFBO;
-  
-  uint32 rowHeight = 0;
-  uint4 atlasInsertRegion = uint4(0, 0, 0, 0);
 
-  std::map<ImagePtr, float4> textureRects;
+  RectPacker packer;
+  std::map<ImagePtr, MASRegion> regions;
+
+  // NOTE: Textures which each material used when it has been integrated the last time
+  std::map<Asset*, MASMaterialTextures> materialsTextures;
 
   bool8 initialized = FALSE;
 };
 
 static MASData data;
 
-bool8 initializeMAS()
+static ImagePtr createAtlas(uint2 size)
 {
-  if(data.initialized == TRUE)
-  {
-    return FALSE;
-  }
-
-  const uint32 atlasWidth = 1024;
-  const uint32 atlasHeight = 512;  
-  
   GLuint atlasHandle;
   glGenTextures(1, &atlasHandle);
   glBindTexture(GL_TEXTURE_2D, atlasHandle);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, atlasWidth, atlasHeight, 0, GL_RGB, GL_FLOAT, NULL);  
+
+  // NOTE: Compressed textures are copied into the atlas by blocks, so it has to be of the same format
+  if(imageManagerCompressesTextures() == TRUE)
+  {
+    glTexStorage2D(GL_TEXTURE_2D, 1, TEXTURE_COOKER_FORMAT, size.x, size.y);
+  }
+  else
+  {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, size.x, size.y, 0, GL_RGB, GL_FLOAT, NULL);
+  }
+
   glBindTexture(GL_TEXTURE_2D, 0);
 
   Image* atlas;
-  assert(createImage(atlasHandle, atlasWidth, atlasHeight, &atlas));
-  data.atlas = ImagePtr(atlas);
+  if(createImage(atlasHandle, size.x, size.y, &atlas) == FALSE)
+  {
+    glDeleteTextures(1, &atlasHandle);
+    return ImagePtr(nullptr);
+  }
+
+  return ImagePtr(atlas);
+}
+
+bool8 initializeMAS()
+{
+  if(data.initialized == TRUE)
+  {
+    return FALSE;
+  }
+
+  uint2 atlasSize = uint2(MAS_INITIAL_ATLAS_WIDTH, MAS_INITIAL_ATLAS_HEIGHT);
 
+  data.atlas = createAtlas(atlasSize);
+  if(data.atlas == ImagePtr(nullptr))
+  {
+    return FALSE;
+  }
+
+  rectPackerInit(data.packer, atlasSize);
   glGenFramebuffers(1, &data.copyingFBO);
 
   data.initialized = TRUE;
-  
+
   return TRUE;
 }
 
@@ -58,98 +115,415 @@ void shutdownMAS()
 {
   if(data.initialized == TRUE)
   {
-    data.atlas = ImagePtr(nullptr);
     glDeleteFramebuffers(1, &data.copyingFBO);
+    data = MASData{};
   }
 }
 
-static float4 addTextureToAtlas(ImagePtr texture)
+static uint2 masGetPaddedSize(uint2 textureSize)
 {
-  auto rectIt = data.textureRects.find(texture);
-  if(rectIt != data.textureRects.end())
-  {
-    return rectIt->second;
-  }
+  uint2 alignedSize = (textureSize + uint2(MAS_TEXTURE_PADDING - 1)) / MAS_TEXTURE_PADDING * MAS_TEXTURE_PADDING;
+  return alignedSize + uint2(2 * MAS_TEXTURE_PADDING);
+}
 
-  uint2 atlasSize = imageGetSize(data.atlas);
-  uint2 textureSize = imageGetSize(texture);
+/** @return size of the content of the texture, i.e without its border (see imageGetBorder()) */
+static uint2 masGetTextureSize(ImagePtr texture)
+{
+  return imageGetSize(texture) - uint2(2 * imageGetBorder(texture));
+}
 
-  // If we cannot place this image at the end of the current row - move insert pointer at
-  // the beginning of the next row.
-  if(data.atlasInsertRegion.x + textureSize.x > atlasSize.x)
-  {
-    data.atlasInsertRegion.x = 0;
-    data.atlasInsertRegion.y += data.rowHeight;
-    assert(data.atlasInsertRegion.y < atlasSize.y);
+/**
+ * Copies the compressed texture into the atlas together with its border, which fills the padding,
+ * sizes of compressed textures are multiples of the block side (see textureCookerDecode())
+ */
+static void masCopyCompressedTexture(ImagePtr texture, uint2 position)
+{
+  assert(imageGetBorder(texture) == MAS_TEXTURE_PADDING);
+
+  uint2 paddedSize = imageGetSize(texture);
+  uint2 paddedPosition = position - uint2(MAS_TEXTURE_PADDING);
+
+  glCopyImageSubData(imageGetGLHandle(texture), GL_TEXTURE_2D, 0, 0, 0, 0,
+                     imageGetGLHandle(data.atlas), GL_TEXTURE_2D, 0, paddedPosition.x, paddedPosition.y, 0,
+                     paddedSize.x, paddedSize.y, 1);
+}
 
-    data.rowHeight = 0;
+/** Copies the texture into the atlas and fills the padding around it */
+static void masCopyTexture(ImagePtr texture, uint2 position)
+{
+  if(imageManagerCompressesTextures() == TRUE)
+  {
+    masCopyCompressedTexture(texture, position);
+    return;
   }
 
+  uint2 size = masGetTextureSize(texture);
+  uint32 border = imageGetBorder(texture);
+  GLuint atlasHandle = imageGetGLHandle(data.atlas);
+
   // Bind FBO, change color attachment to a given texture that's going to be copied, say
   // that glCopyTex... command should read from the color attachment #0 (which in turn
   // stores handle of our texture), finally perform copying.
   glBindFramebuffer(GL_FRAMEBUFFER, data.copyingFBO);
-  
+
     glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, imageGetGLHandle(texture), 0);
     glReadBuffer(GL_COLOR_ATTACHMENT0);
-  
-    glCopyTextureSubImage2D(imageGetGLHandle(data.atlas),
-                            0,
-                            data.atlasInsertRegion.x,
-                            data.atlasInsertRegion.y,
-                            0, 0,
-                            textureSize.x, textureSize.y);
+
+    glCopyTextureSubImage2D(atlasHandle, 0, position.x, position.y, border, border, size.x, size.y);
 
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  
-  float4 uvRect = calculateUVRect(atlasSize,
-                                  uint2(data.atlasInsertRegion.x, data.atlasInsertRegion.y),
-                                  textureSize);
-  data.textureRects[texture] = uvRect;
-  
-  data.rowHeight = max(data.rowHeight, textureSize.y);
-  data.atlasInsertRegion.x += textureSize.x;
-
-  return uvRect;
+
+  // NOTE: Edge columns are extended first, then edge rows together with padding of columns, so
+  // that corners are filled too
+  for(uint32 i = 1; i <= MAS_TEXTURE_PADDING; i++)
+  {
+    glCopyImageSubData(atlasHandle, GL_TEXTURE_2D, 0, position.x, position.y, 0,
+                       atlasHandle, GL_TEXTURE_2D, 0, position.x - i, position.y, 0,
+                       1, size.y, 1);
+    glCopyImageSubData(atlasHandle, GL_TEXTURE_2D, 0, position.x + size.x - 1, position.y, 0,
+                       atlasHandle, GL_TEXTURE_2D, 0, position.x + size.x - 1 + i, position.y, 0,
+                       1, size.y, 1);
+  }
+
+  uint32 paddedWidth = size.x + 2 * MAS_TEXTURE_PADDING;
+  uint32 paddedX = position.x - MAS_TEXTURE_PADDING;
+
+  for(uint32 i = 1; i <= MAS_TEXTURE_PADDING; i++)
+  {
+    glCopyImageSubData(atlasHandle, GL_TEXTURE_2D, 0, paddedX, position.y, 0,
+                       atlasHandle, GL_TEXTURE_2D, 0, paddedX, position.y - i, 0,
+                       paddedWidth, 1, 1);
+    glCopyImageSubData(atlasHandle, GL_TEXTURE_2D, 0, paddedX, position.y + size.y - 1, 0,
+                       atlasHandle, GL_TEXTURE_2D, 0, paddedX, position.y + size.y - 1 + i, 0,
+                       paddedWidth, 1, 1);
+  }
+}
+
+/**
+ * Packs regions which are still referenced (plus the extra one) into an atlas of the given size.
+ * @return FALSE if they don't fit
+ */
+static bool8 masPackRegions(uint2 atlasSize,
+                            uint2 extraSize,
+                            RectPacker& outPacker,
+                            std::map<ImagePtr, uint2>& outPositions)
+{
+  vector<ImagePtr> textures;
+  for(const auto& region: data.regions)
+  {
+    if(region.second.referencesCount > 0)
+    {
+      textures.push_back(region.first);
+    }
+  }
+
+  // NOTE: Large textures are placed first, small ones fill gaps between them
+  std::sort(textures.begin(), textures.end(), [](const ImagePtr& lop, const ImagePtr& rop)
+  {
+    uint2 lopSize = masGetTextureSize(lop);
+    uint2 ropSize = masGetTextureSize(rop);
+
+    return std::max(lopSize.x, lopSize.y) > std::max(ropSize.x, ropSize.y);
+  });
+
+  rectPackerInit(outPacker, atlasSize);
+  outPositions.clear();
+
+  for(const ImagePtr& texture: textures)
+  {
+    uint2 paddedPosition;
+    if(rectPackerInsert(outPacker, masGetPaddedSize(masGetTextureSize(texture)), paddedPosition) == FALSE)
+    {
+      return FALSE;
+    }
+
+    outPositions[texture] = paddedPosition + uint2(MAS_TEXTURE_PADDING);
+  }
+
+  // NOTE: Only checks that the extra region fits, it's inserted by the caller
+  RectPacker packer = outPacker;
+  uint2 extraPosition;
+
+  return rectPackerInsert(packer, extraSize, extraPosition);
+}
+
+/**
+ * Defragments the atlas, i.e repacks regions which are still referenced and evicts the rest. The atlas
+ * grows twice (alternately in width and height) until there is space for the extra region.
+ * @return FALSE if the extra region doesn't fit even into the atlas of the maximal size
+ */
+static bool8 masRepack(uint2 extraSize)
+{
+  GLint maxTextureSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+  uint2 atlasSize = imageGetSize(data.atlas);
+  RectPacker packer;
+  std::map<ImagePtr, uint2> positions;
+
+  while(masPackRegions(atlasSize, extraSize, packer, positions) == FALSE)
+  {
+    uint32& side = atlasSize.x <= atlasSize.y ? atlasSize.x : atlasSize.y;
+    if(side * 2 > (uint32)maxTextureSize)
+    {
+      return FALSE;
+    }
+
+    side *= 2;
+  }
+
+  ImagePtr atlas = createAtlas(atlasSize);
+  if(atlas == ImagePtr(nullptr))
+  {
+    return FALSE;
+  }
+
+  // NOTE: Regions are moved together with their padding
+  for(const auto& position: positions)
+  {
+    const MASRegion& region = data.regions[position.first];
+    uint2 paddedSize = region.size + uint2(2 * MAS_TEXTURE_PADDING);
+
+    glCopyImageSubData(imageGetGLHandle(data.atlas), GL_TEXTURE_2D, 0,
+                       region.position.x - MAS_TEXTURE_PADDING, region.position.y - MAS_TEXTURE_PADDING, 0,
+                       imageGetGLHandle(atlas), GL_TEXTURE_2D, 0,
+                       position.second.x - MAS_TEXTURE_PADDING, position.second.y - MAS_TEXTURE_PADDING, 0,
+                       paddedSize.x, paddedSize.y, 1);
+  }
+
+  for(auto regionIt = data.regions.begin(); regionIt != data.regions.end();)
+  {
+    if(regionIt->second.referencesCount == 0)
+    {
+      regionIt = data.regions.erase(regionIt);
+    }
+    else
+    {
+      regionIt->second.position = positions[regionIt->first];
+      regionIt++;
+    }
+  }
+
+  if(atlasSize != imageGetSize(data.atlas))
+  {
+    LOG_INFO("Materials atlas has grown to %ux%u", atlasSize.x, atlasSize.y);
+  }
+
+  data.atlas = atlas;
+  data.packer = packer;
+
+  return TRUE;
+}
+
+/** @return FALSE if the texture can't be placed into the atlas */
+static bool8 masAcquireRegion(ImagePtr texture, bool8& outAtlasChanged)
+{
+  auto regionIt = data.regions.find(texture);
+  if(regionIt != data.regions.end())
+  {
+    regionIt->second.referencesCount++;
+    return TRUE;
+  }
+
+  uint2 textureSize = masGetTextureSize(texture);
+  uint2 paddedSize = masGetPaddedSize(textureSize);
+  uint2 paddedPosition;
+
+  if(rectPackerInsert(data.packer, paddedSize, paddedPosition) == FALSE)
+  {
+    // NOTE: Repacking checks that there is enough space, so the second insertion can't fail
+    if(masRepack(paddedSize) == FALSE ||
+       rectPackerInsert(data.packer, paddedSize, paddedPosition) == FALSE)
+    {
+      LOG_ERROR("Texture '%s' (%ux%u) doesn't fit into the materials atlas",
+                imageGetName(texture).c_str(), textureSize.x, textureSize.y);
+      return FALSE;
+    }
+
+    outAtlasChanged = TRUE;
+  }
+
+  MASRegion region = {};
+  region.position = paddedPosition + uint2(MAS_TEXTURE_PADDING);
+  region.size = textureSize;
+  region.version = imageGetVersion(texture);
+  region.referencesCount = 1;
+
+  data.regions[texture] = region;
+  masCopyTexture(texture, region.position);
+
+  return TRUE;
+}
+
+static void masReleaseRegion(ImagePtr texture)
+{
+  auto regionIt = data.regions.find(texture);
+  if(regionIt != data.regions.end() && regionIt->second.referencesCount > 0)
+  {
+    regionIt->second.referencesCount--;
+  }
+}
+
+static void masEvictUnusedRegions()
+{
+  for(auto regionIt = data.regions.begin(); regionIt != data.regions.end();)
+  {
+    if(regionIt->second.referencesCount == 0)
+    {
+      const MASRegion& region = regionIt->second;
+      rectPackerFree(data.packer,
+                     region.position - uint2(MAS_TEXTURE_PADDING),
+                     masGetPaddedSize(region.size));
+
+      regionIt = data.regions.erase(regionIt);
+    }
+    else
+    {
+      regionIt++;
+    }
+  }
+}
+
+/**
+ * Removes regions of images whose content has changed since they were copied (e.g asynchronously
+ * loaded images which have replaced their placeholders), materials which use them are integrated again.
+ */
+static void masInvalidateOutdatedRegions()
+{
+  for(auto regionIt = data.regions.begin(); regionIt != data.regions.end();)
+  {
+    ImagePtr texture = regionIt->first;
+    const MASRegion& region = regionIt->second;
+
+    if(region.version == imageGetVersion(texture))
+    {
+      regionIt++;
+      continue;
+    }
+
+    for(auto texturesIt = data.materialsTextures.begin(); texturesIt != data.materialsTextures.end();)
+    {
+      const MASMaterialTextures& textures = texturesIt->second;
+      if(std::find(textures.begin(), textures.end(), texture) == textures.end())
+      {
+        texturesIt++;
+        continue;
+      }
+
+      for(const ImagePtr& materialTexture: textures)
+      {
+        if(materialTexture != ImagePtr(nullptr) && materialTexture != texture)
+        {
+          masReleaseRegion(materialTexture);
+        }
+      }
+
+      materialSetIntegratedIntoAtlas(texturesIt->first, FALSE);
+      texturesIt = data.materialsTextures.erase(texturesIt);
+    }
+
+    rectPackerFree(data.packer, region.position - uint2(MAS_TEXTURE_PADDING), masGetPaddedSize(region.size));
+    regionIt = data.regions.erase(regionIt);
+  }
 }
 
 void masUpdate()
 {
-  std::vector<AssetPtr> materials = assetsManagerGetAssetsByType(ASSET_TYPE_MATERIAL);
+  const std::vector<AssetPtr>& materials = assetsManagerGetAssetsByType(ASSET_TYPE_MATERIAL);
 
+  // NOTE: Textures of removed materials and of the ones which have to be integrated again are
+  // released, regions aren't evicted until the end of update, so textures which are still used
+  // don't have to be copied again
+  std::map<Asset*, MASMaterialTextures> materialsTextures;
+
+  for(AssetPtr material: materials)
+  {
+    auto texturesIt = data.materialsTextures.find(material.raw());
+    if(texturesIt != data.materialsTextures.end() && materialIsIntegratedIntoAtlas(material) == TRUE)
+    {
+      materialsTextures[material.raw()] = texturesIt->second;
+      data.materialsTextures.erase(texturesIt);
+    }
+  }
+
+  for(const auto& textures: data.materialsTextures)
+  {
+    for(const ImagePtr& texture: textures.second)
+    {
+      if(texture != ImagePtr(nullptr))
+      {
+        masReleaseRegion(texture);
+      }
+    }
+  }
+
+  data.materialsTextures = materialsTextures;
+
+  masInvalidateOutdatedRegions();
+
+  bool8 atlasChanged = FALSE;
+  for(AssetPtr material: materials)
+  {
+    if(materialIsIntegratedIntoAtlas(material) == TRUE)
+    {
+      continue;
+    }
+
+    MASMaterialTextures& textures = data.materialsTextures[material.raw()];
+    for(uint32 itype = 0; itype < MATERIAL_TEXTURE_TYPE_COUNT; itype++)
+    {
+      ImagePtr texture = materialGetTexture(material, (MaterialTextureType)itype);
+
+      if(texture != ImagePtr(nullptr) && masAcquireRegion(texture, atlasChanged) == TRUE)
+      {
+        textures[itype] = texture;
+      }
+    }
+  }
+
+  masEvictUnusedRegions();
+
+  // NOTE: Repacking moves all regions and may resize the atlas, so rects of all materials are updated then
   uint2 atlasSize = imageGetSize(data.atlas);
 
   uint32 materialID = 0;
   for(AssetPtr material: materials)
   {
-    if(materialIsIntegratedIntoAtlas(material) == FALSE)
+    if(materialIsIntegratedIntoAtlas(material) == FALSE || atlasChanged == TRUE)
     {
+      const MASMaterialTextures& textures = data.materialsTextures[material.raw()];
+
       for(uint32 itype = 0; itype < MATERIAL_TEXTURE_TYPE_COUNT; itype++)
       {
         MaterialTextureType type = (MaterialTextureType)itype;
-        ImagePtr texture = materialGetTexture(material, type);
-        
-        if(texture != ImagePtr(nullptr))
+        if(textures[itype] == ImagePtr(nullptr))
         {
-          uint4 textureRegion = materialGetTextureRegion(material, type);
-
-          // Get offset in the atlas, calculate uv rect relatively to the origin, apply given offset
-          float2 offsetUVRect = addTextureToAtlas(texture).xy();
-          float4 originUVRect = calculateUVRect(atlasSize,
-                                                uint2(textureRegion.x, textureRegion.y),
-                                                uint2(textureRegion.z, textureRegion.w));
-          
-          float2 uvMin = float2(originUVRect.x, originUVRect.y) + offsetUVRect;
-          float2 uvMax = float2(originUVRect.z, originUVRect.w) + offsetUVRect;
-
-          materialSetTextureAtlasRect(material, type, float4(uvMin.x, uvMin.y, uvMax.x, uvMax.y));
+          materialSetTextureAtlasRect(material, type, float4(0.0f, 0.0f, 0.0f, 0.0f));
+          continue;
         }
+
+        const MASRegion& region = data.regions[textures[itype]];
+        uint4 textureRegion = materialGetTextureRegion(material, type);
+
+        // NOTE: Region is clamped by the size of the texture, e.g while it's a placeholder of an image
+        // which is still being loaded
+        uint2 regionOffset = min(uint2(textureRegion.x, textureRegion.y), region.size - uint2(1));
+        uint2 regionSize = min(uint2(textureRegion.z, textureRegion.w), region.size - regionOffset);
+
+        // Get offset in the atlas, calculate uv rect relatively to the origin, apply given offset
+        float2 offsetUVRect = calculateUVRect(atlasSize, region.position, uint2(0, 0)).xy();
+        float4 originUVRect = calculateUVRect(atlasSize, regionOffset, regionSize);
+
+        float2 uvMin = float2(originUVRect.x, originUVRect.y) + offsetUVRect;
+        float2 uvMax = float2(originUVRect.z, originUVRect.w) + offsetUVRect;
+
+        materialSetTextureAtlasRect(material, type, float4(uvMin.x, uvMin.y, uvMax.x, uvMax.y));
       }
 
       materialSetIntegratedIntoAtlas(material, TRUE);
     }
 
-    materialSetShaderID(material, materialID++);    
+    materialSetShaderID(material, materialID++);
   }
 }
 
@@ -157,4 +531,3 @@ ImagePtr masGetAtlas(uint32 index)
 {
   return data.atlas;
 }
-
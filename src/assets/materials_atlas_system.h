@@ -1,7 +1,9 @@
 /**
  * A simple system for an automatic generation of the collections of the material's textures.
  *
- * The current version gets a list of materials from assets manager.
+ * The current version gets a list of materials from assets manager. Textures are packed into a single
+ * atlas (see rect_packer.h), a texture is shared by all materials which use it and it's evicted once
+ * none of them does. When there is no space left, the atlas is defragmented and grows if needed.
  */
 
 #pragma once
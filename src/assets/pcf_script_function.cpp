@@ -65,11 +65,11 @@ static bool8 serializePCF(AssetPtr pcf, nlohmann::json& jsonData)
   return TRUE;
 }
 
-static bool8 deserializePCF(AssetPtr pcf, nlohmann::json& jsonData)
+static bool8 deserializePCF(AssetPtr pcf, DocumentValue value)
 {
   PCFData* data = (PCFData*)scriptFunctionGetInternalData(pcf);
-  data->nativeType = jsonData.value("pcf_native_type", PCF_NATIVE_TYPE_INTERSECTION);
-  data->multiplier = jsonData.value("multiplier", 0.0f);
+  data->nativeType = documentValueGet(value, "pcf_native_type", PCF_NATIVE_TYPE_INTERSECTION);
+  data->multiplier = documentValueGet(value, "multiplier", 0.0f);
 
   return TRUE;
 }
@@ -100,7 +100,7 @@ bool8 createPCF(const std::string& name, PCFNativeType nativeType, Asset** outAs
 void pcfSetNativeType(Asset* pcf, PCFNativeType type)
 {
   PCFData* data = (PCFData*)scriptFunctionGetInternalData(pcf);
-  data->nativeType = type;
+  assetSetProperty(pcf, data->nativeType, type);
 }
 
 PCFNativeType pcfGetNativeType(Asset* pcf)
@@ -112,7 +112,7 @@ PCFNativeType pcfGetNativeType(Asset* pcf)
 void pcfSetBoundingMultiplier(Asset* pcf, float32 multiplier)
 {
   PCFData* data = (PCFData*)scriptFunctionGetInternalData(pcf);
-  data->multiplier = multiplier;
+  assetSetProperty(pcf, data->multiplier, multiplier);
 }
 
 float32 pcfGetBoundingMultiplier(Asset* pcf)
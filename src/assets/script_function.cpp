@@ -1,3 +1,5 @@
+#include <algorithm>
+
 
 #include "memory_manager.h"
 #include "lua/lua_system.h"
@@ -13,13 +15,16 @@ struct ScriptFunction
   ScriptFunctionArgs args;
   ScriptFunctionType type;
 
+  // NOTE: Declared by the user, see scriptFunctionSetLipschitzBound()
+  float32 lipschitzBound;
+
   ScriptFunctionInterface interface;
   void* internalData;
 };
 
 static void scriptFunctionDestroy(Asset* asset);
 static bool8 scriptFunctionSerialize(AssetPtr asset, json& jsonData);
-static bool8 scriptFunctionDeserialize(AssetPtr asset, json& jsonData);
+static bool8 scriptFunctionDeserialize(AssetPtr asset, DocumentValue value);
 static uint32 scriptFunctionGetSize(Asset* asset) { /** TODO */ }
 static void scriptFunctionOnNameChanged(Asset* asset, const std::string& prevName, const std::string& newName);
 
@@ -51,6 +56,7 @@ bool8 createScriptFunction(ScriptFunctionType type, const string& name, Asset**
   ScriptFunction* function = engineAllocObject<ScriptFunction>(MEMORY_TYPE_GENERAL);
   function->code = "";
   function->type = type;
+  function->lipschitzBound = 1.0f;
 
   assetSetInternalData(*outAsset, function);
   
@@ -95,7 +101,8 @@ void scriptFunctionCopy(Asset* dst, Asset* src)
     srcData->interface.copy(dst, src);
   }
   
-  assetSetName(dst, assetGetName(src));  
+  assetSetName(dst, assetGetName(src));
+  assetMarkModified(dst);
 }
 
 void scriptFunctionDestroy(Asset* asset)
@@ -116,6 +123,7 @@ bool8 scriptFunctionSerialize(AssetPtr asset, json& jsonData)
 
   jsonData["code"] = data->code;
   jsonData["sf_type"] = data->type;  
+  jsonData["lipschitz_bound"] = data->lipschitzBound;
   for(const auto& arg: data->args)
   {
     jsonData["args"][arg.first] = arg.second;
@@ -129,19 +137,23 @@ bool8 scriptFunctionSerialize(AssetPtr asset, json& jsonData)
   return TRUE;
 }
 
-bool8 scriptFunctionDeserialize(AssetPtr asset, json& jsonData)
+bool8 scriptFunctionDeserialize(AssetPtr asset, DocumentValue value)
 {
   ScriptFunction* data = (ScriptFunction*)assetGetInternalData(asset);
-  data->code = jsonData.at("code");
-  data->type = jsonData.at("sf_type");
-  for(const auto& arg: jsonData["args"].items())
+  data->code = documentValueGetString(documentValueFind(value, "code"));
+  data->type = documentValueGet(value, "sf_type", SCRIPT_FUNCTION_TYPE_SDF);
+  data->lipschitzBound = documentValueGet(value, "lipschitz_bound", 1.0f);
+
+  DocumentValue args = documentValueFind(value, "args");
+  for(uint32 argIdx = 0; argIdx < documentValueGetSize(args); argIdx++)
   {
-    data->args[arg.key()] = arg.value();
+    data->args[string(documentValueGetMemberKey(args, argIdx))] =
+      documentValueGet(documentValueGetMemberValue(args, argIdx), 0.0f);
   }
 
   if(data->interface.deserialize != nullptr)
   {
-    return data->interface.deserialize(asset, jsonData);
+    return data->interface.deserialize(asset, value);
   }
 
   return TRUE;
@@ -152,6 +164,7 @@ void scriptFunctionSetArgValue(Asset* asset, const string& argName, float32 valu
   ScriptFunction* data = (ScriptFunction*)assetGetInternalData(asset);
   
   data->args[argName] = value;
+  assetMarkModified(asset);
 }
 
 float32 scriptFunctionGetArgValue(Asset* asset, const string& argName)
@@ -171,7 +184,7 @@ ScriptFunctionArgs& scriptFunctionGetArgs(Asset* asset)
 void scriptFunctionSetType(Asset* asset, ScriptFunctionType type)
 {
   ScriptFunction* data = (ScriptFunction*)assetGetInternalData(asset);
-  data->type = type;
+  assetSetProperty(asset, data->type, type);
 }
 
 ScriptFunctionType scriptFunctionGetType(Asset* asset)
@@ -185,7 +198,22 @@ void scriptFunctionSetCode(Asset* asset, const std::string& code)
 {
   ScriptFunction* data = (ScriptFunction*)assetGetInternalData(asset);
 
-  data->code = code;
+  assetSetProperty(asset, data->code, code);
+}
+
+void scriptFunctionSetLipschitzBound(Asset* asset, float32 bound)
+{
+  ScriptFunction* data = (ScriptFunction*)assetGetInternalData(asset);
+
+  // NOTE: Bound below 1 would make steps longer than the distance, which is never safe
+  assetSetProperty(asset, data->lipschitzBound, std::max(bound, 1.0f));
+}
+
+float32 scriptFunctionGetLipschitzBound(Asset* asset)
+{
+  ScriptFunction* data = (ScriptFunction*)assetGetInternalData(asset);
+
+  return data->lipschitzBound;
 }
 
 const std::string& scriptFunctionGetRawCode(Asset* asset)
@@ -39,7 +39,7 @@ struct ScriptFunctionInterface
   void(*destroy)(Asset* scriptFunction);
   void(*copy)(Asset* dst, Asset* src);
   bool8(*serialize)(AssetPtr asset, nlohmann::json& jsonData);
-  bool8(*deserialize)(AssetPtr asset, nlohmann::json& jsonData);  
+  bool8(*deserialize)(AssetPtr asset, DocumentValue value);  
 };
 
 ENGINE_API const char* scriptFunctionTypeLabel(ScriptFunctionType type);
@@ -64,6 +64,14 @@ ENGINE_API void scriptFunctionSetType(Asset* function, ScriptFunctionType type);
 ENGINE_API ScriptFunctionType scriptFunctionGetType(Asset* function);
 
 ENGINE_API void scriptFunctionSetCode(Asset* function, const std::string& code);
+
+/**
+ * Lipschitz bound tells how fast the result of the function can change relatively to its input
+ * (e.g. a twist IDF or a displacement ODF have bounds greater than 1). Renderer divides distances by
+ * bounds combined through the tree, so that rays never step through a surface.
+ */
+ENGINE_API void scriptFunctionSetLipschitzBound(Asset* function, float32 bound);
+ENGINE_API float32 scriptFunctionGetLipschitzBound(Asset* function);
 ENGINE_API bool8 scriptFunctionHasValidCode(Asset* function);
 
 /**
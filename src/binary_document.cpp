@@ -0,0 +1,1068 @@
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <nlohmann/json.hpp>
+
+using std::string;
+using std::vector;
+using std::string_view;
+using std::unordered_map;
+using nlohmann::json;
+
+#include "logging.h"
+#include "memory_manager.h"
+
+#include "binary_document.h"
+
+static const char BINARY_DOCUMENT_MAGIC[4] = {'M', 'B', 'D', 'C'};
+
+// NOTE: Vectors longer than that are stored as usual objects
+static const uint32 BINARY_DOCUMENT_MAX_VECTOR_SIZE = 16;
+
+// NOTE: Keys of float vectors elements, vectors don't store them
+static const char* const BINARY_DOCUMENT_VECTOR_KEYS[BINARY_DOCUMENT_MAX_VECTOR_SIZE] = {
+  "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15"
+};
+
+// NOTE: Deeper documents are rejected by the conversion into json, so corrupted files can't
+// overflow the stack
+static const uint32 BINARY_DOCUMENT_MAX_DEPTH = 256;
+
+enum BinaryDocumentNodeType
+{
+  BINARY_DOCUMENT_NODE_TYPE_NULL,
+  BINARY_DOCUMENT_NODE_TYPE_BOOLEAN,
+  BINARY_DOCUMENT_NODE_TYPE_INTEGER,
+  BINARY_DOCUMENT_NODE_TYPE_UNSIGNED,
+  BINARY_DOCUMENT_NODE_TYPE_FLOAT,
+  BINARY_DOCUMENT_NODE_TYPE_STRING,
+  BINARY_DOCUMENT_NODE_TYPE_ARRAY,
+  BINARY_DOCUMENT_NODE_TYPE_OBJECT,
+  BINARY_DOCUMENT_NODE_TYPE_FLOAT_VECTOR
+};
+
+struct BinaryDocumentHeader
+{
+  char magic[4];
+  uint32 version;
+  uint32 rootNode;
+  uint32 fileSize;
+
+  uint32 stringsCount;
+  uint32 stringsOffset;
+  uint32 stringsDataSize;
+  uint32 stringsDataOffset;
+
+  uint32 nodesCount;
+  uint32 nodesOffset;
+
+  uint32 childrenCount;
+  uint32 childrenOffset;
+
+  uint32 membersCount;
+  uint32 membersOffset;
+
+  uint32 floatsCount;
+  uint32 floatsOffset;
+};
+
+struct BinaryDocumentString
+{
+  uint32 offset;
+  uint32 length;
+};
+
+struct BinaryDocumentNode
+{
+  uint32 type;
+
+  // NOTE: Amount of elements for arrays, objects and vectors
+  uint32 count;
+
+  // NOTE: Either a scalar value (bits of a float are stored for floats), an index of a string or
+  // an index of the first element in the corresponding section
+  uint64 value;
+};
+
+struct BinaryDocument
+{
+  void* mapping;
+  uint64 mappingSize;
+
+  const BinaryDocumentHeader* header;
+  const BinaryDocumentString* strings;
+  const char* stringsData;
+  const BinaryDocumentNode* nodes;
+  const uint32* children;
+  const uint32* members;
+  const float32* floats;
+};
+
+// ----------------------------------------------------------------------------
+// Writing
+// ----------------------------------------------------------------------------
+
+struct BinaryDocumentBuilder
+{
+  vector<BinaryDocumentString> strings;
+  string stringsData;
+  unordered_map<string, uint32> stringsIndices;
+
+  vector<BinaryDocumentNode> nodes;
+  vector<uint32> children;
+  vector<uint32> members;
+  vector<float32> floats;
+};
+
+static uint32 binaryDocumentBuilderAddString(BinaryDocumentBuilder& builder, const string& str)
+{
+  auto stringIt = builder.stringsIndices.find(str);
+  if(stringIt != builder.stringsIndices.end())
+  {
+    return stringIt->second;
+  }
+
+  uint32 index = builder.strings.size();
+  builder.strings.push_back(BinaryDocumentString{(uint32)builder.stringsData.size(), (uint32)str.size()});
+  builder.stringsData += str;
+  builder.stringsIndices[str] = index;
+
+  return index;
+}
+
+/**
+ * @return TRUE if the object was created by vecToJson() from a float vector, elements of the vector
+ * are stored as float32, so they all must be represented by it exactly
+ */
+static bool8 binaryDocumentIsFloatVector(const json& jsonData)
+{
+  uint32 size = jsonData.size();
+  if(size == 0 || size > BINARY_DOCUMENT_MAX_VECTOR_SIZE)
+  {
+    return FALSE;
+  }
+
+  for(uint32 i = 0; i < size; i++)
+  {
+    auto elementIt = jsonData.find(std::to_string(i));
+    if(elementIt == jsonData.end() || elementIt->is_number_float() == FALSE)
+    {
+      return FALSE;
+    }
+
+    float64 value = elementIt->get<float64>();
+    if(float64(float32(value)) != value)
+    {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static uint32 binaryDocumentBuilderAddNode(BinaryDocumentBuilder& builder, const json& jsonData)
+{
+  // NOTE: Children are added recursively, so the node is referred by index, not by reference
+  uint32 nodeIndex = builder.nodes.size();
+  builder.nodes.push_back(BinaryDocumentNode{BINARY_DOCUMENT_NODE_TYPE_NULL, 0, 0});
+
+  BinaryDocumentNode node = {};
+
+  switch(jsonData.type())
+  {
+    case json::value_t::boolean:
+    {
+      node.type = BINARY_DOCUMENT_NODE_TYPE_BOOLEAN;
+      node.value = jsonData.get<bool>() ? 1 : 0;
+    } break;
+    case json::value_t::number_integer:
+    {
+      int64 value = jsonData.get<int64>();
+
+      node.type = BINARY_DOCUMENT_NODE_TYPE_INTEGER;
+      memcpy(&node.value, &value, sizeof(value));
+    } break;
+    case json::value_t::number_unsigned:
+    {
+      node.type = BINARY_DOCUMENT_NODE_TYPE_UNSIGNED;
+      node.value = jsonData.get<uint64>();
+    } break;
+    case json::value_t::number_float:
+    {
+      float64 value = jsonData.get<float64>();
+
+      node.type = BINARY_DOCUMENT_NODE_TYPE_FLOAT;
+      memcpy(&node.value, &value, sizeof(value));
+    } break;
+    case json::value_t::string:
+    {
+      node.type = BINARY_DOCUMENT_NODE_TYPE_STRING;
+      node.value = binaryDocumentBuilderAddString(builder, jsonData.get_ref<const string&>());
+    } break;
+    case json::value_t::array:
+    {
+      uint32 firstChild = builder.children.size();
+      builder.children.resize(firstChild + jsonData.size());
+
+      uint32 childIdx = 0;
+      for(const json& element: jsonData)
+      {
+        uint32 childNode = binaryDocumentBuilderAddNode(builder, element);
+        builder.children[firstChild + childIdx++] = childNode;
+      }
+
+      node.type = BINARY_DOCUMENT_NODE_TYPE_ARRAY;
+      node.count = jsonData.size();
+      node.value = firstChild;
+    } break;
+    case json::value_t::object:
+    {
+      if(binaryDocumentIsFloatVector(jsonData) == TRUE)
+      {
+        node.type = BINARY_DOCUMENT_NODE_TYPE_FLOAT_VECTOR;
+        node.count = jsonData.size();
+        node.value = builder.floats.size();
+
+        for(uint32 i = 0; i < node.count; i++)
+        {
+          builder.floats.push_back(jsonData[std::to_string(i)].get<float32>());
+        }
+
+        break;
+      }
+
+      uint32 firstMember = builder.members.size();
+      builder.members.resize(firstMember + jsonData.size() * 2);
+
+      uint32 memberIdx = 0;
+      for(auto& member: jsonData.items())
+      {
+        uint32 keyString = binaryDocumentBuilderAddString(builder, member.key());
+        uint32 valueNode = binaryDocumentBuilderAddNode(builder, member.value());
+
+        builder.members[firstMember + memberIdx * 2] = keyString;
+        builder.members[firstMember + memberIdx * 2 + 1] = valueNode;
+        memberIdx++;
+      }
+
+      node.type = BINARY_DOCUMENT_NODE_TYPE_OBJECT;
+      node.count = jsonData.size();
+      node.value = firstMember;
+    } break;
+
+    default:
+    {
+      node.type = BINARY_DOCUMENT_NODE_TYPE_NULL;
+    } break;
+  }
+
+  builder.nodes[nodeIndex] = node;
+  return nodeIndex;
+}
+
+static uint32 binaryDocumentAlign(uint32 offset)
+{
+  return (offset + 7) & ~7u;
+}
+
+static void binaryDocumentWriteSection(std::ofstream& file, const void* data, uint32 size)
+{
+  static const char padding[8] = {};
+
+  file.write((const char*)data, size);
+  file.write(padding, binaryDocumentAlign(size) - size);
+}
+
+bool8 writeBinaryDocument(const json& jsonData, const string& fileName)
+{
+  BinaryDocumentBuilder builder;
+  uint32 rootNode = binaryDocumentBuilderAddNode(builder, jsonData);
+
+  BinaryDocumentHeader header = {};
+  memcpy(header.magic, BINARY_DOCUMENT_MAGIC, sizeof(header.magic));
+  header.version = BINARY_DOCUMENT_VERSION;
+  header.rootNode = rootNode;
+
+  uint32 offset = binaryDocumentAlign(sizeof(BinaryDocumentHeader));
+
+  header.stringsCount = builder.strings.size();
+  header.stringsOffset = offset;
+  offset += binaryDocumentAlign(builder.strings.size() * sizeof(BinaryDocumentString));
+
+  header.stringsDataSize = builder.stringsData.size();
+  header.stringsDataOffset = offset;
+  offset += binaryDocumentAlign(builder.stringsData.size());
+
+  header.nodesCount = builder.nodes.size();
+  header.nodesOffset = offset;
+  offset += binaryDocumentAlign(builder.nodes.size() * sizeof(BinaryDocumentNode));
+
+  header.childrenCount = builder.children.size();
+  header.childrenOffset = offset;
+  offset += binaryDocumentAlign(builder.children.size() * sizeof(uint32));
+
+  header.membersCount = builder.members.size();
+  header.membersOffset = offset;
+  offset += binaryDocumentAlign(builder.members.size() * sizeof(uint32));
+
+  header.floatsCount = builder.floats.size();
+  header.floatsOffset = offset;
+  offset += binaryDocumentAlign(builder.floats.size() * sizeof(float32));
+
+  header.fileSize = offset;
+
+  std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+  if(file.is_open() == FALSE)
+  {
+    LOG_ERROR("Cannot open '%s' for writing a binary document!", fileName.c_str());
+    return FALSE;
+  }
+
+  binaryDocumentWriteSection(file, &header, sizeof(header));
+  binaryDocumentWriteSection(file, builder.strings.data(), builder.strings.size() * sizeof(BinaryDocumentString));
+  binaryDocumentWriteSection(file, builder.stringsData.data(), builder.stringsData.size());
+  binaryDocumentWriteSection(file, builder.nodes.data(), builder.nodes.size() * sizeof(BinaryDocumentNode));
+  binaryDocumentWriteSection(file, builder.children.data(), builder.children.size() * sizeof(uint32));
+  binaryDocumentWriteSection(file, builder.members.data(), builder.members.size() * sizeof(uint32));
+  binaryDocumentWriteSection(file, builder.floats.data(), builder.floats.size() * sizeof(float32));
+
+  return file.good() ? TRUE : FALSE;
+}
+
+// ----------------------------------------------------------------------------
+// Reading
+// ----------------------------------------------------------------------------
+
+static bool8 binaryDocumentSectionIsValid(const BinaryDocumentHeader* header,
+                                          uint64 fileSize,
+                                          uint32 offset,
+                                          uint64 size)
+{
+  return (offset % 8) == 0 && offset >= sizeof(BinaryDocumentHeader) && offset + size <= fileSize;
+}
+
+static bool8 binaryDocumentRangeIsValid(uint64 first, uint64 count, uint32 sectionCount)
+{
+  return first <= sectionCount && count <= sectionCount - first;
+}
+
+static bool8 binaryDocumentStringIsValid(const BinaryDocument* document, uint64 index)
+{
+  if(index >= document->header->stringsCount)
+  {
+    return FALSE;
+  }
+
+  const BinaryDocumentString& str = document->strings[index];
+  return binaryDocumentRangeIsValid(str.offset, str.length, document->header->stringsDataSize);
+}
+
+/**
+ * Checks that nodes refer to existing strings, children, members and floats. Children always follow
+ * their parents (see binaryDocumentBuilderAddNode()), so nodes form a tree and walking it terminates.
+ */
+static bool8 binaryDocumentNodesAreValid(const BinaryDocument* document)
+{
+  const BinaryDocumentHeader* header = document->header;
+
+  for(uint32 nodeIdx = 0; nodeIdx < header->nodesCount; nodeIdx++)
+  {
+    const BinaryDocumentNode& node = document->nodes[nodeIdx];
+
+    switch(node.type)
+    {
+      case BINARY_DOCUMENT_NODE_TYPE_NULL:
+      case BINARY_DOCUMENT_NODE_TYPE_BOOLEAN:
+      case BINARY_DOCUMENT_NODE_TYPE_INTEGER:
+      case BINARY_DOCUMENT_NODE_TYPE_UNSIGNED:
+      case BINARY_DOCUMENT_NODE_TYPE_FLOAT: break;
+      case BINARY_DOCUMENT_NODE_TYPE_STRING:
+      {
+        if(binaryDocumentStringIsValid(document, node.value) == FALSE)
+        {
+          return FALSE;
+        }
+      } break;
+      case BINARY_DOCUMENT_NODE_TYPE_ARRAY:
+      {
+        if(binaryDocumentRangeIsValid(node.value, node.count, header->childrenCount) == FALSE)
+        {
+          return FALSE;
+        }
+
+        for(uint32 childIdx = 0; childIdx < node.count; childIdx++)
+        {
+          uint32 childNode = document->children[node.value + childIdx];
+          if(childNode <= nodeIdx || childNode >= header->nodesCount)
+          {
+            return FALSE;
+          }
+        }
+      } break;
+      case BINARY_DOCUMENT_NODE_TYPE_OBJECT:
+      {
+        if(binaryDocumentRangeIsValid(node.value, (uint64)node.count * 2, header->membersCount) == FALSE)
+        {
+          return FALSE;
+        }
+
+        for(uint32 memberIdx = 0; memberIdx < node.count; memberIdx++)
+        {
+          const uint32* member = document->members + node.value + memberIdx * 2;
+          if(binaryDocumentStringIsValid(document, member[0]) == FALSE ||
+             member[1] <= nodeIdx || member[1] >= header->nodesCount)
+          {
+            return FALSE;
+          }
+        }
+      } break;
+      case BINARY_DOCUMENT_NODE_TYPE_FLOAT_VECTOR:
+      {
+        if(node.count > BINARY_DOCUMENT_MAX_VECTOR_SIZE ||
+           binaryDocumentRangeIsValid(node.value, node.count, header->floatsCount) == FALSE)
+        {
+          return FALSE;
+        }
+      } break;
+
+      default: return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static bool8 binaryDocumentHeaderIsValid(const BinaryDocumentHeader* header, uint64 fileSize)
+{
+  if(memcmp(header->magic, BINARY_DOCUMENT_MAGIC, sizeof(header->magic)) != 0)
+  {
+    return FALSE;
+  }
+
+  if(header->version != BINARY_DOCUMENT_VERSION)
+  {
+    LOG_ERROR("Binary document has version %u, but %u is expected!", header->version, BINARY_DOCUMENT_VERSION);
+    return FALSE;
+  }
+
+  return header->fileSize == fileSize &&
+    header->rootNode < header->nodesCount &&
+    binaryDocumentSectionIsValid(header, fileSize, header->stringsOffset,
+                                 (uint64)header->stringsCount * sizeof(BinaryDocumentString)) &&
+    binaryDocumentSectionIsValid(header, fileSize, header->stringsDataOffset, header->stringsDataSize) &&
+    binaryDocumentSectionIsValid(header, fileSize, header->nodesOffset,
+                                 (uint64)header->nodesCount * sizeof(BinaryDocumentNode)) &&
+    binaryDocumentSectionIsValid(header, fileSize, header->childrenOffset,
+                                 (uint64)header->childrenCount * sizeof(uint32)) &&
+    binaryDocumentSectionIsValid(header, fileSize, header->membersOffset,
+                                 (uint64)header->membersCount * sizeof(uint32)) &&
+    binaryDocumentSectionIsValid(header, fileSize, header->floatsOffset,
+                                 (uint64)header->floatsCount * sizeof(float32));
+}
+
+bool8 openBinaryDocument(const string& fileName, BinaryDocument** outDocument)
+{
+  int32 fileDescriptor = open(fileName.c_str(), O_RDONLY);
+  if(fileDescriptor < 0)
+  {
+    return FALSE;
+  }
+
+  struct stat fileStat;
+  if(fstat(fileDescriptor, &fileStat) != 0 || (uint64)fileStat.st_size < sizeof(BinaryDocumentHeader))
+  {
+    close(fileDescriptor);
+    return FALSE;
+  }
+
+  void* mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+  // NOTE: Mapping stays valid after the descriptor is closed
+  close(fileDescriptor);
+
+  if(mapping == MAP_FAILED)
+  {
+    LOG_ERROR("Cannot map a binary document '%s'!", fileName.c_str());
+    return FALSE;
+  }
+
+  const BinaryDocumentHeader* header = (const BinaryDocumentHeader*)mapping;
+  if(binaryDocumentHeaderIsValid(header, fileStat.st_size) == FALSE)
+  {
+    LOG_ERROR("File '%s' is not a valid binary document!", fileName.c_str());
+
+    munmap(mapping, fileStat.st_size);
+    return FALSE;
+  }
+
+  const char* bytes = (const char*)mapping;
+
+  BinaryDocument* document = engineAllocObject<BinaryDocument>(MEMORY_TYPE_GENERAL);
+  document->mapping = mapping;
+  document->mappingSize = fileStat.st_size;
+  document->header = header;
+  document->strings = (const BinaryDocumentString*)(bytes + header->stringsOffset);
+  document->stringsData = bytes + header->stringsDataOffset;
+  document->nodes = (const BinaryDocumentNode*)(bytes + header->nodesOffset);
+  document->children = (const uint32*)(bytes + header->childrenOffset);
+  document->members = (const uint32*)(bytes + header->membersOffset);
+  document->floats = (const float32*)(bytes + header->floatsOffset);
+
+  if(binaryDocumentNodesAreValid(document) == FALSE)
+  {
+    LOG_ERROR("Binary document '%s' is corrupted!", fileName.c_str());
+
+    closeBinaryDocument(document);
+    return FALSE;
+  }
+
+  *outDocument = document;
+
+  return TRUE;
+}
+
+void closeBinaryDocument(BinaryDocument* document)
+{
+  munmap(document->mapping, document->mappingSize);
+  engineFreeObject(document, MEMORY_TYPE_GENERAL);
+}
+
+uint32 binaryDocumentGetStringsCount(BinaryDocument* document)
+{
+  return document->header->stringsCount;
+}
+
+string_view binaryDocumentGetString(BinaryDocument* document, uint32 index)
+{
+  if(binaryDocumentStringIsValid(document, index) == FALSE)
+  {
+    return string_view();
+  }
+
+  const BinaryDocumentString& str = document->strings[index];
+  return string_view(document->stringsData + str.offset, str.length);
+}
+
+// NOTE: Nodes are validated when the document is opened
+static bool8 binaryDocumentNodeToJson(BinaryDocument* document, uint32 nodeIndex, uint32 depth, json& outJsonData)
+{
+  if(depth > BINARY_DOCUMENT_MAX_DEPTH)
+  {
+    return FALSE;
+  }
+
+  const BinaryDocumentNode& node = document->nodes[nodeIndex];
+
+  switch(node.type)
+  {
+    case BINARY_DOCUMENT_NODE_TYPE_NULL:
+    {
+      outJsonData = nullptr;
+    } break;
+    case BINARY_DOCUMENT_NODE_TYPE_BOOLEAN:
+    {
+      outJsonData = node.value != 0;
+    } break;
+    case BINARY_DOCUMENT_NODE_TYPE_INTEGER:
+    {
+      int64 value;
+      memcpy(&value, &node.value, sizeof(value));
+
+      outJsonData = value;
+    } break;
+    case BINARY_DOCUMENT_NODE_TYPE_UNSIGNED:
+    {
+      outJsonData = node.value;
+    } break;
+    case BINARY_DOCUMENT_NODE_TYPE_FLOAT:
+    {
+      float64 value;
+      memcpy(&value, &node.value, sizeof(value));
+
+      outJsonData = value;
+    } break;
+    case BINARY_DOCUMENT_NODE_TYPE_STRING:
+    {
+      outJsonData = string(binaryDocumentGetString(document, node.value));
+    } break;
+    case BINARY_DOCUMENT_NODE_TYPE_ARRAY:
+    {
+      outJsonData = json::array();
+      json::array_t& elements = outJsonData.get_ref<json::array_t&>();
+      elements.resize(node.count);
+
+      for(uint32 childIdx = 0; childIdx < node.count; childIdx++)
+      {
+        if(binaryDocumentNodeToJson(document, document->children[node.value + childIdx], depth + 1, elements[childIdx]) == FALSE)
+        {
+          return FALSE;
+        }
+      }
+    } break;
+    case BINARY_DOCUMENT_NODE_TYPE_OBJECT:
+    {
+      outJsonData = json::object();
+
+      for(uint32 memberIdx = 0; memberIdx < node.count; memberIdx++)
+      {
+        const uint32* member = document->members + node.value + memberIdx * 2;
+
+        json& value = outJsonData[string(binaryDocumentGetString(document, member[0]))];
+        if(binaryDocumentNodeToJson(document, member[1], depth + 1, value) == FALSE)
+        {
+          return FALSE;
+        }
+      }
+    } break;
+    case BINARY_DOCUMENT_NODE_TYPE_FLOAT_VECTOR:
+    {
+      outJsonData = json::object();
+
+      for(uint32 i = 0; i < node.count; i++)
+      {
+        outJsonData[std::to_string(i)] = document->floats[node.value + i];
+      }
+    } break;
+
+    default: return FALSE;
+  }
+
+  return TRUE;
+}
+
+bool8 binaryDocumentToJson(BinaryDocument* document, json& outJsonData)
+{
+  return binaryDocumentNodeToJson(document, document->header->rootNode, 0, outJsonData);
+}
+
+// ----------------------------------------------------------------------------
+// Documents
+// ----------------------------------------------------------------------------
+
+struct Document
+{
+  json jsonData;
+  BinaryDocument* binaryDocument = nullptr;
+};
+
+bool8 openDocument(const string& fileName, Document** outDocument)
+{
+  BinaryDocument* binaryDocument = nullptr;
+  json jsonData;
+
+  if(isBinaryDocument(fileName) == TRUE)
+  {
+    if(openBinaryDocument(fileName, &binaryDocument) == FALSE)
+    {
+      return FALSE;
+    }
+  }
+  else
+  {
+    std::ifstream file(fileName);
+    if(file.is_open() == FALSE)
+    {
+      return FALSE;
+    }
+
+    file >> jsonData;
+  }
+
+  *outDocument = engineAllocObject<Document>(MEMORY_TYPE_GENERAL);
+  (*outDocument)->jsonData = std::move(jsonData);
+  (*outDocument)->binaryDocument = binaryDocument;
+
+  return TRUE;
+}
+
+void closeDocument(Document* document)
+{
+  if(document->binaryDocument != nullptr)
+  {
+    closeBinaryDocument(document->binaryDocument);
+  }
+
+  engineFreeObject(document, MEMORY_TYPE_GENERAL);
+}
+
+DocumentValue documentGetRoot(Document* document)
+{
+  if(document->binaryDocument != nullptr)
+  {
+    DocumentValue value;
+    value.binaryDocument = document->binaryDocument;
+    value.node = document->binaryDocument->header->rootNode;
+
+    return value;
+  }
+
+  return documentValueFromJson(document->jsonData);
+}
+
+DocumentValue documentValueFromJson(const json& jsonData)
+{
+  DocumentValue value;
+  value.jsonValue = &jsonData;
+
+  return value;
+}
+
+/** @return node of a binary document value, nullptr for json values and elements of vectors */
+static const BinaryDocumentNode* documentValueGetNode(DocumentValue value)
+{
+  if(value.binaryDocument == nullptr || value.vectorElement >= 0)
+  {
+    return nullptr;
+  }
+
+  return &value.binaryDocument->nodes[value.node];
+}
+
+static DocumentValue documentValueFromNode(BinaryDocument* document, uint32 node)
+{
+  DocumentValue value;
+  value.binaryDocument = document;
+  value.node = node;
+
+  return value;
+}
+
+bool8 documentValueIsValid(DocumentValue value)
+{
+  return value.jsonValue != nullptr || value.binaryDocument != nullptr ? TRUE : FALSE;
+}
+
+bool8 documentValueIsNumber(DocumentValue value)
+{
+  if(value.jsonValue != nullptr)
+  {
+    return value.jsonValue->is_number() ? TRUE : FALSE;
+  }
+
+  if(value.binaryDocument != nullptr && value.vectorElement >= 0)
+  {
+    return TRUE;
+  }
+
+  const BinaryDocumentNode* node = documentValueGetNode(value);
+  return node != nullptr && (node->type == BINARY_DOCUMENT_NODE_TYPE_INTEGER ||
+                             node->type == BINARY_DOCUMENT_NODE_TYPE_UNSIGNED ||
+                             node->type == BINARY_DOCUMENT_NODE_TYPE_FLOAT) ? TRUE : FALSE;
+}
+
+bool8 documentValueIsObject(DocumentValue value)
+{
+  if(value.jsonValue != nullptr)
+  {
+    return value.jsonValue->is_object() ? TRUE : FALSE;
+  }
+
+  const BinaryDocumentNode* node = documentValueGetNode(value);
+  return node != nullptr && (node->type == BINARY_DOCUMENT_NODE_TYPE_OBJECT ||
+                             node->type == BINARY_DOCUMENT_NODE_TYPE_FLOAT_VECTOR) ? TRUE : FALSE;
+}
+
+uint32 documentValueGetSize(DocumentValue value)
+{
+  if(value.jsonValue != nullptr)
+  {
+    return value.jsonValue->is_array() || value.jsonValue->is_object() ? value.jsonValue->size() : 0;
+  }
+
+  const BinaryDocumentNode* node = documentValueGetNode(value);
+  if(node != nullptr && (node->type == BINARY_DOCUMENT_NODE_TYPE_ARRAY ||
+                         node->type == BINARY_DOCUMENT_NODE_TYPE_OBJECT ||
+                         node->type == BINARY_DOCUMENT_NODE_TYPE_FLOAT_VECTOR))
+  {
+    return node->count;
+  }
+
+  return 0;
+}
+
+DocumentValue documentValueGetElement(DocumentValue value, uint32 index)
+{
+  if(value.jsonValue != nullptr)
+  {
+    if(value.jsonValue->is_array() && index < value.jsonValue->size())
+    {
+      return documentValueFromJson((*value.jsonValue)[index]);
+    }
+
+    return DocumentValue();
+  }
+
+  const BinaryDocumentNode* node = documentValueGetNode(value);
+  if(node != nullptr && node->type == BINARY_DOCUMENT_NODE_TYPE_ARRAY && index < node->count)
+  {
+    return documentValueFromNode(value.binaryDocument, value.binaryDocument->children[node->value + index]);
+  }
+
+  return DocumentValue();
+}
+
+string_view documentValueGetMemberKey(DocumentValue value, uint32 index)
+{
+  if(value.jsonValue != nullptr)
+  {
+    if(value.jsonValue->is_object() && index < value.jsonValue->size())
+    {
+      return std::next(value.jsonValue->begin(), index).key();
+    }
+
+    return string_view();
+  }
+
+  const BinaryDocumentNode* node = documentValueGetNode(value);
+  if(node == nullptr || index >= node->count)
+  {
+    return string_view();
+  }
+
+  if(node->type == BINARY_DOCUMENT_NODE_TYPE_OBJECT)
+  {
+    return binaryDocumentGetString(value.binaryDocument, value.binaryDocument->members[node->value + index * 2]);
+  }
+  else if(node->type == BINARY_DOCUMENT_NODE_TYPE_FLOAT_VECTOR)
+  {
+    return BINARY_DOCUMENT_VECTOR_KEYS[index];
+  }
+
+  return string_view();
+}
+
+DocumentValue documentValueGetMemberValue(DocumentValue value, uint32 index)
+{
+  if(value.jsonValue != nullptr)
+  {
+    if(value.jsonValue->is_object() && index < value.jsonValue->size())
+    {
+      return documentValueFromJson(std::next(value.jsonValue->begin(), index).value());
+    }
+
+    return DocumentValue();
+  }
+
+  const BinaryDocumentNode* node = documentValueGetNode(value);
+  if(node == nullptr || index >= node->count)
+  {
+    return DocumentValue();
+  }
+
+  if(node->type == BINARY_DOCUMENT_NODE_TYPE_OBJECT)
+  {
+    return documentValueFromNode(value.binaryDocument, value.binaryDocument->members[node->value + index * 2 + 1]);
+  }
+  else if(node->type == BINARY_DOCUMENT_NODE_TYPE_FLOAT_VECTOR)
+  {
+    DocumentValue element = value;
+    element.vectorElement = index;
+
+    return element;
+  }
+
+  return DocumentValue();
+}
+
+DocumentValue documentValueFind(DocumentValue value, string_view key)
+{
+  if(value.jsonValue != nullptr)
+  {
+    if(value.jsonValue->is_object())
+    {
+      auto memberIt = value.jsonValue->find(string(key));
+      if(memberIt != value.jsonValue->end())
+      {
+        return documentValueFromJson(*memberIt);
+      }
+    }
+
+    return DocumentValue();
+  }
+
+  const BinaryDocumentNode* node = documentValueGetNode(value);
+  if(node == nullptr)
+  {
+    return DocumentValue();
+  }
+
+  if(node->type == BINARY_DOCUMENT_NODE_TYPE_OBJECT)
+  {
+    // NOTE: Objects have only a few members, so they are searched linearly
+    for(uint32 memberIdx = 0; memberIdx < node->count; memberIdx++)
+    {
+      if(documentValueGetMemberKey(value, memberIdx) == key)
+      {
+        return documentValueGetMemberValue(value, memberIdx);
+      }
+    }
+  }
+  else if(node->type == BINARY_DOCUMENT_NODE_TYPE_FLOAT_VECTOR)
+  {
+    for(uint32 i = 0; i < node->count; i++)
+    {
+      if(key == BINARY_DOCUMENT_VECTOR_KEYS[i])
+      {
+        return documentValueGetMemberValue(value, i);
+      }
+    }
+  }
+
+  return DocumentValue();
+}
+
+bool8 documentValueContains(DocumentValue value, string_view key)
+{
+  return documentValueIsValid(documentValueFind(value, key));
+}
+
+string_view documentValueGetString(DocumentValue value, string_view defaultValue)
+{
+  if(value.jsonValue != nullptr)
+  {
+    return value.jsonValue->is_string() ? string_view(value.jsonValue->get_ref<const string&>()) : defaultValue;
+  }
+
+  const BinaryDocumentNode* node = documentValueGetNode(value);
+  if(node != nullptr && node->type == BINARY_DOCUMENT_NODE_TYPE_STRING)
+  {
+    return binaryDocumentGetString(value.binaryDocument, node->value);
+  }
+
+  return defaultValue;
+}
+
+float64 documentValueGetFloat(DocumentValue value, float64 defaultValue)
+{
+  if(value.jsonValue != nullptr)
+  {
+    return value.jsonValue->is_number() ? value.jsonValue->get<float64>() : defaultValue;
+  }
+
+  if(value.binaryDocument != nullptr && value.vectorElement >= 0)
+  {
+    const BinaryDocumentNode& node = value.binaryDocument->nodes[value.node];
+    return value.binaryDocument->floats[node.value + value.vectorElement];
+  }
+
+  const BinaryDocumentNode* node = documentValueGetNode(value);
+  if(node == nullptr)
+  {
+    return defaultValue;
+  }
+
+  switch(node->type)
+  {
+    case BINARY_DOCUMENT_NODE_TYPE_INTEGER: return float64(int64(node->value));
+    case BINARY_DOCUMENT_NODE_TYPE_UNSIGNED: return float64(node->value);
+    case BINARY_DOCUMENT_NODE_TYPE_FLOAT:
+    {
+      float64 result;
+      memcpy(&result, &node->value, sizeof(result));
+
+      return result;
+    }
+  }
+
+  return defaultValue;
+}
+
+int64 documentValueGetInteger(DocumentValue value, int64 defaultValue)
+{
+  if(value.jsonValue != nullptr)
+  {
+    if(value.jsonValue->is_boolean())
+    {
+      return value.jsonValue->get<bool>() ? 1 : 0;
+    }
+
+    return value.jsonValue->is_number() ? value.jsonValue->get<int64>() : defaultValue;
+  }
+
+  const BinaryDocumentNode* node = documentValueGetNode(value);
+  if(node != nullptr && (node->type == BINARY_DOCUMENT_NODE_TYPE_BOOLEAN ||
+                         node->type == BINARY_DOCUMENT_NODE_TYPE_INTEGER ||
+                         node->type == BINARY_DOCUMENT_NODE_TYPE_UNSIGNED))
+  {
+    return int64(node->value);
+  }
+
+  return documentValueIsNumber(value) == TRUE ? int64(documentValueGetFloat(value, 0.0)) : defaultValue;
+}
+
+// ----------------------------------------------------------------------------
+// Common
+// ----------------------------------------------------------------------------
+
+bool8 isBinaryDocument(const string& fileName)
+{
+  std::ifstream file(fileName, std::ios::in | std::ios::binary);
+
+  char magic[sizeof(BINARY_DOCUMENT_MAGIC)] = {};
+  if(file.read(magic, sizeof(magic)).good() == FALSE)
+  {
+    return FALSE;
+  }
+
+  return memcmp(magic, BINARY_DOCUMENT_MAGIC, sizeof(magic)) == 0 ? TRUE : FALSE;
+}
+
+bool8 loadJsonDocument(const string& fileName, json& outJsonData)
+{
+  if(isBinaryDocument(fileName) == TRUE)
+  {
+    BinaryDocument* document = nullptr;
+    if(openBinaryDocument(fileName, &document) == FALSE)
+    {
+      return FALSE;
+    }
+
+    bool8 converted = binaryDocumentToJson(document, outJsonData);
+    closeBinaryDocument(document);
+
+    if(converted == FALSE)
+    {
+      LOG_ERROR("Binary document '%s' is corrupted!", fileName.c_str());
+    }
+
+    return converted;
+  }
+
+  std::ifstream file(fileName);
+  if(file.is_open() == FALSE)
+  {
+    return FALSE;
+  }
+
+  file >> outJsonData;
+
+  return TRUE;
+}
+
+bool8 convertDocument(const string& srcFileName, const string& dstFileName)
+{
+  json jsonData;
+  if(loadJsonDocument(srcFileName, jsonData) == FALSE)
+  {
+    LOG_ERROR("Cannot load a document '%s'!", srcFileName.c_str());
+    return FALSE;
+  }
+
+  if(isBinaryDocument(srcFileName) == TRUE)
+  {
+    std::ofstream file(dstFileName);
+    file << jsonData.dump(2);
+
+    return file.good() ? TRUE : FALSE;
+  }
+
+  return writeBinaryDocument(jsonData, dstFileName);
+}
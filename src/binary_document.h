@@ -0,0 +1,116 @@
+/**
+ * Binary document is a compact representation of a json document, which is used to store scenes
+ * and assets databases. It's loaded through mmap, so reading it doesn't require any parsing.
+ *
+ * Layout (all sections are 8 bytes aligned):
+ *   header   - magic, version, offsets and sizes of the sections
+ *   strings  - table of (offset, length) pairs, followed by the characters of all strings. Strings
+ *              (keys, names, script functions code) are deduplicated and not null-terminated.
+ *   nodes    - flat array of nodes, each node is either a scalar or refers to a range of children,
+ *              members or floats
+ *   children - node indices of arrays elements
+ *   members  - (key string index, node index) pairs of objects
+ *   floats   - flat array of vectors, e.g transforms and AABBs which are stored in json as
+ *              {"0": x, "1": y, ...} objects
+ *
+ * @note Deserializers of assets read documents through DocumentValue, so values of a binary document
+ * are read directly from the mapped file, without building a json tree. Text documents are parsed
+ * into json and read through the same interface.
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <nlohmann/json.hpp>
+
+#include "defines.h"
+
+static const uint32 BINARY_DOCUMENT_VERSION = 1;
+
+struct BinaryDocument;
+
+ENGINE_API bool8 openBinaryDocument(const std::string& fileName, BinaryDocument** outDocument);
+ENGINE_API void closeBinaryDocument(BinaryDocument* document);
+
+ENGINE_API uint32 binaryDocumentGetStringsCount(BinaryDocument* document);
+ENGINE_API std::string_view binaryDocumentGetString(BinaryDocument* document, uint32 index);
+ENGINE_API bool8 binaryDocumentToJson(BinaryDocument* document, nlohmann::json& outJsonData);
+
+ENGINE_API bool8 writeBinaryDocument(const nlohmann::json& jsonData, const std::string& fileName);
+
+/**
+ * Loaded document, either a mapped binary document or a parsed text json, depending on the content
+ * of the file. Values are valid until the document is closed.
+ */
+struct Document;
+
+/**
+ * View of a value of a document (or of a json), missing values are invalid and read as defaults.
+ * It's passed by value and isn't supposed to be modified directly.
+ */
+struct DocumentValue
+{
+  const nlohmann::json* jsonValue = nullptr;
+  BinaryDocument* binaryDocument = nullptr;
+  uint32 node = 0;
+
+  // NOTE: Index of an element of a float vector node, which isn't a node by itself
+  int32 vectorElement = -1;
+};
+
+ENGINE_API bool8 openDocument(const std::string& fileName, Document** outDocument);
+ENGINE_API void closeDocument(Document* document);
+ENGINE_API DocumentValue documentGetRoot(Document* document);
+
+ENGINE_API DocumentValue documentValueFromJson(const nlohmann::json& jsonData);
+
+ENGINE_API bool8 documentValueIsValid(DocumentValue value);
+ENGINE_API bool8 documentValueIsNumber(DocumentValue value);
+ENGINE_API bool8 documentValueIsObject(DocumentValue value);
+
+/** @return amount of elements of an array or of members of an object, 0 for other values */
+ENGINE_API uint32 documentValueGetSize(DocumentValue value);
+ENGINE_API DocumentValue documentValueGetElement(DocumentValue value, uint32 index);
+ENGINE_API std::string_view documentValueGetMemberKey(DocumentValue value, uint32 index);
+ENGINE_API DocumentValue documentValueGetMemberValue(DocumentValue value, uint32 index);
+ENGINE_API DocumentValue documentValueFind(DocumentValue value, std::string_view key);
+ENGINE_API bool8 documentValueContains(DocumentValue value, std::string_view key);
+
+ENGINE_API std::string_view documentValueGetString(DocumentValue value, std::string_view defaultValue = {});
+ENGINE_API float64 documentValueGetFloat(DocumentValue value, float64 defaultValue);
+ENGINE_API int64 documentValueGetInteger(DocumentValue value, int64 defaultValue);
+
+/** Reads a number, a boolean or an enum, defaultValue is returned if the value has another type */
+template <typename T>
+T documentValueGet(DocumentValue value, T defaultValue)
+{
+  if constexpr(std::is_floating_point<T>::value)
+  {
+    return T(documentValueGetFloat(value, defaultValue));
+  }
+  else
+  {
+    return T(documentValueGetInteger(value, int64(defaultValue)));
+  }
+}
+
+template <typename T>
+T documentValueGet(DocumentValue value, std::string_view key, T defaultValue)
+{
+  return documentValueGet(documentValueFind(value, key), defaultValue);
+}
+
+/** @return TRUE if file starts with a header of a binary document */
+ENGINE_API bool8 isBinaryDocument(const std::string& fileName);
+
+/** Loads either a binary document or a text json, depending on the content of the file */
+ENGINE_API bool8 loadJsonDocument(const std::string& fileName, nlohmann::json& outJsonData);
+
+/**
+ * Converts a text json into a binary document and vice versa, format of the source is detected
+ * from its content.
+ */
+ENGINE_API bool8 convertDocument(const std::string& srcFileName, const std::string& dstFileName);
@@ -1,133 +1,218 @@
+#include <deque>
+#include <string>
+#include <vector>
 #include <algorithm>
 #include <unordered_map>
 
+using std::deque;
 using std::string;
 using std::vector;
 using std::transform;
 using std::unordered_map;
 
+#include "logging.h"
+
 #include "cvar_system.h"
 
-template <typename T>
-struct CVar
+struct CVarListener
 {
-  T value;
-  CVarFlags flags;
+  void* listener;
+  fpCVarChangedCallback callback;
 };
 
 struct CVarMeta
 {
+  string name;
   CVarType type;
   CVarFlags flags;
+
+  // NOTE: Index of the variable in the storage of the corresponding type
+  uint32 index;
+
+  vector<CVarListener> listeners;
 };
 
-using CVarInt = CVar<int32>;
-using CVarUint = CVar<uint32>;
-using CVarFloat = CVar<float32>;
-using CVarBool = CVar<bool8>;
+// NOTE: Values are stored in a deque, because it never relocates already pushed elements, hence
+// handles and references (which are given to the user) are never invalidated.
+template <typename T>
+struct CVarStorage
+{
+  deque<T> values;
+  vector<uint32> metaIndices;
+};
 
 struct CVarSystemData
 {
-  unordered_map<string, CVarInt> intCVars;
-  unordered_map<string, CVarUint> uintCVars;
-  unordered_map<string, CVarFloat> floatCVars;
-  unordered_map<string, CVarBool> boolCVars;
-  unordered_map<string, CVarMeta> cvarsMeta;
+  CVarStorage<int32> intCVars;
+  CVarStorage<uint32> uintCVars;
+  CVarStorage<float32> floatCVars;
+  CVarStorage<bool8> boolCVars;
+
+  deque<CVarMeta> cvarsMeta;
+  unordered_map<string, uint32> cvarsMetaIndices;
 };
 
-static CVarSystemData data;
+// NOTE: Cvars are registered by static initializers of other translation units, so the data is
+// constructed on the first use instead of relying on the order of static initialization.
+static CVarSystemData& CVarSystemGetData()
+{
+  static CVarSystemData data;
+  return data;
+}
 
-bool8 CVarSystemRegisterIntVar(const string& name, int32 initValue, CVarFlags flags)
+static CVarMeta* CVarSystemFindMeta(const string& name)
 {
-  if(CVarSystemHasVar(name) == TRUE)
+  CVarSystemData& data = CVarSystemGetData();
+
+  auto metaIt = data.cvarsMetaIndices.find(name);
+  if(metaIt == data.cvarsMetaIndices.end())
   {
-    return FALSE;
+    return nullptr;
   }
 
-  data.cvarsMeta[name] = CVarMeta{ CVAR_TYPE_INT, flags};
-  data.intCVars[name] = CVarInt { initValue, flags };
-  
-  return TRUE;
+  return &data.cvarsMeta[metaIt->second];
 }
 
-bool8 CVarSystemRegisterUintVar(const string& name, uint32 initValue, CVarFlags flags)
+template <typename T>
+static bool8 CVarSystemRegisterVarInStorage(CVarStorage<T>& storage,
+                                            CVarType type,
+                                            const string& name,
+                                            T initValue,
+                                            CVarFlags flags,
+                                            CVarHandle<T>* outHandle)
 {
+  CVarSystemData& data = CVarSystemGetData();
+
   if(CVarSystemHasVar(name) == TRUE)
   {
     return FALSE;
   }
 
-  data.cvarsMeta[name] = CVarMeta{ CVAR_TYPE_UINT, flags};  
-  data.uintCVars[name] = CVarUint { initValue, flags };
-  
+  uint32 metaIndex = data.cvarsMeta.size();
+  uint32 index = storage.values.size();
+
+  data.cvarsMeta.push_back(CVarMeta{name, type, flags, index});
+  data.cvarsMetaIndices[name] = metaIndex;
+
+  storage.values.push_back(initValue);
+  storage.metaIndices.push_back(metaIndex);
+
+  if(outHandle != nullptr)
+  {
+    outHandle->index = index;
+  }
+
   return TRUE;
 }
 
-bool8 CVarSystemRegisterFloatVar(const string& name, float32 initValue, CVarFlags flags)
+template <typename T>
+static CVarHandle<T> CVarSystemGetHandleFromStorage(CVarType type, const string& name)
 {
-  if(CVarSystemHasVar(name) == TRUE)
+  CVarHandle<T> handle;
+
+  CVarMeta* meta = CVarSystemFindMeta(name);
+  if(meta != nullptr && meta->type == type)
   {
-    return FALSE;
+    handle.index = meta->index;
   }
 
-  data.cvarsMeta[name] = CVarMeta{ CVAR_TYPE_FLOAT, flags};    
-  data.floatCVars[name] = CVarFloat { initValue, flags };
-  
-  return TRUE;
+  return handle;
 }
 
-bool8 CVarSystemRegisterBoolVar(const string& name, bool8 initValue, CVarFlags flags)
+static void CVarSystemNotifyListeners(CVarMeta& meta)
 {
-  if(CVarSystemHasVar(name) == TRUE)
+  // NOTE: Copy listeners, so that callback is able to unsubscribe itself
+  vector<CVarListener> listeners = meta.listeners;
+  for(CVarListener& listener: listeners)
   {
-    return FALSE;
+    listener.callback(meta.name, listener.listener);
   }
+}
 
-  data.cvarsMeta[name] = CVarMeta{ CVAR_TYPE_BOOL, flags};      
-  data.boolCVars[name] = CVarBool { initValue, flags };
-  
-  return TRUE;
+template <typename T>
+static void CVarSystemSetValueInStorage(CVarStorage<T>& storage, CVarHandle<T> handle, T value)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  assert(handle.isValid() == TRUE && handle.index < storage.values.size() && "Invalid cvar handle!");
+
+  T& storedValue = storage.values[handle.index];
+  if(storedValue == value)
+  {
+    return;
+  }
+
+  storedValue = value;
+  CVarSystemNotifyListeners(data.cvarsMeta[storage.metaIndices[handle.index]]);
+}
+
+bool8 CVarSystemRegisterIntVar(const string& name, int32 initValue, CVarFlags flags, CVarIntHandle* outHandle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  return CVarSystemRegisterVarInStorage(data.intCVars, CVAR_TYPE_INT, name, initValue, flags, outHandle);
+}
+
+bool8 CVarSystemRegisterUintVar(const string& name, uint32 initValue, CVarFlags flags, CVarUintHandle* outHandle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  return CVarSystemRegisterVarInStorage(data.uintCVars, CVAR_TYPE_UINT, name, initValue, flags, outHandle);
+}
+
+bool8 CVarSystemRegisterFloatVar(const string& name, float32 initValue, CVarFlags flags, CVarFloatHandle* outHandle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  return CVarSystemRegisterVarInStorage(data.floatCVars, CVAR_TYPE_FLOAT, name, initValue, flags, outHandle);
+}
+
+bool8 CVarSystemRegisterBoolVar(const string& name, bool8 initValue, CVarFlags flags, CVarBoolHandle* outHandle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  return CVarSystemRegisterVarInStorage(data.boolCVars, CVAR_TYPE_BOOL, name, initValue, flags, outHandle);
 }
 
 string CVarSystemReadStr(const std::string& name)
 {
+  CVarSystemData& data = CVarSystemGetData();
+
   char result[256] = {};
-  
-  auto metaInfo = data.cvarsMeta.find(name);
-  
-  if(metaInfo == data.cvarsMeta.end())
+
+  CVarMeta* meta = CVarSystemFindMeta(name);
+  if(meta == nullptr)
   {
     return result;
   }
 
-  switch(metaInfo->second.type)
+  switch(meta->type)
   {
-    case CVAR_TYPE_INT: sprintf(result, "%d", CVarSystemReadInt(name)); break;
-    case CVAR_TYPE_UINT: sprintf(result, "%u", CVarSystemReadUint(name)); break;
-    case CVAR_TYPE_FLOAT: sprintf(result, "%f", CVarSystemReadFloat(name)); break;
-    case CVAR_TYPE_BOOL: sprintf(result, "%s", CVarSystemReadBool(name) == TRUE ? "true" : "false"); break;
+    case CVAR_TYPE_INT: sprintf(result, "%d", data.intCVars.values[meta->index]); break;
+    case CVAR_TYPE_UINT: sprintf(result, "%u", data.uintCVars.values[meta->index]); break;
+    case CVAR_TYPE_FLOAT: sprintf(result, "%f", data.floatCVars.values[meta->index]); break;
+    case CVAR_TYPE_BOOL: sprintf(result, "%s", data.boolCVars.values[meta->index] == TRUE ? "true" : "false"); break;
 
     default: assert(false);
   }
-  
+
   return result;
 }
 
 CVarParseCode CVarSystemParseStr(const std::string& name, const std::string& val)
 {
-  auto metaInfo = data.cvarsMeta.find(name);
-  
-  if(metaInfo == data.cvarsMeta.end())
+  CVarMeta* meta = CVarSystemFindMeta(name);
+  if(meta == nullptr)
   {
     return CVAR_PARSE_CODE_VAR_NOT_FOUND;
   }
 
-  if((metaInfo->second.flags & CVAR_FLAG_READ_ONLY) == CVAR_FLAG_READ_ONLY)
+  if((meta->flags & CVAR_FLAG_READ_ONLY) == CVAR_FLAG_READ_ONLY)
   {
     return CVAR_PARSE_CODE_VAR_READ_ONLY;
   }
 
-  switch(metaInfo->second.type)
+  switch(meta->type)
   {
     case CVAR_TYPE_INT:
     {
@@ -137,7 +222,7 @@ CVarParseCode CVarSystemParseStr(const std::string& name, const std::string& val
         return CVAR_PARSE_CODE_CANNOT_PARSE;
       }
 
-      CVarSystemGetInt(name) = ival;
+      CVarSystemSet(CVarIntHandle{meta->index}, ival);
       return CVAR_PARSE_CODE_SUCCESS;
     }
     case CVAR_TYPE_UINT:
@@ -148,7 +233,7 @@ CVarParseCode CVarSystemParseStr(const std::string& name, const std::string& val
         return CVAR_PARSE_CODE_CANNOT_PARSE;
       }
 
-      CVarSystemGetUint(name) = uval;
+      CVarSystemSet(CVarUintHandle{meta->index}, uval);
       return CVAR_PARSE_CODE_SUCCESS;
     }
     case CVAR_TYPE_FLOAT:
@@ -159,7 +244,7 @@ CVarParseCode CVarSystemParseStr(const std::string& name, const std::string& val
         return CVAR_PARSE_CODE_CANNOT_PARSE;
       }
 
-      CVarSystemGetFloat(name) = fval;
+      CVarSystemSet(CVarFloatHandle{meta->index}, fval);
       return CVAR_PARSE_CODE_SUCCESS;
     }
     case CVAR_TYPE_BOOL:
@@ -177,16 +262,16 @@ CVarParseCode CVarSystemParseStr(const std::string& name, const std::string& val
         else if(sval == "false")
         {
           ival = 0;
-        }        
+        }
         else
         {
-          return CVAR_PARSE_CODE_CANNOT_PARSE;          
+          return CVAR_PARSE_CODE_CANNOT_PARSE;
         }
       }
 
       bool8 bval = ival > 0 ? TRUE : FALSE;
-      
-      CVarSystemGetBool(name) = bval;
+
+      CVarSystemSet(CVarBoolHandle{meta->index}, bval);
       return CVAR_PARSE_CODE_SUCCESS;
     }
 
@@ -196,64 +281,59 @@ CVarParseCode CVarSystemParseStr(const std::string& name, const std::string& val
   return CVAR_PARSE_CODE_OTHER;
 }
 
-#define ASSERT_VAR_EXISTS(name) \
-  assert(CVarSystemHasVar(name) == TRUE && "Requested variable doesn't exist!")
+#define ASSERT_HANDLE_IS_VALID(handle) \
+  assert((handle).isValid() == TRUE && "Requested variable doesn't exist or has another type!")
 
 const int32& CVarSystemReadInt(const string& name)
 {
-  ASSERT_VAR_EXISTS(name);
-  return data.intCVars[name].value;
+  return CVarSystemRead(CVarSystemGetIntHandle(name));
 }
 
 int32& CVarSystemGetInt(const string& name)
 {
-  ASSERT_VAR_EXISTS(name);
-  return data.intCVars[name].value;
+  return CVarSystemGet(CVarSystemGetIntHandle(name));
 }
 
 const uint32& CVarSystemReadUint(const string& name)
 {
-  ASSERT_VAR_EXISTS(name);
-  return data.uintCVars[name].value;
+  return CVarSystemRead(CVarSystemGetUintHandle(name));
 }
 
 uint32& CVarSystemGetUint(const string& name)
 {
-  ASSERT_VAR_EXISTS(name);
-  return data.uintCVars[name].value;
+  return CVarSystemGet(CVarSystemGetUintHandle(name));
 }
 
 const float32& CVarSystemReadFloat(const string& name)
 {
-  ASSERT_VAR_EXISTS(name);
-  return data.floatCVars[name].value;
+  return CVarSystemRead(CVarSystemGetFloatHandle(name));
 }
 
 float32& CVarSystemGetFloat(const string& name)
 {
-  ASSERT_VAR_EXISTS(name);
-  return data.floatCVars[name].value;
+  return CVarSystemGet(CVarSystemGetFloatHandle(name));
 }
 
 const bool8& CVarSystemReadBool(const string& name)
 {
-  ASSERT_VAR_EXISTS(name);
-  return data.boolCVars[name].value;
+  return CVarSystemRead(CVarSystemGetBoolHandle(name));
 }
 
 bool8& CVarSystemGetBool(const string& name)
 {
-  ASSERT_VAR_EXISTS(name);
-  return data.boolCVars[name].value;
+  return CVarSystemGet(CVarSystemGetBoolHandle(name));
 }
 
 vector<string> CVarSystemGetRegisteredVars()
 {
+  CVarSystemData& data = CVarSystemGetData();
+
   vector<string> names;
+  names.reserve(data.cvarsMeta.size());
 
-  for(auto cvarMeta: data.cvarsMeta)
+  for(const CVarMeta& cvarMeta: data.cvarsMeta)
   {
-    names.push_back(cvarMeta.first);
+    names.push_back(cvarMeta.name);
   }
 
   return names;
@@ -261,26 +341,234 @@ vector<string> CVarSystemGetRegisteredVars()
 
 CVarType CVarSystemGetVarType(const string& name)
 {
-  if(CVarSystemHasVar(name) == FALSE)
+  CVarMeta* meta = CVarSystemFindMeta(name);
+  if(meta == nullptr)
   {
     return CVAR_TYPE_UNKNOWN;
   }
 
-  return data.cvarsMeta[name].type;
+  return meta->type;
 }
 
 CVarFlags CVarSystemGetVarFlags(const std::string& name)
 {
-  if(CVarSystemHasVar(name) == FALSE)
+  CVarMeta* meta = CVarSystemFindMeta(name);
+  if(meta == nullptr)
   {
     return CVAR_FLAG_NONE;
   }
 
-  return data.cvarsMeta[name].flags;
+  return meta->flags;
 }
 
 bool8 CVarSystemHasVar(const string& name)
 {
-  return data.cvarsMeta.find(name) != data.cvarsMeta.end();
+  CVarSystemData& data = CVarSystemGetData();
+
+  return data.cvarsMetaIndices.find(name) != data.cvarsMetaIndices.end();
 }
 
+// ----------------------------------------------------------------------------
+// Handle-based access
+// ----------------------------------------------------------------------------
+
+CVarIntHandle CVarSystemGetIntHandle(const string& name)
+{
+  return CVarSystemGetHandleFromStorage<int32>(CVAR_TYPE_INT, name);
+}
+
+CVarUintHandle CVarSystemGetUintHandle(const string& name)
+{
+  return CVarSystemGetHandleFromStorage<uint32>(CVAR_TYPE_UINT, name);
+}
+
+CVarFloatHandle CVarSystemGetFloatHandle(const string& name)
+{
+  return CVarSystemGetHandleFromStorage<float32>(CVAR_TYPE_FLOAT, name);
+}
+
+CVarBoolHandle CVarSystemGetBoolHandle(const string& name)
+{
+  return CVarSystemGetHandleFromStorage<bool8>(CVAR_TYPE_BOOL, name);
+}
+
+const int32& CVarSystemRead(CVarIntHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.intCVars.values[handle.index];
+}
+
+const uint32& CVarSystemRead(CVarUintHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.uintCVars.values[handle.index];
+}
+
+const float32& CVarSystemRead(CVarFloatHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.floatCVars.values[handle.index];
+}
+
+const bool8& CVarSystemRead(CVarBoolHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.boolCVars.values[handle.index];
+}
+
+int32& CVarSystemGet(CVarIntHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.intCVars.values[handle.index];
+}
+
+uint32& CVarSystemGet(CVarUintHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.uintCVars.values[handle.index];
+}
+
+float32& CVarSystemGet(CVarFloatHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.floatCVars.values[handle.index];
+}
+
+bool8& CVarSystemGet(CVarBoolHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.boolCVars.values[handle.index];
+}
+
+void CVarSystemSet(CVarIntHandle handle, int32 value)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  CVarSystemSetValueInStorage(data.intCVars, handle, value);
+}
+
+void CVarSystemSet(CVarUintHandle handle, uint32 value)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  CVarSystemSetValueInStorage(data.uintCVars, handle, value);
+}
+
+void CVarSystemSet(CVarFloatHandle handle, float32 value)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  CVarSystemSetValueInStorage(data.floatCVars, handle, value);
+}
+
+void CVarSystemSet(CVarBoolHandle handle, bool8 value)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  CVarSystemSetValueInStorage(data.boolCVars, handle, value);
+}
+
+const std::string& CVarSystemGetName(CVarIntHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.cvarsMeta[data.intCVars.metaIndices[handle.index]].name;
+}
+
+const std::string& CVarSystemGetName(CVarUintHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.cvarsMeta[data.uintCVars.metaIndices[handle.index]].name;
+}
+
+const std::string& CVarSystemGetName(CVarFloatHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.cvarsMeta[data.floatCVars.metaIndices[handle.index]].name;
+}
+
+const std::string& CVarSystemGetName(CVarBoolHandle handle)
+{
+  CVarSystemData& data = CVarSystemGetData();
+
+  ASSERT_HANDLE_IS_VALID(handle);
+  return data.cvarsMeta[data.boolCVars.metaIndices[handle.index]].name;
+}
+
+// ----------------------------------------------------------------------------
+// Change notifications
+// ----------------------------------------------------------------------------
+
+bool8 CVarSystemSubscribe(const string& name, void* listener, fpCVarChangedCallback callback)
+{
+  CVarMeta* meta = CVarSystemFindMeta(name);
+  if(meta == nullptr)
+  {
+    LOG_WARNING("Attempt to subscribe to a not registered cvar '%s'!", name.c_str());
+    return FALSE;
+  }
+
+  for(CVarListener& cvarListener: meta->listeners)
+  {
+    if(cvarListener.listener == listener)
+    {
+      LOG_WARNING("Attempt to subscribe same listener to the cvar '%s' twice!", name.c_str());
+      return FALSE;
+    }
+  }
+
+  meta->listeners.push_back(CVarListener{listener, callback});
+
+  return TRUE;
+}
+
+bool8 CVarSystemUnsubscribe(const string& name, void* listener)
+{
+  CVarMeta* meta = CVarSystemFindMeta(name);
+  if(meta == nullptr)
+  {
+    return FALSE;
+  }
+
+  auto listenerIt = std::find_if(meta->listeners.begin(),
+                                 meta->listeners.end(),
+                                 [listener](const CVarListener& cvarListener) { return cvarListener.listener == listener; });
+
+  if(listenerIt == meta->listeners.end())
+  {
+    return FALSE;
+  }
+
+  meta->listeners.erase(listenerIt);
+  return TRUE;
+}
+
+void CVarSystemNotifyChanged(const string& name)
+{
+  CVarMeta* meta = CVarSystemFindMeta(name);
+  if(meta != nullptr)
+  {
+    CVarSystemNotifyListeners(*meta);
+  }
+}
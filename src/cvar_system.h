@@ -57,31 +57,74 @@ struct CVarTypeTrait<bool8>
   static const CVarType type = CVAR_TYPE_BOOL;
 };
 
+/**
+ * Handle is a typed index into the flat storage of cvars of the corresponding type. It's
+ * resolved once (e.g at registration time or on first use) and then gives O(1) access to the
+ * variable without hashing its name.
+ *
+ * @note Storage of cvars never relocates registered values, so references returned through
+ * handles stay valid for the whole lifetime of the program.
+ */
+static const uint32 CVAR_INVALID_HANDLE_INDEX = (uint32)-1;
+
 template <typename T>
-ENGINE_API bool8 CVarSystemRegisterVar(const std::string& name, T initValue, CVarFlags flags)
+struct CVarHandle
 {
-  CVarType type = CVarTypeTrait<T>::type;
-  switch(type)
+  uint32 index = CVAR_INVALID_HANDLE_INDEX;
+
+  bool8 isValid() const
   {
-    case CVAR_TYPE_INT: return CVarSystemRegisterIntVar(name, initValue, flags);
-    case CVAR_TYPE_UINT: return CVarSystemRegisterUintVar(name, initValue, flags);
-    case CVAR_TYPE_FLOAT: return CVarSystemRegisterFloatVar(name, initValue, flags);
-    case CVAR_TYPE_BOOL: return CVarSystemRegisterBoolVar(name, initValue, flags);
-      
-    default: assert(false);
+    return index != CVAR_INVALID_HANDLE_INDEX ? TRUE : FALSE;
   }
+};
 
-  return FALSE;
-}
+using CVarIntHandle = CVarHandle<int32>;
+using CVarUintHandle = CVarHandle<uint32>;
+using CVarFloatHandle = CVarHandle<float32>;
+using CVarBoolHandle = CVarHandle<bool8>;
+
+/**
+ * Called each time value of a cvar was changed through CVarSystemSet(), CVarSystemParseStr() or
+ * explicitly through CVarSystemNotifyChanged().
+ */
+typedef void(*fpCVarChangedCallback)(const std::string& name, void* listener);
 
 ENGINE_API CVarType CVarSystemGetVarType(const std::string& name);
 ENGINE_API CVarFlags CVarSystemGetVarFlags(const std::string& name);
 ENGINE_API bool8 CVarSystemHasVar(const std::string& name);
 
-ENGINE_API bool8 CVarSystemRegisterIntVar(const std::string& name, int32 initValue, CVarFlags flags);
-ENGINE_API bool8 CVarSystemRegisterUintVar(const std::string& name, uint32 initValue, CVarFlags flags);
-ENGINE_API bool8 CVarSystemRegisterFloatVar(const std::string& name, float32 initValue, CVarFlags flags);
-ENGINE_API bool8 CVarSystemRegisterBoolVar(const std::string& name, bool8 initValue, CVarFlags flags);
+ENGINE_API bool8 CVarSystemRegisterIntVar(const std::string& name, int32 initValue, CVarFlags flags,
+                                          CVarIntHandle* outHandle = nullptr);
+ENGINE_API bool8 CVarSystemRegisterUintVar(const std::string& name, uint32 initValue, CVarFlags flags,
+                                           CVarUintHandle* outHandle = nullptr);
+ENGINE_API bool8 CVarSystemRegisterFloatVar(const std::string& name, float32 initValue, CVarFlags flags,
+                                            CVarFloatHandle* outHandle = nullptr);
+ENGINE_API bool8 CVarSystemRegisterBoolVar(const std::string& name, bool8 initValue, CVarFlags flags,
+                                           CVarBoolHandle* outHandle = nullptr);
+
+template <typename T>
+ENGINE_API bool8 CVarSystemRegisterVar(const std::string& name, T initValue, CVarFlags flags,
+                                       CVarHandle<T>* outHandle = nullptr)
+{
+  if constexpr(CVarTypeTrait<T>::type == CVAR_TYPE_INT)
+  {
+    return CVarSystemRegisterIntVar(name, initValue, flags, outHandle);
+  }
+  else if constexpr(CVarTypeTrait<T>::type == CVAR_TYPE_UINT)
+  {
+    return CVarSystemRegisterUintVar(name, initValue, flags, outHandle);
+  }
+  else if constexpr(CVarTypeTrait<T>::type == CVAR_TYPE_FLOAT)
+  {
+    return CVarSystemRegisterFloatVar(name, initValue, flags, outHandle);
+  }
+  else if constexpr(CVarTypeTrait<T>::type == CVAR_TYPE_BOOL)
+  {
+    return CVarSystemRegisterBoolVar(name, initValue, flags, outHandle);
+  }
+
+  return FALSE;
+}
 
 ENGINE_API std::string CVarSystemReadStr(const std::string& name);
 ENGINE_API CVarParseCode CVarSystemParseStr(const std::string& name, const std::string& val);
@@ -101,41 +144,92 @@ ENGINE_API bool8& CVarSystemGetBool(const std::string& name);
 template <typename T>
 ENGINE_API const T& CVarSystemReadVar(const std::string& name)
 {
-  CVarType type           = CVarTypeTrait<T>::type;
-  CVarType registeredType = CVarSystemGetVarType(name);
-  assert(type == registeredType && "Requested variable has another type!");
+  assert(CVarTypeTrait<T>::type == CVarSystemGetVarType(name) && "Requested variable has another type!");
 
-  switch(type)
+  if constexpr(CVarTypeTrait<T>::type == CVAR_TYPE_INT)
   {
-    case CVAR_TYPE_INT: return CVarSystemReadInt(name);
-    case CVAR_TYPE_UINT: return CVarSystemReadUint(name);
-    case CVAR_TYPE_INT: return CVarSystemReadFloat(name);
-    case CVAR_TYPE_BOOL: return CVarSystemReadBool(name);
-
-    default: assert(false);
+    return CVarSystemReadInt(name);
+  }
+  else if constexpr(CVarTypeTrait<T>::type == CVAR_TYPE_UINT)
+  {
+    return CVarSystemReadUint(name);
+  }
+  else if constexpr(CVarTypeTrait<T>::type == CVAR_TYPE_FLOAT)
+  {
+    return CVarSystemReadFloat(name);
+  }
+  else
+  {
+    return CVarSystemReadBool(name);
   }
 }
 
 template <typename T>
 ENGINE_API T& CVarSystemGetVar(const std::string& name)
 {
-  CVarType type           = CVarTypeTrait<T>::type;
-  CVarType registeredType = CVarSystemGetVarType(name);
-  assert(type == registeredType && "Requested variable has another type!");
+  assert(CVarTypeTrait<T>::type == CVarSystemGetVarType(name) && "Requested variable has another type!");
 
-  switch(type)
+  if constexpr(CVarTypeTrait<T>::type == CVAR_TYPE_INT)
   {
-    case CVAR_TYPE_INT: return CVarSystemGetInt(name);
-    case CVAR_TYPE_UINT: return CVarSystemGetUint(name);
-    case CVAR_TYPE_INT: return CVarSystemGetFloat(name);
-    case CVAR_TYPE_BOOL: return CVarSystemGetBool(name);
-
-    default: assert(false);
+    return CVarSystemGetInt(name);
+  }
+  else if constexpr(CVarTypeTrait<T>::type == CVAR_TYPE_UINT)
+  {
+    return CVarSystemGetUint(name);
+  }
+  else if constexpr(CVarTypeTrait<T>::type == CVAR_TYPE_FLOAT)
+  {
+    return CVarSystemGetFloat(name);
+  }
+  else
+  {
+    return CVarSystemGetBool(name);
   }
 }
 
 ENGINE_API std::vector<std::string> CVarSystemGetRegisteredVars();
 
+// ----------------------------------------------------------------------------
+// Handle-based access
+// ----------------------------------------------------------------------------
+
+/** @return invalid handle if variable doesn't exist or has another type */
+ENGINE_API CVarIntHandle CVarSystemGetIntHandle(const std::string& name);
+ENGINE_API CVarUintHandle CVarSystemGetUintHandle(const std::string& name);
+ENGINE_API CVarFloatHandle CVarSystemGetFloatHandle(const std::string& name);
+ENGINE_API CVarBoolHandle CVarSystemGetBoolHandle(const std::string& name);
+
+ENGINE_API const int32& CVarSystemRead(CVarIntHandle handle);
+ENGINE_API const uint32& CVarSystemRead(CVarUintHandle handle);
+ENGINE_API const float32& CVarSystemRead(CVarFloatHandle handle);
+ENGINE_API const bool8& CVarSystemRead(CVarBoolHandle handle);
+
+// WARNING: Writing through the returned reference doesn't notify subscribers, use CVarSystemSet()
+// or call CVarSystemNotifyChanged() explicitly if somebody may depend on the variable.
+ENGINE_API int32& CVarSystemGet(CVarIntHandle handle);
+ENGINE_API uint32& CVarSystemGet(CVarUintHandle handle);
+ENGINE_API float32& CVarSystemGet(CVarFloatHandle handle);
+ENGINE_API bool8& CVarSystemGet(CVarBoolHandle handle);
+
+/** Changes the value and notifies subscribers (only if value has really changed) */
+ENGINE_API void CVarSystemSet(CVarIntHandle handle, int32 value);
+ENGINE_API void CVarSystemSet(CVarUintHandle handle, uint32 value);
+ENGINE_API void CVarSystemSet(CVarFloatHandle handle, float32 value);
+ENGINE_API void CVarSystemSet(CVarBoolHandle handle, bool8 value);
+
+ENGINE_API const std::string& CVarSystemGetName(CVarIntHandle handle);
+ENGINE_API const std::string& CVarSystemGetName(CVarUintHandle handle);
+ENGINE_API const std::string& CVarSystemGetName(CVarFloatHandle handle);
+ENGINE_API const std::string& CVarSystemGetName(CVarBoolHandle handle);
+
+// ----------------------------------------------------------------------------
+// Change notifications
+// ----------------------------------------------------------------------------
+
+ENGINE_API bool8 CVarSystemSubscribe(const std::string& name, void* listener, fpCVarChangedCallback callback);
+ENGINE_API bool8 CVarSystemUnsubscribe(const std::string& name, void* listener);
+ENGINE_API void CVarSystemNotifyChanged(const std::string& name);
+
 #define DECLARE_CVAR(name, initValue) \
   DECLARE_CVAR_FLAGS(name, initValue, CVAR_FLAG_NONE)
 
@@ -148,7 +242,12 @@ class CVarStaticInitializator
 public:  
   CVarStaticInitializator(const std::string& name, T initValue, CVarFlags flags)
   {
-    assert(CVarSystemRegisterVar(name, initValue, (CVarFlags)(flags | CVAR_FLAG_STATIC)) == TRUE &&
-           "Cannot register console variable!");
+    bool8 registered = CVarSystemRegisterVar(name, initValue, (CVarFlags)(flags | CVAR_FLAG_STATIC), &m_handle);
+    assert(registered == TRUE && "Cannot register console variable!");
   }
+
+  CVarHandle<T> getHandle() const { return m_handle; }
+
+private:
+  CVarHandle<T> m_handle;
 };
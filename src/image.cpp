@@ -6,11 +6,13 @@ struct Image
 
   uint32 width;
   uint32 height;
+  uint32 border;
+  uint32 version = 0;
 
   std::string name;
 };
 
-bool8 createImage(GLuint texture, uint32 width, uint32 height, Image** outImage)
+bool8 createImage(GLuint texture, uint32 width, uint32 height, Image** outImage, uint32 border)
 {
   Image* image = engineAllocObject<Image>(MEMORY_TYPE_GENERAL);
   *outImage = image;
@@ -18,6 +20,7 @@ bool8 createImage(GLuint texture, uint32 width, uint32 height, Image** outImage)
   image->textureHandle = texture;
   image->width = width;
   image->height = height;
+  image->border = border;
 
   return TRUE;
 }
@@ -48,6 +51,11 @@ uint2 imageGetSize(Image* image)
   return uint2(image->width, image->height);
 }
 
+uint32 imageGetBorder(Image* image)
+{
+  return image->border;
+}
+
 void imageSetName(Image* image, const std::string& name)
 {
   image->name = name;
@@ -62,3 +70,22 @@ GLuint imageGetGLHandle(Image* image)
 {
   return image->textureHandle;
 }
+
+void imageSetTexture(Image* image, GLuint texture, uint32 width, uint32 height, uint32 border)
+{
+  if(image->textureHandle != 0)
+  {
+    glDeleteTextures(1, &image->textureHandle);
+  }
+
+  image->textureHandle = texture;
+  image->width = width;
+  image->height = height;
+  image->border = border;
+  image->version++;
+}
+
+uint32 imageGetVersion(Image* image)
+{
+  return image->version;
+}
@@ -6,16 +6,28 @@
 
 struct Image;
 
-ENGINE_API bool8 createImage(GLuint texture, uint32 width, uint32 height, Image** outImage);
+/** @param border width of the border around the content of the texture (see TextureData) */
+ENGINE_API bool8 createImage(GLuint texture, uint32 width, uint32 height, Image** outImage, uint32 border = 0);
 ENGINE_API void destroyImage(Image* image);
 
 ENGINE_API uint32 imageGetWidth(Image* image);
 ENGINE_API uint32 imageGetHeight(Image* image);
 ENGINE_API uint2 imageGetSize(Image* image);
+/** @return width of the border of repeated edge texels, sizes of the image include it */
+ENGINE_API uint32 imageGetBorder(Image* image);
 
 ENGINE_API void imageSetName(Image* image, const std::string& name);
 ENGINE_API const std::string& imageGetName(Image* image);
 
 ENGINE_API GLuint imageGetGLHandle(Image* image);
 
+/**
+ * Replaces the texture of the image (the previous one is deleted), e.g when a placeholder of an
+ * asynchronously loaded image gets its real content. Version of the image is incremented.
+ */
+ENGINE_API void imageSetTexture(Image* image, GLuint texture, uint32 width, uint32 height, uint32 border = 0);
+
+/** @return counter of texture replacements, it allows to detect that cached data is outdated */
+ENGINE_API uint32 imageGetVersion(Image* image);
+
 using ImagePtr = SharedPtr<Image, destroyImage>;
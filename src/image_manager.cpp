@@ -1,39 +1,419 @@
+#include <list>
+#include <deque>
+#include <memory>
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
 #include <unordered_map>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
+#include "scheduler.h"
+#include "cvar_system.h"
 #include "image_manager.h"
+#include "texture_cooker.h"
 
+using std::list;
+using std::deque;
 using std::string;
+using std::vector;
+using std::shared_ptr;
 using std::unordered_map;
 
+// NOTE: Maximal amount of bytes which are uploaded into textures per frame, an image is uploaded
+// by rows (rows of blocks for compressed textures), so at least one row is uploaded each frame
+DECLARE_CVAR(engine_ImageManager_UploadBudget, 4194304u);
+// NOTE: Maximal amount of bytes of texture data which are kept after upload, so that freed images
+// can be loaded again without reading and decoding
+DECLARE_CVAR(engine_ImageManager_TextureCacheSize, 67108864u);
+// NOTE: Images are compressed into BC7 and cooked textures are stored next to them, it's read once
+// (see imageManagerCompressesTextures())
+DECLARE_CVAR(engine_ImageManager_CompressTextures, bool8(TRUE));
+// NOTE: Maximal count of textures which are cooked per frame, cooking stalls the main thread since
+// the driver compresses all levels and they're read back (see textureCookerCompress())
+DECLARE_CVAR(engine_ImageManager_CookingBudget, 1u);
+
+using TextureDataPtr = shared_ptr<const TextureData>;
+
+struct LoadedTexture
+{
+  TextureDataPtr texture;
+  uint64 sourceHash = 0;
+};
+
+struct ImageUpload
+{
+  string path;
+  ImagePtr image;
+  TextureDataPtr texture;
+
+  // NOTE: Texture and pixel buffer are created when the upload starts
+  GLuint textureHandle = 0;
+  GLuint pixelBufferHandle = 0;
+
+  uint32 uploadedLevels = 0;
+  // NOTE: Rows of the current level, in blocks for compressed textures
+  uint32 uploadedRows = 0;
+  uint32 levelOffset = 0;
+};
+
+struct ImageCooking
+{
+  string path;
+  ImagePtr image;
+  LoadedTexture loaded;
+};
+
+struct TextureCacheEntry
+{
+  TextureDataPtr texture;
+  list<string>::iterator lruIt;
+};
+
 struct ImageManagerData
 {
   bool8 initialized;
-  
+
   unordered_map<string, ImagePtr> loadedImages;
+
+  // NOTE: Callbacks of images which are being loaded or uploaded, path is removed once it's loaded
+  unordered_map<string, vector<ImageLoadedCallback>> pendingCallbacks;
+  deque<ImageCooking> cookings;
+  deque<ImageUpload> uploads;
+
+  // NOTE: The most recently used path is at the front
+  list<string> textureCacheLRU;
+  unordered_map<string, TextureCacheEntry> textureCache;
+  uint32 textureCacheSize;
+
+  bool8 compressionProbed;
+  bool8 compressTextures;
+  // NOTE: Single white 4x4 level, compressed if textures are compressed
+  TextureData placeholder;
 };
 
 static ImageManagerData data;
 
+static uint32 getTextureDataSize(const TextureData& texture)
+{
+  uint32 size = 0;
+  for(const TextureLevel& level: texture.levels)
+  {
+    size += level.data.size();
+  }
+
+  return size;
+}
+
+static void imageManagerTrimTextureCache(uint32 cacheSizeLimit)
+{
+  while(data.textureCacheSize > cacheSizeLimit)
+  {
+    auto entryIt = data.textureCache.find(data.textureCacheLRU.back());
+
+    data.textureCacheSize -= getTextureDataSize(*entryIt->second.texture);
+    data.textureCache.erase(entryIt);
+    data.textureCacheLRU.pop_back();
+  }
+}
+
+static void imageManagerCVarChanged(const string& name, void* listener)
+{
+  if(name == CVarSystemGetName(StaticCVar_engine_ImageManager_TextureCacheSize.getHandle()))
+  {
+    imageManagerTrimTextureCache(CVarSystemRead(StaticCVar_engine_ImageManager_TextureCacheSize.getHandle()));
+  }
+  else if(name == CVarSystemGetName(StaticCVar_engine_ImageManager_CompressTextures.getHandle()))
+  {
+    // NOTE: Atlases and loaded images keep the format they were created with
+    LOG_WARNING("Compression of textures is changed only after restart");
+  }
+}
+
 bool8 initializeImageManager()
 {
   assert(data.initialized == FALSE);
 
   data.initialized = TRUE;
 
+  imageManagerCompressesTextures();
+
+  CVarSystemSubscribe("engine_ImageManager_TextureCacheSize", &data, imageManagerCVarChanged);
+  CVarSystemSubscribe("engine_ImageManager_CompressTextures", &data, imageManagerCVarChanged);
+
   return TRUE;
 }
 
+static void imageManagerCancelUpload(ImageUpload& upload)
+{
+  glDeleteTextures(1, &upload.textureHandle);
+  glDeleteBuffers(1, &upload.pixelBufferHandle);
+}
+
 void shutdownImageManager()
 {
   assert(data.initialized == TRUE);
 
+  CVarSystemUnsubscribe("engine_ImageManager_TextureCacheSize", &data);
+  CVarSystemUnsubscribe("engine_ImageManager_CompressTextures", &data);
+
+  for(ImageUpload& upload: data.uploads)
+  {
+    imageManagerCancelUpload(upload);
+  }
+
+  data.uploads.clear();
+  data.cookings.clear();
+  data.pendingCallbacks.clear();
+  data.textureCache.clear();
+  data.textureCacheLRU.clear();
+  data.textureCacheSize = 0;
+
   data.initialized = FALSE;
 }
 
+bool8 imageManagerCompressesTextures()
+{
+  // NOTE: Materials may be loaded before the image manager is initialized, so it's probed on the first call
+  if(data.compressionProbed == TRUE)
+  {
+    return data.compressTextures;
+  }
+
+  const bool8 compressTextures = CVarSystemRead(StaticCVar_engine_ImageManager_CompressTextures.getHandle());
+
+  data.compressionProbed = TRUE;
+
+  TextureLevel placeholderLevel;
+  placeholderLevel.width = TEXTURE_COOKER_BLOCK_SIDE;
+  placeholderLevel.height = TEXTURE_COOKER_BLOCK_SIDE;
+  placeholderLevel.data.assign(placeholderLevel.width * placeholderLevel.height * 4, 255);
+
+  data.placeholder.internalFormat = GL_RGBA8;
+  data.placeholder.levels.push_back(placeholderLevel);
+
+  if(compressTextures == FALSE)
+  {
+    return data.compressTextures;
+  }
+
+  // NOTE: Compressed placeholder has a border like cooked textures (see textureCookerDecode())
+  TextureData borderedPlaceholder = data.placeholder;
+  TextureLevel& borderedLevel = borderedPlaceholder.levels[0];
+  borderedPlaceholder.border = TEXTURE_COOKER_BORDER;
+  borderedLevel.width += 2 * TEXTURE_COOKER_BORDER;
+  borderedLevel.height += 2 * TEXTURE_COOKER_BORDER;
+  borderedLevel.data.assign(borderedLevel.width * borderedLevel.height * 4, 255);
+
+  GLuint probeHandle;
+  TextureData compressedPlaceholder;
+  if(textureCookerCompress(borderedPlaceholder, probeHandle, compressedPlaceholder) == FALSE)
+  {
+    LOG_WARNING("Driver doesn't compress textures into BC7, images are kept uncompressed");
+    return data.compressTextures;
+  }
+
+  glDeleteTextures(1, &probeHandle);
+
+  data.placeholder = compressedPlaceholder;
+  data.compressTextures = TRUE;
+
+  return data.compressTextures;
+}
+
+/** @note It's called by worker threads, so it must not touch anything but its arguments */
+static bool8 loadTexture(const string& path, bool8 compress, LoadedTexture& outTexture)
+{
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if(file.is_open() == false)
+  {
+    return FALSE;
+  }
+
+  vector<uint8> fileData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  outTexture.sourceHash = textureCookerHash(fileData.data(), fileData.size());
+
+  shared_ptr<TextureData> texture = std::make_shared<TextureData>();
+
+  if(compress == TRUE &&
+     textureCookerReadCooked(textureCookerGetCookedPath(path), outTexture.sourceHash, *texture) == TRUE)
+  {
+    outTexture.texture = texture;
+    return TRUE;
+  }
+
+  if(textureCookerDecode(fileData.data(), fileData.size(), compress, *texture) == FALSE)
+  {
+    return FALSE;
+  }
+
+  outTexture.texture = texture;
+  return TRUE;
+}
+
+static TextureDataPtr imageManagerFindCachedTexture(const string& path)
+{
+  auto entryIt = data.textureCache.find(path);
+  if(entryIt == data.textureCache.end())
+  {
+    return nullptr;
+  }
+
+  data.textureCacheLRU.splice(data.textureCacheLRU.begin(), data.textureCacheLRU, entryIt->second.lruIt);
+  return entryIt->second.texture;
+}
+
+static void imageManagerCacheTexture(const string& path, TextureDataPtr texture)
+{
+  const static CVarUintHandle cacheSizeLimitHandle = StaticCVar_engine_ImageManager_TextureCacheSize.getHandle();
+  const uint32 cacheSizeLimit = CVarSystemRead(cacheSizeLimitHandle);
+
+  uint32 textureSize = getTextureDataSize(*texture);
+  if(data.textureCache.find(path) != data.textureCache.end() || textureSize > cacheSizeLimit)
+  {
+    return;
+  }
+
+  data.textureCacheLRU.push_front(path);
+  data.textureCache[path] = TextureCacheEntry{texture, data.textureCacheLRU.begin()};
+  data.textureCacheSize += textureSize;
+
+  imageManagerTrimTextureCache(cacheSizeLimit);
+}
+
+static GLenum getPixelsFormat(const TextureData& texture)
+{
+  return texture.internalFormat == GL_RGB8 ? GL_RGB : GL_RGBA;
+}
+
+/** @return height of a row which is uploaded at once, a row of blocks for compressed textures */
+static uint32 getRowHeight(const TextureData& texture)
+{
+  return textureDataIsCompressed(texture) == TRUE ? TEXTURE_COOKER_BLOCK_SIDE : 1;
+}
+
+static void uploadLevelRows(const TextureData& texture, uint32 levelIndex, uint32 firstRow, uint32 rowsCount,
+                            const void* rowsData)
+{
+  const TextureLevel& level = texture.levels[levelIndex];
+
+  uint32 rowHeight = getRowHeight(texture);
+  uint32 rowsTotalCount = (level.height + rowHeight - 1) / rowHeight;
+  uint32 rowSize = level.data.size() / rowsTotalCount;
+
+  uint32 y = firstRow * rowHeight;
+  uint32 height = std::min(rowsCount * rowHeight, level.height - y);
+
+  if(textureDataIsCompressed(texture) == TRUE)
+  {
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, levelIndex, 0, y, level.width, height, texture.internalFormat,
+                              rowsCount * rowSize, rowsData);
+  }
+  else
+  {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, levelIndex, 0, y, level.width, height, getPixelsFormat(texture),
+                    GL_UNSIGNED_BYTE, rowsData);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  }
+}
+
+static GLuint createTexture(const TextureData& texture)
+{
+  GLuint textureHandle;
+  glGenTextures(1, &textureHandle);
+  glBindTexture(GL_TEXTURE_2D, textureHandle);
+  glTexStorage2D(GL_TEXTURE_2D, texture.levels.size(), texture.internalFormat,
+                 texture.levels[0].width, texture.levels[0].height);
+
+  uint32 rowHeight = getRowHeight(texture);
+  for(uint32 i = 0; i < texture.levels.size(); i++)
+  {
+    const TextureLevel& level = texture.levels[i];
+    uploadLevelRows(texture, i, 0, (level.height + rowHeight - 1) / rowHeight, level.data.data());
+  }
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return textureHandle;
+}
+
+/** @return FALSE if the image has been freed (and maybe loaded again) since its loading has started */
+static bool8 imageManagerIsLoading(const string& path, ImagePtr image)
+{
+  auto it = data.loadedImages.find(path);
+  return it != data.loadedImages.end() && it->second == image ? TRUE : FALSE;
+}
+
+static void imageManagerCompleteLoading(const string& path, ImagePtr image)
+{
+  auto callbacksIt = data.pendingCallbacks.find(path);
+  if(callbacksIt == data.pendingCallbacks.end())
+  {
+    return;
+  }
+
+  // NOTE: Callbacks may load other images, so the list is detached first
+  vector<ImageLoadedCallback> callbacks = std::move(callbacksIt->second);
+  data.pendingCallbacks.erase(callbacksIt);
+
+  for(ImageLoadedCallback& callback: callbacks)
+  {
+    callback(image);
+  }
+}
+
+/**
+ * Compresses decoded texture, so that it's cooked. Cooked texture is written by a worker thread
+ * unless writeImmediately is TRUE.
+ * @return FALSE if the texture cannot be compressed
+ */
+static bool8 imageManagerCookTexture(const string& path, const LoadedTexture& loaded, bool8 writeImmediately,
+                                     GLuint& outTextureHandle, TextureDataPtr& outTexture)
+{
+  shared_ptr<TextureData> compressed = std::make_shared<TextureData>();
+  if(textureCookerCompress(*loaded.texture, outTextureHandle, *compressed) == FALSE)
+  {
+    LOG_ERROR("Image manager cannot compress image located at '%s'", path.c_str());
+    return FALSE;
+  }
+
+  outTexture = compressed;
+
+  string cookedPath = textureCookerGetCookedPath(path);
+  uint64 sourceHash = loaded.sourceHash;
+
+  if(writeImmediately == TRUE)
+  {
+    if(textureCookerWriteCooked(cookedPath, sourceHash, *compressed) == FALSE)
+    {
+      LOG_WARNING("Image manager cannot write cooked texture '%s'", cookedPath.c_str());
+    }
+
+    return TRUE;
+  }
+
+  auto written = std::make_shared<bool8>(FALSE);
+
+  schedulerSubmitJob([cookedPath, sourceHash, compressed, written]()
+  {
+    *written = textureCookerWriteCooked(cookedPath, sourceHash, *compressed);
+  },
+  [cookedPath, written]()
+  {
+    if(*written == FALSE)
+    {
+      LOG_WARNING("Image manager cannot write cooked texture '%s'", cookedPath.c_str());
+    }
+  });
+
+  return TRUE;
+}
+
 ImagePtr imageManagerLoadImage(const char* path)
 {
   auto it = data.loadedImages.find(string(path));
@@ -42,67 +422,323 @@ ImagePtr imageManagerLoadImage(const char* path)
     return it->second;
   }
 
-  int32 width, height, channelsCount;
-  uint8* pixels = stbi_load(path, &width, &height, &channelsCount, 0);
-  if(pixels == NULL)
+  bool8 compress = imageManagerCompressesTextures();
+
+  LoadedTexture loaded;
+  loaded.texture = imageManagerFindCachedTexture(path);
+
+  if(loaded.texture == nullptr && loadTexture(path, compress, loaded) == FALSE)
   {
     LOG_ERROR("Image manager cannot load image located at '%s'", path);
     return ImagePtr(nullptr);
   }
 
   GLuint textureHandle;
-  glGenTextures(1, &textureHandle);
-  glBindTexture(GL_TEXTURE_2D, textureHandle);
+  TextureDataPtr texture = loaded.texture;
 
-  if(channelsCount == 3)
-  {
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-  }
-  else if(channelsCount == 4)
+  if(compress == TRUE && textureDataIsCompressed(*texture) == FALSE)
   {
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);    
+    if(imageManagerCookTexture(path, loaded, TRUE, textureHandle, texture) == FALSE)
+    {
+      return ImagePtr(nullptr);
+    }
   }
   else
   {
-    assert(FALSE && "Given image's format is not supported...");
+    textureHandle = createTexture(*texture);
   }
 
+  imageManagerCacheTexture(path, texture);
 
-  glGenerateMipmap(GL_TEXTURE_2D);
-  
-  glBindTexture(GL_TEXTURE_2D, 0);
-  
   Image* image;
-  createImage(textureHandle, width, height, &image);
+  createImage(textureHandle, texture->levels[0].width, texture->levels[0].height, &image, texture->border);
   imageSetName(image, path);
-  
+
   ImagePtr imagePtr = ImagePtr(image);
 
   data.loadedImages[string(path)] = imagePtr;
-  
+
   return imagePtr;
 }
 
+ImagePtr imageManagerLoadImageAsync(const char* path, ImageLoadedCallback onLoaded)
+{
+  string pathStr = string(path);
+
+  auto it = data.loadedImages.find(pathStr);
+  if(it != data.loadedImages.end())
+  {
+    auto callbacksIt = data.pendingCallbacks.find(pathStr);
+
+    if(onLoaded != nullptr && callbacksIt != data.pendingCallbacks.end())
+    {
+      callbacksIt->second.push_back(onLoaded);
+    }
+    else if(onLoaded != nullptr)
+    {
+      onLoaded(it->second);
+    }
+
+    return it->second;
+  }
+
+  bool8 compress = imageManagerCompressesTextures();
+
+  // NOTE: Placeholder is white, the image gets its real texture once it's uploaded
+  Image* image;
+  createImage(createTexture(data.placeholder), data.placeholder.levels[0].width,
+              data.placeholder.levels[0].height, &image, data.placeholder.border);
+  imageSetName(image, pathStr);
+
+  ImagePtr imagePtr = ImagePtr(image);
+  data.loadedImages[pathStr] = imagePtr;
+
+  vector<ImageLoadedCallback>& callbacks = data.pendingCallbacks[pathStr];
+  if(onLoaded != nullptr)
+  {
+    callbacks.push_back(onLoaded);
+  }
+
+  TextureDataPtr cachedTexture = imageManagerFindCachedTexture(pathStr);
+  if(cachedTexture != nullptr)
+  {
+    data.uploads.push_back(ImageUpload{pathStr, imagePtr, cachedTexture});
+    return imagePtr;
+  }
+
+  auto loaded = std::make_shared<LoadedTexture>();
+
+  schedulerSubmitJob([pathStr, compress, loaded]()
+  {
+    if(loadTexture(pathStr, compress, *loaded) == FALSE)
+    {
+      loaded->texture = nullptr;
+    }
+  },
+  [pathStr, imagePtr, compress, loaded]()
+  {
+    // NOTE: Callbacks of the freed image have been dropped, they may belong to its new loading now
+    if(imageManagerIsLoading(pathStr, imagePtr) == FALSE)
+    {
+      return;
+    }
+
+    if(loaded->texture == nullptr)
+    {
+      LOG_ERROR("Image manager cannot load image located at '%s'", pathStr.c_str());
+
+      // NOTE: Placeholder stays in place, so that users of the image don't have to check it
+      imageManagerCompleteLoading(pathStr, ImagePtr(nullptr));
+      return;
+    }
+
+    if(compress == FALSE || textureDataIsCompressed(*loaded->texture) == TRUE)
+    {
+      data.uploads.push_back(ImageUpload{pathStr, imagePtr, loaded->texture});
+      return;
+    }
+
+    // NOTE: Texture isn't cooked yet, it's cooked by imageManagerUpdate() within the cooking budget
+    data.cookings.push_back(ImageCooking{pathStr, imagePtr, *loaded});
+  });
+
+  return imagePtr;
+}
+
+static uint32 imageManagerGetRowSize(const ImageUpload& upload)
+{
+  const TextureData& texture = *upload.texture;
+  const TextureLevel& level = texture.levels[upload.uploadedLevels];
+
+  uint32 rowHeight = getRowHeight(texture);
+  return level.data.size() / ((level.height + rowHeight - 1) / rowHeight);
+}
+
+/** @return TRUE if the upload is finished */
+static bool8 imageManagerUploadRows(ImageUpload& upload, uint32& budget)
+{
+  const TextureData& texture = *upload.texture;
+
+  if(upload.textureHandle == 0)
+  {
+    glGenTextures(1, &upload.textureHandle);
+    glBindTexture(GL_TEXTURE_2D, upload.textureHandle);
+    glTexStorage2D(GL_TEXTURE_2D, texture.levels.size(), texture.internalFormat,
+                   texture.levels[0].width, texture.levels[0].height);
+
+    // NOTE: Texture data is copied into the pixel buffer, so the transfer into the texture doesn't stall
+    glGenBuffers(1, &upload.pixelBufferHandle);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.pixelBufferHandle);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, getTextureDataSize(texture), NULL, GL_STREAM_DRAW);
+  }
+  else
+  {
+    glBindTexture(GL_TEXTURE_2D, upload.textureHandle);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.pixelBufferHandle);
+  }
+
+  const TextureLevel& level = texture.levels[upload.uploadedLevels];
+
+  uint32 rowHeight = getRowHeight(texture);
+  uint32 levelRowsCount = (level.height + rowHeight - 1) / rowHeight;
+  uint32 rowSize = level.data.size() / levelRowsCount;
+
+  uint32 rowsCount = std::min(levelRowsCount - upload.uploadedRows, std::max(budget / rowSize, 1u));
+  uint32 rowsOffset = upload.uploadedRows * rowSize;
+  uint32 offset = upload.levelOffset + rowsOffset;
+
+  glBufferSubData(GL_PIXEL_UNPACK_BUFFER, offset, rowsCount * rowSize, level.data.data() + rowsOffset);
+  uploadLevelRows(texture, upload.uploadedLevels, upload.uploadedRows, rowsCount, (const void*)(uintptr_t)offset);
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  upload.uploadedRows += rowsCount;
+  budget -= std::min(budget, rowsCount * rowSize);
+
+  if(upload.uploadedRows == levelRowsCount)
+  {
+    upload.levelOffset += level.data.size();
+    upload.uploadedRows = 0;
+    upload.uploadedLevels++;
+  }
+
+  if(upload.uploadedLevels < texture.levels.size())
+  {
+    return FALSE;
+  }
+
+  glDeleteBuffers(1, &upload.pixelBufferHandle);
+  upload.pixelBufferHandle = 0;
+
+  return TRUE;
+}
+
+/** Texture is compressed at once, since the driver needs all of its levels */
+static void imageManagerCook(const ImageCooking& cooking)
+{
+  GLuint textureHandle;
+  TextureDataPtr texture;
+  if(imageManagerCookTexture(cooking.path, cooking.loaded, FALSE, textureHandle, texture) == FALSE)
+  {
+    imageManagerCompleteLoading(cooking.path, ImagePtr(nullptr));
+    return;
+  }
+
+  imageSetTexture(cooking.image, textureHandle, texture->levels[0].width, texture->levels[0].height, texture->border);
+  imageManagerCacheTexture(cooking.path, texture);
+
+  imageManagerCompleteLoading(cooking.path, cooking.image);
+}
+
+void imageManagerUpdate()
+{
+  const static CVarUintHandle uploadBudgetHandle = StaticCVar_engine_ImageManager_UploadBudget.getHandle();
+  const static CVarUintHandle cookingBudgetHandle = StaticCVar_engine_ImageManager_CookingBudget.getHandle();
+
+  const uint32 uploadBudget = CVarSystemRead(uploadBudgetHandle);
+  const uint32 cookingBudget = CVarSystemRead(cookingBudgetHandle);
+
+  for(uint32 i = 0; i < cookingBudget && data.cookings.empty() == false; i++)
+  {
+    // NOTE: Callbacks may load other images, so the cooking is detached first
+    ImageCooking cooking = std::move(data.cookings.front());
+    data.cookings.pop_front();
+
+    imageManagerCook(cooking);
+  }
+
+  uint32 budget = uploadBudget;
+  while(data.uploads.empty() == false && budget > 0)
+  {
+    ImageUpload& upload = data.uploads.front();
+
+    // NOTE: Row which is larger than the whole budget is uploaded alone, otherwise it's left for the next frame
+    if(budget < imageManagerGetRowSize(upload) && budget < uploadBudget)
+    {
+      break;
+    }
+
+    if(imageManagerUploadRows(upload, budget) == FALSE)
+    {
+      continue;
+    }
+
+    imageSetTexture(upload.image, upload.textureHandle,
+                    upload.texture->levels[0].width, upload.texture->levels[0].height, upload.texture->border);
+    imageManagerCacheTexture(upload.path, upload.texture);
+
+    string path = upload.path;
+    ImagePtr image = upload.image;
+    data.uploads.pop_front();
+
+    imageManagerCompleteLoading(path, image);
+  }
+}
+
 bool8 imageManagerHasImage(const char* path)
 {
   auto it = data.loadedImages.find(string(path));
   return it != data.loadedImages.end();
 }
 
+bool8 imageManagerIsImageLoading(const char* path)
+{
+  return data.pendingCallbacks.find(string(path)) != data.pendingCallbacks.end() ? TRUE : FALSE;
+}
+
 bool8 imageManagerFreeImage(const char* path)
 {
   auto it = data.loadedImages.find(string(path));
-  if(it != data.loadedImages.end())
+  if(it == data.loadedImages.end())
   {
-    data.loadedImages.erase(it);
+    return FALSE;
+  }
 
-    return TRUE;
+  data.loadedImages.erase(it);
+
+  // NOTE: Loading of the image is abandoned, jobs which are still in flight see that the image has
+  // been freed (see imageManagerIsLoading())
+  data.pendingCallbacks.erase(string(path));
+
+  for(auto cookingIt = data.cookings.begin(); cookingIt != data.cookings.end();)
+  {
+    if(cookingIt->path == path)
+    {
+      cookingIt = data.cookings.erase(cookingIt);
+    }
+    else
+    {
+      cookingIt++;
+    }
   }
 
-  return FALSE;
+  for(auto uploadIt = data.uploads.begin(); uploadIt != data.uploads.end();)
+  {
+    if(uploadIt->path == path)
+    {
+      imageManagerCancelUpload(*uploadIt);
+      uploadIt = data.uploads.erase(uploadIt);
+    }
+    else
+    {
+      uploadIt++;
+    }
+  }
+
+  return TRUE;
 }
 
 void imageManagerFreeImages()
 {
   data.loadedImages.clear();
+  data.pendingCallbacks.clear();
+  data.cookings.clear();
+
+  for(ImageUpload& upload: data.uploads)
+  {
+    imageManagerCancelUpload(upload);
+  }
+
+  data.uploads.clear();
 }
@@ -1,15 +1,42 @@
 #pragma once
 
+#include <functional>
+
 #include "image.h"
 #include "defines.h"
 
+/** @param image loaded image or nullptr if it cannot be loaded */
+using ImageLoadedCallback = std::function<void(ImagePtr image)>;
+
 ENGINE_API bool8 initializeImageManager();
 ENGINE_API void shutdownImageManager();
 
 ENGINE_API ImagePtr imageManagerLoadImage(const char* path);
 
+/**
+ * Returns a white placeholder image immediately, the file is read and decoded (or its cooked texture
+ * is read) by worker threads and uploaded across the next frames (see imageManagerUpdate()). Once
+ * it's done, the image gets its real texture (its version changes, see imageGetVersion()) and onLoaded is called on the
+ * main thread. If the image has already been loaded, onLoaded is called right away.
+ */
+ENGINE_API ImagePtr imageManagerLoadImageAsync(const char* path, ImageLoadedCallback onLoaded = nullptr);
+
+/**
+ * Cooks loaded images, which aren't cooked yet, at most engine_ImageManager_CookingBudget per call,
+ * and uploads loaded images into textures, at most engine_ImageManager_UploadBudget bytes per call
+ */
+ENGINE_API void imageManagerUpdate();
+
+/**
+ * @return TRUE if images are loaded as BC7 textures (see texture_cooker.h), then all of their sizes
+ * are multiples of 4
+ */
+ENGINE_API bool8 imageManagerCompressesTextures();
+
 ENGINE_API bool8 imageManagerHasImage(const char* path);
+ENGINE_API bool8 imageManagerIsImageLoading(const char* path);
 
+/** Callbacks of an image, which is freed before it's loaded, are never called */
 ENGINE_API bool8 imageManagerFreeImage(const char* path);
 ENGINE_API void imageManagerFreeImages();
 
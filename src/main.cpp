@@ -1,4 +1,7 @@
+#include <cstring>
+
 #include "memory_manager.h"
+#include "binary_document.h"
 #include "application.h"
 #include "logging.h"
 
@@ -7,8 +10,14 @@
   #include "memory_manager_unit_tests.h"
   #include "shared_ptr_unit_tests.h"
   #include "event_system_unit_tests.h"
+  #include "cvar_system_unit_tests.h"
+  #include "bvh_unit_tests.h"
+  #include "rect_packer_unit_tests.h"
+  #include "binary_document_unit_tests.h"
+  #include "scene_unit_tests.h"
   #include "image_integrator_integration_tests.h"
   #include "window_manager_integration_tests.h"
+  #include "geometry_integration_tests.h"
 
   #include "event_system.h"
   #include "lua/lua_system.h"
@@ -40,6 +49,17 @@ int initNormal(int argc, char** argv)
     return -1;
   }
 
+  // NOTE: "--convert <src> <dst>" converts a document between text json and binary formats
+  if(argc == 4 && strcmp(argv[1], "--convert") == 0)
+  {
+    int result = convertDocument(argv[2], argv[3]) == TRUE ? 0 : -4;
+
+    engineShutdownMemoryManager();
+    shutdownGlobalLogger();
+
+    return result;
+  }
+
   if(!startApplication())
   {
     LOG_ERROR("Cannot start an application!");
@@ -0,0 +1,423 @@
+#include <cmath>
+#include <algorithm>
+
+#include "bvh.h"
+
+using std::vector;
+
+static const uint32 BVH_BINS_COUNT = 16;
+
+static bool8 bvhAABBIsBounded(const AABB& aabb)
+{
+  return std::isfinite(aabb.min.x) && std::isfinite(aabb.min.y) && std::isfinite(aabb.min.z) &&
+         std::isfinite(aabb.max.x) && std::isfinite(aabb.max.y) && std::isfinite(aabb.max.z);
+}
+
+static float32 bvhAABBGetHalfArea(const AABB& aabb)
+{
+  float3 dimensions = max(aabb.max - aabb.min, float3(0.0f, 0.0f, 0.0f));
+  return dimensions.x * dimensions.y + dimensions.y * dimensions.z + dimensions.z * dimensions.x;
+}
+
+static bool8 bvhAABBEquals(const AABB& lop, const AABB& rop)
+{
+  return lop.min == rop.min && lop.max == rop.max;
+}
+
+struct BVHBin
+{
+  AABB aabb;
+  uint32 count = 0;
+};
+
+static void bvhBinAdd(BVHBin& bin, const AABB& aabb)
+{
+  bin.aabb = bin.count == 0 ? aabb : AABBUnion(bin.aabb, aabb);
+  bin.count++;
+}
+
+static AABB bvhCalculatePrimitivesAABB(const BVH& bvh, uint32 begin, uint32 end)
+{
+  AABB aabb = bvh.primitivesAABBs[bvh.primitives[begin]];
+  for(uint32 i = begin + 1; i < end; i++)
+  {
+    aabb = AABBUnion(aabb, bvh.primitivesAABBs[bvh.primitives[i]]);
+  }
+
+  return aabb;
+}
+
+static void bvhMakeLeaf(BVH& bvh, uint32 nodeIndex, uint32 begin, uint32 end)
+{
+  BVHNode& node = bvh.nodes[nodeIndex];
+  node.first = begin;
+  node.primitivesCount = end - begin;
+
+  for(uint32 i = begin; i < end; i++)
+  {
+    bvh.primitivesLeaves[bvh.primitives[i]] = nodeIndex;
+  }
+}
+
+/**
+ * Finds a split of [begin, end) primitives with the smallest SAH cost, binning their centroids.
+ * @return position of the split in bvh.primitives or BVH_INVALID_INDEX if a leaf is cheaper
+ */
+static uint32 bvhPartition(BVH& bvh, const AABB& nodeAABB, uint32 begin, uint32 end)
+{
+  AABB centroidsAABB;
+  for(uint32 i = begin; i < end; i++)
+  {
+    float3 centroid = bvh.primitivesAABBs[bvh.primitives[i]].getCenter();
+    centroidsAABB = i == begin ? AABB(centroid, centroid) : AABBUnion(centroidsAABB, AABB(centroid, centroid));
+  }
+
+  uint32 count = end - begin;
+  float32 bestCost = bvhAABBGetHalfArea(nodeAABB) * count;
+  uint32 bestAxis = 0;
+  uint32 bestBin = BVH_INVALID_INDEX;
+
+  for(uint32 axis = 0; axis < 3; axis++)
+  {
+    float32 axisMin = centroidsAABB.min[axis];
+    float32 axisExtent = centroidsAABB.max[axis] - axisMin;
+    if(axisExtent <= 0.0f)
+    {
+      continue;
+    }
+
+    BVHBin bins[BVH_BINS_COUNT];
+    float32 binScale = BVH_BINS_COUNT / axisExtent;
+
+    for(uint32 i = begin; i < end; i++)
+    {
+      const AABB& aabb = bvh.primitivesAABBs[bvh.primitives[i]];
+      uint32 bin = std::min<uint32>((aabb.getCenter()[axis] - axisMin) * binScale, BVH_BINS_COUNT - 1);
+      bvhBinAdd(bins[bin], aabb);
+    }
+
+    // NOTE: Sweep from the right accumulates costs of right sides of all possible splits
+    float32 rightCosts[BVH_BINS_COUNT];
+    BVHBin right;
+    for(uint32 bin = BVH_BINS_COUNT - 1; bin > 0; bin--)
+    {
+      if(bins[bin].count > 0)
+      {
+        right.aabb = right.count == 0 ? bins[bin].aabb : AABBUnion(right.aabb, bins[bin].aabb);
+        right.count += bins[bin].count;
+      }
+
+      rightCosts[bin] = right.count > 0 ? bvhAABBGetHalfArea(right.aabb) * right.count : 0.0f;
+    }
+
+    BVHBin left;
+    for(uint32 bin = 0; bin < BVH_BINS_COUNT - 1; bin++)
+    {
+      if(bins[bin].count > 0)
+      {
+        left.aabb = left.count == 0 ? bins[bin].aabb : AABBUnion(left.aabb, bins[bin].aabb);
+        left.count += bins[bin].count;
+      }
+
+      if(left.count == 0 || left.count == count)
+      {
+        continue;
+      }
+
+      float32 cost = bvhAABBGetHalfArea(left.aabb) * left.count + rightCosts[bin + 1];
+      if(cost < bestCost)
+      {
+        bestCost = cost;
+        bestAxis = axis;
+        bestBin = bin;
+      }
+    }
+  }
+
+  if(bestBin == BVH_INVALID_INDEX)
+  {
+    // NOTE: Centroids coincide (or splitting doesn't pay off), but leaf can't be that big
+    if(count > BVH_MAX_LEAF_PRIMITIVES)
+    {
+      return begin + count / 2;
+    }
+
+    return BVH_INVALID_INDEX;
+  }
+
+  float32 axisMin = centroidsAABB.min[bestAxis];
+  float32 binScale = BVH_BINS_COUNT / (centroidsAABB.max[bestAxis] - axisMin);
+
+  auto middle = std::partition(bvh.primitives.begin() + begin, bvh.primitives.begin() + end,
+                               [&](uint32 primitive)
+                               {
+                                 float32 centroid = bvh.primitivesAABBs[primitive].getCenter()[bestAxis];
+                                 uint32 bin = std::min<uint32>((centroid - axisMin) * binScale, BVH_BINS_COUNT - 1);
+                                 return bin <= bestBin;
+                               });
+
+  return middle - bvh.primitives.begin();
+}
+
+static void bvhBuildNode(BVH& bvh, uint32 nodeIndex, uint32 begin, uint32 end)
+{
+  bvh.nodes[nodeIndex].aabb = bvhCalculatePrimitivesAABB(bvh, begin, end);
+
+  uint32 split = BVH_INVALID_INDEX;
+  if(end - begin > 1)
+  {
+    split = bvhPartition(bvh, bvh.nodes[nodeIndex].aabb, begin, end);
+  }
+
+  if(split == BVH_INVALID_INDEX)
+  {
+    bvhMakeLeaf(bvh, nodeIndex, begin, end);
+    return;
+  }
+
+  if(split == begin || split == end)
+  {
+    split = begin + (end - begin) / 2;
+  }
+
+  // NOTE: Both children are allocated together, so that the right one is next to the left one
+  uint32 left = bvh.nodes.size();
+  bvh.nodes.resize(left + 2);
+
+  bvh.nodes[nodeIndex].first = left;
+  bvh.nodes[nodeIndex].primitivesCount = 0;
+  bvh.nodes[left].parent = nodeIndex;
+  bvh.nodes[left + 1].parent = nodeIndex;
+
+  bvhBuildNode(bvh, left, begin, split);
+  bvhBuildNode(bvh, left + 1, split, end);
+}
+
+void bvhBuild(BVH& bvh, const vector<AABB>& aabbs, const vector<uint32>& primitives)
+{
+  bvh.nodes.clear();
+  bvh.primitives.clear();
+  bvh.unboundedPrimitives.clear();
+
+  bvh.primitivesAABBs = aabbs;
+  bvh.primitivesLeaves.assign(aabbs.size(), BVH_INVALID_INDEX);
+
+  for(uint32 primitive: primitives)
+  {
+    if(bvhAABBIsBounded(aabbs[primitive]) == TRUE)
+    {
+      bvh.primitives.push_back(primitive);
+    }
+    else
+    {
+      bvh.unboundedPrimitives.push_back(primitive);
+    }
+  }
+
+  if(bvh.primitives.empty())
+  {
+    return;
+  }
+
+  // NOTE: Binary tree with N leaves has 2N - 1 nodes
+  bvh.nodes.reserve(2 * bvh.primitives.size());
+  bvh.nodes.resize(1);
+  bvh.nodes[0].parent = BVH_INVALID_INDEX;
+
+  bvhBuildNode(bvh, 0, 0, bvh.primitives.size());
+}
+
+bool8 bvhRefit(BVH& bvh, uint32 primitive, const AABB& aabb)
+{
+  uint32 node = bvh.primitivesLeaves[primitive];
+  bool8 bounded = bvhAABBIsBounded(aabb);
+
+  bvh.primitivesAABBs[primitive] = aabb;
+
+  if(node == BVH_INVALID_INDEX)
+  {
+    bool8 unbounded = std::find(bvh.unboundedPrimitives.begin(),
+                                bvh.unboundedPrimitives.end(),
+                                primitive) != bvh.unboundedPrimitives.end();
+
+    // NOTE: Primitive isn't a part of the BVH at all
+    if(unbounded == FALSE)
+    {
+      return TRUE;
+    }
+
+    // NOTE: Primitive has to be moved into the hierarchy
+    return bounded == FALSE;
+  }
+
+  if(bounded == FALSE)
+  {
+    return FALSE;
+  }
+
+  BVHNode& leaf = bvh.nodes[node];
+  leaf.aabb = bvhCalculatePrimitivesAABB(bvh, leaf.first, leaf.first + leaf.primitivesCount);
+
+  for(node = leaf.parent; node != BVH_INVALID_INDEX; node = bvh.nodes[node].parent)
+  {
+    BVHNode& inner = bvh.nodes[node];
+    AABB refitted = AABBUnion(bvh.nodes[inner.first].aabb, bvh.nodes[inner.first + 1].aabb);
+
+    // NOTE: Nodes above haven't changed either
+    if(bvhAABBEquals(refitted, inner.aabb) == TRUE)
+    {
+      break;
+    }
+
+    inner.aabb = refitted;
+  }
+
+  return TRUE;
+}
+
+template <typename AABBTest>
+static void bvhQuery(const BVH& bvh, AABBTest test, vector<uint32>& outPrimitives)
+{
+  outPrimitives.insert(outPrimitives.end(), bvh.unboundedPrimitives.begin(), bvh.unboundedPrimitives.end());
+
+  if(bvh.nodes.empty())
+  {
+    return;
+  }
+
+  // NOTE: SAH doesn't guarantee a balanced tree, so the depth isn't limited
+  vector<uint32> stack;
+  stack.reserve(64);
+  stack.push_back(0);
+
+  while(stack.empty() == FALSE)
+  {
+    const BVHNode& node = bvh.nodes[stack.back()];
+    stack.pop_back();
+
+    if(test(node.aabb) == FALSE)
+    {
+      continue;
+    }
+
+    if(node.primitivesCount > 0)
+    {
+      for(uint32 i = node.first; i < node.first + node.primitivesCount; i++)
+      {
+        uint32 primitive = bvh.primitives[i];
+        if(node.primitivesCount == 1 || test(bvh.primitivesAABBs[primitive]) == TRUE)
+        {
+          outPrimitives.push_back(primitive);
+        }
+      }
+    }
+    else
+    {
+      stack.push_back(node.first + 1);
+      stack.push_back(node.first);
+    }
+  }
+}
+
+void bvhQueryFrustum(const BVH& bvh, const Frustum& frustum, vector<uint32>& outPrimitives)
+{
+  bvhQuery(bvh, [&](const AABB& aabb) { return frustum.intersects(aabb); }, outPrimitives);
+}
+
+void bvhQuerySphere(const BVH& bvh, float3 center, float32 radius, vector<uint32>& outPrimitives)
+{
+  float32 radius2 = radius * radius;
+
+  bvhQuery(bvh,
+           [&](const AABB& aabb)
+           {
+             float3 closest = clamp(center, aabb.min, aabb.max);
+             return length2(closest - center) <= radius2 ? TRUE : FALSE;
+           },
+           outPrimitives);
+}
+
+void bvhQueryAABB(const BVH& bvh, const AABB& aabb, vector<uint32>& outPrimitives)
+{
+  bvhQuery(bvh,
+           [&](const AABB& nodeAABB)
+           {
+             return AABBOverlap(nodeAABB, aabb);
+           },
+           outPrimitives);
+}
+
+float32 rayIntersectAABB(const Ray& ray, const AABB& aabb, float32 maxDistance)
+{
+  float32 tMin;
+  float32 tMax;
+
+  return rayClipAABB(ray, aabb, maxDistance, tMin, tMax) == TRUE ? tMin : -1.0f;
+}
+
+bool8 rayClipAABB(const Ray& ray, const AABB& aabb, float32 maxDistance,
+                  float32& outMinDistance, float32& outMaxDistance)
+{
+  float32 tMin = 0.0f;
+  float32 tMax = maxDistance;
+
+  for(uint32 axis = 0; axis < 3; axis++)
+  {
+    float32 origin = ray.origin[axis];
+    float32 direction = ray.direction[axis];
+
+    // NOTE: Ray is parallel to the slab, it either always or never inside of it
+    if(direction == 0.0f)
+    {
+      if(origin < aabb.min[axis] || origin > aabb.max[axis])
+      {
+        return FALSE;
+      }
+
+      continue;
+    }
+
+    float32 invDirection = 1.0f / direction;
+    float32 t1 = (aabb.min[axis] - origin) * invDirection;
+    float32 t2 = (aabb.max[axis] - origin) * invDirection;
+
+    tMin = std::max(tMin, std::min(t1, t2));
+    tMax = std::min(tMax, std::max(t1, t2));
+
+    if(tMin > tMax)
+    {
+      return FALSE;
+    }
+  }
+
+  outMinDistance = tMin;
+  outMaxDistance = tMax;
+
+  return TRUE;
+}
+
+void bvhQueryRay(const BVH& bvh, const Ray& ray, float32 maxDistance, vector<BVHRayHit>& outHits)
+{
+  vector<uint32> primitives;
+  bvhQuery(bvh,
+           [&](const AABB& aabb) { return rayIntersectAABB(ray, aabb, maxDistance) >= 0.0f ? TRUE : FALSE; },
+           primitives);
+
+  uint32 firstHit = outHits.size();
+  for(uint32 primitive: primitives)
+  {
+    float32 distance = rayIntersectAABB(ray, bvh.primitivesAABBs[primitive], maxDistance);
+
+    // NOTE: Unbounded primitives aren't tested by the query
+    if(distance >= 0.0f || bvh.primitivesLeaves[primitive] == BVH_INVALID_INDEX)
+    {
+      outHits.push_back(BVHRayHit{primitive, std::max(distance, 0.0f)});
+    }
+  }
+
+  std::sort(outHits.begin() + firstHit, outHits.end(),
+            [](const BVHRayHit& lop, const BVHRayHit& rop)
+            {
+              return lop.distance < rop.distance;
+            });
+}
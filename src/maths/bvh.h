@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include "common.h"
+#include "primitives.h"
+
+static const uint32 BVH_INVALID_INDEX = (uint32)-1;
+static const uint32 BVH_MAX_LEAF_PRIMITIVES = 4;
+
+struct BVHNode
+{
+  AABB aabb;
+  uint32 parent;
+
+  // NOTE: Inner node - index of the left child (the right child goes right after it),
+  // leaf node - index of the first primitive in BVH::primitives
+  uint32 first;
+
+  // NOTE: 0 for inner nodes
+  uint32 primitivesCount;
+};
+
+/**
+ * Bounding volume hierarchy over a set of AABBs (primitives), which is built via binned SAH.
+ * Primitives are identified by their indices in the array of AABBs passed to bvhBuild(), so that
+ * e.g indices of a flat tree can be used directly.
+ *
+ * Unbounded primitives can't be placed into the hierarchy, they're kept aside and reported by
+ * each query.
+ */
+struct BVH
+{
+  std::vector<BVHNode> nodes;
+
+  // NOTE: Primitives referenced by leaf nodes
+  std::vector<uint32> primitives;
+  std::vector<uint32> unboundedPrimitives;
+
+  // NOTE: Indexed by primitive, leaf is BVH_INVALID_INDEX if primitive isn't in the hierarchy
+  std::vector<AABB> primitivesAABBs;
+  std::vector<uint32> primitivesLeaves;
+};
+
+struct BVHRayHit
+{
+  uint32 primitive;
+  // NOTE: Distance along the ray at which it enters AABB of the primitive
+  float32 distance;
+};
+
+/**
+ * @param aabbs AABBs of all primitives
+ * @param primitives indices of primitives (in aabbs) which are put into the hierarchy
+ */
+ENGINE_API void bvhBuild(BVH& bvh, const std::vector<AABB>& aabbs, const std::vector<uint32>& primitives);
+
+/**
+ * Updates AABB of the primitive and refits AABBs of its leaf and all nodes above it.
+ * @return FALSE if the hierarchy has to be rebuilt, i.e primitive has become unbounded (or bounded)
+ */
+ENGINE_API bool8 bvhRefit(BVH& bvh, uint32 primitive, const AABB& aabb);
+
+ENGINE_API void bvhQueryFrustum(const BVH& bvh, const Frustum& frustum, std::vector<uint32>& outPrimitives);
+ENGINE_API void bvhQuerySphere(const BVH& bvh, float3 center, float32 radius, std::vector<uint32>& outPrimitives);
+ENGINE_API void bvhQueryAABB(const BVH& bvh, const AABB& aabb, std::vector<uint32>& outPrimitives);
+
+/** @param outHits hits sorted by distance */
+ENGINE_API void bvhQueryRay(const BVH& bvh, const Ray& ray, float32 maxDistance, std::vector<BVHRayHit>& outHits);
+
+/** @return distance at which the ray enters AABB or a negative value if it misses */
+ENGINE_API float32 rayIntersectAABB(const Ray& ray, const AABB& aabb, float32 maxDistance);
+
+/**
+ * Clips the ray by AABB, outMinDistance is 0 if the ray starts inside of it.
+ * @return FALSE if the ray misses AABB
+ */
+ENGINE_API bool8 rayClipAABB(const Ray& ray, const AABB& aabb, float32 maxDistance,
+                             float32& outMinDistance, float32& outMaxDistance);
@@ -3,6 +3,7 @@
 #include <nlohmann/json.hpp>
 
 #include "common.h"
+#include "binary_document.h"
 
 template <typename T, int32 size>
 nlohmann::json vecToJson(const vec<T, size>& vect)
@@ -27,3 +28,15 @@ vec<T, size> jsonToVec(const nlohmann::json& jsonData)
 
   return result;
 }
+
+template <typename T, int32 size>
+vec<T, size> documentValueToVec(DocumentValue value)
+{
+  vec<T, size> result;
+  for(int32 i = 0; i < size; ++i)
+  {
+    result[i] = documentValueGet(value, std::to_string(i), T{});
+  }
+
+  return result;
+}
@@ -133,6 +133,8 @@ ENGINE_API AABB AABBCentered(float3 center, float3 dimensions);
 ENGINE_API AABB AABBUnion(const AABB& lop, const AABB& rop);
 ENGINE_API AABB AABBIntersection(const AABB& lop, const AABB& rop);
 ENGINE_API bool8 AABBIntersect(const AABB& lop, const AABB& rop);
+/** Unlike AABBIntersect(), touching boxes overlap too, so flat boxes (e.g of a floor) are handled */
+ENGINE_API bool8 AABBOverlap(const AABB& lop, const AABB& rop);
 
 // ----------------------------------------------------------------------------
 // Frustum
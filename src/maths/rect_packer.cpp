@@ -0,0 +1,190 @@
+#include <limits>
+#include <algorithm>
+
+#include "rect_packer.h"
+
+using std::vector;
+
+static bool8 rectPackerIntersects(const uint4& lop, const uint4& rop)
+{
+  return lop.x < rop.x + rop.z && rop.x < lop.x + lop.z &&
+         lop.y < rop.y + rop.w && rop.y < lop.y + lop.w;
+}
+
+static bool8 rectPackerContains(const uint4& outer, const uint4& inner)
+{
+  return inner.x >= outer.x && inner.x + inner.z <= outer.x + outer.z &&
+         inner.y >= outer.y && inner.y + inner.w <= outer.y + outer.w;
+}
+
+/** Splits the free rectangle into parts which don't intersect the used one (up to 4 of them) */
+static void rectPackerSplit(const uint4& freeRect, const uint4& usedRect, vector<uint4>& outRects)
+{
+  if(usedRect.x > freeRect.x)
+  {
+    outRects.push_back(uint4(freeRect.x, freeRect.y, usedRect.x - freeRect.x, freeRect.w));
+  }
+
+  if(usedRect.x + usedRect.z < freeRect.x + freeRect.z)
+  {
+    outRects.push_back(uint4(usedRect.x + usedRect.z,
+                             freeRect.y,
+                             freeRect.x + freeRect.z - (usedRect.x + usedRect.z),
+                             freeRect.w));
+  }
+
+  if(usedRect.y > freeRect.y)
+  {
+    outRects.push_back(uint4(freeRect.x, freeRect.y, freeRect.z, usedRect.y - freeRect.y));
+  }
+
+  if(usedRect.y + usedRect.w < freeRect.y + freeRect.w)
+  {
+    outRects.push_back(uint4(freeRect.x,
+                             usedRect.y + usedRect.w,
+                             freeRect.z,
+                             freeRect.y + freeRect.w - (usedRect.y + usedRect.w)));
+  }
+}
+
+/** Removes free rectangles which lie inside other ones */
+static void rectPackerPrune(RectPacker& packer)
+{
+  vector<uint4>& rects = packer.freeRects;
+
+  for(uint32 i = 0; i < rects.size(); i++)
+  {
+    for(uint32 j = i + 1; j < rects.size();)
+    {
+      if(rectPackerContains(rects[i], rects[j]) == TRUE)
+      {
+        rects.erase(rects.begin() + j);
+      }
+      else if(rectPackerContains(rects[j], rects[i]) == TRUE)
+      {
+        rects.erase(rects.begin() + i);
+        i--;
+        break;
+      }
+      else
+      {
+        j++;
+      }
+    }
+  }
+}
+
+/** @return TRUE if rectangles share a whole edge, outMerged is their union then */
+static bool8 rectPackerMerge(const uint4& lop, const uint4& rop, uint4& outMerged)
+{
+  if(lop.x == rop.x && lop.z == rop.z && (lop.y + lop.w == rop.y || rop.y + rop.w == lop.y))
+  {
+    outMerged = uint4(lop.x, std::min(lop.y, rop.y), lop.z, lop.w + rop.w);
+    return TRUE;
+  }
+
+  if(lop.y == rop.y && lop.w == rop.w && (lop.x + lop.z == rop.x || rop.x + rop.z == lop.x))
+  {
+    outMerged = uint4(std::min(lop.x, rop.x), lop.y, lop.z + rop.z, lop.w);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+void rectPackerInit(RectPacker& packer, uint2 size)
+{
+  packer.size = size;
+  packer.freeRects.clear();
+  packer.freeRects.push_back(uint4(0, 0, size.x, size.y));
+}
+
+bool8 rectPackerInsert(RectPacker& packer, uint2 size, uint2& outPosition)
+{
+  assert(size.x > 0 && size.y > 0);
+
+  // NOTE: Best short side fit, i.e the free rectangle which leaves the smallest leftover along
+  // one of the sides, ties are broken by the leftover along the other side
+  uint32 bestIndex = std::numeric_limits<uint32>::max();
+  uint32 bestShortSide = std::numeric_limits<uint32>::max();
+  uint32 bestLongSide = std::numeric_limits<uint32>::max();
+
+  for(uint32 i = 0; i < packer.freeRects.size(); i++)
+  {
+    const uint4& rect = packer.freeRects[i];
+    if(rect.z < size.x || rect.w < size.y)
+    {
+      continue;
+    }
+
+    uint32 leftoverX = rect.z - size.x;
+    uint32 leftoverY = rect.w - size.y;
+    uint32 shortSide = std::min(leftoverX, leftoverY);
+    uint32 longSide = std::max(leftoverX, leftoverY);
+
+    if(shortSide < bestShortSide || (shortSide == bestShortSide && longSide < bestLongSide))
+    {
+      bestIndex = i;
+      bestShortSide = shortSide;
+      bestLongSide = longSide;
+    }
+  }
+
+  if(bestIndex == std::numeric_limits<uint32>::max())
+  {
+    return FALSE;
+  }
+
+  uint4 usedRect = uint4(packer.freeRects[bestIndex].x, packer.freeRects[bestIndex].y, size.x, size.y);
+
+  vector<uint4>& splitRects = packer.splitRects;
+  splitRects.clear();
+
+  for(uint32 i = 0; i < packer.freeRects.size();)
+  {
+    if(rectPackerIntersects(packer.freeRects[i], usedRect) == FALSE)
+    {
+      i++;
+      continue;
+    }
+
+    rectPackerSplit(packer.freeRects[i], usedRect, splitRects);
+
+    packer.freeRects[i] = packer.freeRects.back();
+    packer.freeRects.pop_back();
+  }
+
+  packer.freeRects.insert(packer.freeRects.end(), splitRects.begin(), splitRects.end());
+  rectPackerPrune(packer);
+
+  outPosition = uint2(usedRect.x, usedRect.y);
+  return TRUE;
+}
+
+void rectPackerFree(RectPacker& packer, uint2 position, uint2 size)
+{
+  uint4 freedRect = uint4(position.x, position.y, size.x, size.y);
+
+  // NOTE: Freed rectangle grows while it shares a whole edge with some free rectangle
+  bool8 merged = TRUE;
+  while(merged == TRUE)
+  {
+    merged = FALSE;
+
+    for(uint32 i = 0; i < packer.freeRects.size(); i++)
+    {
+      uint4 mergedRect;
+      if(rectPackerMerge(freedRect, packer.freeRects[i], mergedRect) == TRUE)
+      {
+        freedRect = mergedRect;
+        packer.freeRects.erase(packer.freeRects.begin() + i);
+        merged = TRUE;
+
+        break;
+      }
+    }
+  }
+
+  packer.freeRects.push_back(freedRect);
+  rectPackerPrune(packer);
+}
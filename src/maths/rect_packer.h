@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include "common.h"
+
+/**
+ * Packer of rectangles into a fixed size area, which is based on the MaxRects algorithm (best short
+ * side fit). Free space is kept as a list of maximal free rectangles, which may overlap each other.
+ *
+ * Rectangles can be freed, freed space is merged with free rectangles it's adjacent to, but it's
+ * not extended to maximal rectangles, so packing degrades over time until everything is repacked.
+ */
+struct RectPacker
+{
+  uint2 size = uint2(0, 0);
+
+  // NOTE: x, y - position, z, w - size
+  std::vector<uint4> freeRects;
+
+  // NOTE: Intermediate data of rectPackerInsert(), kept to avoid allocations per insertion
+  std::vector<uint4> splitRects;
+};
+
+ENGINE_API void rectPackerInit(RectPacker& packer, uint2 size);
+
+/** @return FALSE if there is no space for the rectangle, outPosition isn't changed then */
+ENGINE_API bool8 rectPackerInsert(RectPacker& packer, uint2 size, uint2& outPosition);
+
+/** Returns space of the inserted rectangle back to the packer */
+ENGINE_API void rectPackerFree(RectPacker& packer, uint2 position, uint2 size);
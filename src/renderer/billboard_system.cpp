@@ -179,7 +179,9 @@ void billboardSystemDrawImagePix(ImagePtr image,
                                  float3 offset,
                                  bool8 usePainterOrder)
 {
-  float4 uvRect = calculateUVRect(imageGetSize(image), pixelOffset, pixelSize);
+  // NOTE: Pixel offset is given relative to the content of the image, i.e without its border
+  uint2 offsetInTexture = pixelOffset + uint2(imageGetBorder(image));
+  float4 uvRect = calculateUVRect(imageGetSize(image), offsetInTexture, pixelSize);
   
   billboardSystemDrawImage(image, worldPosition,
                            float2(uvRect.x, uvRect.y), float2(uvRect.z, uvRect.w), color, scale, offset, usePainterOrder);
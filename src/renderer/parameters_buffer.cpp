@@ -0,0 +1,261 @@
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+using std::vector;
+
+#include "logging.h"
+#include "memory_manager.h"
+#include "parameters_buffer.h"
+
+static const GLbitfield PARAMETERS_BUFFER_MAP_FLAGS =
+  GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+// NOTE: Waiting for a fence is flushed and repeated until it's signaled, timeout only allows to
+// report an error instead of hanging forever when something went wrong
+static const GLuint64 PARAMETERS_BUFFER_FENCE_TIMEOUT = 1000000000;
+
+struct ParametersBuffer
+{
+  GLuint handle = 0;
+  uint8* mappedData = nullptr;
+
+  uint32 elementSize = 0;
+  uint32 count = 0;
+  uint32 capacity = 0;
+  // NOTE: Size of a region in bytes, it's aligned to GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+  uint32 regionSize = 0;
+  uint32 currentRegion = 0;
+
+  GLsync fences[PARAMETERS_BUFFER_REGIONS_COUNT] = {};
+
+  // NOTE: Range of elements [begin, end), which has to be copied into a region before it's used
+  uint32 dirtyBegin[PARAMETERS_BUFFER_REGIONS_COUNT] = {};
+  uint32 dirtyEnd[PARAMETERS_BUFFER_REGIONS_COUNT] = {};
+
+  // NOTE: Up to date elements, regions are updated from here
+  vector<uint8> elements;
+};
+
+static void parametersBufferMarkDirty(ParametersBuffer* buffer, uint32 begin, uint32 end)
+{
+  for(uint32 region = 0; region < PARAMETERS_BUFFER_REGIONS_COUNT; region++)
+  {
+    if(buffer->dirtyBegin[region] >= buffer->dirtyEnd[region])
+    {
+      buffer->dirtyBegin[region] = begin;
+      buffer->dirtyEnd[region] = end;
+    }
+    else
+    {
+      buffer->dirtyBegin[region] = std::min(buffer->dirtyBegin[region], begin);
+      buffer->dirtyEnd[region] = std::max(buffer->dirtyEnd[region], end);
+    }
+  }
+}
+
+static void parametersBufferWaitFence(ParametersBuffer* buffer, uint32 region)
+{
+  GLsync fence = buffer->fences[region];
+  if(fence == nullptr)
+  {
+    return;
+  }
+
+  GLenum result = GL_TIMEOUT_EXPIRED;
+  while(result == GL_TIMEOUT_EXPIRED)
+  {
+    result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, PARAMETERS_BUFFER_FENCE_TIMEOUT);
+  }
+
+  if(result == GL_WAIT_FAILED)
+  {
+    LOG_ERROR("Waiting for a region of parameters buffer has failed");
+  }
+
+  glDeleteSync(fence);
+  buffer->fences[region] = nullptr;
+}
+
+static void parametersBufferReleaseStorage(ParametersBuffer* buffer)
+{
+  for(uint32 region = 0; region < PARAMETERS_BUFFER_REGIONS_COUNT; region++)
+  {
+    if(buffer->fences[region] != nullptr)
+    {
+      glDeleteSync(buffer->fences[region]);
+      buffer->fences[region] = nullptr;
+    }
+  }
+
+  if(buffer->handle != 0)
+  {
+    // NOTE: Deleted buffer is unmapped, GL keeps the storage alive while it's used by GPU
+    glDeleteBuffers(1, &buffer->handle);
+    buffer->handle = 0;
+    buffer->mappedData = nullptr;
+  }
+}
+
+static bool8 parametersBufferAllocateStorage(ParametersBuffer* buffer, uint32 capacity)
+{
+  parametersBufferReleaseStorage(buffer);
+
+  GLint alignment = 1;
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  alignment = std::max(alignment, 1);
+
+  uint32 size = capacity * buffer->elementSize;
+  buffer->regionSize = ((size + alignment - 1) / alignment) * alignment;
+  buffer->capacity = capacity;
+  buffer->currentRegion = 0;
+
+  GLsizeiptr totalSize = (GLsizeiptr)buffer->regionSize * PARAMETERS_BUFFER_REGIONS_COUNT;
+
+  glGenBuffers(1, &buffer->handle);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer->handle);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, totalSize, NULL, PARAMETERS_BUFFER_MAP_FLAGS);
+  buffer->mappedData = (uint8*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, totalSize,
+                                                PARAMETERS_BUFFER_MAP_FLAGS);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  if(buffer->mappedData == nullptr)
+  {
+    LOG_ERROR("Cannot map parameters buffer of %u elements", capacity);
+    return FALSE;
+  }
+
+  // NOTE: New storage has no valid data in any of the regions
+  if(buffer->count > 0)
+  {
+    parametersBufferMarkDirty(buffer, 0, buffer->count);
+  }
+
+  return TRUE;
+}
+
+bool8 createParametersBuffer(uint32 elementSize,
+                             uint32 initialCapacity,
+                             ParametersBuffer** outBuffer)
+{
+  assert(elementSize > 0);
+
+  ParametersBuffer* buffer = engineAllocObject<ParametersBuffer>(MEMORY_TYPE_GENERAL);
+  buffer->elementSize = elementSize;
+
+  if(parametersBufferAllocateStorage(buffer, std::max<uint32>(initialCapacity, 1)) == FALSE)
+  {
+    destroyParametersBuffer(buffer);
+    return FALSE;
+  }
+
+  *outBuffer = buffer;
+  return TRUE;
+}
+
+void destroyParametersBuffer(ParametersBuffer* buffer)
+{
+  parametersBufferReleaseStorage(buffer);
+  engineFreeObject(buffer, MEMORY_TYPE_GENERAL);
+}
+
+void parametersBufferResize(ParametersBuffer* buffer, uint32 count)
+{
+  if(count == buffer->count)
+  {
+    return;
+  }
+
+  uint32 prevCount = buffer->count;
+
+  buffer->count = count;
+  buffer->elements.resize(count * buffer->elementSize, 0);
+
+  if(count > buffer->capacity)
+  {
+    bool8 allocated = parametersBufferAllocateStorage(buffer, std::max(buffer->capacity * 2, count));
+    assert(allocated == TRUE);
+  }
+  else if(count > prevCount)
+  {
+    // NOTE: Regions can hold stale elements at the new indices, so they're uploaded even when
+    // they're never written
+    parametersBufferMarkDirty(buffer, prevCount, count);
+  }
+  else
+  {
+    for(uint32 region = 0; region < PARAMETERS_BUFFER_REGIONS_COUNT; region++)
+    {
+      buffer->dirtyEnd[region] = std::min(buffer->dirtyEnd[region], count);
+    }
+  }
+}
+
+uint32 parametersBufferGetCount(ParametersBuffer* buffer)
+{
+  return buffer->count;
+}
+
+void parametersBufferWrite(ParametersBuffer* buffer, uint32 index, const void* element)
+{
+  assert(index < buffer->count);
+
+  uint8* dst = &buffer->elements[index * buffer->elementSize];
+  if(memcmp(dst, element, buffer->elementSize) == 0)
+  {
+    return;
+  }
+
+  memcpy(dst, element, buffer->elementSize);
+  parametersBufferMarkDirty(buffer, index, index + 1);
+}
+
+void parametersBufferWriteRange(ParametersBuffer* buffer, uint32 index, uint32 count, const void* elements)
+{
+  assert(index + count <= buffer->count);
+
+  if(count == 0)
+  {
+    return;
+  }
+
+  uint8* dst = &buffer->elements[index * buffer->elementSize];
+  if(memcmp(dst, elements, count * buffer->elementSize) == 0)
+  {
+    return;
+  }
+
+  memcpy(dst, elements, count * buffer->elementSize);
+  parametersBufferMarkDirty(buffer, index, index + count);
+}
+
+void parametersBufferUpload(ParametersBuffer* buffer, GLuint binding)
+{
+  // NOTE: Commands which have been issued so far can read the current region
+  uint32 prevRegion = buffer->currentRegion;
+  if(buffer->fences[prevRegion] != nullptr)
+  {
+    glDeleteSync(buffer->fences[prevRegion]);
+  }
+  buffer->fences[prevRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  uint32 region = (prevRegion + 1) % PARAMETERS_BUFFER_REGIONS_COUNT;
+  parametersBufferWaitFence(buffer, region);
+  buffer->currentRegion = region;
+
+  uint32 begin = buffer->dirtyBegin[region];
+  uint32 end = buffer->dirtyEnd[region];
+  if(begin < end)
+  {
+    uint32 offset = begin * buffer->elementSize;
+    memcpy(buffer->mappedData + region * buffer->regionSize + offset,
+           &buffer->elements[offset],
+           (end - begin) * buffer->elementSize);
+  }
+
+  buffer->dirtyBegin[region] = 0;
+  buffer->dirtyEnd[region] = 0;
+
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, buffer->handle,
+                    region * buffer->regionSize, buffer->regionSize);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * Parameters buffer is a growable array of fixed-size elements (e.g GeometryParameters), which is
+ * exposed to shaders as an SSBO.
+ *
+ * GPU storage is persistently mapped and split into PARAMETERS_BUFFER_REGIONS_COUNT regions, one
+ * region is written by CPU while the previous ones are still read by GPU. Written elements are
+ * compared to the CPU copy of the array, so only elements which have actually changed are copied
+ * into the regions.
+ */
+
+static const uint32 PARAMETERS_BUFFER_REGIONS_COUNT = 3;
+
+struct ParametersBuffer;
+
+ENGINE_API bool8 createParametersBuffer(uint32 elementSize,
+                                        uint32 initialCapacity,
+                                        ParametersBuffer** outBuffer);
+ENGINE_API void destroyParametersBuffer(ParametersBuffer* buffer);
+
+/** Changes count of elements, storage grows by doubling of the capacity */
+ENGINE_API void parametersBufferResize(ParametersBuffer* buffer, uint32 count);
+ENGINE_API uint32 parametersBufferGetCount(ParametersBuffer* buffer);
+
+ENGINE_API void parametersBufferWrite(ParametersBuffer* buffer, uint32 index, const void* element);
+/** Writes count elements starting from the index, the range is compared and marked as changed at once */
+ENGINE_API void parametersBufferWriteRange(ParametersBuffer* buffer, uint32 index, uint32 count, const void* elements);
+
+/**
+ * Switches to the next region, copies elements which have changed since the region was used the
+ * last time and binds the region to the given SSBO binding.
+ * @warning Waits for GPU if it still reads the region (i.e it lags behind by more than
+ * PARAMETERS_BUFFER_REGIONS_COUNT - 1 uploads).
+ */
+ENGINE_API void parametersBufferUpload(ParametersBuffer* buffer, GLuint binding);
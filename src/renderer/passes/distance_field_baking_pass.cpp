@@ -0,0 +1,242 @@
+#include <cmath>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+using std::vector;
+
+#include <logging.h>
+#include <cvar_system.h>
+#include <memory_manager.h>
+#include <../bin/shaders/declarations.h>
+
+#include "distance_field_baking_pass.h"
+
+// NOTE: Count of cells along the longest side of bounds
+DECLARE_CVAR(engine_DistanceFieldBaking_Resolution, 32u);
+// NOTE: Cells, which are closer to the surface than this count of cells (plus a half of the diagonal),
+// get a brick
+DECLARE_CVAR(engine_DistanceFieldBaking_BandWidth, 1.0f);
+
+static const uint32 BRICK_SAMPLES_COUNT = BAKED_BRICK_SIZE * BAKED_BRICK_SIZE * BAKED_BRICK_SIZE;
+
+struct DistanceFieldBakingPassData
+{
+  GLuint cellsBufferHandle;
+
+  bool8 initialized;
+};
+
+static DistanceFieldBakingPassData data;
+
+bool8 initializeDistanceFieldBakingPass()
+{
+  if(data.initialized == TRUE)
+  {
+    return FALSE;
+  }
+
+  glGenBuffers(1, &data.cellsBufferHandle);
+
+  data.initialized = TRUE;
+
+  return TRUE;
+}
+
+void destroyDistanceFieldBakingPass()
+{
+  if(data.initialized == FALSE)
+  {
+    return;
+  }
+
+  glDeleteBuffers(1, &data.cellsBufferHandle);
+  data = DistanceFieldBakingPassData{};
+}
+
+static void distanceFieldBakingPassDispatch(ShaderProgram* bakeProgram, uint32 stage, uint32 itemsCount)
+{
+  GLuint programHandle = shaderProgramGetGLHandle(bakeProgram);
+
+  glUniform1ui(glGetUniformLocation(programHandle, "bakingStage"), stage);
+  glUniform1ui(glGetUniformLocation(programHandle, "itemsCount"), itemsCount);
+
+  glDispatchCompute((itemsCount + DISTANCE_FIELD_BAKING_LOCAL_SIZE - 1) / DISTANCE_FIELD_BAKING_LOCAL_SIZE, 1, 1);
+}
+
+bool8 distanceFieldBakingPassBake(ShaderProgram* bakeProgram,
+                                  uint32 geometryID,
+                                  const AABB& bounds,
+                                  BakedDistanceField** outField)
+{
+  const static CVarUintHandle resolutionHandle = StaticCVar_engine_DistanceFieldBaking_Resolution.getHandle();
+  const static CVarFloatHandle bandWidthHandle = StaticCVar_engine_DistanceFieldBaking_BandWidth.getHandle();
+
+  const uint32 resolution = CVarSystemRead(resolutionHandle);
+  const float32 bandWidth = CVarSystemRead(bandWidthHandle);
+
+  if(resolution < 3)
+  {
+    LOG_ERROR("Resolution of baked distance field has to be at least 3 cells!");
+    return FALSE;
+  }
+
+  // NOTE: One cell of margin is added on each side, so that the surface never touches bounds
+  float32 cellSize = maxelem(bounds.max - bounds.min) / float32(resolution - 2);
+  if(cellSize <= 0.0f)
+  {
+    LOG_ERROR("Cannot bake distance field of empty bounds!");
+    return FALSE;
+  }
+
+  float3 boundsMin = bounds.min - float3(cellSize, cellSize, cellSize);
+  float3 extent = bounds.max - bounds.min + 2.0f * float3(cellSize, cellSize, cellSize);
+  uint3 gridSize = uint3(max(int3(ceil(extent / cellSize)), int3(1, 1, 1)));
+  uint32 cellsCount = gridSize.x * gridSize.y * gridSize.z;
+
+  GLuint programHandle = shaderProgramGetGLHandle(bakeProgram);
+  shaderProgramUse(bakeProgram);
+
+  glUniform1ui(glGetUniformLocation(programHandle, "bakedGeometryID"), geometryID);
+  glUniform3f(glGetUniformLocation(programHandle, "boundsMin"), boundsMin.x, boundsMin.y, boundsMin.z);
+  glUniform1f(glGetUniformLocation(programHandle, "cellSize"), cellSize);
+  glUniform3i(glGetUniformLocation(programHandle, "gridSize"), gridSize.x, gridSize.y, gridSize.z);
+
+  // ------------------------------------------------------------------------
+  // 1. Sample distance at centers of cells
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, data.cellsBufferHandle);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, cellsCount * sizeof(float2), NULL, GL_DYNAMIC_READ);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DISTANCE_FIELD_BAKING_SSBO_BINDING, data.cellsBufferHandle);
+
+  distanceFieldBakingPassDispatch(bakeProgram, DISTANCE_FIELD_BAKING_STAGE_COARSE, cellsCount);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  vector<float2> cells(cellsCount);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, cellsCount * sizeof(float2), cells.data());
+
+  // ------------------------------------------------------------------------
+  // 2. Allocate bricks for cells in the narrow band, the rest store conservative distances
+
+  float32 halfDiagonal = cellSize * std::sqrt(3.0f) * 0.5f;
+  float32 bandDistance = halfDiagonal + cellSize * bandWidth;
+
+  vector<float4> indirection(cellsCount);
+  vector<float2> bricksCells;
+
+  for(uint32 i = 0; i < cellsCount; i++)
+  {
+    float32 distance = cells[i].x;
+    float32 id = cells[i].y;
+
+    if(std::abs(distance) <= bandDistance)
+    {
+      indirection[i] = float4(distance, float32(bricksCells.size()), id, 0.0f);
+
+      // NOTE: Index is passed as bits of a float, the same buffer is reused for bricks
+      float32 cellIndexBits;
+      memcpy(&cellIndexBits, &i, sizeof(uint32));
+      bricksCells.push_back(float2(cellIndexBits, 0.0f));
+    }
+    else
+    {
+      // NOTE: Any point of the cell is at least this far from the surface
+      float32 conservativeDistance = distance > 0.0f ? distance - halfDiagonal : distance + halfDiagonal;
+      indirection[i] = float4(conservativeDistance, -1.0f, id, 0.0f);
+    }
+  }
+
+  uint32 bricksCount = bricksCells.size();
+  uint32 atlasBricksPerAxis = std::max(1u, (uint32)std::ceil(std::cbrt(float32(bricksCount))));
+  while(atlasBricksPerAxis * atlasBricksPerAxis * atlasBricksPerAxis < bricksCount)
+  {
+    atlasBricksPerAxis++;
+  }
+
+  GLint max3DTextureSize = 0;
+  glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max3DTextureSize);
+  if(atlasBricksPerAxis * BAKED_BRICK_SIZE > (uint32)max3DTextureSize)
+  {
+    LOG_ERROR("Baked distance field requires too many bricks (%u)!", bricksCount);
+    return FALSE;
+  }
+
+  BakedDistanceField* field = engineAllocObject<BakedDistanceField>(MEMORY_TYPE_GENERAL);
+  field->bounds = AABB(boundsMin, boundsMin + float3(gridSize) * cellSize);
+  field->cellSize = cellSize;
+  field->gridSize = gridSize;
+  field->atlasBricksPerAxis = atlasBricksPerAxis;
+  field->bricksCount = bricksCount;
+
+  glGenTextures(1, &field->indirectionTexture);
+  glBindTexture(GL_TEXTURE_3D, field->indirectionTexture);
+  glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA32F, gridSize.x, gridSize.y, gridSize.z, 0, GL_RGBA, GL_FLOAT,
+               indirection.data());
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+  uint32 atlasSize = atlasBricksPerAxis * BAKED_BRICK_SIZE;
+
+  glGenTextures(1, &field->bricksAtlasTexture);
+  glBindTexture(GL_TEXTURE_3D, field->bricksAtlasTexture);
+  glTexStorage3D(GL_TEXTURE_3D, 1, GL_RG32F, atlasSize, atlasSize, atlasSize);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_3D, 0);
+
+  // ------------------------------------------------------------------------
+  // 3. Fill bricks
+
+  if(bricksCount > 0)
+  {
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bricksCount * sizeof(float2), bricksCells.data(), GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DISTANCE_FIELD_BAKING_SSBO_BINDING, data.cellsBufferHandle);
+
+    glBindImageTexture(0, field->bricksAtlasTexture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RG32F);
+    glUniform1i(glGetUniformLocation(programHandle, "atlasBricksPerAxis"), atlasBricksPerAxis);
+
+    distanceFieldBakingPassDispatch(bakeProgram, DISTANCE_FIELD_BAKING_STAGE_BRICKS, bricksCount * BRICK_SAMPLES_COUNT);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RG32F);
+  }
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  LOG_INFO("Distance field has been baked: %ux%ux%u cells, %u bricks",
+           gridSize.x, gridSize.y, gridSize.z, bricksCount);
+
+  *outField = field;
+  return TRUE;
+}
+
+void destroyBakedDistanceField(BakedDistanceField* field)
+{
+  glDeleteTextures(1, &field->indirectionTexture);
+  glDeleteTextures(1, &field->bricksAtlasTexture);
+
+  engineFreeObject(field, MEMORY_TYPE_GENERAL);
+}
+
+void bakedDistanceFieldBind(const BakedDistanceField* field, ShaderProgram* program)
+{
+  GLuint programHandle = shaderProgramGetGLHandle(program);
+
+  glActiveTexture(GL_TEXTURE0 + BAKED_INDIRECTION_TEXTURE_UNIT);
+  glBindTexture(GL_TEXTURE_3D, field->indirectionTexture);
+  glActiveTexture(GL_TEXTURE0 + BAKED_BRICKS_TEXTURE_UNIT);
+  glBindTexture(GL_TEXTURE_3D, field->bricksAtlasTexture);
+
+  glUniform3f(glGetUniformLocation(programHandle, "bakedBoundsMin"),
+              field->bounds.min.x, field->bounds.min.y, field->bounds.min.z);
+  glUniform1f(glGetUniformLocation(programHandle, "bakedCellSize"), field->cellSize);
+  glUniform3i(glGetUniformLocation(programHandle, "bakedGridSize"),
+              field->gridSize.x, field->gridSize.y, field->gridSize.z);
+  glUniform1i(glGetUniformLocation(programHandle, "bakedAtlasBricksPerAxis"), field->atlasBricksPerAxis);
+}
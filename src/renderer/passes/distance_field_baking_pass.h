@@ -0,0 +1,43 @@
+#pragma once
+
+#include <shader_program.h>
+#include <maths/primitives.h>
+
+/**
+ * Baked distance field is a sparse brick volume, which stores distance of a subtree in a narrow
+ * band around its surface. Bounds are split into a coarse grid of cubic cells (indirection map),
+ * cells near the surface point to bricks of BAKED_BRICK_SIZE^3 samples in a 3D atlas, the rest of
+ * cells store a single conservative distance.
+ *
+ * Field is defined in the space of the baked geometry, see baked_distance_field.glsl for sampling.
+ */
+struct BakedDistanceField
+{
+  GLuint indirectionTexture;
+  GLuint bricksAtlasTexture;
+
+  AABB bounds;
+  float32 cellSize;
+  uint3 gridSize;
+  uint32 atlasBricksPerAxis;
+  uint32 bricksCount;
+};
+
+ENGINE_API bool8 initializeDistanceFieldBakingPass();
+ENGINE_API void destroyDistanceFieldBakingPass();
+
+/**
+ * @param bakeProgram program generated by geometry, which includes bake_distance_field.glsl
+ * @param geometryID ID of the baked geometry
+ * @param bounds bounds of the subtree in the space of the baked geometry
+ * @return FALSE if baking has failed, outField isn't changed then
+ */
+ENGINE_API bool8 distanceFieldBakingPassBake(ShaderProgram* bakeProgram,
+                                             uint32 geometryID,
+                                             const AABB& bounds,
+                                             BakedDistanceField** outField);
+
+ENGINE_API void destroyBakedDistanceField(BakedDistanceField* field);
+
+/** Binds textures of the field and sets its parameters to the program, which is in use */
+ENGINE_API void bakedDistanceFieldBind(const BakedDistanceField* field, ShaderProgram* program);
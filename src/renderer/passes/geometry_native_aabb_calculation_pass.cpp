@@ -43,9 +43,13 @@ void destroyAABBCalculationPass()
 
 AABB AABBCalculationPassCalculateAABB(Asset* geometry)
 {
-  const static uint32& iterationsCount = CVarSystemReadUint("engine_AABBCalculation_IterationsCount");
-  const static uint32& viewportSize = CVarSystemReadUint("engine_AABBCalculation_RaysPerIteration");
-  const static uint32& localWorkgroupSize = CVarSystemReadUint("engine_AABBCalculation_LocalWorkGroupSize");  
+  const static CVarUintHandle iterationsCountHandle = CVarSystemGetUintHandle("engine_AABBCalculation_IterationsCount");
+  const static CVarUintHandle viewportSizeHandle = CVarSystemGetUintHandle("engine_AABBCalculation_RaysPerIteration");
+  const static CVarUintHandle localWorkgroupSizeHandle = CVarSystemGetUintHandle("engine_AABBCalculation_LocalWorkGroupSize");
+
+  const uint32 iterationsCount = CVarSystemRead(iterationsCountHandle);
+  const uint32 viewportSize = CVarSystemRead(viewportSizeHandle);
+  const uint32 localWorkgroupSize = CVarSystemRead(localWorkgroupSizeHandle);
 
   glBindBuffer(GL_SHADER_STORAGE_BUFFER, data.aabbBufferHandle);
 
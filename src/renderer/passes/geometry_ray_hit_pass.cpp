@@ -0,0 +1,119 @@
+#include <algorithm>
+
+#include <../bin/shaders/declarations.h>
+
+#include "geometry_ray_hit_pass.h"
+
+struct RayHitPassData
+{
+  GLuint hitsBufferHandle;
+  uint32 hitsCapacity;
+
+  // NOTE: Rays are traced with normalized directions, distances are converted back when read
+  std::vector<float32> directionLengths;
+
+  bool8 initialized;
+};
+
+static RayHitPassData data;
+
+bool8 initializeRayHitPass()
+{
+  if(data.initialized == TRUE)
+  {
+    return FALSE;
+  }
+
+  glGenBuffers(1, &data.hitsBufferHandle);
+  data.hitsCapacity = 0;
+
+  data.initialized = TRUE;
+
+  return TRUE;
+}
+
+void destroyRayHitPass()
+{
+  if(data.initialized == FALSE)
+  {
+    return;
+  }
+
+  glDeleteBuffers(1, &data.hitsBufferHandle);
+  data = RayHitPassData{};
+}
+
+void rayHitPassBeginBatch(uint32 raysCount)
+{
+  data.directionLengths.assign(raysCount, 0.0f);
+
+  if(raysCount == 0)
+  {
+    return;
+  }
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, data.hitsBufferHandle);
+
+  if(raysCount > data.hitsCapacity)
+  {
+    data.hitsCapacity = std::max(raysCount, 2 * data.hitsCapacity);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, data.hitsCapacity * sizeof(float32), NULL, GL_DYNAMIC_READ);
+  }
+
+  // NOTE: Rays which aren't traced (e.g they miss bounds of their leaves) keep the miss
+  const float32 miss = -1.0f;
+  glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32F, 0, raysCount * sizeof(float32), GL_RED, GL_FLOAT, &miss);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void rayHitPassTraceRay(ShaderProgram* rayHitProgram, uint32 geometryID, uint32 rayIndex,
+                        const Ray& ray, float32 minDistance, float32 maxDistance)
+{
+  assert(rayIndex < data.directionLengths.size());
+
+  float32 directionLength = length(ray.direction);
+  if(directionLength <= 0.0f)
+  {
+    return;
+  }
+
+  data.directionLengths[rayIndex] = directionLength;
+  float3 direction = ray.direction / directionLength;
+
+  shaderProgramUse(rayHitProgram);
+
+  glUniform1ui(0, geometryID);
+  glUniform3f(1, ray.origin.x, ray.origin.y, ray.origin.z);
+  glUniform3f(2, direction.x, direction.y, direction.z);
+  glUniform2f(3, minDistance * directionLength, maxDistance * directionLength);
+  glUniform1ui(4, rayIndex);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAY_HIT_SSBO_BINDING, data.hitsBufferHandle);
+  glDispatchCompute(1, 1, 1);
+}
+
+void rayHitPassReadHits(std::vector<float32>& outDistances)
+{
+  uint32 raysCount = data.directionLengths.size();
+  outDistances.assign(raysCount, -1.0f);
+
+  if(raysCount == 0)
+  {
+    return;
+  }
+
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, data.hitsBufferHandle);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, raysCount * sizeof(float32), outDistances.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  for(uint32 i = 0; i < raysCount; i++)
+  {
+    bool8 hit = outDistances[i] >= 0.0f && data.directionLengths[i] > 0.0f;
+    outDistances[i] = hit == TRUE ? outDistances[i] / data.directionLengths[i] : -1.0f;
+  }
+
+  data.directionLengths.clear();
+}
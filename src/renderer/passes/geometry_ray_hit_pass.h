@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include <shader_program.h>
+#include <maths/common.h>
+
+ENGINE_API bool8 initializeRayHitPass();
+ENGINE_API void destroyRayHitPass();
+
+/**
+ * Starts a batch of rays, each of them is sphere traced by a leaf on GPU (see rayHitPassTraceRay())
+ * and hits of all of them are read back at once (see rayHitPassReadHits()), so the batch stalls only
+ * once until the GPU finishes all the previous work. It's meant for rare queries, e.g picking.
+ */
+ENGINE_API void rayHitPassBeginBatch(uint32 raysCount);
+
+/**
+ * @param rayHitProgram program generated by the leaf, which includes calculate_ray_hit.glsl
+ * @param rayIndex index of the ray in the batch, its hit is stored at this index
+ * @param minDistance, maxDistance interval of the ray, which is traced
+ */
+ENGINE_API void rayHitPassTraceRay(ShaderProgram* rayHitProgram, uint32 geometryID, uint32 rayIndex,
+                                   const Ray& ray, float32 minDistance, float32 maxDistance);
+
+/**
+ * @param outDistances distances along rays of the batch at which they hit their leaves, negative
+ * values for rays which miss (or weren't traced)
+ */
+ENGINE_API void rayHitPassReadHits(std::vector<float32>& outDistances);
@@ -4,6 +4,7 @@
 #include "renderer/renderer.h"
 #include "renderer/renderer_utils.h"
 
+#include "passes_common.h"
 #include "normals_calculation_pass.h"
 
 struct NormalsCalculationPassData
@@ -11,6 +12,10 @@ struct NormalsCalculationPassData
   GLuint normalsFBO;
   
   ShaderProgramPtr normalsCalculationProgram;
+
+  std::vector<bool> visibleGeometries;
+  // NOTE: Intermediate data of calculateGeometriesVisibility(), kept to avoid allocations each frame
+  std::vector<uint32> visibleLeaves;
 };
 
 static void destroyNormalsCalculationPass(RenderPass* pass)
@@ -23,6 +28,50 @@ static void destroyNormalsCalculationPass(RenderPass* pass)
   engineFreeObject(data, MEMORY_TYPE_GENERAL);
 }
 
+/** Overwrites normals of pixels of visible leaves by normals calculated from their distances */
+static void normalsCalculationPassCalculateAnalyticNormals(NormalsCalculationPassData* data)
+{
+  Camera* camera = rendererGetPassedCamera();
+  const GeometryFlatTree& geometryTree = geometryGetFlatTree(sceneGetGeometryRoot(rendererGetPassedScene()));
+
+  calculateGeometriesVisibility(cameraGetFrustum(camera), geometryTree, data->visibleLeaves, data->visibleGeometries);
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  glEnable(GL_SCISSOR_TEST);
+
+  for(uint32 leaf: geometryTree.leaves)
+  {
+    ShaderProgram* normalsProgram = geometryTree.normalsPrograms[leaf];
+    if(normalsProgram == nullptr || geometryTree.enabled[leaf] == false || data->visibleGeometries[leaf] == false)
+    {
+      continue;
+    }
+
+    // NOTE: Leaves which cross the near plane may cover the whole viewport
+    int4 rect = int4(0, 0, viewport[2], viewport[3]);
+    calculateScreenRect(geometryTree.finalAABBs[leaf], cameraGetWorldNDCMat(camera), int2(viewport[2], viewport[3]), rect);
+
+    rect = clamp(rect, int4(0), int4(viewport[2], viewport[3], viewport[2], viewport[3]));
+    if(rect.x >= rect.z || rect.y >= rect.w)
+    {
+      continue;
+    }
+
+    glScissor(viewport[0] + rect.x, viewport[1] + rect.y, rect.z - rect.x, rect.w - rect.y);
+
+    shaderProgramUse(normalsProgram);
+    glUniform1i(0, 0);
+    glUniform1i(1, 1);
+    glUniform1ui(2, geometryTree.ids[leaf]);
+
+    drawTriangleNoVAO();
+  }
+
+  glDisable(GL_SCISSOR_TEST);
+}
+
 static bool8 normalsCalculationPassExecute(RenderPass* pass)
 {
   NormalsCalculationPassData* data = (NormalsCalculationPassData*)renderPassGetInternalData(pass);
@@ -37,6 +86,11 @@ static bool8 normalsCalculationPassExecute(RenderPass* pass)
   glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_GEOIDS_MAP_TEXTURE));
   
   drawTriangleNoVAO();
+
+  if(rendererGetPassedRenderingParameters().enableAnalyticNormals == TRUE)
+  {
+    normalsCalculationPassCalculateAnalyticNormals(data);
+  }
   
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
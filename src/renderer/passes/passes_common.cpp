@@ -1,8 +1,11 @@
+#include <cmath>
+
 #include <shader_manager.h>
 #include <renderer/renderer.h>
 #include <renderer/renderer_utils.h>
 
 #include "passes_common.h"
+#include "distance_field_baking_pass.h"
 
 ShaderProgram* createAndLinkTriangleShadingProgram(const char* fragmentShaderPath)
 {
@@ -21,37 +24,121 @@ ShaderProgram* createAndLinkTriangleShadingProgram(const char* fragmentShaderPat
   return program;
 }
 
-bool8 drawGeometryPostorder(Camera* camera,
-                            AssetPtr geometry,
+void calculateGeometriesVisibility(const Frustum& frustum,
+                                   const GeometryFlatTree& tree,
+                                   std::vector<uint32>& visibleLeaves,
+                                   std::vector<bool>& outVisible)
+{
+  outVisible.assign(tree.geometries.size(), false);
+
+  visibleLeaves.clear();
+  bvhQueryFrustum(tree.leavesBVH, frustum, visibleLeaves);
+
+  for(uint32 leaf: visibleLeaves)
+  {
+    outVisible[leaf] = true;
+  }
+
+  // NOTE: There are much fewer branches than leaves, so they're tested directly
+  for(uint32 i = 0; i < tree.geometries.size(); i++)
+  {
+    if(tree.firstChildren[i] != GEOMETRY_INVALID_INDEX)
+    {
+      outVisible[i] = frustum.intersects(tree.finalAABBs[i]) == TRUE;
+    }
+  }
+}
+
+void calculateGeometriesVisibility(const AABB& bounds,
+                                   const GeometryFlatTree& tree,
+                                   std::vector<uint32>& visibleLeaves,
+                                   std::vector<bool>& outVisible)
+{
+  outVisible.assign(tree.geometries.size(), false);
+
+  visibleLeaves.clear();
+  bvhQueryAABB(tree.leavesBVH, bounds, visibleLeaves);
+
+  for(uint32 leaf: visibleLeaves)
+  {
+    outVisible[leaf] = true;
+  }
+
+  for(uint32 i = 0; i < tree.geometries.size(); i++)
+  {
+    if(tree.firstChildren[i] != GEOMETRY_INVALID_INDEX)
+    {
+      outVisible[i] = AABBOverlap(tree.finalAABBs[i], bounds) == TRUE;
+    }
+  }
+}
+
+bool8 calculateScreenRect(const AABB& bounds, const float4x4& worldNDCMat, int2 viewportSize, int4& outRect)
+{
+  float2 minPixel = float2(viewportSize.x, viewportSize.y);
+  float2 maxPixel = float2(0.0f, 0.0f);
+
+  for(uint32 i = 0; i < 8; i++)
+  {
+    float4 ndcPosition = mul(worldNDCMat, float4(bounds.getVertex(i), 1.0f));
+    if(ndcPosition.w <= 0.0f)
+    {
+      return FALSE;
+    }
+
+    // NOTE: Inverse of the mapping in getWorldPos() (see common.glsl)
+    float2 ndc = ndcPosition.xy() / ndcPosition.w;
+    float2 pixel = float2((1.0f - ndc.x) * 0.5f * viewportSize.x, (ndc.y + 1.0f) * 0.5f * viewportSize.y);
+
+    minPixel = min(minPixel, pixel);
+    maxPixel = max(maxPixel, pixel);
+  }
+
+  outRect = int4(int32(std::floor(minPixel.x)) - 1,
+                 int32(std::floor(minPixel.y)) - 1,
+                 int32(std::ceil(maxPixel.x)) + 1,
+                 int32(std::ceil(maxPixel.y)) + 1);
+
+  return TRUE;
+}
+
+bool8 drawGeometryPostorder(const std::vector<bool>* visibleGeometries,
+                            const GeometryFlatTree& tree,
+                            uint32 geometryIndex,
                             uint32 indexInBranch,
                             uint32 culledSiblingsCount,
                             uint32& culledObjCounter,
                             bool8 shadowPath)
 {
-  const AABB& geometryAABB = geometryGetFinalAABB(geometry);
-  if(camera != nullptr && cameraGetFrustum(camera).intersects(geometryAABB) == FALSE)
+  if(visibleGeometries != nullptr && (*visibleGeometries)[geometryIndex] == false)
   {
     // NOTE: We've culled the object + its children
-    culledObjCounter += geometryGetTotalChildrenCount(geometry) + 1;
+    culledObjCounter += tree.totalChildrenCounts[geometryIndex] + 1;
     return FALSE;
   }
 
-  std::vector<AssetPtr>& children = geometryGetChildren(geometry);
-  
   // NOTE: This counter stores number of culled objects on the current level, this number is crucial for
   // some optimizations (e.g knowing that all previous siblings were culled, we know
   // that we must not read the stack)
   uint32 culledChildrenCount = 0;
   uint32 disabledSiblingsCount = 0;
-  for(uint32 i = 0; i < children.size(); i++)
+  uint32 childrenCount = 0;
+
+  // NOTE: Baked geometry samples the distance of its whole subtree, so its children aren't drawn
+  const BakedDistanceField* bakedField = geometryGetBakedDistanceField(tree.geometries[geometryIndex]);
+  uint32 firstChild = bakedField == nullptr ? tree.firstChildren[geometryIndex] : GEOMETRY_INVALID_INDEX;
+
+  for(uint32 child = firstChild;
+      child != GEOMETRY_INVALID_INDEX;
+      child = tree.nextSiblings[child], childrenCount++)
   {
-    if(geometryIsEnabled(children[i]) == FALSE)
+    if(tree.enabled[child] == FALSE)
     {
       disabledSiblingsCount++;
       continue;
     }
     
-    if(drawGeometryPostorder(camera, children[i], i - disabledSiblingsCount, culledChildrenCount, culledObjCounter, shadowPath) == FALSE)
+    if(drawGeometryPostorder(visibleGeometries, tree, child, childrenCount - disabledSiblingsCount, culledChildrenCount, culledObjCounter, shadowPath) == FALSE)
     {
       culledChildrenCount++;
     }
@@ -64,19 +151,24 @@ bool8 drawGeometryPostorder(Camera* camera,
     }
   }
 
-  if(!children.empty() && culledChildrenCount == children.size())
+  if(childrenCount > 0 && culledChildrenCount == childrenCount)
   {
     return FALSE;
   }
   
   // NOTE: If it's a root - omit further actions, because it's treated in a special way
   // (it's not a real geometry object)
-  if(geometryIsRoot(geometry) == TRUE)
+  if(tree.parents[geometryIndex] == GEOMETRY_INVALID_INDEX)
   {
     return TRUE;
   }
   
-  ShaderProgramPtr geometryProgram = shadowPath == TRUE ? geometryGetShadowProgram(geometry) : geometryGetDrawProgram(geometry);
+  ShaderProgram* geometryProgram = shadowPath == TRUE ? tree.shadowPrograms[geometryIndex] : tree.drawPrograms[geometryIndex];
+  if(bakedField != nullptr)
+  {
+    geometryProgram = geometryGetBakedProgram(tree.geometries[geometryIndex], shadowPath).raw();
+  }
+
   if(geometryProgram == nullptr)
   {
     return FALSE;
@@ -84,8 +176,13 @@ bool8 drawGeometryPostorder(Camera* camera,
 
   shaderProgramUse(geometryProgram);
 
+  if(bakedField != nullptr)
+  {
+    bakedDistanceFieldBind(bakedField, geometryProgram);
+  }
+
   glUniform1ui(glGetUniformLocation(shaderProgramGetGLHandle(geometryProgram), "geometryID"),
-               geometryGetID(geometry));
+               tree.ids[geometryIndex]);
   glUniform1ui(glGetUniformLocation(shaderProgramGetGLHandle(geometryProgram), "indexInBranch"),
                indexInBranch);
   glUniform1ui(glGetUniformLocation(shaderProgramGetGLHandle(geometryProgram), "prevCulledSiblingsCount"),
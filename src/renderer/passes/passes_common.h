@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include <camera.h>
 #include <shader_program.h>
 #include <assets/geometry.h>
@@ -7,10 +9,37 @@
 ShaderProgram* createAndLinkTriangleShadingProgram(const char* fragmentShaderPath);
 
 /**
+ * Calculates which nodes of the flat tree intersect the frustum, leaves are queried from BVH of the
+ * tree instead of being tested one by one.
+ * @param visibleLeaves intermediate list of leaves, it's kept by the caller to avoid allocations
+ */
+void calculateGeometriesVisibility(const Frustum& frustum,
+                                   const GeometryFlatTree& tree,
+                                   std::vector<uint32>& visibleLeaves,
+                                   std::vector<bool>& outVisible);
+
+/** The same as above, but nodes are tested against a box (e.g a volume of shadow casters) */
+void calculateGeometriesVisibility(const AABB& bounds,
+                                   const GeometryFlatTree& tree,
+                                   std::vector<uint32>& visibleLeaves,
+                                   std::vector<bool>& outVisible);
+
+/**
+ * Calculates screen rectangle (min x, min y, max x, max y in pixels) of the box with a margin of one
+ * pixel, the rectangle isn't clipped by the viewport.
+ * @return FALSE if some vertex of the box isn't in front of the camera, outRect isn't changed then
+ */
+bool8 calculateScreenRect(const AABB& bounds, const float4x4& worldNDCMat, int2 viewportSize, int4& outRect);
+
+/**
+ * @param visibleGeometries visibility of the nodes (see calculateGeometriesVisibility()), nothing
+ * is culled if it's nullptr
+ * @param geometryIndex index of the geometry in the flat tree (see geometryGetFlatTree())
  * @return boolean value which indicates whether it was rendered or not
  */
-bool8 drawGeometryPostorder(Camera* camera,
-                            AssetPtr geometry,
+bool8 drawGeometryPostorder(const std::vector<bool>* visibleGeometries,
+                            const GeometryFlatTree& tree,
+                            uint32 geometryIndex,
                             uint32 indexInBranch,
                             uint32 culledSiblingsCount,
                             uint32& culledObjCounter,
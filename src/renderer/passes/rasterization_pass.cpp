@@ -14,10 +14,20 @@ struct RasterizationPassData
 {
   GLuint raysMapFBO;
   GLuint geometryAndDistancesFBO;
+  GLuint coneDistancesFBO;
   
   ShaderProgramPtr preparingProgram;
   ShaderProgramPtr raysMoverProgram;
   ShaderProgramPtr resultsExtractionProgram;
+
+  ShaderProgramPtr conePreparingProgram;
+  ShaderProgramPtr coneRaysMoverProgram;
+  ShaderProgramPtr coneResultsExtractionProgram;
+
+  // NOTE: Visibility doesn't change between iterations (and cone marching), so culling is done once
+  std::vector<bool> visibleGeometries;
+  // NOTE: Intermediate data of calculateGeometriesVisibility(), kept to avoid allocations each frame
+  std::vector<uint32> visibleLeaves;
 };
 
 static void destroyRasterizationPass(RenderPass* pass)
@@ -25,35 +35,37 @@ static void destroyRasterizationPass(RenderPass* pass)
   RasterizationPassData* data = (RasterizationPassData*)renderPassGetInternalData(pass);
   glDeleteFramebuffers(1, &data->raysMapFBO);
   glDeleteFramebuffers(1, &data->geometryAndDistancesFBO);
+  glDeleteFramebuffers(1, &data->coneDistancesFBO);
 
   data->preparingProgram = ShaderProgramPtr(nullptr);
   data->raysMoverProgram = ShaderProgramPtr(nullptr);
   data->resultsExtractionProgram = ShaderProgramPtr(nullptr);
+  data->conePreparingProgram = ShaderProgramPtr(nullptr);
+  data->coneRaysMoverProgram = ShaderProgramPtr(nullptr);
+  data->coneResultsExtractionProgram = ShaderProgramPtr(nullptr);
   
   engineFreeObject(data, MEMORY_TYPE_GENERAL);
 }
 
-static bool8 rasterizationPassPrepareToRasterize(RasterizationPassData* data)
+static bool8 coneMarchingIsEnabled(const RenderingParameters& renderingParams)
 {
-  shaderProgramUse(data->preparingProgram);
-  glBindFramebuffer(GL_FRAMEBUFFER, data->raysMapFBO);
-  glClearColor(0, 0, 0, 0);
-  
-  drawTriangleNoVAO();
-
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-  return TRUE;
+  return renderingParams.coneBlockSize > 1 && renderingParams.coneItersMaxCount > 0 ? TRUE : FALSE;
 }
 
-static bool8 rasterizationPassRasterize(RasterizationPassData* data)
+/**
+ * Moves rays of the bound framebuffer until they hit something or iterations are over. Moving is
+ * done by the given program, which exports stencil value of rays that have to be moved further.
+ */
+static void rasterizationPassMarchRays(RasterizationPassData* data,
+                                       ShaderProgram* raysMoverProgram,
+                                       uint32 itersMaxCount)
 {
-  const RenderingParameters& renderingParams = rendererGetPassedRenderingParameters();
-  static uint32& culledObjectsCounter = CVarSystemGetUint("engine_RasterizationStatistics_LastFrameCulledObjects");
-  
-  Scene* sceneToRasterize = rendererGetPassedScene();
+  const static CVarUintHandle culledObjectsCounterHandle =
+    StaticCVar_engine_RasterizationStatistics_LastFrameCulledObjects.getHandle();
+  uint32 culledObjectsCounter = 0;
 
-  glBindFramebuffer(GL_FRAMEBUFFER, data->raysMapFBO);
+  Scene* sceneToRasterize = rendererGetPassedScene();
+  const GeometryFlatTree& geometryTree = geometryGetFlatTree(sceneGetGeometryRoot(sceneToRasterize));
 
   glClearStencil(1);
   glClear(GL_STENCIL_BUFFER_BIT);  
@@ -62,7 +74,7 @@ static bool8 rasterizationPassRasterize(RasterizationPassData* data)
   glEnable(GL_BLEND);
   pushBlend(GL_FUNC_ADD, GL_FUNC_ADD, GL_ZERO, GL_ONE, GL_ONE, GL_ONE);
   
-  for(uint32 i = 0; i < renderingParams.rasterItersMaxCount; i++)
+  for(uint32 i = 0; i < itersMaxCount; i++)
   {
     culledObjectsCounter = 0;
 
@@ -75,8 +87,9 @@ static bool8 rasterizationPassRasterize(RasterizationPassData* data)
     glStencilOpSeparate(GL_FRONT_AND_BACK, GL_KEEP, GL_KEEP, GL_KEEP);
 
     
-    drawGeometryPostorder(rendererGetPassedCamera(),
-                          sceneGetGeometryRoot(sceneToRasterize),
+    drawGeometryPostorder(&data->visibleGeometries,
+                          geometryTree,
+                          geometryTree.getRootIndex(),
                           0, 0,
                           culledObjectsCounter);
 
@@ -88,8 +101,8 @@ static bool8 rasterizationPassRasterize(RasterizationPassData* data)
     glStencilFuncSeparate(GL_FRONT_AND_BACK, GL_ALWAYS, 1, 0xFF);
     glStencilOpSeparate(GL_FRONT_AND_BACK, GL_KEEP, GL_KEEP, GL_REPLACE);
     
-    shaderProgramUse(data->raysMoverProgram);
-    glUniform1ui(glGetUniformLocation(shaderProgramGetGLHandle(data->raysMoverProgram), "curIterIdx"), i);
+    shaderProgramUse(raysMoverProgram);
+    glUniform1ui(glGetUniformLocation(shaderProgramGetGLHandle(raysMoverProgram), "curIterIdx"), i);
     drawTriangleNoVAO();
 
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);    
@@ -98,6 +111,91 @@ static bool8 rasterizationPassRasterize(RasterizationPassData* data)
   assert(popBlend() == TRUE);
   glDisable(GL_BLEND);
   glDisable(GL_STENCIL_TEST);
+
+  CVarSystemSet(culledObjectsCounterHandle, culledObjectsCounter);
+}
+
+static bool8 rasterizationPassCalculateVisibility(RasterizationPassData* data)
+{
+  Scene* sceneToRasterize = rendererGetPassedScene();
+  const GeometryFlatTree& geometryTree = geometryGetFlatTree(sceneGetGeometryRoot(sceneToRasterize));
+
+  calculateGeometriesVisibility(cameraGetFrustum(rendererGetPassedCamera()), geometryTree,
+                                data->visibleLeaves, data->visibleGeometries);
+
+  return TRUE;
+}
+
+// NOTE: Traces one cone per block of pixels in a low resolution, distance reached by the axis of
+// the cone is safe for all rays of the block, it's stored into the cone distances map
+static bool8 rasterizationPassMarchCones(RasterizationPassData* data)
+{
+  const RenderingParameters& renderingParams = rendererGetPassedRenderingParameters();
+  uint32 blockSize = renderingParams.coneBlockSize;
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  pushViewport(0, 0, (viewport[2] + blockSize - 1) / blockSize, (viewport[3] + blockSize - 1) / blockSize);
+
+  // 1. Prepare cones
+  shaderProgramUse(data->conePreparingProgram);
+  glUniform1ui(glGetUniformLocation(shaderProgramGetGLHandle(data->conePreparingProgram), "coneBlockSize"), blockSize);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, data->raysMapFBO);
+  drawTriangleNoVAO();
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  // 2. March cones
+  shaderProgramUse(data->coneRaysMoverProgram);
+  glUniform1ui(glGetUniformLocation(shaderProgramGetGLHandle(data->coneRaysMoverProgram), "coneBlockSize"), blockSize);
+
+  rasterizationPassMarchRays(data, data->coneRaysMoverProgram.raw(), renderingParams.coneItersMaxCount);
+
+  // 3. Extract distances
+  glBindFramebuffer(GL_FRAMEBUFFER, data->coneDistancesFBO);
+  shaderProgramUse(data->coneResultsExtractionProgram);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_RAYS_MAP_TEXTURE));
+  glUniform1i(0, 0);
+  drawTriangleNoVAO();
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  assert(popViewport() == TRUE);
+
+  return TRUE;
+}
+
+static bool8 rasterizationPassPrepareToRasterize(RasterizationPassData* data)
+{
+  const RenderingParameters& renderingParams = rendererGetPassedRenderingParameters();
+  uint32 coneBlockSize = coneMarchingIsEnabled(renderingParams) == TRUE ? renderingParams.coneBlockSize : 0;
+
+  shaderProgramUse(data->preparingProgram);
+  glUniform1ui(glGetUniformLocation(shaderProgramGetGLHandle(data->preparingProgram), "coneBlockSize"), coneBlockSize);
+
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_CONE_DISTANCES_MAP_TEXTURE));
+  glUniform1i(2, 2);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, data->raysMapFBO);
+  glClearColor(0, 0, 0, 0);
+  
+  drawTriangleNoVAO();
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  return TRUE;
+}
+
+static bool8 rasterizationPassRasterize(RasterizationPassData* data)
+{
+  const RenderingParameters& renderingParams = rendererGetPassedRenderingParameters();
+
+  glBindFramebuffer(GL_FRAMEBUFFER, data->raysMapFBO);
+
+  rasterizationPassMarchRays(data, data->raysMoverProgram.raw(), renderingParams.rasterItersMaxCount);
   
   glBindFramebuffer(GL_FRAMEBUFFER, 0);  
   
@@ -129,6 +227,13 @@ static bool8 rasterizationPassExecute(RenderPass* pass)
 {
   RasterizationPassData* data = (RasterizationPassData*)renderPassGetInternalData(pass);
 
+  assert(rasterizationPassCalculateVisibility(data));
+
+  if(coneMarchingIsEnabled(rendererGetPassedRenderingParameters()) == TRUE)
+  {
+    assert(rasterizationPassMarchCones(data));
+  }
+
   assert(rasterizationPassPrepareToRasterize(data));
   assert(rasterizationPassRasterize(data));
   assert(rasterizationPassExtractResults(data));
@@ -164,6 +269,9 @@ bool8 createRasterizationPass(RenderPass** outPass)
                                                      rendererGetResourceHandle(RR_DEPTH1_MAP_TEXTURE));
   assert(data->geometryAndDistancesFBO != 0);
 
+  data->coneDistancesFBO = createFramebuffer(rendererGetResourceHandle(RR_CONE_DISTANCES_MAP_TEXTURE));
+  assert(data->coneDistancesFBO != 0);
+
   data->preparingProgram = ShaderProgramPtr(createAndLinkTriangleShadingProgram("shaders/prepare_to_raster.frag"));
   assert(data->preparingProgram != nullptr);
 
@@ -172,6 +280,15 @@ bool8 createRasterizationPass(RenderPass** outPass)
 
   data->resultsExtractionProgram = ShaderProgramPtr(createAndLinkTriangleShadingProgram("shaders/extract_raster_results.frag"));
   assert(data->resultsExtractionProgram != nullptr);
+
+  data->conePreparingProgram = ShaderProgramPtr(createAndLinkTriangleShadingProgram("shaders/prepare_to_cone_raster.frag"));
+  assert(data->conePreparingProgram != nullptr);
+
+  data->coneRaysMoverProgram = ShaderProgramPtr(createAndLinkTriangleShadingProgram("shaders/cone_rays_mover.frag"));
+  assert(data->coneRaysMoverProgram != nullptr);
+
+  data->coneResultsExtractionProgram = ShaderProgramPtr(createAndLinkTriangleShadingProgram("shaders/extract_cone_results.frag"));
+  assert(data->coneResultsExtractionProgram != nullptr);
   
   renderPassSetInternalData(*outPass, data);
   
@@ -0,0 +1,355 @@
+#include <algorithm>
+
+#include "cvar_system.h"
+#include "shader_program.h"
+#include "memory_manager.h"
+#include "shader_manager.h"
+#include "assets/light_source.h"
+#include "renderer/renderer.h"
+#include "renderer/renderer_utils.h"
+#include <../bin/shaders/declarations.h>
+
+#include "passes_common.h"
+#include "sdf_occlusion_pass.h"
+#include "distance_field_baking_pass.h"
+
+// NOTE: 0 - off, 1 - low (4 samples per pixel), 2 - high (8 samples per pixel)
+DECLARE_CVAR(engine_SDFOcclusion_Quality, 1u);
+// NOTE: Distances of the farthest samples along the normal and toward the light source
+DECLARE_CVAR(engine_SDFOcclusion_AODistance, 0.5f);
+DECLARE_CVAR(engine_SDFOcclusion_ShadowDistance, 2.0f);
+
+static const uint32 SDF_OCCLUSION_QUALITY_OFF = 0;
+static const uint32 SDF_OCCLUSION_QUALITY_LOW = 1;
+
+struct SDFOcclusionPassData
+{
+  GLuint samplesFBO;
+  // NOTE: Occlusion map, shadows map isn't touched, since it's cached by the shadow pass
+  GLuint resolveFBO;
+
+  ShaderProgramPtr resolveProgram;
+};
+
+struct SDFOcclusionSettings
+{
+  uint32 samplesCount;
+  float32 aoDistance;
+  float32 shadowDistance;
+  int32 shadowLightIndex;
+};
+
+static void destroySDFOcclusionPass(RenderPass* pass)
+{
+  SDFOcclusionPassData* data = (SDFOcclusionPassData*)renderPassGetInternalData(pass);
+  glDeleteFramebuffers(1, &data->samplesFBO);
+  glDeleteFramebuffers(1, &data->resolveFBO);
+
+  data->resolveProgram = ShaderProgramPtr(nullptr);
+
+  engineFreeObject(data, MEMORY_TYPE_GENERAL);
+}
+
+/** @return index of the first light source, which casts shadows, or -1 */
+static int32 sdfOcclusionPassFindKeyLight()
+{
+  if(rendererGetPassedRenderingParameters().enableShadows == FALSE)
+  {
+    return -1;
+  }
+
+  const std::vector<AssetPtr> lightSources = sceneGetEnabledLightSources(rendererGetPassedScene());
+
+  // NOTE: Only light sources with a channel in the shadows map are considered (see shadow_rasterization_pass.cpp)
+  uint32 lightSourcesCount = std::min<uint32>(lightSources.size(), MAX_SHADOW_LIGHT_SOURCES_COUNT);
+  for(uint32 lightIndex = 0; lightIndex < lightSourcesCount; lightIndex++)
+  {
+    if(lightSourceShadowIsEnabled(lightSources[lightIndex]) == TRUE)
+    {
+      return lightIndex;
+    }
+  }
+
+  return -1;
+}
+
+static void sdfOcclusionPassSetUniforms(const SDFOcclusionSettings& settings)
+{
+  glUniform1i(0, 0);
+  glUniform1i(1, 1);
+  glUniform1ui(3, settings.samplesCount);
+  glUniform1f(4, settings.aoDistance);
+  glUniform1f(5, settings.shadowDistance);
+  glUniform1i(6, settings.shadowLightIndex);
+}
+
+/**
+ * Geometry changes samples only of pixels, which are closer to it than twice the distance of the
+ * farthest sample, so it's drawn only over the screen rectangle of its bounds extended by it.
+ * @return FALSE if the geometry doesn't affect any pixel
+ */
+static bool8 sdfOcclusionPassCalculateRect(const AABB& aabb, float32 reach, const int4& viewport, int4& outRect)
+{
+  Camera* camera = rendererGetPassedCamera();
+
+  AABB reachAABB = AABB(aabb.min - float3(reach), aabb.max + float3(reach));
+  if(cameraGetFrustum(camera).intersects(reachAABB) == FALSE)
+  {
+    return FALSE;
+  }
+
+  // NOTE: Bounds which cross the near plane may cover the whole viewport
+  outRect = int4(0, 0, viewport.z, viewport.w);
+  calculateScreenRect(reachAABB, cameraGetWorldNDCMat(camera), int2(viewport.z, viewport.w), outRect);
+
+  outRect = clamp(outRect, int4(0), int4(viewport.z, viewport.w, viewport.z, viewport.w));
+  return outRect.x < outRect.z && outRect.y < outRect.w ? TRUE : FALSE;
+}
+
+/**
+ * Samples distances of leaves and baked subtrees of the subtree, they're combined by min, so branches
+ * which aren't unions are sampled as a whole (see GeometryFlatTree::occlusionPrograms)
+ */
+static void sdfOcclusionPassSampleSubtree(const GeometryFlatTree& tree, uint32 geometryIndex,
+                                          const SDFOcclusionSettings& settings, const int4& viewport)
+{
+  if(tree.enabled[geometryIndex] == false)
+  {
+    return;
+  }
+
+  // NOTE: Root isn't a real geometry, it's never baked
+  bool8 isRoot = tree.parents[geometryIndex] == GEOMETRY_INVALID_INDEX ? TRUE : FALSE;
+
+  // NOTE: Baked geometry samples the distance of its whole subtree, so its children aren't sampled
+  const BakedDistanceField* bakedField = isRoot == FALSE ? geometryGetBakedDistanceField(tree.geometries[geometryIndex]) : nullptr;
+  bool8 isBranch = tree.firstChildren[geometryIndex] != GEOMETRY_INVALID_INDEX ? TRUE : FALSE;
+
+  if(bakedField == nullptr && isBranch == TRUE && (isRoot == TRUE || tree.occlusionPrograms[geometryIndex] == nullptr))
+  {
+    for(uint32 child = tree.firstChildren[geometryIndex];
+        child != GEOMETRY_INVALID_INDEX;
+        child = tree.nextSiblings[child])
+    {
+      sdfOcclusionPassSampleSubtree(tree, child, settings, viewport);
+    }
+
+    return;
+  }
+
+  if(isRoot == TRUE)
+  {
+    return;
+  }
+
+  ShaderProgram* program = bakedField != nullptr ?
+    geometryGetBakedOcclusionProgram(tree.geometries[geometryIndex]).raw() : tree.occlusionPrograms[geometryIndex];
+
+  if(program == nullptr)
+  {
+    return;
+  }
+
+  float32 reach = 2.0f * std::max(settings.aoDistance, settings.shadowDistance);
+
+  int4 rect;
+  if(sdfOcclusionPassCalculateRect(tree.finalAABBs[geometryIndex], reach, viewport, rect) == FALSE)
+  {
+    return;
+  }
+
+  glScissor(viewport.x + rect.x, viewport.y + rect.y, rect.z - rect.x, rect.w - rect.y);
+
+  shaderProgramUse(program);
+
+  if(bakedField != nullptr)
+  {
+    bakedDistanceFieldBind(bakedField, program);
+  }
+
+  sdfOcclusionPassSetUniforms(settings);
+
+  // NOTE: Code of the subtree of a branch refers to its leaves directly
+  if(bakedField != nullptr || isBranch == FALSE)
+  {
+    glUniform1ui(2, tree.ids[geometryIndex]);
+  }
+
+  drawTriangleNoVAO();
+}
+
+static void sdfOcclusionPassSampleDistances(SDFOcclusionPassData* data, const SDFOcclusionSettings& settings)
+{
+  const GeometryFlatTree& geometryTree = geometryGetFlatTree(sceneGetGeometryRoot(rendererGetPassedScene()));
+
+  glBindFramebuffer(GL_FRAMEBUFFER, data->samplesFBO);
+
+  // NOTE: Samples, which no geometry reaches, aren't occluded
+  const GLfloat farDistance[] = {INF_DISTANCE, INF_DISTANCE, INF_DISTANCE, INF_DISTANCE};
+  for(uint32 i = 0; i < SDF_OCCLUSION_SAMPLES_LAYERS_COUNT; i++)
+  {
+    glClearBufferfv(GL_COLOR, i, farDistance);
+  }
+
+  if(geometryTree.geometries.empty())
+  {
+    return;
+  }
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_DEPTH1_MAP_TEXTURE));
+
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_NORMALS_MAP_TEXTURE));
+
+  glEnable(GL_SCISSOR_TEST);
+  glEnable(GL_BLEND);
+  pushBlend(GL_MIN, GL_MIN, GL_ONE, GL_ONE, GL_ONE, GL_ONE);
+
+  sdfOcclusionPassSampleSubtree(geometryTree, 0, settings, int4(viewport[0], viewport[1], viewport[2], viewport[3]));
+
+  popBlend();
+  glDisable(GL_BLEND);
+  glDisable(GL_SCISSOR_TEST);
+}
+
+static void sdfOcclusionPassResolve(SDFOcclusionPassData* data, const SDFOcclusionSettings& settings)
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, data->resolveFBO);
+  shaderProgramUse(data->resolveProgram);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_DEPTH1_MAP_TEXTURE));
+
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_NORMALS_MAP_TEXTURE));
+
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, rendererGetResourceHandle(RR_OCCLUSION_SAMPLES_MAP_TEXTURE));
+
+  sdfOcclusionPassSetUniforms(settings);
+  glUniform1i(2, 2);
+
+  drawTriangleNoVAO();
+}
+
+static bool8 sdfOcclusionPassExecute(RenderPass* pass)
+{
+  const static CVarUintHandle qualityHandle = StaticCVar_engine_SDFOcclusion_Quality.getHandle();
+  const static CVarFloatHandle aoDistanceHandle = StaticCVar_engine_SDFOcclusion_AODistance.getHandle();
+  const static CVarFloatHandle shadowDistanceHandle = StaticCVar_engine_SDFOcclusion_ShadowDistance.getHandle();
+
+  const uint32 quality = CVarSystemRead(qualityHandle);
+  const float32 aoDistance = CVarSystemRead(aoDistanceHandle);
+  const float32 shadowDistance = CVarSystemRead(shadowDistanceHandle);
+
+  SDFOcclusionPassData* data = (SDFOcclusionPassData*)renderPassGetInternalData(pass);
+
+  // NOTE: Shading reads the occlusion map anyway, so it's cleared even if the pass is off
+  const GLfloat noOcclusion[] = {1.0f, 1.0f, 1.0f, 1.0f};
+  glBindFramebuffer(GL_FRAMEBUFFER, data->resolveFBO);
+  glClearBufferfv(GL_COLOR, 0, noOcclusion);
+
+  if(quality == SDF_OCCLUSION_QUALITY_OFF || rendererGetPassedRenderingParameters().enableNormals == FALSE)
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return TRUE;
+  }
+
+  SDFOcclusionSettings settings = {};
+  settings.samplesCount = quality == SDF_OCCLUSION_QUALITY_LOW ? SDF_OCCLUSION_MAX_SAMPLES_COUNT / 2 :
+                                                                 SDF_OCCLUSION_MAX_SAMPLES_COUNT;
+  settings.aoDistance = std::max(aoDistance, float32(INT_DISTANCE));
+  settings.shadowDistance = std::max(shadowDistance, float32(INT_DISTANCE));
+  settings.shadowLightIndex = sdfOcclusionPassFindKeyLight();
+
+  sdfOcclusionPassSampleDistances(data, settings);
+  sdfOcclusionPassResolve(data, settings);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  return TRUE;
+}
+
+static const char* sdfOcclusionPassGetName(RenderPass* pass)
+{
+  return "SDFOcclusionPass";
+}
+
+static ShaderProgram* createResolveProgram()
+{
+  ShaderProgram* program = nullptr;
+
+  createShaderProgram(&program);
+  shaderProgramAttachShader(program, shaderManagerGetShader("triangle.vert"));
+  shaderProgramAttachShader(program, shaderManagerLoadShader(GL_FRAGMENT_SHADER, "shaders/resolve_sdf_occlusion.frag"));
+
+  if(linkShaderProgram(program) == FALSE)
+  {
+    destroyShaderProgram(program);
+    return nullptr;
+  }
+
+  return program;
+}
+
+static GLuint createSamplesFramebuffer()
+{
+  GLuint framebuffer = 0;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+  // NOTE: Each layer of the samples map is a separate draw buffer
+  GLenum drawBuffers[SDF_OCCLUSION_SAMPLES_LAYERS_COUNT];
+  for(uint32 i = 0; i < SDF_OCCLUSION_SAMPLES_LAYERS_COUNT; i++)
+  {
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
+                              rendererGetResourceHandle(RR_OCCLUSION_SAMPLES_MAP_TEXTURE), 0, i);
+    drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+  }
+
+  glDrawBuffers(SDF_OCCLUSION_SAMPLES_LAYERS_COUNT, drawBuffers);
+
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  if(status != GL_FRAMEBUFFER_COMPLETE)
+  {
+    glDeleteFramebuffers(1, &framebuffer);
+    return 0;
+  }
+
+  return framebuffer;
+}
+
+bool8 createSDFOcclusionPass(RenderPass** outPass)
+{
+  RenderPassInterface interface = {};
+  interface.destroy = destroySDFOcclusionPass;
+  interface.execute = sdfOcclusionPassExecute;
+  interface.getName = sdfOcclusionPassGetName;
+  interface.type = RENDER_PASS_TYPE_SDF_OCCLUSION;
+
+  if(allocateRenderPass(interface, outPass) == FALSE)
+  {
+    return FALSE;
+  }
+
+  SDFOcclusionPassData* data = engineAllocObject<SDFOcclusionPassData>(MEMORY_TYPE_GENERAL);
+
+  data->samplesFBO = createSamplesFramebuffer();
+  assert(data->samplesFBO != 0);
+
+  data->resolveFBO = createFramebuffer(rendererGetResourceHandle(RR_OCCLUSION_MAP_TEXTURE));
+  assert(data->resolveFBO != 0);
+
+  data->resolveProgram = ShaderProgramPtr(createResolveProgram());
+  assert(data->resolveProgram != nullptr);
+
+  renderPassSetInternalData(*outPass, data);
+
+  return TRUE;
+}
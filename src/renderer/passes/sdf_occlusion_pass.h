@@ -0,0 +1,18 @@
+#pragma once
+
+#include "render_pass.h"
+
+/**
+ * SDF occlusion pass calculates ambient occlusion and improves soft shadow of the key light source
+ * (the first one, which casts shadows) near surfaces. Distances of leaves (or of baked subtrees) are
+ * sampled at a few fixed points along the normal and toward the light from the positions and
+ * normals of pixels, so geometries aren't traced again. Samples are resolved into the occlusion map:
+ * ambient occlusion into its R channel and soft shadow into its G channel. Shading combines the
+ * shadow with the shadows map by min, so the map cached by the shadow pass is never modified.
+ *
+ * Quality is controlled by engine_SDFOcclusion_Quality cvar: 0 - off, 1 - 4 samples, 2 - 8 samples.
+ */
+
+static const RenderPassType RENDER_PASS_TYPE_SDF_OCCLUSION = 0x5d0cc7a1;
+
+ENGINE_API bool8 createSDFOcclusionPass(RenderPass** outPass);
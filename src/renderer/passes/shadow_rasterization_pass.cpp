@@ -1,28 +1,145 @@
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include "cvar_system.h"
 #include "shader_program.h"
 #include "memory_manager.h"
 #include "shader_manager.h"
+#include "assets/light_source.h"
 #include "renderer/renderer.h"
 #include "renderer/renderer_utils.h"
 #include <../bin/shaders/declarations.h>
+#include <../bin/shaders/fp_math.h>
 
 #include "passes_common.h"
 #include "shadow_rasterization_pass.h"
 
+// NOTE: Maximal distance between a point and its reprojection (relative to the distance to the camera),
+// at which shadows of the previous frame are reused
+DECLARE_CVAR(engine_ShadowCache_ReprojectionThreshold, 0.005f);
+
+static bool operator==(const LightSourceParameters& lop, const LightSourceParameters& rop)
+{
+  return lop.type == rop.type &&
+    lop.enabled == rop.enabled &&
+    lop.shadowEnabled == rop.shadowEnabled &&
+    lop.shadowFactor == rop.shadowFactor &&
+    lop.attenuationDistanceFactors == rop.attenuationDistanceFactors &&
+    lop.attenuationAngleFactors == rop.attenuationAngleFactors &&
+    lop.position == rop.position &&
+    lop.forward == rop.forward &&
+    lop.intensity == rop.intensity &&
+    lop.attenuation == rop.attenuation;
+}
+
+/** Everything shadows depend on, except the camera */
+struct ShadowCacheKey
+{
+  const GeometryFlatTree* tree = nullptr;
+  uint32 treeEpoch = 0;
+  uint32 itersMaxCount = 0;
+  int2 resolution = int2(0, 0);
+  // NOTE: Parameters of primary rays, they change points which receive shadows
+  uint32 rasterItersMaxCount = 0;
+  uint32 coneBlockSize = 0;
+  uint32 coneItersMaxCount = 0;
+  float32 relaxationFactor = 0.0f;
+  float32 maxTraceDistance = 0.0f;
+  float32 convergenceThreshold = 0.0f;
+  uint32 lightSourcesCount = 0;
+  LightSourceParameters lightSources[MAX_SHADOW_LIGHT_SOURCES_COUNT] = {};
+
+  bool operator==(const ShadowCacheKey& rop) const
+  {
+    if(tree != rop.tree ||
+       treeEpoch != rop.treeEpoch ||
+       itersMaxCount != rop.itersMaxCount ||
+       resolution != rop.resolution ||
+       rasterItersMaxCount != rop.rasterItersMaxCount ||
+       coneBlockSize != rop.coneBlockSize ||
+       coneItersMaxCount != rop.coneItersMaxCount ||
+       relaxationFactor != rop.relaxationFactor ||
+       maxTraceDistance != rop.maxTraceDistance ||
+       convergenceThreshold != rop.convergenceThreshold ||
+       lightSourcesCount != rop.lightSourcesCount)
+    {
+      return false;
+    }
+
+    // NOTE: Only light sources in use are compared
+    for(uint32 i = 0; i < lightSourcesCount; i++)
+    {
+      if(!(lightSources[i] == rop.lightSources[i]))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+};
+
 struct ShadowRasterizationPassData
 {
   GLuint raysMapFBO;
   GLuint shadowsMapFBO;
+  GLuint reprojectionFBO;
+  GLuint receiversBufferHandle;
   
+  ShaderProgramPtr reprojectionProgram;
+  ShaderProgramPtr receiversCalculationProgram;
   ShaderProgramPtr preparingProgram;
   ShaderProgramPtr shadowCalculationProgram;
   ShaderProgramPtr raysMoverProgram;
+
+  std::vector<bool> visibleGeometries;
+  std::vector<bool> lightVisibleGeometries;
+  // NOTE: Intermediate data of calculateGeometriesVisibility(), kept to avoid allocations each frame
+  std::vector<uint32> visibleLeaves;
+
+  // NOTE: State of the previous frame, which shadows are kept in the history textures
+  ShadowCacheKey cacheKey;
+  float4x4 cachedWorldNDCMat;
+  float4x4 cachedNDCWorldMat;
+  bool8 cacheValid = FALSE;
+};
+
+/**
+ * Receivers are all visible points of surface, each light source shadows only those of them which
+ * are in its range, so only geometries between them and the light source have to be drawn.
+ */
+struct ShadowReceivers
+{
+  AABB bounds;
+  // NOTE: Screen rectangle in pixels, which covers tiles with receivers: xy - min (inclusive), zw - max (exclusive)
+  int4 rect;
+};
+
+/**
+ * Shadow rays of all light sources are traced together, each light source in its own slice of the
+ * shadow rays map and stacks (see getShadowSlice() in common.glsl). This way each geometry program
+ * is drawn once per iteration for all light sources.
+ */
+struct ShadowSlices
+{
+  uint32 count;
+  uint32 lights[MAX_SHADOW_LIGHT_SOURCES_COUNT];
+  int4 rects[MAX_SHADOW_LIGHT_SOURCES_COUNT];
+  // NOTE: Union of rectangles of all slices (in film space)
+  int4 rect;
 };
 
 static void destroyShadowRasterizationPass(RenderPass* pass)
 {
   ShadowRasterizationPassData* data = (ShadowRasterizationPassData*)renderPassGetInternalData(pass);
   glDeleteFramebuffers(1, &data->raysMapFBO);
+  glDeleteFramebuffers(1, &data->shadowsMapFBO);
+  glDeleteFramebuffers(1, &data->reprojectionFBO);
+  glDeleteBuffers(1, &data->receiversBufferHandle);
 
+  data->reprojectionProgram = ShaderProgramPtr(nullptr);
+  data->receiversCalculationProgram = ShaderProgramPtr(nullptr);
   data->preparingProgram = ShaderProgramPtr(nullptr);
   data->shadowCalculationProgram = ShaderProgramPtr(nullptr);
   data->raysMoverProgram = ShaderProgramPtr(nullptr);
@@ -30,8 +147,149 @@ static void destroyShadowRasterizationPass(RenderPass* pass)
   engineFreeObject(data, MEMORY_TYPE_GENERAL);
 }
 
-static bool8 shadowRasterizationPassPrepareToRasterize(ShadowRasterizationPassData* data, uint32 lightIndex)
+// NOTE: Result is read back immediately, the same way as AABB calculation pass does it. Buffer is
+// tiny and depth/normals maps are ready by now, so the stall is short.
+static bool8 shadowRasterizationPassGatherReceivers(ShadowRasterizationPassData* data, ShadowReceivers& outReceivers)
+{
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  const uint32 maxValue = 0xFFFFFFFF;
+  ShadowReceiversBufferParameters receiversParams =
+  {
+    uint4(maxValue, maxValue, maxValue, 0),
+    uint4(0, 0, 0, 0),
+    uint4(maxValue, maxValue, 0, 0)
+  };
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->receiversBufferHandle);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(ShadowReceiversBufferParameters), &receiversParams);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADOW_RECEIVERS_SSBO_BINDING, data->receiversBufferHandle);
+
+  shaderProgramUse(data->receiversCalculationProgram);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_DEPTH1_MAP_TEXTURE));
+  
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_NORMALS_MAP_TEXTURE));
+
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_SHADOWS_REUSE_MASK_TEXTURE));
+
+  glUniform1i(0, 0);
+  glUniform1i(1, 1);
+  glUniform1i(2, 2);
+  glDispatchCompute((viewport[2] + SHADOW_RECEIVERS_TILE_SIZE - 1) / SHADOW_RECEIVERS_TILE_SIZE,
+                    (viewport[3] + SHADOW_RECEIVERS_TILE_SIZE - 1) / SHADOW_RECEIVERS_TILE_SIZE,
+                    1);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  ShadowReceiversBufferParameters* mappedParams =
+    (ShadowReceiversBufferParameters*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
+                                                       0,
+                                                       sizeof(ShadowReceiversBufferParameters),
+                                                       GL_MAP_READ_BIT);
+  receiversParams = *mappedParams;
+  
+  glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  // NOTE: No tile has been marked --> nothing can receive shadows
+  if(receiversParams.tiles.x > receiversParams.tiles.z)
+  {
+    return FALSE;
+  }
+
+  outReceivers.bounds = AABB(
+    float3(fixedPointToFloat(receiversParams.min.x), fixedPointToFloat(receiversParams.min.y), fixedPointToFloat(receiversParams.min.z)),
+    float3(fixedPointToFloat(receiversParams.max.x), fixedPointToFloat(receiversParams.max.y), fixedPointToFloat(receiversParams.max.z))
+  );
+  
+  outReceivers.rect = int4(receiversParams.tiles.x * SHADOW_RECEIVERS_TILE_SIZE,
+                           receiversParams.tiles.y * SHADOW_RECEIVERS_TILE_SIZE,
+                           std::min<int32>((receiversParams.tiles.z + 1) * SHADOW_RECEIVERS_TILE_SIZE, viewport[2]),
+                           std::min<int32>((receiversParams.tiles.w + 1) * SHADOW_RECEIVERS_TILE_SIZE, viewport[3]));
+
+  return TRUE;
+}
+
+/**
+ * Clips receivers by the range of the light source, calculates visibility of casters which can
+ * shadow them (the ones between receivers and the light source) and screen rectangle of lit receivers.
+ * @return FALSE if the light source doesn't reach any receiver
+ */
+static bool8 shadowRasterizationPassCullLight(Asset* lightSource,
+                                              const ShadowReceivers& receivers,
+                                              std::vector<uint32>& visibleLeaves,
+                                              std::vector<bool>& outVisible,
+                                              int4& outRect)
+{
+  const GeometryFlatTree& geometryTree = geometryGetFlatTree(sceneGetGeometryRoot(rendererGetPassedScene()));
+  const LightSourceParameters& light = lightSourceGetParameters(lightSource);
+  
+  outRect = receivers.rect;
+
+  if(light.type == LIGHT_SOURCE_TYPE_DIRECTIONAL)
+  {
+    // NOTE: Casters lie in the volume of receivers swept towards the light source until it leaves the scene
+    const AABB& sceneAABB = geometryTree.finalAABBs[geometryTree.getRootIndex()];
+    AABB casters = AABB::createUnbounded();
+    
+    if(sceneAABB.isUnbounded() == FALSE)
+    {
+      AABB bounds = AABBUnion(sceneAABB, receivers.bounds);
+      float3 sweep = -light.forward.xyz() * length(bounds.max - bounds.min);
+
+      casters = AABBUnion(receivers.bounds, AABB(receivers.bounds.min + sweep, receivers.bounds.max + sweep));
+    }
+
+    calculateGeometriesVisibility(casters, geometryTree, visibleLeaves, outVisible);
+    
+    return TRUE;
+  }
+
+  // NOTE: Receivers farther than attenuation radius are culled by prepare_to_shadow_raster.frag anyway
+  float32 attenuationRadius = lightSourceGetAttenuationRadius(lightSource);
+  float3 lightPosition = light.position.xyz();
+  AABB lightVolume = AABB(lightPosition - float3(attenuationRadius), lightPosition + float3(attenuationRadius));
+  
+  if(AABBOverlap(receivers.bounds, lightVolume) == FALSE)
+  {
+    return FALSE;
+  }
+
+  AABB litReceivers = AABBIntersection(receivers.bounds, lightVolume);
+  calculateGeometriesVisibility(AABBUnion(litReceivers, AABB(lightPosition, lightPosition)),
+                                geometryTree,
+                                visibleLeaves,
+                                outVisible);
+
+  // NOTE: Screen rectangle of lit receivers, it's used only if the whole box is in front of the camera
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  int4 litRect;
+  if(calculateScreenRect(litReceivers,
+                         cameraGetWorldNDCMat(rendererGetPassedCamera()),
+                         int2(viewport[2], viewport[3]),
+                         litRect) == FALSE)
+  {
+    return TRUE;
+  }
+
+  outRect = int4(std::max(outRect.x, litRect.x),
+                 std::max(outRect.y, litRect.y),
+                 std::min(outRect.z, litRect.z),
+                 std::min(outRect.w, litRect.w));
+
+  return outRect.x < outRect.z && outRect.y < outRect.w ? TRUE : FALSE;
+}
+
+static bool8 shadowRasterizationPassPrepareToRasterize(ShadowRasterizationPassData* data, const ShadowSlices& slices)
 {
+  GLuint programHandle = shaderProgramGetGLHandle(data->preparingProgram);
+  
   shaderProgramUse(data->preparingProgram);
   glBindFramebuffer(GL_FRAMEBUFFER, data->raysMapFBO);
 
@@ -51,9 +309,14 @@ static bool8 shadowRasterizationPassPrepareToRasterize(ShadowRasterizationPassDa
   glActiveTexture(GL_TEXTURE1);
   glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_NORMALS_MAP_TEXTURE));
 
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_SHADOWS_REUSE_MASK_TEXTURE));
+
   glUniform1i(0, 0);
-  glUniform1i(1, 1);  
-  glUniform1ui(2, lightIndex);
+  glUniform1i(1, 1);
+  glUniform1i(2, 2);  
+  glUniform1uiv(glGetUniformLocation(programHandle, "shadowSlicesLights"), slices.count, slices.lights);
+  glUniform4iv(glGetUniformLocation(programHandle, "shadowSlicesRects"), slices.count, &slices.rects[0].x);
   drawTriangleNoVAO();
 
   glDisable(GL_STENCIL_TEST);
@@ -62,16 +325,32 @@ static bool8 shadowRasterizationPassPrepareToRasterize(ShadowRasterizationPassDa
   return TRUE;
 }
 
-static bool8 shadowRasterizationPassRasterize(ShadowRasterizationPassData* data, uint32 lightIndex)
+static bool8 shadowRasterizationPassRasterize(ShadowRasterizationPassData* data,
+                                              const ShadowSlices& slices,
+                                              const int4& filmViewport)
 {
   const RenderingParameters& renderingParams = rendererGetPassedRenderingParameters();  
-  Scene* sceneToRasterize = rendererGetPassedScene();  
+  Scene* sceneToRasterize = rendererGetPassedScene();
+  const GeometryFlatTree& geometryTree = geometryGetFlatTree(sceneGetGeometryRoot(sceneToRasterize));
 
   glEnable(GL_STENCIL_TEST);
 
   glEnable(GL_BLEND);
   pushBlend(GL_FUNC_ADD, GL_FUNC_ADD, GL_ZERO, GL_ONE, GL_ONE, GL_ONE);
 
+  GLuint estimatorHandle = shaderProgramGetGLHandle(data->shadowCalculationProgram);
+  GLuint moverHandle = shaderProgramGetGLHandle(data->raysMoverProgram);
+
+  shaderProgramUse(data->shadowCalculationProgram);
+  glUniform1ui(glGetUniformLocation(estimatorHandle, "shadowSlicesCount"), slices.count);
+  glUniform1uiv(glGetUniformLocation(estimatorHandle, "shadowSlicesLights"), slices.count, slices.lights);
+
+  shaderProgramUse(data->raysMoverProgram);
+  glUniform1uiv(glGetUniformLocation(moverHandle, "shadowSlicesLights"), slices.count, slices.lights);
+
+  GLint slicesScissor[4];
+  glGetIntegerv(GL_SCISSOR_BOX, slicesScissor);
+
   glBindFramebuffer(GL_FRAMEBUFFER, data->raysMapFBO);
   
   uint32 culledObjectsCounter = 0;
@@ -86,9 +365,9 @@ static bool8 shadowRasterizationPassRasterize(ShadowRasterizationPassData* data,
     glStencilFuncSeparate(GL_FRONT_AND_BACK, GL_EQUAL, 1, 0xFF);
     glStencilOpSeparate(GL_FRONT_AND_BACK, GL_KEEP, GL_KEEP, GL_KEEP);
     
-    // TODO: Generate frustum for light (now we're passing nullptr) for further optimization
-    drawGeometryPostorder(nullptr,
-                          sceneGetGeometryRoot(sceneToRasterize),
+    drawGeometryPostorder(&data->visibleGeometries,
+                          geometryTree,
+                          geometryTree.getRootIndex(),
                           0, 0,
                           culledObjectsCounter,
                           TRUE);
@@ -96,16 +375,25 @@ static bool8 shadowRasterizationPassRasterize(ShadowRasterizationPassData* data,
     // ------------------------------------------------------------------------
     // 2. Calculate soft shadow with parameters calculated at this iteration
     // (see: https://www.iquilezles.org/www/articles/rmshadows/rmshadows.htm)
+
+    // NOTE: Estimator runs over the film and reads all slices, finished rays don't affect the result
+    // (see shadows_estimator.frag), so stencil isn't needed here
+    glDisable(GL_STENCIL_TEST);
+    pushViewport(filmViewport.x, filmViewport.y, filmViewport.z, filmViewport.w);
+    glScissor(slices.rect.x, slices.rect.y, slices.rect.z - slices.rect.x, slices.rect.w - slices.rect.y);
     
     pushBlend(GL_MIN, GL_MIN, GL_ONE, GL_ONE, GL_ONE, GL_ONE);
     glBindFramebuffer(GL_FRAMEBUFFER, data->shadowsMapFBO);
     shaderProgramUse(data->shadowCalculationProgram);
-    glUniform1ui(0, lightIndex);
 
     drawTriangleNoVAO();
     
     popBlend();
 
+    assert(popViewport() == TRUE);
+    glScissor(slicesScissor[0], slicesScissor[1], slicesScissor[2], slicesScissor[3]);
+    glEnable(GL_STENCIL_TEST);
+
     // ------------------------------------------------------------------------
     // 3. Move per-pixel rays based on calculated distances
 
@@ -122,7 +410,6 @@ static bool8 shadowRasterizationPassRasterize(ShadowRasterizationPassData* data,
     
     glUniform1i(glGetUniformLocation(shaderProgramGetGLHandle(data->raysMoverProgram), "depthMap"), 0);    
     glUniform1ui(glGetUniformLocation(shaderProgramGetGLHandle(data->raysMoverProgram), "curIterIdx"), i);
-    glUniform1ui(glGetUniformLocation(shaderProgramGetGLHandle(data->raysMoverProgram), "lightIndex"), lightIndex); 
     drawTriangleNoVAO();
 
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);        
@@ -135,27 +422,196 @@ static bool8 shadowRasterizationPassRasterize(ShadowRasterizationPassData* data,
   return TRUE;
 }
 
-static bool8 shadowRasterizationPassExecute(RenderPass* pass)
+static ShadowCacheKey shadowRasterizationPassGetCacheKey()
 {
-  ShadowRasterizationPassData* data = (ShadowRasterizationPassData*)renderPassGetInternalData(pass);
   const std::vector<AssetPtr> lightSources = sceneGetEnabledLightSources(rendererGetPassedScene());
+  const GeometryFlatTree& geometryTree = geometryGetFlatTree(sceneGetGeometryRoot(rendererGetPassedScene()));
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  ShadowCacheKey key;
+
+  const RenderingParameters& renderingParams = rendererGetPassedRenderingParameters();
+
+  key.tree = &geometryTree;
+  key.treeEpoch = geometryTree.epoch;
+  key.itersMaxCount = renderingParams.shadowRasterItersMaxCount;
+  key.resolution = int2(viewport[2], viewport[3]);
+  key.rasterItersMaxCount = renderingParams.rasterItersMaxCount;
+  key.coneBlockSize = renderingParams.coneBlockSize;
+  key.coneItersMaxCount = renderingParams.coneItersMaxCount;
+  key.relaxationFactor = renderingParams.relaxationFactor;
+  key.maxTraceDistance = renderingParams.maxTraceDistance;
+  key.convergenceThreshold = renderingParams.convergenceThreshold;
+  key.lightSourcesCount = std::min<uint32>(lightSources.size(), MAX_SHADOW_LIGHT_SOURCES_COUNT);
+
+  for(uint32 i = 0; i < key.lightSourcesCount; i++)
+  {
+    key.lightSources[i] = lightSourceGetParameters(lightSources[i]);
+  }
+
+  return key;
+}
+
+// NOTE: Takes shadows of the previous frame for pixels, which points were visible in it,
+// these pixels are marked in the reuse mask and aren't traced
+static bool8 shadowRasterizationPassReproject(ShadowRasterizationPassData* data)
+{
+  const static CVarFloatHandle reprojectionThresholdHandle =
+    StaticCVar_engine_ShadowCache_ReprojectionThreshold.getHandle();
+  const float32 reprojectionThreshold = CVarSystemRead(reprojectionThresholdHandle);
+
+  GLuint programHandle = shaderProgramGetGLHandle(data->reprojectionProgram);
+
+  shaderProgramUse(data->reprojectionProgram);
+  glBindFramebuffer(GL_FRAMEBUFFER, data->reprojectionFBO);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_DEPTH1_MAP_TEXTURE));
+
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_DEPTH_HISTORY_MAP_TEXTURE));
+
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_SHADOWS_HISTORY_MAP_TEXTURE));
+
+  glUniform1i(0, 0);
+  glUniform1i(1, 1);
+  glUniform1i(2, 2);
+  glUniformMatrix4fv(glGetUniformLocation(programHandle, "prevWorldNDCMat"), 1, GL_FALSE, &data->cachedWorldNDCMat[0][0]);
+  glUniformMatrix4fv(glGetUniformLocation(programHandle, "prevNDCWorldMat"), 1, GL_FALSE, &data->cachedNDCWorldMat[0][0]);
+  glUniform1f(glGetUniformLocation(programHandle, "reprojectionThreshold"), reprojectionThreshold);
+  drawTriangleNoVAO();
 
-  // NOTE: Clear each channel of shadowmap to 1.0f, meaning that initially lights are not blocked
-  glBindFramebuffer(GL_FRAMEBUFFER, data->shadowsMapFBO);
-  glClearColor(1.0f, 1.0f, 1.0f, 1.0f);  
-  glClear(GL_COLOR_BUFFER_BIT);
-  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  return TRUE;
+}
+
+static bool8 shadowRasterizationPassTrace(ShadowRasterizationPassData* data)
+{
+  const std::vector<AssetPtr> lightSources = sceneGetEnabledLightSources(rendererGetPassedScene());
+
+  ShadowReceivers receivers;
+  if(shadowRasterizationPassGatherReceivers(data, receivers) == FALSE)
+  {
+    return TRUE;
+  }
+
+  const GeometryFlatTree& geometryTree = geometryGetFlatTree(sceneGetGeometryRoot(rendererGetPassedScene()));
+  data->visibleGeometries.assign(geometryTree.geometries.size(), false);
+
+  ShadowSlices slices = {};
+  slices.rect = int4(receivers.rect.z, receivers.rect.w, receivers.rect.x, receivers.rect.y);
   
-  for(uint32 lightIndex = 0; lightIndex < lightSources.size(); lightIndex++)
+  // NOTE: Only first MAX_SHADOW_LIGHT_SOURCES_COUNT light sources cast shadows, one channel of shadows map each
+  uint32 lightSourcesCount = std::min<uint32>(lightSources.size(), MAX_SHADOW_LIGHT_SOURCES_COUNT);
+  for(uint32 lightIndex = 0; lightIndex < lightSourcesCount; lightIndex++)
   {
-    if(lightSourceShadowIsEnabled(lightSources[lightIndex]) == TRUE)
+    if(lightSourceShadowIsEnabled(lightSources[lightIndex]) == FALSE)
+    {
+      continue;
+    }
+
+    // NOTE: Pixels outside of the rectangle keep 1.0f in the shadowmap, i.e they aren't shadowed
+    int4 rect;
+    if(shadowRasterizationPassCullLight(lightSources[lightIndex], receivers, data->visibleLeaves,
+                                        data->lightVisibleGeometries, rect) == FALSE)
     {
-      assert(shadowRasterizationPassPrepareToRasterize(data, lightIndex));
-      assert(shadowRasterizationPassRasterize(data, lightIndex));
+      continue;
     }
+
+    // NOTE: Casters of all light sources are drawn together
+    for(uint32 i = 0; i < data->visibleGeometries.size(); i++)
+    {
+      data->visibleGeometries[i] = data->visibleGeometries[i] || data->lightVisibleGeometries[i];
+    }
+
+    slices.lights[slices.count] = lightIndex;
+    slices.rects[slices.count] = rect;
+    slices.count++;
+
+    slices.rect = int4(std::min(slices.rect.x, rect.x), std::min(slices.rect.y, rect.y),
+                       std::max(slices.rect.z, rect.z), std::max(slices.rect.w, rect.w));
+  }
+
+  if(slices.count == 0)
+  {
+    return TRUE;
+  }
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  int4 filmViewport = int4(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+  pushViewport(0, 0, filmViewport.z, filmViewport.w * slices.count);
+
+  // NOTE: Scissor covers the union rectangle in each slice, rows between the first and the last
+  // slice are covered entirely
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(slices.rect.x,
+            slices.rect.y,
+            slices.rect.z - slices.rect.x,
+            (slices.count - 1) * filmViewport.w + slices.rect.w - slices.rect.y);
+    
+  assert(shadowRasterizationPassPrepareToRasterize(data, slices));
+  assert(shadowRasterizationPassRasterize(data, slices, filmViewport));
+
+  glDisable(GL_SCISSOR_TEST);
+  assert(popViewport() == TRUE);
+
+  return TRUE;
+}
+
+static bool8 shadowRasterizationPassExecute(RenderPass* pass)
+{
+  ShadowRasterizationPassData* data = (ShadowRasterizationPassData*)renderPassGetInternalData(pass);
+  const RenderingParameters& renderingParams = rendererGetPassedRenderingParameters();
+  Camera* camera = rendererGetPassedCamera();
+  
+  ShadowCacheKey key = shadowRasterizationPassGetCacheKey();
+  float4x4 worldNDCMat = cameraGetWorldNDCMat(camera);
+
+  bool8 cacheIsValid = renderingParams.enableShadowCache == TRUE && data->cacheValid == TRUE &&
+    key == data->cacheKey;
+
+  // NOTE: Nothing has changed, so shadowmap of the previous frame is still valid
+  if(cacheIsValid == TRUE && worldNDCMat == data->cachedWorldNDCMat)
+  {
+    return TRUE;
+  }
+
+  // NOTE: Clear each channel of shadowmap to 1.0f, meaning that initially lights are not blocked,
+  // nothing is reused yet
+  const float32 unblocked[] = {1.0f, 1.0f, 1.0f, 1.0f};
+  const float32 notReused[] = {0.0f, 0.0f, 0.0f, 0.0f};
+  
+  glBindFramebuffer(GL_FRAMEBUFFER, data->reprojectionFBO);
+  glClearBufferfv(GL_COLOR, 0, unblocked);
+  glClearBufferfv(GL_COLOR, 1, notReused);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  if(cacheIsValid == TRUE)
+  {
+    assert(shadowRasterizationPassReproject(data));
   }
 
+  assert(shadowRasterizationPassTrace(data));
+
+  // NOTE: Keep shadows and depth for the next frame
+  glCopyImageSubData(rendererGetResourceHandle(RR_SHADOWS_MAP_TEXTURE), GL_TEXTURE_2D, 0, 0, 0, 0,
+                     rendererGetResourceHandle(RR_SHADOWS_HISTORY_MAP_TEXTURE), GL_TEXTURE_2D, 0, 0, 0, 0,
+                     key.resolution.x, key.resolution.y, 1);
+  glCopyImageSubData(rendererGetResourceHandle(RR_DEPTH1_MAP_TEXTURE), GL_TEXTURE_2D, 0, 0, 0, 0,
+                     rendererGetResourceHandle(RR_DEPTH_HISTORY_MAP_TEXTURE), GL_TEXTURE_2D, 0, 0, 0, 0,
+                     key.resolution.x, key.resolution.y, 1);
+
+  data->cacheKey = key;
+  data->cachedWorldNDCMat = worldNDCMat;
+  data->cachedNDCWorldMat = cameraGetNDCWorldMat(camera);
+  data->cacheValid = key.tree->readsGlobalParameters == FALSE ? TRUE : FALSE;
+
   return TRUE;
 }
 
@@ -179,13 +635,38 @@ bool8 createShadowRasterizationPass(RenderPass** outPass)
 
   ShadowRasterizationPassData* data = engineAllocObject<ShadowRasterizationPassData>(MEMORY_TYPE_GENERAL);
 
-  data->raysMapFBO = createFramebufferDS(rendererGetResourceHandle(RR_RAYS_MAP_TEXTURE),
-                                         rendererGetResourceHandle(RR_COVERAGE_MASK_TEXTURE));
+  data->raysMapFBO = createFramebufferDS(rendererGetResourceHandle(RR_SHADOW_RAYS_MAP_TEXTURE),
+                                         rendererGetResourceHandle(RR_SHADOW_COVERAGE_MASK_TEXTURE));
   assert(data->raysMapFBO != 0);
 
   data->shadowsMapFBO = createFramebufferDS(rendererGetResourceHandle(RR_SHADOWS_MAP_TEXTURE),
                                             rendererGetResourceHandle(RR_COVERAGE_MASK_TEXTURE));
   assert(data->shadowsMapFBO != 0);
+
+  data->reprojectionFBO = createFramebuffer(rendererGetResourceHandle(RR_SHADOWS_MAP_TEXTURE),
+                                            rendererGetResourceHandle(RR_SHADOWS_REUSE_MASK_TEXTURE));
+  assert(data->reprojectionFBO != 0);
+
+  data->reprojectionProgram = ShaderProgramPtr(createAndLinkTriangleShadingProgram("shaders/reproject_shadows.frag"));
+  assert(data->reprojectionProgram != nullptr);
+  
+  glGenBuffers(1, &data->receiversBufferHandle);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->receiversBufferHandle);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ShadowReceiversBufferParameters), NULL, GL_DYNAMIC_READ);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  ShaderProgram* receiversCalculationProgram = nullptr;
+  createShaderProgram(&receiversCalculationProgram);
+  shaderProgramAttachShader(receiversCalculationProgram,
+                            shaderManagerLoadShader(GL_COMPUTE_SHADER, "shaders/calculate_shadow_receivers.comp"));
+  if(linkShaderProgram(receiversCalculationProgram) == FALSE)
+  {
+    destroyShaderProgram(receiversCalculationProgram);
+    receiversCalculationProgram = nullptr;
+  }
+  
+  data->receiversCalculationProgram = ShaderProgramPtr(receiversCalculationProgram);
+  assert(data->receiversCalculationProgram != nullptr);
   
   data->preparingProgram = ShaderProgramPtr(createAndLinkTriangleShadingProgram("shaders/prepare_to_shadow_raster.frag"));
   assert(data->preparingProgram != nullptr);
@@ -1,5 +1,6 @@
 #include <imgui/imgui.h>
 
+#include "shader_build.h"
 #include "shader_program.h"
 #include "memory_manager.h"
 #include "shader_manager.h"
@@ -14,30 +15,93 @@ struct SimpleShadingPassData
 {
   GLuint ldrFBO;
   float3 ambientColor;
-  
-  ShaderProgramPtr shadingProgram;
+
+  // NOTE: Pixels are shaded by tiles, each tile is shaded by the program specialised for the
+  // features of materials in it (see classify_materials.comp)
+  ShaderProgramPtr classificationProgram;
+  ShaderProgramPtr shadingPrograms[MATERIAL_FEATURES_PERMUTATIONS_COUNT];
+
+  GLuint tilesBufferHandle;
+  // NOTE: Maximal count of tiles per bin, i.e count of tiles of the viewport
+  uint32 tilesCapacity = 0;
 };
 
 static void destroySimpleShadingPass(RenderPass* pass)
 {
   SimpleShadingPassData* data = (SimpleShadingPassData*)renderPassGetInternalData(pass);
   glDeleteFramebuffers(1, &data->ldrFBO);
+  glDeleteBuffers(1, &data->tilesBufferHandle);
 
-  data->shadingProgram = ShaderProgramPtr(nullptr);
+  data->classificationProgram = ShaderProgramPtr(nullptr);
+  for(ShaderProgramPtr& program: data->shadingPrograms)
+  {
+    program = ShaderProgramPtr(nullptr);
+  }
   
   engineFreeObject(data, MEMORY_TYPE_GENERAL);
 }
 
+static void simpleShadingPassClassifyTiles(SimpleShadingPassData* data)
+{
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  uint32 tilesCount = ((viewport[2] + SHADING_TILE_SIZE - 1) / SHADING_TILE_SIZE) *
+                      ((viewport[3] + SHADING_TILE_SIZE - 1) / SHADING_TILE_SIZE);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->tilesBufferHandle);
+
+  if(tilesCount > data->tilesCapacity)
+  {
+    data->tilesCapacity = tilesCount;
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 MATERIAL_FEATURES_PERMUTATIONS_COUNT * (sizeof(uint4) + tilesCount * sizeof(uint32)),
+                 NULL,
+                 GL_DYNAMIC_DRAW);
+  }
+
+  // NOTE: Each tile is drawn as two triangles, tiles are instances
+  uint4 bins[MATERIAL_FEATURES_PERMUTATIONS_COUNT];
+  for(uint4& bin: bins)
+  {
+    bin = uint4(6, 0, 0, 0);
+  }
+
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(bins), bins);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADING_TILES_SSBO_BINDING, data->tilesBufferHandle);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  shaderProgramUse(data->classificationProgram);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_DEPTH1_MAP_TEXTURE));
+
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_NORMALS_MAP_TEXTURE));
+
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_GEOIDS_MAP_TEXTURE));
+
+  glUniform1i(0, 0);
+  glUniform1i(1, 1);
+  glUniform1i(2, 2);
+  glUniform1ui(3, data->tilesCapacity);
+  glDispatchCompute((viewport[2] + SHADING_TILE_SIZE - 1) / SHADING_TILE_SIZE,
+                    (viewport[3] + SHADING_TILE_SIZE - 1) / SHADING_TILE_SIZE,
+                    1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
 static bool8 simpleShadingPassExecute(RenderPass* pass)
 {
   SimpleShadingPassData* data = (SimpleShadingPassData*)renderPassGetInternalData(pass);
-  const std::vector<AssetPtr>& lightSources = sceneGetEnabledLightSources(rendererGetPassedScene());
+
+  simpleShadingPassClassifyTiles(data);
 
   glEnable(GL_BLEND);
   pushBlend(GL_FUNC_ADD, GL_FUNC_ADD, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);  
   
   glBindFramebuffer(GL_FRAMEBUFFER, data->ldrFBO);
-  shaderProgramUse(data->shadingProgram);
 
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, imageGetGLHandle(masGetAtlas()));
@@ -54,15 +118,29 @@ static bool8 simpleShadingPassExecute(RenderPass* pass)
   glActiveTexture(GL_TEXTURE4);
   glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_SHADOWS_MAP_TEXTURE));
 
-  glUniform1ui(0, lightSources.size());
-  glUniform1i(1, 0);
-  glUniform1i(2, 1);
-  glUniform1i(3, 2);
-  glUniform1i(4, 3);
-  glUniform1i(5, 4);  
-  
-  drawTriangleNoVAO();
+  glActiveTexture(GL_TEXTURE5);
+  glBindTexture(GL_TEXTURE_2D, rendererGetResourceHandle(RR_OCCLUSION_MAP_TEXTURE));
+
+  glBindVertexArray(rendererGetResourceHandle(RR_EMPTY_VAO));
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, data->tilesBufferHandle);
+
+  // NOTE: Bins are empty draw commands unless classification has put tiles into them
+  for(uint32 i = 0; i < MATERIAL_FEATURES_PERMUTATIONS_COUNT; i++)
+  {
+    shaderProgramUse(data->shadingPrograms[i]);
+
+    glUniform1ui(0, i * data->tilesCapacity);
+    glUniform1i(1, 0);
+    glUniform1i(2, 1);
+    glUniform1i(3, 2);
+    glUniform1i(4, 3);
+    glUniform1i(5, 4);
+    glUniform1i(6, 5);
+
+    glDrawArraysIndirect(GL_TRIANGLES, (const void*)(uintptr_t)(i * sizeof(uint4)));
+  }
 
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
   popBlend();
@@ -83,6 +161,38 @@ static const char* simpleShadingPassGetName(RenderPass* pass)
   return "SimpleShadingPass";
 }
 
+/** @param features set of MATERIAL_FEATURE_* flags, the program shades only materials with them */
+static ShaderProgram* createShadingProgram(uint32 features)
+{
+  ShaderBuild* build = nullptr;
+  createShaderBuild(&build);
+
+  shaderBuildAddVersion(build, 450, "core");
+  shaderBuildAddCodefln(build, "#define MATERIAL_FEATURES %u", features);
+  shaderBuildIncludeFile(build, "shaders/simple_shading.frag");
+
+  ShaderPtr fragmentShader = shaderBuildGenerateShader(build, GL_FRAGMENT_SHADER);
+  destroyShaderBuild(build);
+
+  if(fragmentShader == nullptr)
+  {
+    return nullptr;
+  }
+
+  ShaderProgram* program = nullptr;
+  createShaderProgram(&program);
+  shaderProgramAttachShader(program, shaderManagerLoadShader(GL_VERTEX_SHADER, "shaders/shading_tile.vert"));
+  shaderProgramAttachShader(program, fragmentShader);
+
+  if(linkShaderProgram(program) == FALSE)
+  {
+    destroyShaderProgram(program);
+    return nullptr;
+  }
+
+  return program;
+}
+
 bool8 createSimpleShadingPass(RenderPass** outPass)
 {
   RenderPassInterface interface = {};
@@ -103,8 +213,26 @@ bool8 createSimpleShadingPass(RenderPass** outPass)
   data->ldrFBO = createFramebuffer(rendererGetResourceHandle(RR_LDR1_MAP_TEXTURE));
   assert(data->ldrFBO != 0);
 
-  data->shadingProgram = ShaderProgramPtr(createAndLinkTriangleShadingProgram("shaders/simple_shading.frag"));
-  assert(data->shadingProgram != nullptr);
+  for(uint32 i = 0; i < MATERIAL_FEATURES_PERMUTATIONS_COUNT; i++)
+  {
+    data->shadingPrograms[i] = ShaderProgramPtr(createShadingProgram(i));
+    assert(data->shadingPrograms[i] != nullptr);
+  }
+
+  ShaderProgram* classificationProgram = nullptr;
+  createShaderProgram(&classificationProgram);
+  shaderProgramAttachShader(classificationProgram,
+                            shaderManagerLoadShader(GL_COMPUTE_SHADER, "shaders/classify_materials.comp"));
+  if(linkShaderProgram(classificationProgram) == FALSE)
+  {
+    destroyShaderProgram(classificationProgram);
+    classificationProgram = nullptr;
+  }
+
+  data->classificationProgram = ShaderProgramPtr(classificationProgram);
+  assert(data->classificationProgram != nullptr);
+
+  glGenBuffers(1, &data->tilesBufferHandle);
 
   renderPassSetInternalData(*outPass, data);
   
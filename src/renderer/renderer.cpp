@@ -1,15 +1,20 @@
+#include <cmath>
+
 #include <../bin/shaders/declarations.h>
 
 #include "logging.h"
 #include "renderer_utils.h"
 #include "assets/material.h"
 #include "billboard_system.h"
+#include "parameters_buffer.h"
 #include "assets/assets_manager.h"
 
 #include "passes/fog_pass.h"
 #include "passes/render_pass.h"
+#include "passes/passes_common.h"
 #include "passes/rasterization_pass.h"
 #include "passes/sky_rendering_pass.h"
+#include "passes/sdf_occlusion_pass.h"
 #include "passes/simple_shading_pass.h"
 #include "passes/ldr_to_film_copy_pass.h"
 #include "passes/ids_visualization_pass.h"
@@ -18,8 +23,10 @@
 #include "passes/lights_visualization_pass.h"
 #include "passes/normals_visualization_pass.h"
 #include "passes/distances_visualization_pass.h"
+#include "passes/distance_field_baking_pass.h"
 #include "passes/ui_widgets_visualization_pass.h"
 #include "passes/geometry_native_aabb_calculation_pass.h"
+#include "passes/geometry_ray_hit_pass.h"
 
 #include "renderer.h"
 
@@ -28,13 +35,32 @@
 #define MAX_WIDTH 512
 #define MAX_HEIGHT 512
 
+// NOTE: Initial capacities of parameters buffers, they grow on demand
+#define INITIAL_GEOMETRIES_CAPACITY 256
+#define INITIAL_MATERIALS_CAPACITY 64
+#define INITIAL_INSTANCES_CAPACITY 256
+#define INITIAL_LIGHTS_CAPACITY 16
+// NOTE: (offset, count) pairs of tiles of the full resolution light grid plus a few indices per tile
+#define INITIAL_LIGHT_GRID_CAPACITY (4 * (MAX_WIDTH / LIGHT_GRID_TILE_SIZE) * (MAX_HEIGHT / LIGHT_GRID_TILE_SIZE))
+
 struct Renderer
 {
   GLuint handles[RR_MAX];
+
+  ParametersBuffer* geometriesParameters;
+  ParametersBuffer* materialsParameters;
+  ParametersBuffer* instancesParameters;
+  ParametersBuffer* lightsParameters;
+  ParametersBuffer* lightGrid;
+
+  // NOTE: Intermediate data of rendererSetupLightGrid(), kept to avoid per frame allocations
+  std::vector<int4> lightTiles;
+  std::vector<uint32> lightGridElements;
   
   RenderPass* rasterizationPass;
   RenderPass* normalsCalculationPass;
   RenderPass* shadowRasterizationPass;
+  RenderPass* sdfOcclusionPass;
 
   RenderPass* distancesVisualizationPass;
   RenderPass* idsVisualizationPass;
@@ -93,6 +119,12 @@ static void rendererSetupGlobalParameters(Film* film,
 
   parameters.intersectionThreshold = params.intersectionThreshold;
   parameters.worldSize = params.worldSize;
+
+  const GeometryFlatTree& tree = geometryGetFlatTree(sceneGetGeometryRoot(scene));
+  parameters.rayMarching.x = tree.lipschitzBounds[tree.getRootIndex()];
+  parameters.rayMarching.y = std::max(1.0f, std::min(params.relaxationFactor, 1.99f));
+  parameters.rayMarching.z = params.maxTraceDistance;
+  parameters.rayMarching.w = params.convergenceThreshold;
   
   parameters.resolution = filmGetSize(film);
   parameters.invResolution = float2(1.0f / parameters.resolution.x, 1.0f / parameters.resolution.y);
@@ -129,77 +161,222 @@ static void rendererSetupGlobalParameters(Film* film,
 
 static void rendererSetupGlobalLightParameters(Scene* scene)
 {
-  std::vector<AssetPtr> lightSources = sceneGetEnabledLightSources(scene);  
-  std::vector<LightSourceParameters> parameters(MAX_LIGHT_SOURCES_COUNT);
+  std::vector<AssetPtr> lightSources = sceneGetEnabledLightSources(scene);
+  parametersBufferResize(data.lightsParameters, lightSources.size());
 
-  for(uint32 i = 0; i < std::min<uint32>(MAX_LIGHT_SOURCES_COUNT, lightSources.size()); i++)
+  for(uint32 i = 0; i < lightSources.size(); i++)
   {
-    parameters[i] = lightSourceGetParameters(lightSources[i]);
+    parametersBufferWrite(data.lightsParameters, i, &lightSourceGetParameters(lightSources[i]));
   }
 
-  uint32 offset = sizeof(GlobalParameters);
+  parametersBufferUpload(data.lightsParameters, LIGHT_PARAMS_SSBO_BINDING);
+}
 
-  glBindBuffer(GL_UNIFORM_BUFFER, rendererGetResourceHandle(RR_GLOBAL_PARAMS_UBO));
-  glBufferSubData(GL_UNIFORM_BUFFER, offset,
-                  sizeof(LightSourceParameters) * parameters.size(),
-                  &parameters[0]);
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+/**
+ * Light grid splits the screen into tiles of LIGHT_GRID_TILE_SIZE pixels, each tile lists light
+ * sources whose attenuation volume is projected onto it, so shading cost of a pixel depends on the
+ * count of light sources which reach it rather than on the count of all light sources in the scene.
+ */
+static void rendererSetupLightGrid(Scene* scene, Camera* camera)
+{
+  std::vector<AssetPtr> lightSources = sceneGetEnabledLightSources(scene);
+
+  int2 resolution = int2(data.globalParameters.gapResolution);
+  int2 gridSize = (resolution + int2(LIGHT_GRID_TILE_SIZE - 1)) / LIGHT_GRID_TILE_SIZE;
+  uint32 tilesCount = gridSize.x * gridSize.y;
+
+  const Frustum& frustum = cameraGetFrustum(camera);
+  float4x4 worldNDCMat = cameraGetWorldNDCMat(camera);
+
+  // NOTE: Tiles covered by each light source as (min x, min y, max x, max y), max is exclusive
+  std::vector<int4>& lightTiles = data.lightTiles;
+  lightTiles.assign(lightSources.size(), int4(0, 0, gridSize.x, gridSize.y));
+
+  for(uint32 i = 0; i < lightSources.size(); i++)
+  {
+    const LightSourceParameters& light = lightSourceGetParameters(lightSources[i]);
+    float32 attenuationRadius = lightSourceGetAttenuationRadius(lightSources[i]);
+
+    if(light.type == LIGHT_SOURCE_TYPE_DIRECTIONAL || std::isinf(attenuationRadius))
+    {
+      continue;
+    }
+
+    float3 lightPosition = light.position.xyz();
+    AABB lightVolume = AABB(lightPosition - float3(attenuationRadius), lightPosition + float3(attenuationRadius));
+
+    if(frustum.intersects(lightVolume) == FALSE)
+    {
+      lightTiles[i] = int4(0, 0, 0, 0);
+      continue;
+    }
+
+    // NOTE: Volumes which cross the near plane cover the whole screen
+    int4 rect;
+    if(calculateScreenRect(lightVolume, worldNDCMat, resolution, rect) == TRUE)
+    {
+      lightTiles[i] = int4(clamp(rect.x / LIGHT_GRID_TILE_SIZE, 0, gridSize.x),
+                           clamp(rect.y / LIGHT_GRID_TILE_SIZE, 0, gridSize.y),
+                           clamp(rect.z / LIGHT_GRID_TILE_SIZE + 1, 0, gridSize.x),
+                           clamp(rect.w / LIGHT_GRID_TILE_SIZE + 1, 0, gridSize.y));
+    }
+  }
+
+  // NOTE: Counts of light sources per tile are calculated first, so that indices can be packed right
+  // after (offset, count) pairs without per tile allocations
+  std::vector<uint32>& grid = data.lightGridElements;
+  grid.assign(2 * tilesCount, 0);
+
+  for(const int4& tiles: lightTiles)
+  {
+    for(int32 y = tiles.y; y < tiles.w; y++)
+    {
+      for(int32 x = tiles.x; x < tiles.z; x++)
+      {
+        grid[2 * (y * gridSize.x + x) + 1]++;
+      }
+    }
+  }
+
+  uint32 offset = 2 * tilesCount;
+  for(uint32 tile = 0; tile < tilesCount; tile++)
+  {
+    grid[2 * tile] = offset;
+    offset += grid[2 * tile + 1];
+    grid[2 * tile + 1] = 0;
+  }
+
+  grid.resize(offset);
 
+  for(uint32 i = 0; i < lightTiles.size(); i++)
+  {
+    for(int32 y = lightTiles[i].y; y < lightTiles[i].w; y++)
+    {
+      for(int32 x = lightTiles[i].x; x < lightTiles[i].z; x++)
+      {
+        uint32 tile = y * gridSize.x + x;
+        grid[grid[2 * tile] + grid[2 * tile + 1]++] = i;
+      }
+    }
+  }
+
+  parametersBufferResize(data.lightGrid, grid.size());
+  parametersBufferWriteRange(data.lightGrid, 0, grid.size(), grid.data());
+
+  parametersBufferUpload(data.lightGrid, LIGHT_GRID_SSBO_BINDING);
+}
+
+static void rendererSetupInstancesParameters(Asset* geometry, uint32& instancesOffset, GeometryParameters& geo)
+{
+  const std::vector<GeometryInstance>& instances = geometryGetInstances(geometry);
+  
+  geo.instancesOffset = instancesOffset;
+  geo.instancesCount = instances.size();
+
+  GeometryInstancesLattice lattice;
+  if(geometryGetInstancesLattice(geometry, lattice) == TRUE)
+  {
+    geo.instancesLattice = 1;
+    geo.latticeOrigin = float4(lattice.origin, 0.0f);
+    geo.latticeSpacing = float4(lattice.spacing, 0.0f);
+    geo.latticeCount = uint4(lattice.count, 0);
+  }
+
+  for(const GeometryInstance& instance: instances)
+  {
+    GeometryInstanceParameters parameters = {};
+    parameters.materialID = instance.material != nullptr ? materialGetShaderID(instance.material) :
+                                                           UNKNOWN_MATERIAL_ID;
+    parameters.scale = instance.scale;
+    parameters.geoInstanceMat = inverse(mul(translation_matrix(instance.position),
+                                            rotation_matrix(instance.orientation)));
+
+    parametersBufferWrite(data.instancesParameters, instancesOffset++, &parameters);
+  }
 }
 
 static void rendererSetupGeometriesParameters(Scene* scene)
 {
-  const std::set<AssetPtr>& children = geometryRootGetAllChildren(sceneGetGeometryRoot(scene));
-  std::vector<GeometryParameters> parameters(MAX_GEOMETRIES);
+  const GeometryFlatTree& tree = geometryGetFlatTree(sceneGetGeometryRoot(scene));
 
-  for(AssetPtr geometry: children)
+  // NOTE: IDs are assigned in preorder starting from the root, so they're in [0, nodes count)
+  parametersBufferResize(data.geometriesParameters, tree.geometries.size());
+
+  // NOTE: Instances of all leaves are packed into a single array, in postorder of leaves
+  uint32 instancesCount = 0;
+  for(uint32 i = 0; i < tree.getRootIndex(); i++)
   {
-    GeometryParameters geo;
+    if(tree.firstChildren[i] == GEOMETRY_INVALID_INDEX)
+    {
+      instancesCount += geometryGetInstances(tree.geometries[i]).size();
+    }
+  }
+
+  parametersBufferResize(data.instancesParameters, instancesCount);
+
+  // NOTE: Root is the last one and it's not a real geometry, so it's skipped
+  uint32 instancesOffset = 0;
+  for(uint32 i = 0; i < tree.getRootIndex(); i++)
+  {
+    GeometryParameters geo = {};
 
-    if(geometryIsLeaf(geometry) == TRUE)
+    if(tree.firstChildren[i] == GEOMETRY_INVALID_INDEX)
     {
-      geo.materialID = materialGetShaderID(geometryGetMaterial(geometry));
+      geo.materialID = materialGetShaderID(tree.materials[i]);
+      rendererSetupInstancesParameters(tree.geometries[i], instancesOffset, geo);
     }
     else
     {
       geo.materialID = UNKNOWN_MATERIAL_ID;
     }
     
-    geo.position = float4(geometryGetPosition(geometry), 1.0);
-    geo.scale = float4(geometryGetFullScale(geometry), 1.0);
-    geo.geoWorldMat = geometryGetGeoWorldMat(geometry);
-    geo.worldGeoMat = geometryGetWorldGeoMat(geometry);
-    geo.geoParentMat = geometryGetGeoParentMat(geometry);
-    geo.parentGeoMat = geometryGetParentGeoMat(geometry);
-
-    parameters[geometryGetID(geometry)] = geo;
+    geo.position = float4(tree.positions[i], 1.0);
+    geo.scale = float4(tree.fullScales[i], 1.0);
+    geo.geoWorldMat = tree.transformsToWorld[i];
+    geo.worldGeoMat = tree.transformsToLocal[i];
+    geo.geoParentMat = tree.transformsToParentFromLocal[i];
+    geo.parentGeoMat = tree.transformsToLocalFromParent[i];
+
+    // NOTE: Only geometries which have changed are uploaded
+    parametersBufferWrite(data.geometriesParameters, tree.ids[i], &geo);
   }
 
-  glBindBuffer(GL_UNIFORM_BUFFER, rendererGetResourceHandle(RR_GEOTRANSFORM_PARAMS_UBO));
-  glBufferSubData(GL_UNIFORM_BUFFER, 0,
-                  sizeof(GeometryParameters) * parameters.size(),
-                  &parameters[0]);
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);  
+  parametersBufferUpload(data.geometriesParameters, GEOMETRY_PARAMS_SSBO_BINDING);
+  parametersBufferUpload(data.instancesParameters, INSTANCE_PARAMS_SSBO_BINDING);
 }
 
-static void rendererSetupMaterialsParameters()
+// NOTE: Bake programs read parameters of geometries, so it's done after they're uploaded
+static void rendererBakeDistanceFields(Scene* scene)
 {
-  std::vector<AssetPtr> materials = assetsManagerGetAssetsByType(ASSET_TYPE_MATERIAL);
-  std::vector<MaterialParameters> parameters(MAX_MATERIALS);
+  const GeometryFlatTree& tree = geometryGetFlatTree(sceneGetGeometryRoot(scene));
 
-  for(AssetPtr material: materials)
+  for(uint32 i = 0; i < tree.getRootIndex(); i++)
   {
-    parameters[materialGetShaderID(material)] = materialToMaterialParameters(material);
+    if(tree.firstChildren[i] != GEOMETRY_INVALID_INDEX && tree.enabled[i] == true)
+    {
+      geometryBakeDistanceField(tree.geometries[i]);
+    }
   }
+}
 
-  uint32 offset = sizeof(GlobalParameters) + sizeof(LightSourceParameters) * MAX_LIGHT_SOURCES_COUNT;
+static void rendererSetupMaterialsParameters()
+{
+  const std::vector<AssetPtr>& materials = assetsManagerGetAssetsByType(ASSET_TYPE_MATERIAL);
+  parametersBufferResize(data.materialsParameters, materials.size());
 
-  glBindBuffer(GL_UNIFORM_BUFFER, rendererGetResourceHandle(RR_GLOBAL_PARAMS_UBO));
-  glBufferSubData(GL_UNIFORM_BUFFER, offset,
-                  sizeof(MaterialParameters) * parameters.size(),
-                  &parameters[0]);
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  for(const AssetPtr& material: materials)
+  {
+    uint32 shaderID = materialGetShaderID(material);
+    if(shaderID >= materials.size())
+    {
+      continue;
+    }
+
+    MaterialParameters parameters = materialToMaterialParameters(material);
+    parametersBufferWrite(data.materialsParameters, shaderID, &parameters);
+  }
 
+  parametersBufferUpload(data.materialsParameters, MATERIAL_PARAMS_SSBO_BINDING);
 }
 
 // ----------------------------------------------------------------------------
@@ -210,7 +387,11 @@ static bool8 initStacksSSBO()
 {
   glGenBuffers(1, &data.handles[RR_DISTANCES_STACK_SSBO]);
   glBindBuffer(GL_SHADER_STORAGE_BUFFER, data.handles[RR_DISTANCES_STACK_SSBO]);
-  glBufferData(GL_SHADER_STORAGE_BUFFER, GEOMETRY_STACK_MEMBERS_COUNT * MAX_WIDTH * MAX_HEIGHT * sizeof(float32), NULL, GL_DYNAMIC_COPY);
+  // NOTE: Shadow rays of each light source use their own slice of stacks (see getShadowSlice() in common.glsl)
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               GEOMETRY_STACK_MEMBERS_COUNT * MAX_WIDTH * MAX_HEIGHT * MAX_SHADOW_LIGHT_SOURCES_COUNT * sizeof(float32),
+               NULL,
+               GL_DYNAMIC_COPY);
   glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STACKS_SSBO_BINDING, data.handles[RR_DISTANCES_STACK_SSBO]);
 
@@ -221,24 +402,46 @@ static bool8 initGlobalParamsUBO()
 {
   glGenBuffers(1, &data.handles[RR_GLOBAL_PARAMS_UBO]);
   glBindBuffer(GL_UNIFORM_BUFFER, data.handles[RR_GLOBAL_PARAMS_UBO]);
-  glBufferData(GL_UNIFORM_BUFFER,
-               sizeof(GlobalParameters) + MAX_LIGHT_SOURCES_COUNT * sizeof(LightSourceParameters) + MAX_MATERIALS * sizeof(MaterialParameters),
-               NULL, GL_DYNAMIC_DRAW);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(GlobalParameters), NULL, GL_DYNAMIC_DRAW);
   glBindBuffer(GL_UNIFORM_BUFFER, 0);
   glBindBufferBase(GL_UNIFORM_BUFFER, GLOBAL_PARAMS_UBO_BINDING, data.handles[RR_GLOBAL_PARAMS_UBO]);
 
   return TRUE;
 }
 
-static bool8 initGeometryTransformParamsUBO()
+static bool8 initGeometryParamsSSBO()
 {
-  glGenBuffers(1, &data.handles[RR_GEOTRANSFORM_PARAMS_UBO]);
-  glBindBuffer(GL_UNIFORM_BUFFER, data.handles[RR_GEOTRANSFORM_PARAMS_UBO]);
-  glBufferData(GL_UNIFORM_BUFFER, sizeof(GeometryParameters) * MAX_GEOMETRIES, NULL, GL_DYNAMIC_COPY);
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
-  glBindBufferBase(GL_UNIFORM_BUFFER, GEOMETRY_TRANSFORMS_UBO_BINDING, data.handles[RR_GEOTRANSFORM_PARAMS_UBO]);
+  return createParametersBuffer(sizeof(GeometryParameters),
+                                INITIAL_GEOMETRIES_CAPACITY,
+                                &data.geometriesParameters);
+}
 
-  return TRUE;
+static bool8 initMaterialParamsSSBO()
+{
+  return createParametersBuffer(sizeof(MaterialParameters),
+                                INITIAL_MATERIALS_CAPACITY,
+                                &data.materialsParameters);
+}
+
+static bool8 initInstanceParamsSSBO()
+{
+  return createParametersBuffer(sizeof(GeometryInstanceParameters),
+                                INITIAL_INSTANCES_CAPACITY,
+                                &data.instancesParameters);
+}
+
+static bool8 initLightParamsSSBO()
+{
+  return createParametersBuffer(sizeof(LightSourceParameters),
+                                INITIAL_LIGHTS_CAPACITY,
+                                &data.lightsParameters);
+}
+
+static bool8 initLightGridSSBO()
+{
+  return createParametersBuffer(sizeof(uint32),
+                                INITIAL_LIGHT_GRID_CAPACITY,
+                                &data.lightGrid);
 }
 
 static bool8 initCoverageMaskTexture()
@@ -266,6 +469,44 @@ static bool8 initRaysMapTexture()
   return TRUE;
 }
 
+static bool8 initShadowCoverageMaskTexture()
+{
+  glGenTextures(1, &data.handles[RR_SHADOW_COVERAGE_MASK_TEXTURE]);
+  glBindTexture(GL_TEXTURE_2D, data.handles[RR_SHADOW_COVERAGE_MASK_TEXTURE]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8,
+               MAX_WIDTH, MAX_HEIGHT * MAX_SHADOW_LIGHT_SOURCES_COUNT, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return TRUE;
+}
+
+// NOTE: Slices of shadow rays of all light sources are stacked vertically
+static bool8 initShadowRaysMapTexture()
+{
+  glGenTextures(1, &data.handles[RR_SHADOW_RAYS_MAP_TEXTURE]);
+  glBindTexture(GL_TEXTURE_2D, data.handles[RR_SHADOW_RAYS_MAP_TEXTURE]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, MAX_WIDTH, MAX_HEIGHT * MAX_SHADOW_LIGHT_SOURCES_COUNT, 0, GL_RGBA, GL_FLOAT, NULL);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return TRUE;
+}
+
+static bool8 initConeDistancesMapTexture()
+{
+  glGenTextures(1, &data.handles[RR_CONE_DISTANCES_MAP_TEXTURE]);
+  glBindTexture(GL_TEXTURE_2D, data.handles[RR_CONE_DISTANCES_MAP_TEXTURE]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, MAX_WIDTH, MAX_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return TRUE;
+}
+
 static bool8 initGeometryIDMapTexture()
 {
   glGenTextures(1, &data.handles[RR_GEOIDS_MAP_TEXTURE]);
@@ -340,20 +581,83 @@ static bool8 initShadowsMapTexture()
   return TRUE;
 }
 
+// NOTE: Distances sampled by SDF occlusion pass, layers are separate draw buffers (see sdf_occlusion_pass.cpp)
+static bool8 initOcclusionSamplesMapTexture()
+{
+  glGenTextures(1, &data.handles[RR_OCCLUSION_SAMPLES_MAP_TEXTURE]);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, data.handles[RR_OCCLUSION_SAMPLES_MAP_TEXTURE]);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA16F, MAX_WIDTH, MAX_HEIGHT, SDF_OCCLUSION_SAMPLES_LAYERS_COUNT,
+               0, GL_RGBA, GL_FLOAT, NULL);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  return TRUE;
+}
+
+// NOTE: R - ambient occlusion, G - contact shadow of the key light source (see sdf_occlusion_pass.h)
+static bool8 initOcclusionMapTexture()
+{
+  glGenTextures(1, &data.handles[RR_OCCLUSION_MAP_TEXTURE]);
+  glBindTexture(GL_TEXTURE_2D, data.handles[RR_OCCLUSION_MAP_TEXTURE]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, MAX_WIDTH, MAX_HEIGHT, 0, GL_RG, GL_FLOAT, NULL);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return TRUE;
+}
+
+// NOTE: Shadows and depth of the previous frame, reused by the shadow pass (see shadow_rasterization_pass.cpp)
+static bool8 initShadowsHistoryTextures()
+{
+  glGenTextures(1, &data.handles[RR_SHADOWS_HISTORY_MAP_TEXTURE]);
+  glBindTexture(GL_TEXTURE_2D, data.handles[RR_SHADOWS_HISTORY_MAP_TEXTURE]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, MAX_WIDTH, MAX_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+
+  glGenTextures(1, &data.handles[RR_DEPTH_HISTORY_MAP_TEXTURE]);
+  glBindTexture(GL_TEXTURE_2D, data.handles[RR_DEPTH_HISTORY_MAP_TEXTURE]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, MAX_WIDTH, MAX_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+
+  glGenTextures(1, &data.handles[RR_SHADOWS_REUSE_MASK_TEXTURE]);
+  glBindTexture(GL_TEXTURE_2D, data.handles[RR_SHADOWS_REUSE_MASK_TEXTURE]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, MAX_WIDTH, MAX_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+  
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return TRUE;
+}
+
 static bool8 initializeRendererResources()
 {
   glCreateVertexArrays(1, &data.handles[RR_EMPTY_VAO]);
 
   INIT(initStacksSSBO);
   INIT(initGlobalParamsUBO);
-  INIT(initGeometryTransformParamsUBO);
+  INIT(initGeometryParamsSSBO);
+  INIT(initMaterialParamsSSBO);
+  INIT(initInstanceParamsSSBO);
+  INIT(initLightParamsSSBO);
+  INIT(initLightGridSSBO);
   INIT(initCoverageMaskTexture);
   INIT(initRaysMapTexture);
+  INIT(initConeDistancesMapTexture);
+  INIT(initShadowCoverageMaskTexture);
+  INIT(initShadowRaysMapTexture);
   INIT(initGeometryIDMapTexture);
   INIT(initDepthMapTexture);
   INIT(initLDRMapTexture);
   INIT(initNormalsMapTexture);
   INIT(initShadowsMapTexture);
+  INIT(initShadowsHistoryTextures);
+  INIT(initOcclusionSamplesMapTexture);
+  INIT(initOcclusionMapTexture);
   
   return TRUE;
 }
@@ -363,15 +667,28 @@ static void destroyRendererResources()
   glDeleteVertexArrays(1, &data.handles[RR_EMPTY_VAO]);
   glDeleteBuffers(1, &data.handles[RR_DISTANCES_STACK_SSBO]);
   glDeleteBuffers(1, &data.handles[RR_GLOBAL_PARAMS_UBO]);
-  glDeleteBuffers(1, &data.handles[RR_GEOTRANSFORM_PARAMS_UBO]);
   glDeleteTextures(1, &data.handles[RR_COVERAGE_MASK_TEXTURE]);
   glDeleteTextures(1, &data.handles[RR_RAYS_MAP_TEXTURE]);
+  glDeleteTextures(1, &data.handles[RR_CONE_DISTANCES_MAP_TEXTURE]);
+  glDeleteTextures(1, &data.handles[RR_SHADOW_COVERAGE_MASK_TEXTURE]);
+  glDeleteTextures(1, &data.handles[RR_SHADOW_RAYS_MAP_TEXTURE]);
   glDeleteTextures(1, &data.handles[RR_GEOIDS_MAP_TEXTURE]);  
   glDeleteTextures(1, &data.handles[RR_DEPTH1_MAP_TEXTURE]);
   glDeleteTextures(1, &data.handles[RR_DEPTH2_MAP_TEXTURE]);    
   glDeleteTextures(1, &data.handles[RR_LDR1_MAP_TEXTURE]);
   glDeleteTextures(1, &data.handles[RR_LDR2_MAP_TEXTURE]);  
   glDeleteTextures(1, &data.handles[RR_SHADOWS_MAP_TEXTURE]);
+  glDeleteTextures(1, &data.handles[RR_SHADOWS_HISTORY_MAP_TEXTURE]);
+  glDeleteTextures(1, &data.handles[RR_DEPTH_HISTORY_MAP_TEXTURE]);
+  glDeleteTextures(1, &data.handles[RR_SHADOWS_REUSE_MASK_TEXTURE]);
+  glDeleteTextures(1, &data.handles[RR_OCCLUSION_SAMPLES_MAP_TEXTURE]);
+  glDeleteTextures(1, &data.handles[RR_OCCLUSION_MAP_TEXTURE]);
+
+  destroyParametersBuffer(data.geometriesParameters);
+  destroyParametersBuffer(data.materialsParameters);
+  destroyParametersBuffer(data.instancesParameters);
+  destroyParametersBuffer(data.lightsParameters);
+  destroyParametersBuffer(data.lightGrid);
 }
 
 // ----------------------------------------------------------------------------
@@ -383,6 +700,7 @@ static bool8 initializeRenderPasses()
   INIT(createRasterizationPass, &data.rasterizationPass);
   INIT(createShadowRasterizationPass, &data.shadowRasterizationPass);
   INIT(createNormalsCalculationPass, &data.normalsCalculationPass);
+  INIT(createSDFOcclusionPass, &data.sdfOcclusionPass);
   INIT(createDistancesVisualizationPass,
        float2(0.0f, 20.0f), float3(0.156f, 0.7, 0.06), float3(0.0f, 0.0f, 0.0f),
        &data.distancesVisualizationPass);
@@ -392,6 +710,8 @@ static bool8 initializeRenderPasses()
   INIT(createLightsVisualizationPass, &data.lightsVisualizationPass);
   INIT(createLDRToFilmCopyPass, &data.ldrToFilmPass);
   INIT(initializeAABBCalculationPass);
+  INIT(initializeRayHitPass);
+  INIT(initializeDistanceFieldBakingPass);
   INIT(createSimpleShadingPass, &data.simpleShadingPass);
   INIT(createSkyRenderingPass, &data.skyRenderingPass);  
   INIT(createFogPass, &data.fogPass);
@@ -399,6 +719,7 @@ static bool8 initializeRenderPasses()
   data.passes.push_back(data.rasterizationPass);
   data.passes.push_back(data.shadowRasterizationPass);
   data.passes.push_back(data.normalsCalculationPass);
+  data.passes.push_back(data.sdfOcclusionPass);
   data.passes.push_back(data.distancesVisualizationPass);
   data.passes.push_back(data.idsVisualizationPass);
   data.passes.push_back(data.normalsVisualizationPass);
@@ -415,6 +736,7 @@ static void destroyRenderPasses()
 {
   destroyRenderPass(data.rasterizationPass);
   destroyRenderPass(data.normalsCalculationPass);
+  destroyRenderPass(data.sdfOcclusionPass);
   destroyRenderPass(data.distancesVisualizationPass);
   destroyRenderPass(data.idsVisualizationPass);
   destroyRenderPass(data.normalsVisualizationPass);
@@ -426,6 +748,8 @@ static void destroyRenderPasses()
   destroyRenderPass(data.fogPass);
 
   destroyAABBCalculationPass();
+  destroyRayHitPass();
+  destroyDistanceFieldBakingPass();
 }
 
 bool8 initializeRenderer()
@@ -468,7 +792,9 @@ bool8 rendererRenderScene(Film* film,
   
   rendererSetupGlobalParameters(film, scene, camera, params);
   rendererSetupGlobalLightParameters(scene);
+  rendererSetupLightGrid(scene, camera);
   rendererSetupGeometriesParameters(scene);
+  rendererBakeDistanceFields(scene);
   rendererSetupMaterialsParameters();
 
   pushViewport(0, 0, data.globalParameters.gapResolution.x, data.globalParameters.gapResolution.y);
@@ -484,6 +810,9 @@ bool8 rendererRenderScene(Film* film,
   {
     assert(renderPassExecute(data.shadowRasterizationPass));
   }
+
+  // NOTE: Pass clears the occlusion map even if it's off, because shading reads it
+  assert(renderPassExecute(data.sdfOcclusionPass));
   
   if(params.shadingMode == RS_VISUALIZE_DISTANCES)
   {
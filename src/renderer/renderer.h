@@ -28,17 +28,24 @@ enum RendererResourceType
   RR_DISTANCES_STACK_SSBO,
   
   RR_GLOBAL_PARAMS_UBO,
-  RR_GEOTRANSFORM_PARAMS_UBO,
   
   RR_COVERAGE_MASK_TEXTURE,
   RR_GEOIDS_MAP_TEXTURE,
   RR_RAYS_MAP_TEXTURE,
+  RR_CONE_DISTANCES_MAP_TEXTURE,
+  RR_SHADOW_COVERAGE_MASK_TEXTURE,
+  RR_SHADOW_RAYS_MAP_TEXTURE,
   
   RR_DEPTH1_MAP_TEXTURE,
   RR_DEPTH2_MAP_TEXTURE,  
   RR_NORMALS_MAP_TEXTURE,
   RR_SHADOWS_MAP_TEXTURE,
+  RR_SHADOWS_HISTORY_MAP_TEXTURE,
+  RR_DEPTH_HISTORY_MAP_TEXTURE,
+  RR_SHADOWS_REUSE_MASK_TEXTURE,
   RR_TEXCOORDS_MAP_TEXTURE,
+  RR_OCCLUSION_SAMPLES_MAP_TEXTURE,
+  RR_OCCLUSION_MAP_TEXTURE,
   
   RR_RADIANCE_MAP_TEXTURE,
   RR_LDR1_MAP_TEXTURE,
@@ -54,16 +61,31 @@ struct RenderingParameters
   float32 gamma = 2.2f;
   float32 intersectionThreshold = 0.1f;
   float32 worldSize = 50.0f;
+
+  // NOTE: Factor in [1, 2) by which steps of primary rays are enlarged, 1 disables over-relaxation
+  float32 relaxationFactor = 1.6f;
+  float32 maxTraceDistance = 100.0f;
+  float32 convergenceThreshold = 0.001f;
   
   RendererShadingMode shadingMode = RS_VISUALIZE_DISTANCES;
 
   uint32 rasterItersMaxCount = 8;
   uint32 shadowRasterItersMaxCount = 8;
 
+  // NOTE: Cone marching pre-pass traces one cone per block of coneBlockSize^2 pixels, rays of the
+  // block start from the distance reached by the cone (block size less than 2 disables the pre-pass)
+  uint32 coneBlockSize = 8;
+  uint32 coneItersMaxCount = 16;
+
   uint2 pixelGap = uint2(2, 2);
   
   bool8 enableNormals  = TRUE;
+  // NOTE: Normals of leaves are calculated by differences of their distances, normals reconstructed
+  // from depth are kept for pixels which leaves don't describe alone
+  bool8 enableAnalyticNormals = TRUE;
   bool8 enableShadows  = TRUE;
+  // NOTE: Shadows are reused from the previous frame when light sources and geometry haven't changed
+  bool8 enableShadowCache = TRUE;
   bool8 showUIWidgets  = TRUE;
   bool8 showLights     = TRUE;
   bool8 showBillboards = TRUE;
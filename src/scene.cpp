@@ -1,6 +1,7 @@
 #include <algorithm>
 
 #include <assets/assets_factory.h>
+#include <renderer/passes/geometry_ray_hit_pass.h>
 #include <../bin/shaders/declarations.h>
 
 #include "memory_manager.h"
@@ -58,17 +59,18 @@ bool8 serializeScene(Scene* scene, nlohmann::json& json)
   return TRUE;
 }
 
-bool8 deserializeScene(Scene* scene, nlohmann::json& json)
+bool8 deserializeScene(Scene* scene, DocumentValue value)
 {
   scene->lightSources.clear();
   
-  scene->name = json["name"];
-  scene->geometryRoot = createAssetFromJson(json["geometry_root"]);
+  scene->name = documentValueGetString(documentValueFind(value, "name"));
+  scene->geometryRoot = createAssetFromDocument(documentValueFind(value, "geometry_root"));
 
-  uint32 lightsCount = json["lights_count"];
+  uint32 lightsCount = documentValueGet(value, "lights_count", 0u);
+  DocumentValue lights = documentValueFind(value, "lights");
   for(uint32 i = 0; i < lightsCount; i++)
   {
-    scene->lightSources.push_back(createAssetFromJson(json["lights"][i]));
+    scene->lightSources.push_back(createAssetFromDocument(documentValueGetElement(lights, i)));
   }
 
   return TRUE;
@@ -116,11 +118,6 @@ const std::set<AssetPtr>& sceneGetAllChildren(Scene* scene)
 
 bool8 sceneAddLightSource(Scene* scene, AssetPtr lightSource)
 {
-  if(scene->lightSources.size() >= MAX_LIGHT_SOURCES_COUNT)
-  {
-    return FALSE;
-  }
-  
   scene->lightSources.push_back(lightSource);
   return TRUE;
 }
@@ -158,3 +155,136 @@ std::vector<AssetPtr> sceneGetEnabledLightSources(Scene* scene)
 
   return result;
 }
+
+/** Leaf is effectively enabled only if all of its parents are enabled too */
+static bool8 sceneLeafIsEnabled(const GeometryFlatTree& tree, uint32 index)
+{
+  for(uint32 i = index; i != GEOMETRY_INVALID_INDEX; i = tree.parents[i])
+  {
+    if(tree.enabled[i] == false)
+    {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static void sceneCollectEnabledLeaves(const GeometryFlatTree& tree,
+                                      const vector<uint32>& primitives,
+                                      vector<Asset*>& outGeometries)
+{
+  for(uint32 primitive: primitives)
+  {
+    if(sceneLeafIsEnabled(tree, primitive) == TRUE)
+    {
+      outGeometries.push_back(tree.geometries[primitive]);
+    }
+  }
+}
+
+void sceneQueryFrustum(Scene* scene, const Frustum& frustum, std::vector<Asset*>& outGeometries)
+{
+  const GeometryFlatTree& tree = geometryGetFlatTree(scene->geometryRoot.raw());
+
+  vector<uint32> primitives;
+  bvhQueryFrustum(tree.leavesBVH, frustum, primitives);
+  sceneCollectEnabledLeaves(tree, primitives, outGeometries);
+}
+
+void sceneQuerySphere(Scene* scene, float3 center, float32 radius, std::vector<Asset*>& outGeometries)
+{
+  const GeometryFlatTree& tree = geometryGetFlatTree(scene->geometryRoot.raw());
+
+  vector<uint32> primitives;
+  bvhQuerySphere(tree.leavesBVH, center, radius, primitives);
+  sceneCollectEnabledLeaves(tree, primitives, outGeometries);
+}
+
+void sceneQueryRay(Scene* scene, const Ray& ray, float32 maxDistance, std::vector<SceneRayHit>& outHits)
+{
+  const GeometryFlatTree& tree = geometryGetFlatTree(scene->geometryRoot.raw());
+
+  vector<BVHRayHit> hits;
+  bvhQueryRay(tree.leavesBVH, ray, maxDistance, hits);
+
+  for(const BVHRayHit& hit: hits)
+  {
+    if(sceneLeafIsEnabled(tree, hit.primitive) == TRUE)
+    {
+      outHits.push_back(SceneRayHit{tree.geometries[hit.primitive], hit.distance});
+    }
+  }
+}
+
+/** Subtracted leaves only carve other geometries, so they can't be picked */
+static bool8 sceneLeafIsSubtracted(const GeometryFlatTree& tree, uint32 index)
+{
+  uint32 parent = tree.parents[index];
+
+  return geometryGetPCFNativeType(tree.geometries[parent]) == PCF_NATIVE_TYPE_SUBTRACTION &&
+    tree.firstEnabledChildren[parent] != index;
+}
+
+bool8 scenePick(Scene* scene, const Ray& ray, ScenePickResult& outResult, float32 maxDistance)
+{
+  const GeometryFlatTree& tree = geometryGetFlatTree(scene->geometryRoot.raw());
+
+  vector<BVHRayHit> hits;
+  bvhQueryRay(tree.leavesBVH, ray, maxDistance, hits);
+
+  outResult.geometry = nullptr;
+  outResult.distance = maxDistance;
+
+  vector<Asset*> candidates;
+  for(const BVHRayHit& hit: hits)
+  {
+    if(sceneLeafIsEnabled(tree, hit.primitive) == TRUE && sceneLeafIsSubtracted(tree, hit.primitive) == FALSE)
+    {
+      candidates.push_back(tree.geometries[hit.primitive]);
+    }
+  }
+
+  if(candidates.empty() == true)
+  {
+    return FALSE;
+  }
+
+  // NOTE: Each leaf has its own program, but results of all of them are read back at once
+  rayHitPassBeginBatch(candidates.size());
+  for(uint32 i = 0; i < candidates.size(); i++)
+  {
+    geometryTraceRay(candidates[i], ray, maxDistance, i);
+  }
+
+  vector<float32> hitDistances;
+  rayHitPassReadHits(hitDistances);
+
+  int32 nearest = sceneSelectNearestHit(hitDistances, maxDistance);
+  if(nearest < 0)
+  {
+    return FALSE;
+  }
+
+  outResult.geometry = candidates[nearest];
+  outResult.distance = hitDistances[nearest];
+  outResult.point = ray.origin + ray.direction * outResult.distance;
+  return TRUE;
+}
+
+int32 sceneSelectNearestHit(const std::vector<float32>& hitDistances, float32 maxDistance)
+{
+  int32 nearest = -1;
+  float32 nearestDistance = maxDistance;
+
+  for(uint32 i = 0; i < hitDistances.size(); i++)
+  {
+    if(hitDistances[i] >= 0.0f && hitDistances[i] < nearestDistance)
+    {
+      nearest = i;
+      nearestDistance = hitDistances[i];
+    }
+  }
+
+  return nearest;
+}
@@ -14,7 +14,7 @@ ENGINE_API bool8 createScene(Scene** outScene);
 ENGINE_API void destroyScene(Scene* scene);
 
 ENGINE_API bool8 serializeScene(Scene* scene, nlohmann::json& json);
-ENGINE_API bool8 deserializeScene(Scene* scene, nlohmann::json& json);
+ENGINE_API bool8 deserializeScene(Scene* scene, DocumentValue value);
 
 ENGINE_API void updateScene(Scene* scene, float64 delta);
 
@@ -31,3 +31,43 @@ ENGINE_API bool8 sceneAddLightSource(Scene* scene, AssetPtr lightSource);
 ENGINE_API bool8 sceneRemoveLightSource(Scene* scene, AssetPtr lightSource);
 ENGINE_API std::vector<AssetPtr>& sceneGetLightSources(Scene* scene);
 ENGINE_API std::vector<AssetPtr> sceneGetEnabledLightSources(Scene* scene);
+
+struct SceneRayHit
+{
+  Asset* geometry;
+  // NOTE: Distance at which the ray enters the final AABB of the geometry
+  float32 distance;
+};
+
+/**
+ * Spatial queries over enabled leaf geometries of the scene, they use BVH of the geometry flat tree,
+ * so results are up to date as of the last updateScene().
+ */
+ENGINE_API void sceneQueryFrustum(Scene* scene, const Frustum& frustum, std::vector<Asset*>& outGeometries);
+ENGINE_API void sceneQuerySphere(Scene* scene, float3 center, float32 radius, std::vector<Asset*>& outGeometries);
+
+/** @param outHits hits sorted by distance */
+ENGINE_API void sceneQueryRay(Scene* scene, const Ray& ray, float32 maxDistance, std::vector<SceneRayHit>& outHits);
+
+struct ScenePickResult
+{
+  Asset* geometry;
+  float32 distance;
+  float3 point;
+};
+
+/**
+ * Finds the closest leaf geometry hit by the ray, candidates are found by BVH on CPU and all of them
+ * are traced on GPU as a single batch (see geometryTraceRay()), doesn't require anything to be rendered.
+ * @return FALSE if nothing is hit
+ */
+ENGINE_API bool8 scenePick(Scene* scene, const Ray& ray, ScenePickResult& outResult,
+                           float32 maxDistance = 1000.0f);
+
+/**
+ * Selects the nearest hit of traced candidates, ties are resolved in favour of the earlier candidate
+ * (candidates are ordered by distances to their bounds, see bvhQueryRay()).
+ * @param hitDistances distances to surfaces of candidates, negative values for misses
+ * @return index of the nearest candidate closer than maxDistance or -1 if there is no such candidate
+ */
+ENGINE_API int32 sceneSelectNearestHit(const std::vector<float32>& hitDistances, float32 maxDistance);
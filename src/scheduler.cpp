@@ -1,61 +1,530 @@
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
 #include <vector>
+#include <algorithm>
 #include <unordered_map>
+#include <condition_variable>
 
+using std::deque;
+using std::mutex;
+using std::thread;
 using std::vector;
 using std::unordered_map;
 
+#include "cvar_system.h"
 #include "scheduler.h"
 
+DECLARE_CVAR_FLAGS(engine_Scheduler_WorkersCount, 1u, CVAR_FLAG_READ_ONLY);
+
+// NOTE: Hierarchical timer wheel, each level has 64 slots and every slot of a level covers the whole
+// previous level. With 10ms ticks 4 levels cover ~46 hours, longer delays are clamped.
+static const uint32 SCHEDULER_WHEEL_LEVELS_COUNT = 4;
+static const uint32 SCHEDULER_WHEEL_SLOT_BITS = 6;
+static const uint32 SCHEDULER_WHEEL_SLOTS_COUNT = 1 << SCHEDULER_WHEEL_SLOT_BITS;
+static const uint32 SCHEDULER_WHEEL_SLOT_MASK = SCHEDULER_WHEEL_SLOTS_COUNT - 1;
+static const uint64 SCHEDULER_WHEEL_MAX_DELAY = (1ull << (SCHEDULER_WHEEL_SLOT_BITS * SCHEDULER_WHEEL_LEVELS_COUNT)) - 1;
+static const float64 SCHEDULER_TICK_DURATION = 0.01;
+
 struct ScheduleFunctionData
 {
   schedulerFunction function;
+  void* owner;
   void* userData;
   float32 updateTime;
-  float32 elapsedTime;
+
+  // NOTE: In ticks, 0 for one shot functions
+  uint64 period;
+  uint64 expirationTick;
+
+  uint32 generation;
+  bool8 alive;
+
+  // NOTE: Intrusive list of a wheel slot (or of free functions)
+  uint32 prev;
+  uint32 next;
+  uint32* slotHead;
+};
+
+struct SchedulerJobData
+{
+  schedulerJob job;
+  schedulerJob onCompleted;
 };
 
 struct SchedulerData
 {
   bool8 initialized;
-  
-  unordered_map<void*, vector<ScheduleFunctionData>> ownerFunctions;
+
+  // NOTE: Deque, because a function may register another function while it's being called
+  deque<ScheduleFunctionData> functions;
+  uint32 freeFunctionsHead = SCHEDULER_INVALID_TASK_INDEX;
+  uint32 executingFunction = SCHEDULER_INVALID_TASK_INDEX;
+  vector<SchedulerTaskHandle> expiredFunctions;
+
+  uint32 wheel[SCHEDULER_WHEEL_LEVELS_COUNT][SCHEDULER_WHEEL_SLOTS_COUNT];
+
+  // NOTE: Next tick to be processed
+  uint64 currentTick;
+  float64 pendingTime;
+
+  unordered_map<void*, vector<uint32>> ownerFunctions;
+
+  vector<thread> workers;
+  mutex jobsMutex;
+  std::condition_variable jobsCondition;
+  deque<SchedulerJobData> jobs;
+  bool8 stopWorkers;
+
+  mutex completedJobsMutex;
+  vector<schedulerJob> completedJobs;
+  std::atomic<uint32> pendingJobsCount;
 };
 
 static SchedulerData data;
 
+static uint64 schedulerTimeToTicks(float32 time)
+{
+  uint64 ticks = (uint64)(time / SCHEDULER_TICK_DURATION + 0.5);
+  return std::max<uint64>(ticks, 1);
+}
+
+static void schedulerLinkFunction(uint32 index, uint32* slotHead)
+{
+  ScheduleFunctionData& functionData = data.functions[index];
+  functionData.prev = SCHEDULER_INVALID_TASK_INDEX;
+  functionData.next = *slotHead;
+  functionData.slotHead = slotHead;
+
+  if(*slotHead != SCHEDULER_INVALID_TASK_INDEX)
+  {
+    data.functions[*slotHead].prev = index;
+  }
+
+  *slotHead = index;
+}
+
+static void schedulerUnlinkFunction(uint32 index)
+{
+  ScheduleFunctionData& functionData = data.functions[index];
+  if(functionData.slotHead == nullptr)
+  {
+    return;
+  }
+
+  if(functionData.prev != SCHEDULER_INVALID_TASK_INDEX)
+  {
+    data.functions[functionData.prev].next = functionData.next;
+  }
+  else
+  {
+    *functionData.slotHead = functionData.next;
+  }
+
+  if(functionData.next != SCHEDULER_INVALID_TASK_INDEX)
+  {
+    data.functions[functionData.next].prev = functionData.prev;
+  }
+
+  functionData.prev = SCHEDULER_INVALID_TASK_INDEX;
+  functionData.next = SCHEDULER_INVALID_TASK_INDEX;
+  functionData.slotHead = nullptr;
+}
+
+static void schedulerInsertFunction(uint32 index)
+{
+  ScheduleFunctionData& functionData = data.functions[index];
+
+  // NOTE: Only cascading inserts functions which expire at the current tick, they are inserted right
+  // before the slot of the current tick is processed.
+  uint64 expirationTick = std::max(functionData.expirationTick, data.currentTick);
+  expirationTick = std::min(expirationTick, data.currentTick + SCHEDULER_WHEEL_MAX_DELAY);
+  functionData.expirationTick = expirationTick;
+
+  uint64 delay = expirationTick - data.currentTick;
+
+  uint32 level = 0;
+  while(level < SCHEDULER_WHEEL_LEVELS_COUNT - 1 &&
+        delay >= (1ull << (SCHEDULER_WHEEL_SLOT_BITS * (level + 1))))
+  {
+    level++;
+  }
+
+  uint32 slot = (expirationTick >> (SCHEDULER_WHEEL_SLOT_BITS * level)) & SCHEDULER_WHEEL_SLOT_MASK;
+  schedulerLinkFunction(index, &data.wheel[level][slot]);
+}
+
+static void schedulerRemoveFromOwner(uint32 index)
+{
+  ScheduleFunctionData& functionData = data.functions[index];
+
+  auto ownerIt = data.ownerFunctions.find(functionData.owner);
+  if(ownerIt == data.ownerFunctions.end())
+  {
+    return;
+  }
+
+  vector<uint32>& ownerFunctions = ownerIt->second;
+  auto functionIt = std::find(ownerFunctions.begin(), ownerFunctions.end(), index);
+  if(functionIt != ownerFunctions.end())
+  {
+    *functionIt = ownerFunctions.back();
+    ownerFunctions.pop_back();
+  }
+
+  if(ownerFunctions.empty())
+  {
+    data.ownerFunctions.erase(ownerIt);
+  }
+}
+
+static void schedulerFreeFunction(uint32 index)
+{
+  schedulerUnlinkFunction(index);
+  schedulerRemoveFromOwner(index);
+
+  ScheduleFunctionData& functionData = data.functions[index];
+  functionData.function = nullptr;
+  functionData.alive = FALSE;
+  functionData.generation++;
+
+  schedulerLinkFunction(index, &data.freeFunctionsHead);
+  functionData.slotHead = nullptr;
+}
+
+static uint32 schedulerAllocateFunction()
+{
+  if(data.freeFunctionsHead != SCHEDULER_INVALID_TASK_INDEX)
+  {
+    uint32 index = data.freeFunctionsHead;
+    data.freeFunctionsHead = data.functions[index].next;
+
+    if(data.freeFunctionsHead != SCHEDULER_INVALID_TASK_INDEX)
+    {
+      data.functions[data.freeFunctionsHead].prev = SCHEDULER_INVALID_TASK_INDEX;
+    }
+
+    data.functions[index].prev = SCHEDULER_INVALID_TASK_INDEX;
+    data.functions[index].next = SCHEDULER_INVALID_TASK_INDEX;
+
+    return index;
+  }
+
+  data.functions.push_back(ScheduleFunctionData{});
+
+  ScheduleFunctionData& functionData = data.functions.back();
+  functionData.prev = SCHEDULER_INVALID_TASK_INDEX;
+  functionData.next = SCHEDULER_INVALID_TASK_INDEX;
+  functionData.slotHead = nullptr;
+
+  return data.functions.size() - 1;
+}
+
+static SchedulerTaskHandle schedulerAddFunction(schedulerFunction function,
+                                                float32 time,
+                                                bool8 periodic,
+                                                void* owner,
+                                                void* userData)
+{
+  uint32 index = schedulerAllocateFunction();
+
+  ScheduleFunctionData& functionData = data.functions[index];
+  functionData.function = function;
+  functionData.owner = owner;
+  functionData.userData = userData;
+  functionData.updateTime = time;
+  functionData.period = periodic == TRUE ? schedulerTimeToTicks(time) : 0;
+  functionData.expirationTick = data.currentTick + schedulerTimeToTicks(time);
+  functionData.alive = TRUE;
+
+  schedulerInsertFunction(index);
+  data.ownerFunctions[owner].push_back(index);
+
+  return SchedulerTaskHandle{index, functionData.generation};
+}
+
+/**
+ * Moves all functions of the slot to the lower levels.
+ *
+ * @return index of the cascaded slot
+ */
+static uint32 schedulerCascade(uint32 level)
+{
+  uint32 slot = (data.currentTick >> (SCHEDULER_WHEEL_SLOT_BITS * level)) & SCHEDULER_WHEEL_SLOT_MASK;
+
+  uint32 index = data.wheel[level][slot];
+  data.wheel[level][slot] = SCHEDULER_INVALID_TASK_INDEX;
+
+  while(index != SCHEDULER_INVALID_TASK_INDEX)
+  {
+    uint32 next = data.functions[index].next;
+
+    data.functions[index].slotHead = nullptr;
+    schedulerInsertFunction(index);
+
+    index = next;
+  }
+
+  return slot;
+}
+
+static void schedulerProcessTick(uint64 lastTick)
+{
+  uint32 slot = data.currentTick & SCHEDULER_WHEEL_SLOT_MASK;
+  if(slot == 0)
+  {
+    for(uint32 level = 1; level < SCHEDULER_WHEEL_LEVELS_COUNT; level++)
+    {
+      if(schedulerCascade(level) != 0)
+      {
+        break;
+      }
+    }
+  }
+
+  // NOTE: Detach the whole slot first, calls may register or cancel other functions (including
+  // the ones from this slot), generation check skips those which were cancelled meanwhile.
+  vector<SchedulerTaskHandle>& expiredFunctions = data.expiredFunctions;
+  expiredFunctions.clear();
+
+  uint32 index = data.wheel[0][slot];
+  data.wheel[0][slot] = SCHEDULER_INVALID_TASK_INDEX;
+
+  while(index != SCHEDULER_INVALID_TASK_INDEX)
+  {
+    ScheduleFunctionData& functionData = data.functions[index];
+    expiredFunctions.push_back(SchedulerTaskHandle{index, functionData.generation});
+
+    index = functionData.next;
+    functionData.prev = SCHEDULER_INVALID_TASK_INDEX;
+    functionData.next = SCHEDULER_INVALID_TASK_INDEX;
+    functionData.slotHead = nullptr;
+  }
+
+  for(uint32 functionIdx = 0; functionIdx < expiredFunctions.size(); functionIdx++)
+  {
+    SchedulerTaskHandle handle = expiredFunctions[functionIdx];
+
+    ScheduleFunctionData& functionData = data.functions[handle.index];
+    if(functionData.alive == FALSE || functionData.generation != handle.generation)
+    {
+      continue;
+    }
+
+    data.executingFunction = handle.index;
+    functionData.function(functionData.updateTime, functionData.owner, functionData.userData);
+    data.executingFunction = SCHEDULER_INVALID_TASK_INDEX;
+
+    if(functionData.alive == TRUE && functionData.period > 0)
+    {
+      // NOTE: If a frame took longer than a period, missed calls are collapsed into the one
+      functionData.expirationTick = std::max(functionData.expirationTick + functionData.period, lastTick);
+      schedulerInsertFunction(handle.index);
+    }
+    else
+    {
+      schedulerFreeFunction(handle.index);
+    }
+  }
+}
+
+static void schedulerWorkerLoop()
+{
+  while(true)
+  {
+    SchedulerJobData jobData;
+
+    {
+      std::unique_lock<mutex> lock(data.jobsMutex);
+      data.jobsCondition.wait(lock, []() { return data.stopWorkers == TRUE || !data.jobs.empty(); });
+
+      if(data.jobs.empty())
+      {
+        return;
+      }
+
+      jobData = std::move(data.jobs.front());
+      data.jobs.pop_front();
+    }
+
+    jobData.job();
+
+    if(jobData.onCompleted != nullptr)
+    {
+      std::lock_guard<mutex> lock(data.completedJobsMutex);
+      data.completedJobs.push_back(std::move(jobData.onCompleted));
+    }
+
+    data.pendingJobsCount--;
+  }
+}
+
+static void schedulerRunCompletedJobs()
+{
+  vector<schedulerJob> completedJobs;
+
+  {
+    std::lock_guard<mutex> lock(data.completedJobsMutex);
+    completedJobs.swap(data.completedJobs);
+  }
+
+  for(schedulerJob& onCompleted: completedJobs)
+  {
+    onCompleted();
+  }
+}
+
 bool8 initSchedulerSystem()
 {
+  for(uint32 level = 0; level < SCHEDULER_WHEEL_LEVELS_COUNT; level++)
+  {
+    std::fill_n(data.wheel[level], SCHEDULER_WHEEL_SLOTS_COUNT, SCHEDULER_INVALID_TASK_INDEX);
+  }
+
+  data.currentTick = 0;
+  data.pendingTime = 0.0;
+  data.stopWorkers = FALSE;
+  data.pendingJobsCount = 0;
+
+  uint32 workersCount = CVarSystemRead(StaticCVar_engine_Scheduler_WorkersCount.getHandle());
+  for(uint32 workerIdx = 0; workerIdx < workersCount; workerIdx++)
+  {
+    data.workers.emplace_back(schedulerWorkerLoop);
+  }
+
   data.initialized = TRUE;
   return TRUE;
 }
 
 void shutdownSchedulerSystem()
 {
+  // NOTE: Let workers finish already submitted jobs, so that nothing (e.g autosave) is left half done
+  {
+    std::lock_guard<mutex> lock(data.jobsMutex);
+    data.stopWorkers = TRUE;
+  }
+
+  data.jobsCondition.notify_all();
+  for(thread& worker: data.workers)
+  {
+    worker.join();
+  }
+
+  data.workers.clear();
+  schedulerRunCompletedJobs();
+
   data.ownerFunctions.clear();
+  data.functions.clear();
+  data.freeFunctionsHead = SCHEDULER_INVALID_TASK_INDEX;
+  data.initialized = FALSE;
 }
 
-void schedulerRegisterFunction(schedulerFunction function,
-                               float32 updateTime,
-                               void* owner,
-                               void* userData)
+SchedulerTaskHandle schedulerRegisterFunction(schedulerFunction function,
+                                              float32 updateTime,
+                                              void* owner,
+                                              void* userData)
 {
-  data.ownerFunctions[owner].push_back(ScheduleFunctionData{function, userData, updateTime, 0.0f});
+  return schedulerAddFunction(function, updateTime, TRUE, owner, userData);
 }
 
-void schedulerUpdate(float32 delta)
+SchedulerTaskHandle schedulerRegisterOneShotFunction(schedulerFunction function,
+                                                     float32 delay,
+                                                     void* owner,
+                                                     void* userData)
+{
+  return schedulerAddFunction(function, delay, FALSE, owner, userData);
+}
+
+bool8 schedulerCancelFunction(SchedulerTaskHandle handle)
 {
-  for(auto& ownerPair: data.ownerFunctions)
+  if(handle.isValid() == FALSE || handle.index >= data.functions.size())
   {
-    for(ScheduleFunctionData& functionData: ownerPair.second)
-    {
-      functionData.elapsedTime += delta;
-      if(functionData.elapsedTime > functionData.updateTime)
-      {
+    return FALSE;
+  }
 
-        functionData.function(functionData.updateTime, ownerPair.first, functionData.userData);
-        functionData.elapsedTime = 0.0f;
-      }
+  ScheduleFunctionData& functionData = data.functions[handle.index];
+  if(functionData.alive == FALSE || functionData.generation != handle.generation)
+  {
+    return FALSE;
+  }
+
+  // NOTE: Executing function is freed by schedulerProcessTick() after it returns
+  if(handle.index == data.executingFunction)
+  {
+    functionData.alive = FALSE;
+    return TRUE;
+  }
+
+  schedulerFreeFunction(handle.index);
+
+  return TRUE;
+}
+
+uint32 schedulerRemoveOwner(void* owner)
+{
+  auto ownerIt = data.ownerFunctions.find(owner);
+  if(ownerIt == data.ownerFunctions.end())
+  {
+    return 0;
+  }
+
+  // NOTE: Copy, because cancellation modifies owner's list
+  vector<uint32> ownerFunctions = ownerIt->second;
+  uint32 cancelledCount = 0;
+
+  for(uint32 index: ownerFunctions)
+  {
+    cancelledCount += schedulerCancelFunction(SchedulerTaskHandle{index, data.functions[index].generation});
+  }
+
+  return cancelledCount;
+}
+
+void schedulerSubmitJob(schedulerJob job, schedulerJob onCompleted)
+{
+  data.pendingJobsCount++;
+
+  if(data.workers.empty())
+  {
+    job();
+    data.pendingJobsCount--;
+
+    if(onCompleted != nullptr)
+    {
+      std::lock_guard<mutex> lock(data.completedJobsMutex);
+      data.completedJobs.push_back(onCompleted);
     }
+
+    return;
+  }
+
+  {
+    std::lock_guard<mutex> lock(data.jobsMutex);
+    data.jobs.push_back(SchedulerJobData{job, onCompleted});
   }
+
+  data.jobsCondition.notify_one();
 }
 
+uint32 schedulerGetPendingJobsCount()
+{
+  return data.pendingJobsCount;
+}
+
+void schedulerUpdate(float32 delta)
+{
+  schedulerRunCompletedJobs();
+
+  data.pendingTime += delta;
+
+  uint64 ticksCount = (uint64)(data.pendingTime / SCHEDULER_TICK_DURATION);
+  data.pendingTime -= ticksCount * SCHEDULER_TICK_DURATION;
+
+  uint64 lastTick = data.currentTick + ticksCount;
+  while(data.currentTick < lastTick)
+  {
+    schedulerProcessTick(lastTick);
+    data.currentTick++;
+  }
+}
@@ -6,21 +6,49 @@
 #include "defines.h"
 
 using schedulerFunction = std::function<void(float32, void*, void*)>;
+using schedulerJob = std::function<void()>;
+
+static const uint32 SCHEDULER_INVALID_TASK_INDEX = (uint32)-1;
+
+/**
+ * Identifies a registered function, generation protects from cancelling another function which
+ * reused the same slot after the original one was removed.
+ */
+struct SchedulerTaskHandle
+{
+  uint32 index = SCHEDULER_INVALID_TASK_INDEX;
+  uint32 generation = 0;
+
+  bool8 isValid() const
+  {
+    return index != SCHEDULER_INVALID_TASK_INDEX ? TRUE : FALSE;
+  }
+};
 
 ENGINE_API bool8 initSchedulerSystem();
 ENGINE_API void shutdownSchedulerSystem();
 
-ENGINE_API void schedulerRegisterFunction(schedulerFunction function,
-                                          float32 updateTime,
-                                          void* owner = nullptr,
-                                          void* userData = nullptr);
+/**
+ * Registers a function which is called on the main thread each updateTime seconds, until it's
+ * cancelled or its owner is removed.
+ */
+ENGINE_API SchedulerTaskHandle schedulerRegisterFunction(schedulerFunction function,
+                                                         float32 updateTime,
+                                                         void* owner = nullptr,
+                                                         void* userData = nullptr);
+
+/** Same as schedulerRegisterFunction(), but the function is called only once after delay seconds */
+ENGINE_API SchedulerTaskHandle schedulerRegisterOneShotFunction(schedulerFunction function,
+                                                                float32 delay,
+                                                                void* owner = nullptr,
+                                                                void* userData = nullptr);
 
 template <typename FunctionType, typename T>
-void schedulerRegisterFunctionT1(FunctionType function,
-                                 float32 updateTime,
-                                 T param1,                                
-                                 void* owner = nullptr,
-                                 void* userData = nullptr)
+SchedulerTaskHandle schedulerRegisterFunctionT1(FunctionType function,
+                                                float32 updateTime,
+                                                T param1,
+                                                void* owner = nullptr,
+                                                void* userData = nullptr)
 {
   auto lambda = [function, param1](float32 time, void* owner, void* userData)
   {
@@ -28,8 +56,28 @@ void schedulerRegisterFunctionT1(FunctionType function,
     function(time, param1, owner, userData);
   };
 
-  schedulerRegisterFunction(lambda, updateTime, owner, userData);
+  return schedulerRegisterFunction(lambda, updateTime, owner, userData);
 }
 
+/**
+ * @note It's safe to cancel a function from inside of itself.
+ * @return FALSE if function was already removed (e.g it was a one shot function which was called)
+ */
+ENGINE_API bool8 schedulerCancelFunction(SchedulerTaskHandle handle);
+
+/** Cancels all functions registered with the owner, returns how many functions were cancelled */
+ENGINE_API uint32 schedulerRemoveOwner(void* owner);
+
+/**
+ * Pushes a job to the queue of worker threads. onCompleted (if any) is called on the main thread
+ * during one of the next schedulerUpdate() calls after the job has finished.
+ *
+ * WARNING: Job is executed concurrently with the main thread, so it must not touch assets, GL state
+ * or logging, pass everything it needs by value and report results through onCompleted.
+ */
+ENGINE_API void schedulerSubmitJob(schedulerJob job, schedulerJob onCompleted = nullptr);
+
+/** @return amount of submitted jobs which are either waiting or being executed */
+ENGINE_API uint32 schedulerGetPendingJobsCount();
 
 void schedulerUpdate(float32 delta);
@@ -0,0 +1,301 @@
+#include <fstream>
+#include <algorithm>
+
+#include "stb/stb_image.h"
+
+#include "texture_cooker.h"
+
+using std::vector;
+
+static const uint32 COOKED_TEXTURE_MAGIC = 0x4b4f4f43; // "COOK"
+static const uint32 COOKED_TEXTURE_VERSION = 2;
+// NOTE: Chain of a 2^31 sized texture has 32 levels, longer chains can come only from broken files
+static const uint32 COOKED_TEXTURE_MAX_LEVELS_COUNT = 32;
+
+struct CookedTextureHeader
+{
+  uint32 magic;
+  uint32 version;
+  uint64 sourceHash;
+
+  uint32 internalFormat;
+  uint32 levelsCount;
+  uint32 border;
+  uint32 _gap;
+};
+
+struct CookedLevelHeader
+{
+  uint32 width;
+  uint32 height;
+  uint32 size;
+  uint32 _gap;
+};
+
+bool8 textureDataIsCompressed(const TextureData& texture)
+{
+  return texture.internalFormat == TEXTURE_COOKER_FORMAT ? TRUE : FALSE;
+}
+
+uint64 textureCookerHash(const uint8* data, uint32 size)
+{
+  // NOTE: 64-bit FNV-1a
+  uint64 hash = 14695981039346656037ull;
+  for(uint32 i = 0; i < size; i++)
+  {
+    hash = (hash ^ data[i]) * 1099511628211ull;
+  }
+
+  return hash;
+}
+
+std::string textureCookerGetCookedPath(const std::string& sourcePath)
+{
+  return sourcePath + ".cooked";
+}
+
+static void textureCookerGenerateLevels(TextureData& texture, uint32 channelsCount)
+{
+  while(texture.levels.back().width > 1 || texture.levels.back().height > 1)
+  {
+    const TextureLevel& src = texture.levels.back();
+
+    TextureLevel dst;
+    dst.width = std::max(src.width / 2, 1u);
+    dst.height = std::max(src.height / 2, 1u);
+    dst.data.resize(dst.width * dst.height * channelsCount);
+
+    // NOTE: Box filter over 2x2 texels, the last row/column of odd sized levels is clamped
+    for(uint32 y = 0; y < dst.height; y++)
+    {
+      uint32 srcY0 = std::min(2 * y, src.height - 1);
+      uint32 srcY1 = std::min(2 * y + 1, src.height - 1);
+
+      for(uint32 x = 0; x < dst.width; x++)
+      {
+        uint32 srcX0 = std::min(2 * x, src.width - 1);
+        uint32 srcX1 = std::min(2 * x + 1, src.width - 1);
+
+        for(uint32 c = 0; c < channelsCount; c++)
+        {
+          uint32 sum = src.data[(srcY0 * src.width + srcX0) * channelsCount + c] +
+                       src.data[(srcY0 * src.width + srcX1) * channelsCount + c] +
+                       src.data[(srcY1 * src.width + srcX0) * channelsCount + c] +
+                       src.data[(srcY1 * src.width + srcX1) * channelsCount + c];
+
+          dst.data[(y * dst.width + x) * channelsCount + c] = uint8((sum + 2) / 4);
+        }
+      }
+    }
+
+    texture.levels.push_back(std::move(dst));
+  }
+}
+
+bool8 textureCookerDecode(const uint8* fileData, uint32 fileSize, bool8 compressible, TextureData& outTexture)
+{
+  int32 width, height, channelsCount;
+  if(stbi_info_from_memory(fileData, fileSize, &width, &height, &channelsCount) == 0)
+  {
+    return FALSE;
+  }
+
+  // NOTE: Grey and grey-alpha images are expanded, so that only RGB and RGBA textures are created
+  int32 desiredChannelsCount = channelsCount == 3 && compressible == FALSE ? 3 : 4;
+
+  uint8* pixels = stbi_load_from_memory(fileData, fileSize, &width, &height, &channelsCount, desiredChannelsCount);
+  if(pixels == NULL)
+  {
+    return FALSE;
+  }
+
+  TextureLevel level;
+  level.width = width;
+  level.height = height;
+  uint32 border = 0;
+
+  if(compressible == TRUE)
+  {
+    border = TEXTURE_COOKER_BORDER;
+    level.width = (width + TEXTURE_COOKER_BLOCK_SIDE - 1) / TEXTURE_COOKER_BLOCK_SIDE * TEXTURE_COOKER_BLOCK_SIDE + 2 * border;
+    level.height = (height + TEXTURE_COOKER_BLOCK_SIDE - 1) / TEXTURE_COOKER_BLOCK_SIDE * TEXTURE_COOKER_BLOCK_SIDE + 2 * border;
+  }
+
+  // NOTE: Texels of the border and of the padding are clamped to the edges of the image
+  level.data.resize(level.width * level.height * desiredChannelsCount);
+  for(uint32 y = 0; y < level.height; y++)
+  {
+    uint32 srcY = uint32(std::clamp<int32>(int32(y) - int32(border), 0, height - 1));
+    for(uint32 x = 0; x < level.width; x++)
+    {
+      uint32 srcX = uint32(std::clamp<int32>(int32(x) - int32(border), 0, width - 1));
+
+      std::copy_n(pixels + (srcY * width + srcX) * desiredChannelsCount,
+                  desiredChannelsCount,
+                  level.data.data() + (y * level.width + x) * desiredChannelsCount);
+    }
+  }
+
+  stbi_image_free(pixels);
+
+  outTexture.internalFormat = desiredChannelsCount == 3 ? GL_RGB8 : GL_RGBA8;
+  outTexture.border = border;
+  outTexture.levels.clear();
+  outTexture.levels.push_back(std::move(level));
+
+  textureCookerGenerateLevels(outTexture, desiredChannelsCount);
+
+  return TRUE;
+}
+
+bool8 textureCookerReadCooked(const std::string& cookedPath, uint64 sourceHash, TextureData& outTexture)
+{
+  std::ifstream file(cookedPath, std::ios::in | std::ios::binary);
+  if(file.is_open() == false)
+  {
+    return FALSE;
+  }
+
+  CookedTextureHeader header = {};
+  file.read((char*)&header, sizeof(header));
+
+  if(file.good() == false ||
+     header.magic != COOKED_TEXTURE_MAGIC ||
+     header.version != COOKED_TEXTURE_VERSION ||
+     header.sourceHash != sourceHash ||
+     header.internalFormat != TEXTURE_COOKER_FORMAT ||
+     header.levelsCount == 0 ||
+     header.levelsCount > COOKED_TEXTURE_MAX_LEVELS_COUNT ||
+     header.border != TEXTURE_COOKER_BORDER)
+  {
+    return FALSE;
+  }
+
+  outTexture.internalFormat = header.internalFormat;
+  outTexture.border = header.border;
+  outTexture.levels.resize(header.levelsCount);
+
+  for(uint32 i = 0; i < outTexture.levels.size(); i++)
+  {
+    CookedLevelHeader levelHeader = {};
+    file.read((char*)&levelHeader, sizeof(levelHeader));
+
+    // NOTE: Sizes are validated before anything is allocated, so that a broken file can't request
+    // arbitrary amount of memory or a chain, which doesn't fit storage of the texture
+    bool8 sizeIsValid = i == 0 ?
+      levelHeader.width > 2 * header.border && levelHeader.height > 2 * header.border :
+      levelHeader.width == std::max(outTexture.levels[i - 1].width / 2, 1u) &&
+      levelHeader.height == std::max(outTexture.levels[i - 1].height / 2, 1u);
+
+    uint64 blocksCount = uint64((levelHeader.width + TEXTURE_COOKER_BLOCK_SIDE - 1) / TEXTURE_COOKER_BLOCK_SIDE) *
+                         uint64((levelHeader.height + TEXTURE_COOKER_BLOCK_SIDE - 1) / TEXTURE_COOKER_BLOCK_SIDE);
+
+    if(file.good() == false || sizeIsValid == FALSE ||
+       uint64(levelHeader.size) != blocksCount * TEXTURE_COOKER_BLOCK_SIZE)
+    {
+      return FALSE;
+    }
+
+    TextureLevel& level = outTexture.levels[i];
+    level.width = levelHeader.width;
+    level.height = levelHeader.height;
+    level.data.resize(levelHeader.size);
+
+    file.read((char*)level.data.data(), levelHeader.size);
+  }
+
+  // NOTE: Chain ends with 1x1 level (see TextureData)
+  const TextureLevel& lastLevel = outTexture.levels.back();
+  if(lastLevel.width != 1 || lastLevel.height != 1)
+  {
+    return FALSE;
+  }
+
+  return file.good() ? TRUE : FALSE;
+}
+
+bool8 textureCookerWriteCooked(const std::string& cookedPath, uint64 sourceHash, const TextureData& texture)
+{
+  std::ofstream file(cookedPath, std::ios::out | std::ios::binary | std::ios::trunc);
+  if(file.is_open() == false)
+  {
+    return FALSE;
+  }
+
+  CookedTextureHeader header = {};
+  header.magic = COOKED_TEXTURE_MAGIC;
+  header.version = COOKED_TEXTURE_VERSION;
+  header.sourceHash = sourceHash;
+  header.internalFormat = texture.internalFormat;
+  header.levelsCount = texture.levels.size();
+  header.border = texture.border;
+
+  file.write((const char*)&header, sizeof(header));
+
+  for(const TextureLevel& level: texture.levels)
+  {
+    CookedLevelHeader levelHeader = {};
+    levelHeader.width = level.width;
+    levelHeader.height = level.height;
+    levelHeader.size = level.data.size();
+
+    file.write((const char*)&levelHeader, sizeof(levelHeader));
+    file.write((const char*)level.data.data(), level.data.size());
+  }
+
+  return file.good() ? TRUE : FALSE;
+}
+
+bool8 textureCookerCompress(const TextureData& rawTexture, GLuint& outTextureHandle, TextureData& outTexture)
+{
+  assert(textureDataIsCompressed(rawTexture) == FALSE);
+
+  GLenum format = rawTexture.internalFormat == GL_RGB8 ? GL_RGB : GL_RGBA;
+
+  GLuint textureHandle;
+  glGenTextures(1, &textureHandle);
+  glBindTexture(GL_TEXTURE_2D, textureHandle);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, rawTexture.levels.size() - 1);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for(uint32 i = 0; i < rawTexture.levels.size(); i++)
+  {
+    const TextureLevel& level = rawTexture.levels[i];
+    glTexImage2D(GL_TEXTURE_2D, i, TEXTURE_COOKER_FORMAT, level.width, level.height, 0,
+                 format, GL_UNSIGNED_BYTE, level.data.data());
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  GLint compressed = GL_FALSE;
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+
+  if(compressed == GL_FALSE)
+  {
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &textureHandle);
+
+    return FALSE;
+  }
+
+  outTexture.internalFormat = TEXTURE_COOKER_FORMAT;
+  outTexture.border = rawTexture.border;
+  outTexture.levels.resize(rawTexture.levels.size());
+
+  for(uint32 i = 0; i < rawTexture.levels.size(); i++)
+  {
+    GLint compressedSize = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &compressedSize);
+
+    TextureLevel& level = outTexture.levels[i];
+    level.width = rawTexture.levels[i].width;
+    level.height = rawTexture.levels[i].height;
+    level.data.resize(compressedSize);
+
+    glGetCompressedTexImage(GL_TEXTURE_2D, i, level.data.data());
+  }
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  outTextureHandle = textureHandle;
+  return TRUE;
+}
@@ -0,0 +1,67 @@
+/**
+ * Texture cooker converts source images into block compressed textures (BC7) with precomputed mips.
+ * Cooked textures are stored next to their sources (see textureCookerGetCookedPath()) together with
+ * the hash of the source file, so a texture is cooked again only when its source changes.
+ *
+ * Compression itself is done by the driver (raw levels are uploaded with a compressed internal format
+ * and read back), so it has to be done on the main thread. Reading, decoding and writing of files
+ * don't touch GL and can be done by worker threads.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "defines.h"
+
+#define TEXTURE_COOKER_FORMAT GL_COMPRESSED_RGBA_BPTC_UNORM
+// NOTE: Side of a block and size of a block in bytes of TEXTURE_COOKER_FORMAT
+#define TEXTURE_COOKER_BLOCK_SIDE 4
+#define TEXTURE_COOKER_BLOCK_SIZE 16
+// NOTE: Compressible textures are surrounded by a border of repeated edge texels (see textureCookerDecode())
+#define TEXTURE_COOKER_BORDER TEXTURE_COOKER_BLOCK_SIDE
+
+struct TextureLevel
+{
+  uint32 width = 0;
+  uint32 height = 0;
+
+  std::vector<uint8> data;
+};
+
+struct TextureData
+{
+  // NOTE: GL_RGB8 or GL_RGBA8 for raw pixels, TEXTURE_COOKER_FORMAT for blocks
+  GLenum internalFormat = GL_RGBA8;
+
+  // NOTE: Width of the border around the image on level 0, sizes of levels include it
+  uint32 border = 0;
+
+  // NOTE: Level 0 goes first, the chain ends with 1x1 level
+  std::vector<TextureLevel> levels;
+};
+
+ENGINE_API bool8 textureDataIsCompressed(const TextureData& texture);
+
+ENGINE_API uint64 textureCookerHash(const uint8* data, uint32 size);
+ENGINE_API std::string textureCookerGetCookedPath(const std::string& sourcePath);
+
+/**
+ * Decodes the source image and calculates its mips with a box filter.
+ * @param compressible if TRUE, image is decoded into RGBA, its size is padded to a multiple of the
+ * block side and it's surrounded by a border of TEXTURE_COOKER_BORDER texels (edge texels are repeated),
+ * so that it can be compressed and copied by blocks together with texels to filter its edges
+ */
+ENGINE_API bool8 textureCookerDecode(const uint8* fileData, uint32 fileSize, bool8 compressible, TextureData& outTexture);
+
+/** @return FALSE if there is no cooked texture or it has been cooked from another source */
+ENGINE_API bool8 textureCookerReadCooked(const std::string& cookedPath, uint64 sourceHash, TextureData& outTexture);
+ENGINE_API bool8 textureCookerWriteCooked(const std::string& cookedPath, uint64 sourceHash, const TextureData& texture);
+
+/**
+ * Compresses raw levels (see textureCookerDecode()) by the driver, must be called on the main thread.
+ * @param outTextureHandle texture which contains compressed levels
+ * @return FALSE if the driver doesn't support compression, nothing is created then
+ */
+ENGINE_API bool8 textureCookerCompress(const TextureData& rawTexture, GLuint& outTextureHandle, TextureData& outTexture);
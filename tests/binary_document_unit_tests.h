@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include <gtest/gtest.h>
+#include <binary_document.h>
+#include <maths/json_serializers.h>
+
+static const char* BINARY_DOCUMENT_TESTS_FILE_NAME = "binary_document_unit_tests.mbd";
+
+static nlohmann::json binaryDocumentTestsCreateJson()
+{
+  nlohmann::json jsonData;
+  jsonData["null"] = nullptr;
+  jsonData["true"] = true;
+  jsonData["false"] = false;
+  jsonData["integer"] = int64(-1234567890123);
+  jsonData["unsigned"] = uint64(18000000000000000000ull);
+  jsonData["float"] = 0.1;
+  jsonData["string"] = "string";
+  jsonData["duplicated_string"] = "string";
+  jsonData["empty_string"] = "";
+  jsonData["array"] = {1, -2, 3.5, "four", nullptr, nlohmann::json::array()};
+  jsonData["empty_object"] = nlohmann::json::object();
+  jsonData["object"]["nested"]["value"] = 42u;
+  jsonData["float_vector"] = vecToJson(float3(0.5f, -1.25f, 3.0f));
+
+  // NOTE: Elements aren't represented by float32 exactly, so the vector must stay float64
+  jsonData["double_vector"] = vecToJson(linalg::vec<float64, 2>(0.1, 1e-40));
+
+  return jsonData;
+}
+
+TEST(BinaryDocumentTests, RoundTripPreservesAllNodeTypes)
+{
+  nlohmann::json source = binaryDocumentTestsCreateJson();
+  ASSERT_TRUE(writeBinaryDocument(source, BINARY_DOCUMENT_TESTS_FILE_NAME));
+  ASSERT_TRUE(isBinaryDocument(BINARY_DOCUMENT_TESTS_FILE_NAME));
+
+  nlohmann::json loaded;
+  ASSERT_TRUE(loadJsonDocument(BINARY_DOCUMENT_TESTS_FILE_NAME, loaded));
+  EXPECT_EQ(loaded, source);
+
+  std::remove(BINARY_DOCUMENT_TESTS_FILE_NAME);
+}
+
+TEST(BinaryDocumentTests, DocumentValuesAreReadFromMapping)
+{
+  nlohmann::json source = binaryDocumentTestsCreateJson();
+  ASSERT_TRUE(writeBinaryDocument(source, BINARY_DOCUMENT_TESTS_FILE_NAME));
+
+  Document* document = nullptr;
+  ASSERT_TRUE(openDocument(BINARY_DOCUMENT_TESTS_FILE_NAME, &document));
+
+  DocumentValue root = documentGetRoot(document);
+  EXPECT_TRUE(documentValueIsObject(root));
+  EXPECT_EQ(documentValueGetSize(root), source.size());
+
+  EXPECT_TRUE(documentValueIsValid(documentValueFind(root, "null")));
+  EXPECT_FALSE(documentValueIsValid(documentValueFind(root, "missing")));
+  EXPECT_EQ(documentValueGet(root, "missing", 7), 7);
+
+  EXPECT_EQ(documentValueGet(root, "true", FALSE), TRUE);
+  EXPECT_EQ(documentValueGet(root, "false", TRUE), FALSE);
+  EXPECT_EQ(documentValueGet(root, "integer", int64(0)), int64(-1234567890123));
+  EXPECT_EQ(documentValueGet(root, "unsigned", uint64(0)), uint64(18000000000000000000ull));
+  EXPECT_EQ(documentValueGet(root, "float", 0.0), 0.1);
+  EXPECT_EQ(documentValueGetString(documentValueFind(root, "string")), "string");
+  EXPECT_EQ(documentValueGetString(documentValueFind(root, "empty_string"), "default"), "");
+  EXPECT_EQ(documentValueGetString(documentValueFind(root, "integer"), "default"), "default");
+
+  DocumentValue array = documentValueFind(root, "array");
+  ASSERT_EQ(documentValueGetSize(array), 6u);
+  EXPECT_EQ(documentValueGet(documentValueGetElement(array, 1), 0), -2);
+  EXPECT_EQ(documentValueGet(documentValueGetElement(array, 2), 0.0f), 3.5f);
+  EXPECT_EQ(documentValueGetString(documentValueGetElement(array, 3)), "four");
+  EXPECT_EQ(documentValueGetSize(documentValueGetElement(array, 5)), 0u);
+  EXPECT_FALSE(documentValueIsValid(documentValueGetElement(array, 6)));
+
+  DocumentValue nested = documentValueFind(documentValueFind(root, "object"), "nested");
+  ASSERT_EQ(documentValueGetSize(nested), 1u);
+  EXPECT_EQ(documentValueGetMemberKey(nested, 0), "value");
+  EXPECT_EQ(documentValueGet(documentValueGetMemberValue(nested, 0), 0u), 42u);
+
+  DocumentValue floatVector = documentValueFind(root, "float_vector");
+  EXPECT_TRUE(documentValueIsObject(floatVector));
+  EXPECT_EQ(documentValueGetMemberKey(floatVector, 2), "2");
+  EXPECT_EQ((documentValueToVec<float32, 3>(floatVector)), float3(0.5f, -1.25f, 3.0f));
+
+  DocumentValue doubleVector = documentValueFind(root, "double_vector");
+  EXPECT_EQ(documentValueGet(doubleVector, "0", 0.0), 0.1);
+  EXPECT_EQ(documentValueGet(doubleVector, "1", 0.0), 1e-40);
+
+  closeDocument(document);
+  std::remove(BINARY_DOCUMENT_TESTS_FILE_NAME);
+}
+
+TEST(BinaryDocumentTests, TextDocumentValuesMatchBinaryOnes)
+{
+  nlohmann::json source = binaryDocumentTestsCreateJson();
+  DocumentValue root = documentValueFromJson(source);
+
+  EXPECT_EQ(documentValueGet(root, "true", FALSE), TRUE);
+  EXPECT_EQ(documentValueGet(root, "unsigned", uint64(0)), uint64(18000000000000000000ull));
+  EXPECT_EQ(documentValueGetString(documentValueFind(root, "string")), "string");
+  EXPECT_EQ(documentValueGetMemberKey(documentValueFind(documentValueFind(root, "object"), "nested"), 0), "value");
+  EXPECT_EQ((documentValueToVec<float32, 3>(documentValueFind(root, "float_vector"))), float3(0.5f, -1.25f, 3.0f));
+  EXPECT_FALSE(documentValueIsValid(documentValueFind(root, "missing")));
+}
+
+TEST(BinaryDocumentTests, CyclicDocumentIsRejected)
+{
+  // NOTE: Nodes are [outer array, inner array, 1], children section is [1, 2]
+  ASSERT_TRUE(writeBinaryDocument(nlohmann::json::parse("[[1]]"), BINARY_DOCUMENT_TESTS_FILE_NAME));
+
+  std::string bytes;
+  {
+    std::ifstream file(BINARY_DOCUMENT_TESTS_FILE_NAME, std::ios::in | std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
+  // NOTE: Offset of the children section is the 12th field of the header, inner array becomes its
+  // own child
+  uint32 childrenOffset;
+  memcpy(&childrenOffset, bytes.data() + 11 * sizeof(uint32), sizeof(childrenOffset));
+
+  uint32 cyclicChild = 1;
+  memcpy(&bytes[childrenOffset + sizeof(uint32)], &cyclicChild, sizeof(cyclicChild));
+
+  {
+    std::ofstream file(BINARY_DOCUMENT_TESTS_FILE_NAME, std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), bytes.size());
+  }
+
+  BinaryDocument* binaryDocument = nullptr;
+  EXPECT_FALSE(openBinaryDocument(BINARY_DOCUMENT_TESTS_FILE_NAME, &binaryDocument));
+
+  nlohmann::json loaded;
+  EXPECT_FALSE(loadJsonDocument(BINARY_DOCUMENT_TESTS_FILE_NAME, loaded));
+
+  std::remove(BINARY_DOCUMENT_TESTS_FILE_NAME);
+}
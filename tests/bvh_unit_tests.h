@@ -0,0 +1,201 @@
+#pragma once
+
+#include <random>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+#include <maths/bvh.h>
+
+static std::vector<AABB> generateRandomAABBs(uint32 count, uint32 seed)
+{
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float32> positionDistribution(-50.0f, 50.0f);
+  std::uniform_real_distribution<float32> sizeDistribution(0.1f, 3.0f);
+
+  std::vector<AABB> aabbs;
+  for(uint32 i = 0; i < count; i++)
+  {
+    float3 center = float3(positionDistribution(generator),
+                           positionDistribution(generator),
+                           positionDistribution(generator));
+    float3 size = float3(sizeDistribution(generator), sizeDistribution(generator), sizeDistribution(generator));
+
+    aabbs.push_back(AABB(center - size, center + size));
+  }
+
+  return aabbs;
+}
+
+static std::vector<uint32> generateAllPrimitives(uint32 count)
+{
+  std::vector<uint32> primitives(count);
+  for(uint32 i = 0; i < count; i++)
+  {
+    primitives[i] = i;
+  }
+
+  return primitives;
+}
+
+static bool8 sphereIntersectsAABB(float3 center, float32 radius, const AABB& aabb)
+{
+  return length2(clamp(center, aabb.min, aabb.max) - center) <= radius * radius;
+}
+
+TEST(BVHTests, EmptyBVHReturnsNothing)
+{
+  BVH bvh;
+  bvhBuild(bvh, {}, {});
+
+  std::vector<uint32> primitives;
+  bvhQuerySphere(bvh, float3(0.0f, 0.0f, 0.0f), 100.0f, primitives);
+
+  EXPECT_TRUE(primitives.empty());
+}
+
+TEST(BVHTests, SphereQueryMatchesBruteForce)
+{
+  std::vector<AABB> aabbs = generateRandomAABBs(500, 7);
+
+  BVH bvh;
+  bvhBuild(bvh, aabbs, generateAllPrimitives(aabbs.size()));
+
+  float3 center = float3(5.0f, -3.0f, 10.0f);
+  float32 radius = 15.0f;
+
+  std::vector<uint32> primitives;
+  bvhQuerySphere(bvh, center, radius, primitives);
+  std::sort(primitives.begin(), primitives.end());
+
+  std::vector<uint32> expected;
+  for(uint32 i = 0; i < aabbs.size(); i++)
+  {
+    if(sphereIntersectsAABB(center, radius, aabbs[i]) == TRUE)
+    {
+      expected.push_back(i);
+    }
+  }
+
+  EXPECT_EQ(primitives, expected);
+}
+
+TEST(BVHTests, AABBQueryMatchesBruteForce)
+{
+  std::vector<AABB> aabbs = generateRandomAABBs(500, 9);
+  // NOTE: Touches the query box, such boxes overlap it (see AABBOverlap())
+  aabbs.push_back(AABB(float3(15.0f, 0.0f, 0.0f), float3(20.0f, 1.0f, 1.0f)));
+
+  BVH bvh;
+  bvhBuild(bvh, aabbs, generateAllPrimitives(aabbs.size()));
+
+  AABB box = AABB(float3(-10.0f, -20.0f, 0.0f), float3(15.0f, 5.0f, 30.0f));
+
+  std::vector<uint32> primitives;
+  bvhQueryAABB(bvh, box, primitives);
+  std::sort(primitives.begin(), primitives.end());
+
+  std::vector<uint32> expected;
+  for(uint32 i = 0; i < aabbs.size(); i++)
+  {
+    if(AABBOverlap(box, aabbs[i]) == TRUE)
+    {
+      expected.push_back(i);
+    }
+  }
+
+  EXPECT_EQ(primitives, expected);
+}
+
+TEST(BVHTests, RayQueryReturnsSortedHits)
+{
+  std::vector<AABB> aabbs = generateRandomAABBs(500, 11);
+
+  BVH bvh;
+  bvhBuild(bvh, aabbs, generateAllPrimitives(aabbs.size()));
+
+  Ray ray(float3(-60.0f, 0.5f, 0.5f), normalize(float3(1.0f, 0.05f, 0.02f)));
+
+  std::vector<BVHRayHit> hits;
+  bvhQueryRay(bvh, ray, 1000.0f, hits);
+
+  uint32 expectedHitsCount = 0;
+  for(const AABB& aabb: aabbs)
+  {
+    expectedHitsCount += rayIntersectAABB(ray, aabb, 1000.0f) >= 0.0f ? 1 : 0;
+  }
+
+  EXPECT_EQ(hits.size(), expectedHitsCount);
+  for(uint32 i = 1; i < hits.size(); i++)
+  {
+    EXPECT_LE(hits[i - 1].distance, hits[i].distance);
+  }
+}
+
+TEST(BVHTests, RefitMovesPrimitive)
+{
+  std::vector<AABB> aabbs = generateRandomAABBs(100, 13);
+
+  BVH bvh;
+  bvhBuild(bvh, aabbs, generateAllPrimitives(aabbs.size()));
+
+  AABB moved = AABB(float3(200.0f, 200.0f, 200.0f), float3(201.0f, 201.0f, 201.0f));
+  EXPECT_TRUE(bvhRefit(bvh, 42, moved));
+
+  std::vector<uint32> primitives;
+  bvhQuerySphere(bvh, float3(200.5f, 200.5f, 200.5f), 1.0f, primitives);
+
+  ASSERT_EQ(primitives.size(), 1);
+  EXPECT_EQ(primitives[0], 42);
+}
+
+TEST(BVHTests, UnboundedPrimitivesAreAlwaysReported)
+{
+  std::vector<AABB> aabbs = generateRandomAABBs(10, 17);
+  aabbs.push_back(AABB::createUnbounded());
+
+  BVH bvh;
+  bvhBuild(bvh, aabbs, generateAllPrimitives(aabbs.size()));
+
+  std::vector<uint32> primitives;
+  bvhQuerySphere(bvh, float3(1000.0f, 1000.0f, 1000.0f), 1.0f, primitives);
+
+  ASSERT_EQ(primitives.size(), 1);
+  EXPECT_EQ(primitives[0], 10);
+
+  // NOTE: Unbounded primitive which becomes bounded requires a rebuild
+  EXPECT_FALSE(bvhRefit(bvh, 10, AABB(float3(0.0f, 0.0f, 0.0f), float3(1.0f, 1.0f, 1.0f))));
+}
+
+TEST(BVHTests, RayQueryOrdersPickCandidates)
+{
+  // NOTE: Ray starts inside of the second box, the unbounded primitive and the second box have zero
+  // distance, the third box is passed by the ray
+  std::vector<AABB> aabbs = {
+    AABB(float3(10.0f, -1.0f, -1.0f), float3(12.0f, 1.0f, 1.0f)),
+    AABB(float3(-1.0f, -1.0f, -1.0f), float3(1.0f, 1.0f, 1.0f)),
+    AABB(float3(4.0f, 5.0f, -1.0f), float3(6.0f, 7.0f, 1.0f)),
+    AABB(float3(3.0f, -1.0f, -1.0f), float3(20.0f, 1.0f, 1.0f)),
+    AABB::createUnbounded()
+  };
+
+  BVH bvh;
+  bvhBuild(bvh, aabbs, generateAllPrimitives(aabbs.size()));
+
+  std::vector<BVHRayHit> hits;
+  bvhQueryRay(bvh, Ray(float3(0.0f, 0.0f, 0.0f), float3(1.0f, 0.0f, 0.0f)), 100.0f, hits);
+
+  ASSERT_EQ(hits.size(), 4);
+  EXPECT_EQ(hits[0].distance, 0.0f);
+  EXPECT_EQ(hits[1].distance, 0.0f);
+  EXPECT_TRUE((hits[0].primitive == 1 && hits[1].primitive == 4) || (hits[0].primitive == 4 && hits[1].primitive == 1));
+  EXPECT_EQ(hits[2].primitive, 3);
+  EXPECT_FLOAT_EQ(hits[2].distance, 3.0f);
+  EXPECT_EQ(hits[3].primitive, 0);
+  EXPECT_FLOAT_EQ(hits[3].distance, 10.0f);
+
+  // NOTE: Candidates farther than the limit aren't reported
+  hits.clear();
+  bvhQueryRay(bvh, Ray(float3(0.0f, 0.0f, 0.0f), float3(1.0f, 0.0f, 0.0f)), 5.0f, hits);
+
+  EXPECT_EQ(hits.size(), 3);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <cvar_system.h>
+
+static uint32 cvarChangesCounter = 0;
+void someCVarListener(const std::string& name, void* listener) { (*(uint32*)listener)++; }
+
+TEST(CVarSystemTests, HandleOfNotExistingVarIsInvalid)
+{
+  EXPECT_EQ(CVarSystemGetUintHandle("test_CVarSystem_NotExisting").isValid(), FALSE);
+}
+
+TEST(CVarSystemTests, HandleOfVarWithAnotherTypeIsInvalid)
+{
+  EXPECT_EQ(CVarSystemRegisterVar("test_CVarSystem_AnotherType", 1.0f, CVAR_FLAG_NONE), TRUE);
+  EXPECT_EQ(CVarSystemGetUintHandle("test_CVarSystem_AnotherType").isValid(), FALSE);
+  EXPECT_EQ(CVarSystemGetFloatHandle("test_CVarSystem_AnotherType").isValid(), TRUE);
+}
+
+TEST(CVarSystemTests, RegisterReturnsSameHandleAsLookup)
+{
+  CVarIntHandle handle;
+  EXPECT_EQ(CVarSystemRegisterVar("test_CVarSystem_Handle", -5, CVAR_FLAG_NONE, &handle), TRUE);
+  EXPECT_EQ(handle.index, CVarSystemGetIntHandle("test_CVarSystem_Handle").index);
+  EXPECT_EQ(CVarSystemRead(handle), -5);
+  EXPECT_EQ(CVarSystemGetName(handle), "test_CVarSystem_Handle");
+}
+
+TEST(CVarSystemTests, ReferencesStayValidAfterRegistrations)
+{
+  CVarUintHandle handle;
+  EXPECT_EQ(CVarSystemRegisterVar("test_CVarSystem_Stable", 7u, CVAR_FLAG_NONE, &handle), TRUE);
+
+  const uint32& value = CVarSystemRead(handle);
+  for(uint32 i = 0; i < 1024; i++)
+  {
+    CVarSystemRegisterVar("test_CVarSystem_Stable" + std::to_string(i), i, CVAR_FLAG_NONE);
+  }
+
+  EXPECT_EQ(&value, &CVarSystemRead(handle));
+  EXPECT_EQ(value, 7u);
+}
+
+TEST(CVarSystemTests, SubscriberIsNotifiedOnlyOnChange)
+{
+  CVarBoolHandle handle;
+  EXPECT_EQ(CVarSystemRegisterVar<bool8>("test_CVarSystem_Notify", FALSE, CVAR_FLAG_NONE, &handle), TRUE);
+  EXPECT_EQ(CVarSystemSubscribe("test_CVarSystem_Notify", &cvarChangesCounter, someCVarListener), TRUE);
+  EXPECT_EQ(CVarSystemSubscribe("test_CVarSystem_Notify", &cvarChangesCounter, someCVarListener), FALSE);
+
+  cvarChangesCounter = 0;
+  CVarSystemSet(handle, TRUE);
+  CVarSystemSet(handle, TRUE);
+  EXPECT_EQ(cvarChangesCounter, 1u);
+
+  EXPECT_EQ(CVarSystemParseStr("test_CVarSystem_Notify", "false"), CVAR_PARSE_CODE_SUCCESS);
+  EXPECT_EQ(cvarChangesCounter, 2u);
+
+  EXPECT_EQ(CVarSystemUnsubscribe("test_CVarSystem_Notify", &cvarChangesCounter), TRUE);
+  CVarSystemSet(handle, TRUE);
+  EXPECT_EQ(cvarChangesCounter, 2u);
+}
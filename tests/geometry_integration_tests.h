@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+#include <shader_manager.h>
+#include <assets/geometry.h>
+#include <assets/script_function.h>
+#include <assets/pcf_script_function.h>
+#include <GLFW/glfw3.h>
+
+// NOTE: Programs of geometries are linked during updates, so the tests need an OpenGL context
+// and shaders of the engine (run them from the bin directory, like the application)
+class GeometryTests: public ::testing::Test
+{
+protected:
+  static void SetUpTestSuite()
+  {
+    if(!glfwInit())
+    {
+      return;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window = glfwCreateWindow(64, 64, "geometry_tests", NULL, NULL);
+    if(window == nullptr)
+    {
+      glfwTerminate();
+      return;
+    }
+
+    glfwMakeContextCurrent(window);
+    if(gladLoadGL() == 0 || initShaderManager() == FALSE)
+    {
+      glfwDestroyWindow(window);
+      glfwTerminate();
+      window = nullptr;
+    }
+  }
+
+  static void TearDownTestSuite()
+  {
+    if(window != nullptr)
+    {
+      shutdownShaderManager();
+      glfwDestroyWindow(window);
+      glfwTerminate();
+      window = nullptr;
+    }
+  }
+
+  void SetUp() override
+  {
+    if(window == nullptr)
+    {
+      GTEST_SKIP() << "OpenGL context isn't available";
+    }
+  }
+
+  static AssetPtr createSphere(const char* name)
+  {
+    Asset* sdf = nullptr;
+    createScriptFunction(SCRIPT_FUNCTION_TYPE_SDF, "sphereSDF", &sdf);
+    scriptFunctionSetArgValue(sdf, "radius", 1.0f);
+    scriptFunctionSetCode(sdf, "return length(p) - $radius; ");
+
+    Asset* sphere = nullptr;
+    createGeometry(name, &sphere);
+    geometrySetAABBAutomaticallyCalculated(sphere, FALSE);
+    geometryAddFunction(sphere, AssetPtr(sdf));
+
+    return AssetPtr(sphere);
+  }
+
+  static GLFWwindow* window;
+};
+
+GLFWwindow* GeometryTests::window = nullptr;
+
+TEST_F(GeometryTests, ChildAddedToUpdatedTreeIsRebuilt)
+{
+  Asset* root = nullptr;
+  createGeometry("root", &root);
+  AssetPtr rootPtr = AssetPtr(root);
+
+  AssetPtr firstSphere = createSphere("firstSphere");
+  geometryAddChild(rootPtr, firstSphere);
+
+  geometryUpdate(root, 0.0);
+  ASSERT_EQ(geometryNeedRebuild(firstSphere), FALSE);
+
+  uint32 epoch = geometryGetFlatTree(root).epoch;
+
+  // NOTE: Nothing has changed, so the update is skipped
+  geometryUpdate(root, 0.0);
+  EXPECT_EQ(geometryGetFlatTree(root).epoch, epoch);
+
+  AssetPtr secondSphere = createSphere("secondSphere");
+  geometryAddChild(rootPtr, secondSphere);
+  EXPECT_EQ(geometryNeedRebuild(secondSphere), TRUE);
+
+  geometryUpdate(root, 0.0);
+
+  EXPECT_NE(geometryGetFlatTree(root).epoch, epoch);
+  EXPECT_EQ(geometryGetFlatTree(root).geometries.size(), 3u);
+  EXPECT_EQ(geometryNeedRebuild(secondSphere), FALSE);
+  EXPECT_NE(geometryGetDrawProgram(secondSphere), ShaderProgramPtr(nullptr));
+}
+
+TEST_F(GeometryTests, SubtractionBranchIsSampledAsWholeForOcclusion)
+{
+  Asset* root = nullptr;
+  createGeometry("root", &root);
+  AssetPtr rootPtr = AssetPtr(root);
+
+  Asset* pcf = nullptr;
+  createPCF("subtraction", PCF_NATIVE_TYPE_SUBTRACTION, &pcf);
+  scriptFunctionSetCode(pcf, "return float2(max(d1, -d2), 0.0); ");
+
+  Asset* subtraction = nullptr;
+  createGeometry("subtraction", &subtraction);
+  AssetPtr subtractionPtr = AssetPtr(subtraction);
+  geometryAddFunction(subtraction, AssetPtr(pcf));
+  geometryAddChild(subtractionPtr, createSphere("carvedSphere"));
+  geometryAddChild(subtractionPtr, createSphere("carvingSphere"));
+
+  Asset* group = nullptr;
+  createGeometry("group", &group);
+  AssetPtr groupPtr = AssetPtr(group);
+  geometryAddChild(groupPtr, createSphere("firstSphere"));
+  geometryAddChild(groupPtr, createSphere("secondSphere"));
+
+  geometryAddChild(rootPtr, subtractionPtr);
+  geometryAddChild(rootPtr, groupPtr);
+
+  geometryUpdate(root, 0.0);
+
+  const GeometryFlatTree& tree = geometryGetFlatTree(root);
+  auto indexOf = [&tree](Asset* geometry)
+  {
+    return std::find(tree.geometries.begin(), tree.geometries.end(), geometry) - tree.geometries.begin();
+  };
+
+  // NOTE: Leaves of the group are combined by min, so they're sampled separately
+  EXPECT_NE(tree.occlusionPrograms[indexOf(subtraction)], nullptr);
+  EXPECT_EQ(tree.occlusionPrograms[indexOf(group)], nullptr);
+}
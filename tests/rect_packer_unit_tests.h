@@ -0,0 +1,89 @@
+#pragma once
+
+#include <random>
+
+#include <gtest/gtest.h>
+#include <maths/rect_packer.h>
+
+static bool8 rectsOverlap(uint2 lopPosition, uint2 lopSize, uint2 ropPosition, uint2 ropSize)
+{
+  return lopPosition.x < ropPosition.x + ropSize.x && ropPosition.x < lopPosition.x + lopSize.x &&
+         lopPosition.y < ropPosition.y + ropSize.y && ropPosition.y < lopPosition.y + lopSize.y;
+}
+
+TEST(RectPackerTests, InsertedRectsDontOverlap)
+{
+  std::mt19937 generator(5);
+  std::uniform_int_distribution<uint32> sizeDistribution(1, 64);
+
+  RectPacker packer;
+  rectPackerInit(packer, uint2(512, 512));
+
+  std::vector<uint2> positions;
+  std::vector<uint2> sizes;
+
+  for(uint32 i = 0; i < 200; i++)
+  {
+    uint2 size = uint2(sizeDistribution(generator), sizeDistribution(generator));
+    uint2 position;
+
+    if(rectPackerInsert(packer, size, position) == TRUE)
+    {
+      positions.push_back(position);
+      sizes.push_back(size);
+    }
+  }
+
+  ASSERT_FALSE(positions.empty());
+
+  for(uint32 i = 0; i < positions.size(); i++)
+  {
+    EXPECT_LE(positions[i].x + sizes[i].x, 512);
+    EXPECT_LE(positions[i].y + sizes[i].y, 512);
+
+    for(uint32 j = i + 1; j < positions.size(); j++)
+    {
+      EXPECT_FALSE(rectsOverlap(positions[i], sizes[i], positions[j], sizes[j]));
+    }
+  }
+}
+
+TEST(RectPackerTests, FullPackerRejectsRect)
+{
+  RectPacker packer;
+  rectPackerInit(packer, uint2(128, 128));
+
+  uint2 position;
+  for(uint32 i = 0; i < 4; i++)
+  {
+    EXPECT_TRUE(rectPackerInsert(packer, uint2(64, 64), position));
+  }
+
+  EXPECT_FALSE(rectPackerInsert(packer, uint2(1, 1), position));
+}
+
+TEST(RectPackerTests, FreedSpaceIsReused)
+{
+  RectPacker packer;
+  rectPackerInit(packer, uint2(128, 128));
+
+  uint2 positions[4];
+  for(uint32 i = 0; i < 4; i++)
+  {
+    ASSERT_TRUE(rectPackerInsert(packer, uint2(64, 64), positions[i]));
+  }
+
+  rectPackerFree(packer, positions[2], uint2(64, 64));
+
+  uint2 position;
+  ASSERT_TRUE(rectPackerInsert(packer, uint2(64, 64), position));
+  EXPECT_EQ(position, positions[2]);
+
+  // NOTE: Adjacent freed rects are merged, so the whole area becomes free again
+  for(uint32 i = 0; i < 4; i++)
+  {
+    rectPackerFree(packer, positions[i], uint2(64, 64));
+  }
+
+  EXPECT_TRUE(rectPackerInsert(packer, uint2(128, 128), position));
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <scene.h>
+
+TEST(ScenePickTests, NothingIsSelectedWithoutHits)
+{
+  EXPECT_EQ(sceneSelectNearestHit({}, 100.0f), -1);
+  EXPECT_EQ(sceneSelectNearestHit({-1.0f, -1.0f}, 100.0f), -1);
+}
+
+TEST(ScenePickTests, NearestHitIsSelected)
+{
+  // NOTE: Candidates are ordered by distances to their bounds, surface of a later one may be closer
+  EXPECT_EQ(sceneSelectNearestHit({-1.0f, 7.0f, 3.0f, 5.0f}, 100.0f), 2);
+  EXPECT_EQ(sceneSelectNearestHit({0.0f, 2.0f}, 100.0f), 0);
+}
+
+TEST(ScenePickTests, EarlierCandidateWinsTie)
+{
+  EXPECT_EQ(sceneSelectNearestHit({4.0f, 4.0f}, 100.0f), 0);
+}
+
+TEST(ScenePickTests, HitsBeyondMaxDistanceAreIgnored)
+{
+  EXPECT_EQ(sceneSelectNearestHit({12.0f, 10.0f}, 10.0f), -1);
+  EXPECT_EQ(sceneSelectNearestHit({12.0f, 9.0f}, 10.0f), 1);
+}